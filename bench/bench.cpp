@@ -0,0 +1,1053 @@
+﻿/*
+ * disk_part_fmt_bench: 各阶段性能基准
+ *
+ * 阶段:
+ *   parse       命令行/布局参数解析
+ *   provision   针对模拟提供程序的端到端分区+格式化 (含虚拟时间吞吐)
+ *   bulk        单盘多分区: 逐个分配盘符与 --bulk 批量提交对比 (含虚拟时间每分区耗时)
+ *   preflight   针对模拟提供程序的并发健康预检 (含虚拟时间总耗时)
+ *   pool        针对模拟提供程序创建条带存储池与虚拟磁盘 (含虚拟时间耗时与列数)
+ *   audit       针对模拟提供程序的并发分区对齐审计 (含虚拟时间总耗时)
+ *   retrim      针对模拟的精简置备磁盘并发 ReTrim (含虚拟时间总耗时与归还容量)
+ *   layout      镜像模式的分区布局规划
+ *   gpt         GPT 结构序列化 (含 CRC32)
+ *   fs          FAT32 元数据生成
+ *   ntfs        NTFS 元数据生成 (含元数据字节数与实际保存的字节数)
+ *   image-write 2 TB 动态 VHDX 写入临时文件 (含写入字节数/次数)
+ *   export      2 TB 镜像导出为稀疏流 (含流字节数)
+ *   apply       稀疏流写入临时文件 (含写入字节数/次数)
+ *   stamp       从黄金镜像盖印一个目标 (克隆 + 补丁, 含补丁字节数/次数)
+ *   cache       从布局缓存读取一个条目 (含条目字节数)
+ *   farm        按作业列表批量生成 64 个小镜像到临时目录: 批大小 × 引擎 (含每秒镜像数与每个镜像的提交次数)
+ *
+ * 每个阶段在多组磁盘数/分区数下运行, 结果以 JSON 输出;
+ * --compare 与基线 JSON 比较, 超过阈值的变慢视为回归 (退出码 1)。
+ *
+ * --check-budgets 不计时, 而是检查每个分区的 WMI 往返次数是否超出预算:
+ * 先对模拟提供程序录制调用, 再经回放后端重放同一布局并计数 (退出码 1 表示超出)。
+ *
+ * 用法:
+ *   disk_part_fmt_bench [--filter=<阶段>[,<阶段>...]] [--disks=1,16,256] [--partitions=1,8,32]
+ *                       [--min-time=0.2] [--out=<文件>|-] [--compare=<基线>] [--threshold=10]
+ *   disk_part_fmt_bench --check-budgets
+ */
+
+#include "audit.h"
+#include "cli.h"
+#include "gpt.h"
+#include "image.h"
+#include "image_farm.h"
+#include "layout_cache.h"
+#include "preflight.h"
+#include "provision.h"
+#include "retrim.h"
+#include "storage_pool.h"
+#include "sparse_stream.h"
+#include "stamp.h"
+#include "replay_backend.h"
+#include "sim_backend.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <clocale>
+#include <cstring>
+#include <langinfo.h>
+#endif
+
+using namespace std;
+
+// ================================
+// 基准框架
+// ================================
+
+struct BenchOptions {
+    set<wstring> filter;            // 只运行这些阶段 (名称精确匹配), 为空时运行全部
+    vector<int> diskCounts = { 1, 16, 256 };
+    vector<int> partitionCounts = { 1, 8, 32 };
+    double minTime = 0.2;           // 每个用例的最短采样时间 (秒)
+    wstring outPath = L"-";
+    wstring comparePath;
+    double threshold = 10.0;        // 回归阈值 (百分比)
+    bool checkBudgets = false;
+};
+
+struct BenchResult {
+    string name;
+    string phase;
+    vector<pair<string, long long>> params;
+    long long iterations = 0;
+    double nsPerOp = 0;             // 各批次中位数
+    double minNsPerOp = 0;
+    vector<pair<string, double>> metrics;
+};
+
+// 防止被优化掉的结果汇总
+static volatile size_t g_sink = 0;
+
+class BenchRunner {
+public:
+    explicit BenchRunner(const BenchOptions& options) : options(options) {}
+
+    // 反复执行 body, 直到达到最短采样时间; 取 5 个批次的中位数
+    // (单次执行已超过采样时间的长用例只取 3 次)
+    void Run(const string& phase, const vector<pair<string, long long>>& params, const function<void()>& body) {
+        using clock = chrono::steady_clock;
+        int batches = 5;
+
+        BenchResult result;
+        result.phase = phase;
+        result.params = params;
+        result.name = phase;
+        for (const auto& p : params) {
+            result.name += "/" + p.first + "=" + to_string(p.second);
+        }
+
+        // 标定每批次的迭代次数
+        long long perBatch = 1;
+        for (;;) {
+            auto start = clock::now();
+            for (long long i = 0; i < perBatch; i++) body();
+            double elapsed = chrono::duration<double>(clock::now() - start).count();
+            if (perBatch == 1 && elapsed >= options.minTime) {
+                batches = 3;
+                break;
+            }
+            if (elapsed >= options.minTime / batches || perBatch >= (1LL << 30)) break;
+            perBatch = elapsed <= 0 ? perBatch * 10
+                : max(perBatch + 1, (long long)(perBatch * (options.minTime / batches) / elapsed * 1.2));
+        }
+
+        vector<double> samples;
+        for (int b = 0; b < batches; b++) {
+            auto start = clock::now();
+            for (long long i = 0; i < perBatch; i++) body();
+            double ns = (double)chrono::duration_cast<chrono::nanoseconds>(clock::now() - start).count();
+            samples.push_back(ns / perBatch);
+        }
+        sort(samples.begin(), samples.end());
+
+        result.iterations = perBatch * batches;
+        result.nsPerOp = samples[batches / 2];
+        result.minNsPerOp = samples.front();
+        results.push_back(result);
+
+        wcout << L"  " << left << setw(44) << FromUtf8(result.name) << right
+            << setw(14) << fixed << setprecision(0) << result.nsPerOp << L" ns/op" << endl;
+    }
+
+    // 附加到最近一个结果上的指标
+    void AddMetric(const string& name, double value) {
+        results.back().metrics.push_back({ name, value });
+        wcout << L"    " << FromUtf8(name) << L" = " << fixed << setprecision(2) << value << endl;
+    }
+
+    const vector<BenchResult>& Results() const { return results; }
+
+private:
+    const BenchOptions& options;
+    vector<BenchResult> results;
+};
+
+// ================================
+// 阶段: parse
+// ================================
+
+// 构造 N 个分区的命令行
+static vector<wstring> MakeLayoutArgs(int diskCount, int partitionCount) {
+    vector<wstring> args = { L"disk_part_fmt", L"--disk=1-" + to_wstring(diskCount), L"--gpt" };
+
+    for (int i = 0; i < partitionCount; i++) {
+        args.push_back(L"--create-part=size=1G,label=Part" + to_wstring(i) + L",type=basic");
+        args.push_back(L"--format=fs=ntfs,vol=Vol" + to_wstring(i) + L",quick=1");
+    }
+    return args;
+}
+
+static void BenchParse(BenchRunner& runner, const BenchOptions& options) {
+    for (int partitions : options.partitionCounts) {
+        auto args = MakeLayoutArgs(64, partitions);
+        vector<wchar_t*> argv;
+        for (auto& arg : args) argv.push_back(&arg[0]);
+
+        runner.Run("parse", { {"partitions", partitions} }, [&]() {
+            auto parsed = ParseCommandLine((int)argv.size(), argv.data());
+            g_sink = g_sink + parsed.partitions.size();
+        });
+    }
+}
+
+// ================================
+// 阶段: provision (模拟提供程序端到端)
+// ================================
+
+static void BenchProvision(BenchRunner& runner, const BenchOptions& options) {
+    for (int disks : options.diskCounts) {
+        for (int partitions : options.partitionCounts) {
+            auto argStrings = MakeLayoutArgs(disks, partitions);
+            vector<wchar_t*> argv;
+            for (auto& arg : argStrings) argv.push_back(&arg[0]);
+
+            CommandLineArgs args = ParseCommandLine((int)argv.size(), argv.data());
+            args.quiet = true;
+            args.concurrency = min(16, disks);
+            args.simConfig.diskCount = disks;
+
+            double makespan = 0;
+            size_t succeeded = 0;
+
+            runner.Run("provision", { {"disks", disks}, {"partitions", partitions} }, [&]() {
+                SimulatedStorage storage(args.simConfig);
+                auto results = ProvisionDisks(storage.Factory(), args);
+
+                auto first = chrono::nanoseconds::max();
+                auto last = chrono::nanoseconds::min();
+                succeeded = 0;
+                for (const auto& r : results) {
+                    if (r.success) succeeded++;
+                    first = min(first, r.started);
+                    last = max(last, r.finished);
+                }
+                makespan = chrono::duration<double>(last - first).count();
+                g_sink = g_sink + succeeded;
+            });
+
+            // 模拟 (虚拟时间) 下的容量指标
+            runner.AddMetric("sim_makespan_s", makespan);
+            runner.AddMetric("sim_disks_per_hour", makespan > 0 ? succeeded * 3600.0 / makespan : 0);
+        }
+    }
+}
+
+// ================================
+// 阶段: bulk (单盘多分区, 逐个挂载 vs 批量提交)
+// ================================
+
+static void BenchBulk(BenchRunner& runner, const BenchOptions& options) {
+    for (int partitions : options.partitionCounts) {
+        for (int bulk = 0; bulk <= 1; bulk++) {
+            auto argStrings = MakeLayoutArgs(1, partitions);
+            if (bulk) argStrings.push_back(L"--bulk");
+            vector<wchar_t*> argv;
+            for (auto& arg : argStrings) argv.push_back(&arg[0]);
+
+            CommandLineArgs args = ParseCommandLine((int)argv.size(), argv.data());
+            args.quiet = true;
+            args.simConfig.diskCount = 1;
+
+            double elapsed = 0;
+
+            runner.Run("bulk", { {"partitions", partitions}, {"bulk", bulk} }, [&]() {
+                SimulatedStorage storage(args.simConfig);
+                auto results = ProvisionDisks(storage.Factory(), args);
+                elapsed = chrono::duration<double>(results[0].finished - results[0].started).count();
+                g_sink = g_sink + results[0].success;
+            });
+
+            // 每分区耗时应与分区数无关
+            runner.AddMetric("sim_disk_s", elapsed);
+            runner.AddMetric("sim_s_per_partition", elapsed / partitions);
+        }
+    }
+}
+
+// ================================
+// 阶段: preflight (并发健康预检)
+// ================================
+
+static void BenchPreflight(BenchRunner& runner, const BenchOptions& options) {
+    for (int disks : options.diskCounts) {
+        SimConfig config = SimConfig::Default();
+        config.diskCount = disks;
+
+        vector<int> diskNumbers;
+        for (int i = 0; i < disks; i++) diskNumbers.push_back(config.firstDiskNumber + i);
+
+        PreflightSpec spec;
+        spec.enabled = true;
+
+        double makespan = 0;
+
+        runner.Run("preflight", { {"disks", disks} }, [&]() {
+            SimulatedStorage storage(config);
+            PreflightProbe probe;
+            probe.read = [&storage](int diskNumber, ULONGLONG, int samples, vector<double>& latenciesMs) {
+                return storage.ProbeRead(diskNumber, samples, latenciesMs);
+            };
+            probe.simulated = true;
+
+            auto results = RunPreflight(storage.Factory(), diskNumbers, spec, probe, PREFLIGHT_MAX_WORKERS);
+
+            auto first = chrono::nanoseconds::max();
+            auto last = chrono::nanoseconds::min();
+            size_t passed = 0;
+            for (const auto& r : results) {
+                if (r.Passed()) passed++;
+                first = min(first, r.started);
+                last = max(last, r.finished);
+            }
+            makespan = chrono::duration<double>(last - first).count();
+            g_sink = g_sink + passed;
+        });
+
+        runner.AddMetric("sim_makespan_s", makespan);
+    }
+}
+
+// ================================
+// 阶段: pool (条带存储池)
+// ================================
+
+static void BenchPool(BenchRunner& runner, const BenchOptions& options) {
+    for (int disks : options.diskCounts) {
+        SimConfig config = SimConfig::Default();
+        config.diskCount = disks;
+
+        vector<int> diskNumbers;
+        for (int i = 0; i < disks; i++) diskNumbers.push_back(config.firstDiskNumber + i);
+
+        PoolSpec spec;
+        spec.enabled = true;
+        StripeLayout stripe = PlanStripe(spec, disks, L"ntfs", 0);
+
+        double elapsed = 0;
+
+        runner.Run("pool", { {"disks", disks} }, [&]() {
+            SimulatedStorage storage(config);
+            WMIManager wmi;
+            wmi.Initialize(storage.Factory()());
+
+            auto start = wmi.Now();
+            PooledDisk pooled;
+            bool ok = CreatePooledDisk(wmi, spec, diskNumbers, stripe, pooled, false);
+            elapsed = chrono::duration<double>(wmi.Now() - start).count();
+            g_sink = g_sink + (ok ? pooled.diskNumber : 0);
+        });
+
+        runner.AddMetric("sim_s", elapsed);
+        runner.AddMetric("columns", stripe.columns);
+    }
+}
+
+// ================================
+// 阶段: audit (分区对齐审计)
+// ================================
+
+static void BenchAudit(BenchRunner& runner, const BenchOptions& options) {
+    const ULONGLONG MB = 1024ULL * 1024;
+
+    for (int disks : options.diskCounts) {
+        // 每块磁盘两个旧布局分区: 63 扇区起点 (错位) 与 1M 对齐
+        SimConfig config = SimConfig::Default();
+        config.diskCount = disks;
+        for (int i = 0; i < disks; i++) {
+            config.partitions[config.firstDiskNumber + i] = { { 63 * 512, 100 * MB }, { 101 * MB, 100 * MB } };
+        }
+
+        AuditSpec spec;
+        spec.enabled = true;
+
+        double makespan = 0;
+
+        runner.Run("audit", { {"disks", disks} }, [&]() {
+            SimulatedStorage storage(config);
+            auto results = RunAudit(storage.Factory(), {}, spec, AUDIT_MAX_WORKERS);
+
+            auto first = chrono::nanoseconds::max();
+            auto last = chrono::nanoseconds::min();
+            size_t misaligned = 0;
+            for (const auto& disk : results) {
+                misaligned += disk.Misaligned();
+                first = min(first, disk.started);
+                last = max(last, disk.finished);
+            }
+            makespan = chrono::duration<double>(last - first).count();
+            g_sink = g_sink + misaligned;
+        });
+
+        runner.AddMetric("sim_makespan_s", makespan);
+    }
+}
+
+// ================================
+// 阶段: retrim (精简置备空间回收)
+// ================================
+
+static void BenchRetrim(BenchRunner& runner, const BenchOptions& options) {
+    const ULONGLONG GB = 1024ULL * 1024 * 1024;
+
+    for (int disks : options.diskCounts) {
+        // 每块磁盘一个写满的 100G 卷 (相当于完全格式化之后)
+        SimConfig config = SimConfig::Default();
+        config.diskCount = disks;
+        config.thin = true;
+
+        vector<int> diskNumbers;
+        for (int i = 0; i < disks; i++) {
+            diskNumbers.push_back(config.firstDiskNumber + i);
+            config.partitions[config.firstDiskNumber + i] = { { 1024 * 1024, 100 * GB } };
+        }
+
+        RetrimSpec spec;
+        double makespan = 0;
+        ULONGLONG returned = 0;
+
+        runner.Run("retrim", { {"disks", disks} }, [&]() {
+            SimulatedStorage storage(config);
+            auto results = RunRetrim(storage.Factory(), diskNumbers, (size_t)spec.concurrency);
+
+            auto first = chrono::nanoseconds::max();
+            auto last = chrono::nanoseconds::min();
+            returned = 0;
+            for (const auto& r : results) {
+                returned += r.ReturnedBytes();
+                first = min(first, r.started);
+                last = max(last, r.finished);
+            }
+            makespan = chrono::duration<double>(last - first).count();
+            g_sink = g_sink + returned;
+        });
+
+        runner.AddMetric("sim_makespan_s", makespan);
+        runner.AddMetric("returned_gib", (double)returned / GB);
+    }
+}
+
+// ================================
+// 阶段: layout / gpt / fs / ntfs / image-write / export / apply / stamp / cache (镜像模式)
+// ================================
+
+// 2 TB 磁盘上 N 个 1 GiB 的分区 (默认 FAT32)
+static CommandLineArgs MakeImageArgs(int partitionCount, const wstring& imagePath, const wstring& fileSystem = L"fat32") {
+    vector<wstring> argStrings = { L"disk_part_fmt", L"--image=" + imagePath, L"--image-size=2T" };
+    for (int i = 0; i < partitionCount; i++) {
+        argStrings.push_back(L"--create-part=size=1G,label=Part" + to_wstring(i) + L",type=basic");
+        argStrings.push_back(L"--format=fs=" + fileSystem + L",vol=Vol" + to_wstring(i));
+    }
+
+    vector<wchar_t*> argv;
+    for (auto& arg : argStrings) argv.push_back(&arg[0]);
+
+    CommandLineArgs args = ParseCommandLine((int)argv.size(), argv.data());
+    args.quiet = true;
+    return args;
+}
+
+static void BenchLayout(BenchRunner& runner, const BenchOptions& options) {
+    for (int partitions : options.partitionCounts) {
+        CommandLineArgs args = MakeImageArgs(partitions, L"bench.vhdx");
+        mt19937_64 rng(1);
+
+        runner.Run("layout", { {"partitions", partitions} }, [&]() {
+            DiskLayout layout;
+            PlanLayout(args, args.imageSize, args.imageSectorSize, 4096, rng, layout);
+            g_sink = g_sink + layout.partitions.size();
+        });
+    }
+}
+
+static void BenchGpt(BenchRunner& runner, const BenchOptions& options) {
+    for (int partitions : options.partitionCounts) {
+        CommandLineArgs args = MakeImageArgs(partitions, L"bench.vhdx");
+        mt19937_64 rng(1);
+        DiskLayout layout;
+        PlanLayout(args, args.imageSize, args.imageSectorSize, 4096, rng, layout);
+
+        runner.Run("gpt", { {"partitions", partitions} }, [&]() {
+            ExtentList extents;
+            WriteGpt(layout, extents);
+            g_sink = g_sink + extents.Count();
+        });
+    }
+}
+
+static void BenchFs(BenchRunner& runner, const BenchOptions& options) {
+    for (int partitions : options.partitionCounts) {
+        CommandLineArgs args = MakeImageArgs(partitions, L"bench.vhdx");
+        mt19937_64 rng(1);
+        DiskLayout layout;
+        PlanLayout(args, args.imageSize, args.imageSectorSize, 4096, rng, layout);
+
+        runner.Run("fs", { {"partitions", partitions} }, [&]() {
+            ExtentList extents;
+            for (const auto& part : layout.partitions) {
+                FormatImagePartition(layout, part, rng, extents);
+            }
+            g_sink = g_sink + extents.Count();
+        });
+    }
+}
+
+static void BenchNtfs(BenchRunner& runner, const BenchOptions& options) {
+    for (int partitions : options.partitionCounts) {
+        CommandLineArgs args = MakeImageArgs(partitions, L"bench.vhdx", L"ntfs");
+        mt19937_64 rng(1);
+        DiskLayout layout;
+        PlanLayout(args, args.imageSize, args.imageSectorSize, 4096, rng, layout);
+
+        ULONGLONG metadataBytes = 0;
+        ULONGLONG storedBytes = 0;
+        runner.Run("ntfs", { {"partitions", partitions} }, [&]() {
+            ExtentList extents;
+            for (const auto& part : layout.partitions) {
+                FormatImagePartition(layout, part, rng, extents);
+            }
+            metadataBytes = extents.DataBytes();
+            storedBytes = extents.StoredBytes();
+            g_sink = g_sink + extents.Count();
+        });
+
+        runner.AddMetric("metadata_bytes", (double)metadataBytes);
+        runner.AddMetric("stored_bytes", (double)storedBytes);
+    }
+}
+
+static void BenchImageWrite(BenchRunner& runner, const BenchOptions& options) {
+    const wstring path = (filesystem::temp_directory_path() / "disk_part_fmt_bench.vhdx").wstring();
+
+    for (int partitions : options.partitionCounts) {
+        CommandLineArgs args = MakeImageArgs(partitions, path);
+        mt19937_64 rng(1);
+        DiskLayout layout;
+        ExtentList extents;
+        if (!BuildImage(args, rng, layout, extents)) continue;
+
+        ImageWriteStats stats;
+        runner.Run("image-write", { {"partitions", partitions} }, [&]() {
+            WriteImageFile(args, layout, extents, rng, stats);
+            g_sink = g_sink + (size_t)stats.bytesWritten;
+        });
+
+        runner.AddMetric("bytes_written", (double)stats.bytesWritten);
+        runner.AddMetric("write_count", (double)stats.writeCount);
+        runner.AddMetric("allocated_blocks", (double)stats.allocatedBlocks);
+    }
+
+    error_code ec;
+    filesystem::remove(path, ec);
+}
+
+static void BenchExport(BenchRunner& runner, const BenchOptions& options) {
+    const wstring path = (filesystem::temp_directory_path() / "disk_part_fmt_bench.simg").wstring();
+
+    for (int partitions : options.partitionCounts) {
+        CommandLineArgs args = MakeImageArgs(partitions, path);
+        mt19937_64 rng(1);
+        DiskLayout layout;
+        ExtentList extents;
+        if (!BuildImage(args, rng, layout, extents)) continue;
+
+        SparseStats stats;
+        runner.Run("export", { {"partitions", partitions} }, [&]() {
+            OutputStream out;
+            out.Open(path);
+            ExportSparse(extents, layout.diskSize, out, stats);
+            out.Close();
+            g_sink = g_sink + (size_t)stats.streamBytes;
+        });
+
+        runner.AddMetric("stream_bytes", (double)stats.streamBytes);
+        runner.AddMetric("chunks", (double)stats.chunks);
+    }
+
+    error_code ec;
+    filesystem::remove(path, ec);
+}
+
+static void BenchApply(BenchRunner& runner, const BenchOptions& options) {
+    const wstring streamPath = (filesystem::temp_directory_path() / "disk_part_fmt_bench.simg").wstring();
+    const wstring targetPath = (filesystem::temp_directory_path() / "disk_part_fmt_bench.img").wstring();
+
+    for (int partitions : options.partitionCounts) {
+        CommandLineArgs args = MakeImageArgs(partitions, streamPath);
+        mt19937_64 rng(1);
+        DiskLayout layout;
+        ExtentList extents;
+        if (!BuildImage(args, rng, layout, extents)) continue;
+
+        SparseStats exported;
+        OutputStream out;
+        if (!out.Open(streamPath) || !ExportSparse(extents, layout.diskSize, out, exported) || !out.Close()) continue;
+
+        SparseStats stats;
+        ULONGLONG bytesWritten = 0;
+        runner.Run("apply", { {"partitions", partitions} }, [&]() {
+            InputStream in;
+            OutputFile target;
+            in.Open(streamPath);
+            target.Create(targetPath);
+            ApplySparse(in, target, stats);
+            bytesWritten = target.BytesWritten();
+            target.Close();
+            g_sink = g_sink + (size_t)bytesWritten;
+        });
+
+        runner.AddMetric("bytes_written", (double)bytesWritten);
+        runner.AddMetric("write_count", (double)stats.writeCount);
+    }
+
+    error_code ec;
+    filesystem::remove(streamPath, ec);
+    filesystem::remove(targetPath, ec);
+}
+
+static void BenchStamp(BenchRunner& runner, const BenchOptions& options) {
+    const auto tempDir = filesystem::temp_directory_path();
+    const wstring pattern = (tempDir / "disk_part_fmt_bench_stamp{n}.img").wstring();
+
+    for (int partitions : options.partitionCounts) {
+        CommandLineArgs args = MakeImageArgs(partitions, pattern);
+        for (auto& format : args.formats) format.volumeLabel += L"{n}";
+        mt19937_64 rng(1);
+
+        CommandLineArgs goldenArgs = StampArgs(args, 1);
+        DiskLayout layout;
+        ExtentList extents;
+        ExtentList golden;
+        ImageWriteStats goldenStats;
+        if (!BuildImage(goldenArgs, rng, layout, extents)
+            || !BuildImageFile(goldenArgs, layout, extents, rng, golden, goldenStats)
+            || !WriteImageContent(goldenArgs.imagePath, golden, goldenStats)) {
+            continue;
+        }
+
+        CommandLineArgs target = StampArgs(args, 2);
+        StampResult result;
+        runner.Run("stamp", { {"partitions", partitions} }, [&]() {
+            StampImage(goldenArgs.imagePath, golden, goldenStats.fileSize, target, rng, result);
+            g_sink = g_sink + (size_t)result.patchBytes;
+        });
+
+        runner.AddMetric("patch_bytes", (double)result.patchBytes);
+        runner.AddMetric("patch_writes", (double)result.patchWrites);
+        runner.AddMetric("copied_bytes", (double)result.copiedBytes);
+
+        error_code ec;
+        filesystem::remove(goldenArgs.imagePath, ec);
+        filesystem::remove(target.imagePath, ec);
+    }
+}
+
+static void BenchCache(BenchRunner& runner, const BenchOptions& options) {
+    const auto cacheDir = filesystem::temp_directory_path() / "disk_part_fmt_bench_cache";
+
+    for (int partitions : options.partitionCounts) {
+        CommandLineArgs args = MakeImageArgs(partitions, L"bench.vhdx");
+        args.hasImageSeed = true;
+        args.imageSeed = 1;
+        mt19937_64 rng = MakeImageRng(args, IMAGE_RNG_LAYOUT);
+
+        DiskLayout layout;
+        ExtentList extents;
+        LayoutCache cache(cacheDir.wstring());
+        const string key = ImageSpecKey(args);
+        if (!BuildImage(args, rng, layout, extents) || !cache.Store(key, layout, extents)) continue;
+
+        runner.Run("cache", { {"partitions", partitions} }, [&]() {
+            DiskLayout loaded;
+            ExtentList loadedExtents;
+            cache.Load(key, loaded, loadedExtents);
+            g_sink = g_sink + loadedExtents.Count();
+        });
+
+        runner.AddMetric("entry_bytes", (double)cache.Stats().cacheBytes);
+
+        error_code ec;
+        filesystem::remove_all(cacheDir, ec);
+    }
+}
+
+// ================================
+// 阶段: farm (批量镜像)
+// ================================
+
+static void BenchFarm(BenchRunner& runner, const BenchOptions&) {
+    const auto farmDir = filesystem::temp_directory_path() / "disk_part_fmt_bench_farm";
+    const int jobCount = 64;
+
+    // 只有 GPT 的小镜像, 耗时以写入与刷新的提交为主
+    FarmJobList list;
+    list.layouts.push_back({ L"small", { L"--image-size=1G", L"--create-part=size=16M,label=Part{n}" } });
+    for (int i = 0; i < jobCount; i++) {
+        list.jobs.push_back({ (farmDir / ("image" + to_string(i) + ".img")).wstring(), 0 });
+    }
+
+    vector<FarmEngine> engines = { FarmEngine::Threads };
+    if (FarmIoUringAvailable()) engines.push_back(FarmEngine::IoUring);
+
+    for (FarmEngine engine : engines) {
+        for (int batch : { 1, 8, 64 }) {
+            FarmSpec spec;
+            spec.batch = (size_t)batch;
+            spec.engine = engine;
+
+            FarmResult result;
+            runner.Run("farm", { {"batch", batch}, {"io_uring", engine == FarmEngine::IoUring ? 1 : 0} }, [&]() {
+                RunFarm(spec, list, result);
+                g_sink = g_sink + result.images;
+            });
+
+            double ns = runner.Results().back().nsPerOp;
+            runner.AddMetric("images_per_s", ns > 0 ? jobCount * 1e9 / ns : 0);
+            runner.AddMetric("enters_per_image", (double)result.enters / jobCount);
+        }
+    }
+
+    error_code ec;
+    filesystem::remove_all(farmDir, ec);
+}
+
+// ================================
+// 阶段注册表
+// ================================
+
+struct BenchPhase {
+    const wchar_t* name;
+    function<void(BenchRunner&, const BenchOptions&)> run;
+};
+
+static const vector<BenchPhase>& Phases() {
+    static const vector<BenchPhase> phases = {
+        { L"parse", BenchParse },
+        { L"provision", BenchProvision },
+        { L"bulk", BenchBulk },
+        { L"preflight", BenchPreflight },
+        { L"pool", BenchPool },
+        { L"audit", BenchAudit },
+        { L"retrim", BenchRetrim },
+        { L"layout", BenchLayout },
+        { L"gpt", BenchGpt },
+        { L"fs", BenchFs },
+        { L"ntfs", BenchNtfs },
+        { L"image-write", BenchImageWrite },
+        { L"export", BenchExport },
+        { L"apply", BenchApply },
+        { L"stamp", BenchStamp },
+        { L"cache", BenchCache },
+        { L"farm", BenchFarm },
+    };
+    return phases;
+}
+
+// ================================
+// JSON 输出与基线比较
+// ================================
+
+static string EscapeJson(const string& str) {
+    string out;
+    for (char c : str) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+static string ResultsToJson(const vector<BenchResult>& results) {
+    ostringstream json;
+    json << fixed << setprecision(2);
+    json << "{\n  \"tool\": \"disk_part_fmt_bench\",\n  \"results\": [\n";
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& r = results[i];
+        json << "    {\"name\": \"" << EscapeJson(r.name) << "\", \"phase\": \"" << r.phase << "\", \"params\": {";
+        for (size_t k = 0; k < r.params.size(); k++) {
+            json << (k ? ", " : "") << "\"" << r.params[k].first << "\": " << r.params[k].second;
+        }
+        json << "}, \"iterations\": " << r.iterations
+            << ", \"ns_per_op\": " << r.nsPerOp
+            << ", \"min_ns_per_op\": " << r.minNsPerOp
+            << ", \"metrics\": {";
+        for (size_t k = 0; k < r.metrics.size(); k++) {
+            json << (k ? ", " : "") << "\"" << r.metrics[k].first << "\": " << r.metrics[k].second;
+        }
+        json << "}}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+
+    json << "  ]\n}\n";
+    return json.str();
+}
+
+// 读取基线: 只需要每个结果的 name 与 min_ns_per_op (最快批次受噪声影响最小)
+static bool LoadBaseline(const wstring& path, map<string, double>& baseline) {
+    ifstream in(ToUtf8(path));
+    if (!in) return false;
+
+    stringstream buffer;
+    buffer << in.rdbuf();
+    const string text = buffer.str();
+
+    const string nameKey = "\"name\": \"";
+    const string valueKey = "\"min_ns_per_op\": ";
+
+    for (size_t pos = text.find(nameKey); pos != string::npos; pos = text.find(nameKey, pos)) {
+        pos += nameKey.size();
+        size_t end = text.find('"', pos);
+        size_t value = text.find(valueKey, end);
+        if (end == string::npos || value == string::npos) break;
+
+        baseline[text.substr(pos, end - pos)] = strtod(text.c_str() + value + valueKey.size(), nullptr);
+        pos = value;
+    }
+
+    return true;
+}
+
+static int CompareWithBaseline(const vector<BenchResult>& results, const BenchOptions& options) {
+    map<string, double> baseline;
+    if (!LoadBaseline(options.comparePath, baseline)) {
+        wcerr << L"❌ 无法读取基线: " << options.comparePath << endl;
+        return 1;
+    }
+
+    int regressions = 0;
+
+    wcout << L"\n📈 与基线比较 (阈值 " << options.threshold << L"%)" << endl;
+    for (const auto& r : results) {
+        auto it = baseline.find(r.name);
+        if (it == baseline.end() || it->second <= 0) continue;
+
+        double delta = (r.minNsPerOp - it->second) / it->second * 100.0;
+        bool regressed = delta > options.threshold;
+        if (regressed) regressions++;
+
+        wcout << L"  " << (regressed ? L"❌ " : L"✓ ") << left << setw(44) << FromUtf8(r.name) << right
+            << showpos << setw(8) << setprecision(1) << delta << noshowpos << L"%" << endl;
+    }
+
+    if (regressions > 0) {
+        wcerr << L"❌ " << regressions << L" 项超过回归阈值" << endl;
+        return 1;
+    }
+
+    wcout << L"✓ 无回归" << endl;
+    return 0;
+}
+
+// ================================
+// WMI 往返次数预算
+// ================================
+
+struct CallBudget {
+    const char* name;
+    bool label;                                         // 设置 GPT 分区名称
+    bool format;                                        // 格式化 (含盘符查询)
+    bool bulk;                                          // --bulk: 另有每盘一次 UpdateHostStorageCache
+    array<unsigned, CALL_KIND_COUNT> perPartition;      // 按 CallKind 顺序
+};
+
+// 每个分区允许的往返次数; 热路径上新增调用时需要同时调整这里
+static const vector<CallBudget>& Budgets() {
+    //                                              Query Next GetObj GetMeth Spawn Exec Put
+    static const vector<CallBudget> budgets = {
+        { "create+name+format", true, true, false,  { 2,    2,   3,     2,      2,    2,   1 } },
+        { "create+format",      false, true, false, { 2,    2,   2,     2,      2,    2,   0 } },
+        { "create+name",        true, false, false, { 0,    0,   2,     1,      1,    1,   1 } },
+        { "create",             false, false, false,{ 0,    0,   1,     1,      1,    1,   0 } },
+        { "bulk create+format", false, true, true,  { 1,    1,   2,     2,      2,    2,   0 } },
+    };
+    return budgets;
+}
+
+static CommandLineArgs MakeBudgetArgs(const CallBudget& budget, int partitionCount) {
+    vector<wstring> argStrings = { L"disk_part_fmt", L"--disk=1" };
+    if (budget.bulk) argStrings.push_back(L"--bulk");
+    for (int i = 0; i < partitionCount; i++) {
+        argStrings.push_back(L"--create-part=size=1G" + (budget.label ? L",label=Part" + to_wstring(i) : wstring()));
+        if (budget.format) {
+            argStrings.push_back(L"--format=fs=ntfs,vol=Vol" + to_wstring(i));
+        }
+    }
+
+    vector<wchar_t*> argv;
+    for (auto& arg : argStrings) argv.push_back(&arg[0]);
+
+    CommandLineArgs args = ParseCommandLine((int)argv.size(), argv.data());
+    args.quiet = true;
+    return args;
+}
+
+// 录制一次模拟执行, 再回放并按回放计数检查预算
+static bool CheckBudget(const CallBudget& budget, int partitionCount) {
+    CommandLineArgs args = MakeBudgetArgs(budget, partitionCount);
+
+    SimulatedStorage storage(args.simConfig);
+    CallRecorder recorder;
+    {
+        WMIManager wmi;
+        wmi.Initialize(recorder.Wrap(storage.Factory())());
+        DiskManager diskMgr(wmi);
+        diskMgr.SetVerbose(false);
+        if (!ProvisionDisk(diskMgr, 1, args)) {
+            wcerr << L"  ❌ " << budget.name << L": 模拟执行失败" << endl;
+            return false;
+        }
+    }
+
+    CallReplayer replayer(recorder.Sessions());
+    WMIManager wmi;
+    wmi.Initialize(replayer.Factory()());
+    DiskManager diskMgr(wmi);
+    diskMgr.SetVerbose(false);
+    if (!ProvisionDisk(diskMgr, 1, args) || !replayer.Complete()) {
+        wcerr << L"  ❌ " << budget.name << L": 回放与录制的调用序列不一致" << endl;
+        return false;
+    }
+
+    const CallStats& stats = wmi.Stats();
+    unsigned long long allowed = 0;
+    vector<wstring> violations;
+
+    for (size_t i = 0; i < CALL_KIND_COUNT; i++) {
+        unsigned long long limit = (unsigned long long)budget.perPartition[i] * partitionCount;
+        if (budget.bulk && i == (size_t)CallKind::ExecMethod) limit++;
+        allowed += limit;
+        if (stats.count[i] > limit) {
+            violations.push_back(wstring(CallKindName((CallKind)i)) + L": "
+                + to_wstring(stats.count[i]) + L" > " + to_wstring(limit));
+        }
+    }
+
+    wcout << L"  " << (violations.empty() ? L"✓ " : L"❌ ") << left << setw(22) << FromUtf8(budget.name) << right
+        << setw(4) << stats.Total() << L" / " << allowed << L" 次往返 (" << partitionCount << L" 个分区)" << endl;
+    for (const auto& violation : violations) {
+        wcout << L"      " << violation << endl;
+    }
+
+    return violations.empty();
+}
+
+static int CheckBudgets(const BenchOptions& options) {
+    wcout << L"\n📞 WMI 往返次数预算" << endl;
+
+    int failures = 0;
+    for (const auto& budget : Budgets()) {
+        for (int partitions : options.partitionCounts) {
+            if (!CheckBudget(budget, partitions)) failures++;
+        }
+    }
+
+    if (failures > 0) {
+        wcerr << L"❌ " << failures << L" 项超出往返次数预算" << endl;
+        return 1;
+    }
+
+    wcout << L"✓ 全部在预算内" << endl;
+    return 0;
+}
+
+// ================================
+// 主程序
+// ================================
+
+static int RunBench(int argc, wchar_t* argv[]) {
+    BenchOptions options;
+    bool invalid = false;
+
+    for (int i = 1; i < argc; i++) {
+        wstring arg = argv[i];
+
+        if (arg.find(L"--filter=") == 0) {
+            for (const auto& name : SplitString(arg.substr(9), L',')) {
+                if (!name.empty()) options.filter.insert(name);
+            }
+        }
+        else if (arg.find(L"--disks=") == 0) {
+            ParseNumberArg(arg, invalid, [&]() { options.diskCounts = ParseNumberList(arg.substr(8)); });
+        }
+        else if (arg.find(L"--partitions=") == 0) {
+            ParseNumberArg(arg, invalid, [&]() { options.partitionCounts = ParseNumberList(arg.substr(13)); });
+        }
+        else if (arg.find(L"--min-time=") == 0) {
+            ParseNumberArg(arg, invalid, [&]() { options.minTime = stod(arg.substr(11)); });
+        }
+        else if (arg.find(L"--out=") == 0) options.outPath = arg.substr(6);
+        else if (arg.find(L"--compare=") == 0) options.comparePath = arg.substr(10);
+        else if (arg.find(L"--threshold=") == 0) {
+            ParseNumberArg(arg, invalid, [&]() { options.threshold = stod(arg.substr(12)); });
+        }
+        else if (arg == L"--check-budgets") options.checkBudgets = true;
+        else {
+            wcerr << L"❌ 未知参数: " << arg << endl;
+            return 1;
+        }
+    }
+
+    if (invalid) {
+        return 1;
+    }
+
+    if (options.checkBudgets) {
+        return CheckBudgets(options);
+    }
+
+    for (const auto& name : options.filter) {
+        bool known = any_of(Phases().begin(), Phases().end(), [&](const BenchPhase& phase) { return name == phase.name; });
+        if (!known) {
+            wcerr << L"❌ 未知阶段: " << name << endl;
+            return 1;
+        }
+    }
+
+    BenchRunner runner(options);
+
+    for (const auto& phase : Phases()) {
+        if (!options.filter.empty() && !options.filter.count(phase.name)) continue;
+
+        wcout << L"\n⏱  阶段: " << phase.name << endl;
+        phase.run(runner, options);
+    }
+
+    string json = ResultsToJson(runner.Results());
+    if (options.outPath == L"-") {
+        wcout << L"\n" << FromUtf8(json);
+    }
+    else {
+        ofstream out(ToUtf8(options.outPath), ios::binary);
+        out << json;
+        wcout << L"\n✓ 结果已写入 " << options.outPath << endl;
+    }
+
+    if (!options.comparePath.empty()) {
+        return CompareWithBaseline(runner.Results(), options);
+    }
+    return 0;
+}
+
+#ifdef _WIN32
+int wmain(int argc, wchar_t* argv[]) {
+    return RunBench(argc, argv);
+}
+#else
+int main(int argc, char* argv[]) {
+    // 宽字符输出需要 UTF-8 locale
+    setlocale(LC_ALL, "");
+    if (strcmp(nl_langinfo(CODESET), "UTF-8") != 0) {
+        setlocale(LC_ALL, "C.UTF-8");
+    }
+
+    vector<wstring> wideArgs;
+    for (int i = 0; i < argc; i++) {
+        wideArgs.push_back(FromUtf8(argv[i]));
+    }
+
+    vector<wchar_t*> wideArgv;
+    for (auto& arg : wideArgs) {
+        wideArgv.push_back(&arg[0]);
+    }
+
+    return RunBench(argc, wideArgv.data());
+}
+#endif
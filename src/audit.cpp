@@ -0,0 +1,669 @@
+﻿#include "audit.h"
+
+#include "disk_image.h"
+#include "file_io.h"
+#include "guid.h"
+#include "wmi_manager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cwctype>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+// 未知簇大小时估算惩罚使用的写大小
+static const ULONGLONG DEFAULT_IO_BYTES = 4096;
+
+// 估算惩罚时最多枚举的写入位置数 (错位模式的周期)
+static const ULONGLONG MAX_PENALTY_PERIOD = 4096;
+
+// EBR 链的最大长度 (防止循环链)
+static const int MAX_LOGICAL_PARTITIONS = 128;
+
+bool ParseAuditSpec(const wstring& params, AuditSpec& spec) {
+    auto paramMap = ParseParams(params);
+
+    try {
+        if (paramMap.count(L"stripe"))
+            spec.stripeBytes = ParseSizeString(paramMap[L"stripe"]);
+
+        if (paramMap.count(L"erase"))
+            spec.eraseBytes = ParseSizeString(paramMap[L"erase"]);
+
+        if (paramMap.count(L"io"))
+            spec.ioBytes = ParseSizeString(paramMap[L"io"]);
+
+        if (paramMap.count(L"json"))
+            spec.jsonPath = paramMap[L"json"];
+    }
+    catch (...) {
+        return false;
+    }
+
+    return true;
+}
+
+bool AuditPartition::Aligned() const {
+    return all_of(checks.begin(), checks.end(), [](const AlignmentCheck& c) { return c.Aligned(); });
+}
+
+size_t AuditDisk::Misaligned() const {
+    return (size_t)count_if(partitions.begin(), partitions.end(), [](const AuditPartition& p) { return !p.Aligned(); });
+}
+
+// ================================
+// 对齐分析
+// ================================
+
+// 一次写入 [start, start + io) 的设备操作数: 触及的单元各写一次, 部分覆盖的单元另需读一次
+static ULONGLONG DeviceOps(ULONGLONG start, ULONGLONG io, ULONGLONG unit) {
+    ULONGLONG end = start + io;
+    ULONGLONG first = start / unit;
+    ULONGLONG last = (end - 1) / unit;
+    bool headPartial = start % unit != 0 || (first == last && end % unit != 0);
+    bool tailPartial = first != last && end % unit != 0;
+    return last - first + 1 + (headPartial ? 1 : 0) + (tailPartial ? 1 : 0);
+}
+
+// 分区内按 io 对齐的随机写, 分区起点相对单元错位 remainder 时平均设备操作数与对齐时之比
+static double RmwPenalty(ULONGLONG remainder, ULONGLONG unit, ULONGLONG io) {
+    if (remainder == 0) return 1.0;
+
+    // 写入位置相对单元的错位每 unit / gcd(unit, io) 次重复一轮
+    ULONGLONG period = min(unit / gcd(unit, io), MAX_PENALTY_PERIOD);
+    ULONGLONG misaligned = 0;
+    ULONGLONG aligned = 0;
+    for (ULONGLONG k = 0; k < period; k++) {
+        misaligned += DeviceOps(remainder + k * io, io, unit);
+        aligned += DeviceOps(k * io, io, unit);
+    }
+    return (double)misaligned / (double)aligned;
+}
+
+void AnalyzeDisk(AuditDisk& disk, const AuditSpec& spec) {
+    vector<pair<const wchar_t*, ULONGLONG>> units = {
+        { L"logical", disk.logicalSectorSize },
+        { L"physical", disk.physicalSectorSize },
+        { L"stripe", spec.stripeBytes },
+        { L"erase", spec.eraseBytes },
+    };
+
+    ULONGLONG alignment = 1;
+    for (const auto& unit : units) {
+        if (unit.second) alignment = lcm(alignment, unit.second);
+    }
+
+    // 修复方案中起点前移的下限: 前一个分区的末尾 (及分区自身的 minOffset)
+    vector<AuditPartition*> byOffset;
+    for (auto& part : disk.partitions) byOffset.push_back(&part);
+    sort(byOffset.begin(), byOffset.end(), [](const AuditPartition* a, const AuditPartition* b) { return a->offset < b->offset; });
+
+    ULONGLONG previousEnd = disk.firstUsable;
+    for (AuditPartition* part : byOffset) {
+        part->ioBytes = spec.ioBytes ? spec.ioBytes : (part->clusterBytes ? part->clusterBytes : DEFAULT_IO_BYTES);
+        part->checks.clear();
+        part->penalty = 1.0;
+
+        for (const auto& unit : units) {
+            if (unit.second == 0) continue;
+
+            AlignmentCheck check;
+            check.unit = unit.first;
+            check.bytes = unit.second;
+            check.remainder = part->offset % unit.second;
+            check.penalty = RmwPenalty(check.remainder, unit.second, part->ioBytes);
+            part->penalty = max(part->penalty, check.penalty);
+            part->checks.push_back(check);
+        }
+
+        part->alignment = alignment;
+        part->targetOffset = part->offset;
+        part->targetSize = part->size;
+
+        if (!part->Aligned()) {
+            ULONGLONG down = part->offset / alignment * alignment;
+            if (down >= max(previousEnd, part->minOffset)) {
+                part->targetOffset = down;
+            }
+            else {
+                // 起点只能后移, 末尾不变
+                ULONGLONG up = (part->offset + alignment - 1) / alignment * alignment;
+                ULONGLONG end = part->offset + part->size;
+                part->targetOffset = up;
+                part->targetSize = end > up ? (end - up) / disk.logicalSectorSize * disk.logicalSectorSize : 0;
+            }
+        }
+
+        previousEnd = max(previousEnd, part->offset + part->size);
+    }
+}
+
+// ================================
+// WMI 审计
+// ================================
+
+static wstring ToUpperString(wstring text) {
+    for (auto& c : text) c = towupper(c);
+    return text;
+}
+
+static wstring PartitionTypeName(const wstring& gptType, long long mbrType) {
+    if (!gptType.empty()) {
+        wstring upper = ToUpperString(gptType);
+        if (upper == GUID_BASIC_DATA_PARTITION) return L"basic";
+        if (upper == GUID_EFI_SYSTEM_PARTITION) return L"efi";
+        if (upper == GUID_MICROSOFT_RESERVED) return L"msr";
+        if (upper == L"{DE94BBA4-06D1-4D40-A16A-BFD50179D6AC}") return L"recovery";
+        return upper;
+    }
+
+    wstringstream name;
+    name << L"MBR 0x" << hex << uppercase << setw(2) << setfill(L'0') << mbrType;
+    return name.str();
+}
+
+static StorageObjectPtr QueryFirst(WMIManager& wmi, const wstring& query) {
+    auto enumerator = wmi.Query(query);
+    if (!enumerator) return nullptr;
+
+    StorageObjectPtr first, next;
+    while (wmi.Next(*enumerator, next)) {
+        if (!first) first = next;
+    }
+    return first;
+}
+
+// GPT 头与 128 项分区表之后的第一个字节; MBR 为第二个扇区
+static ULONGLONG FirstUsableBytes(const wstring& partitionStyle, ULONGLONG sector) {
+    if (partitionStyle == L"GPT") return (2 + (16 * 1024 + sector - 1) / sector) * sector;
+    return sector;
+}
+
+static void AuditWmiDisk(WMIManager& wmi, int diskNumber, const AuditSpec& spec, AuditDisk& disk) {
+    disk.diskNumber = diskNumber;
+    disk.source = L"磁盘 " + to_wstring(diskNumber);
+
+    auto diskObj = QueryFirst(wmi, L"SELECT * FROM MSFT_Disk WHERE Number = " + to_wstring(diskNumber));
+    if (!diskObj) {
+        disk.error = L"未找到磁盘";
+        return;
+    }
+
+    disk.name = diskObj->GetString(L"FriendlyName");
+    if (disk.name.empty()) disk.name = diskObj->GetString(L"Model");
+    disk.size = diskObj->GetUInt64(L"Size");
+
+    long long style = diskObj->GetInt(L"PartitionStyle");
+    disk.partitionStyle = style == 2 ? L"GPT" : style == 1 ? L"MBR" : L"RAW";
+
+    long long logical = diskObj->GetInt(L"LogicalSectorSize");
+    long long physical = diskObj->GetInt(L"PhysicalSectorSize");
+    disk.logicalSectorSize = logical > 0 ? (unsigned)logical : 512;
+    disk.physicalSectorSize = physical > 0 ? (unsigned)physical : disk.logicalSectorSize;
+    disk.firstUsable = FirstUsableBytes(disk.partitionStyle, disk.logicalSectorSize);
+
+    if (style != 0) {
+        auto enumerator = wmi.Query(L"SELECT * FROM MSFT_Partition WHERE DiskNumber = " + to_wstring(diskNumber));
+        if (!enumerator) {
+            disk.error = L"查询分区失败";
+            return;
+        }
+
+        vector<StorageObjectPtr> partitions;
+        StorageObjectPtr partObj;
+        while (wmi.Next(*enumerator, partObj)) {
+            partitions.push_back(partObj);
+        }
+
+        for (const auto& obj : partitions) {
+            AuditPartition part;
+            part.number = (int)obj->GetInt(L"PartitionNumber");
+            part.offset = obj->GetUInt64(L"Offset");
+            part.size = obj->GetUInt64(L"Size");
+            part.type = PartitionTypeName(obj->GetString(L"GptType"), obj->GetInt(L"MbrType"));
+
+            // 簇大小来自分区上的卷 (MSFT_PartitionToVolume)
+            auto volume = QueryFirst(wmi, L"ASSOCIATORS OF {" + obj->Path() + L"} WHERE ResultClass = MSFT_Volume");
+            if (volume) {
+                part.fileSystem = volume->GetString(L"FileSystem");
+                part.clusterBytes = volume->GetUInt64(L"AllocationUnitSize");
+            }
+            disk.partitions.push_back(part);
+        }
+
+        sort(disk.partitions.begin(), disk.partitions.end(),
+            [](const AuditPartition& a, const AuditPartition& b) { return a.number < b.number; });
+    }
+
+    AnalyzeDisk(disk, spec);
+}
+
+vector<AuditDisk> RunAudit(
+    const BackendFactory& factory,
+    const vector<int>& diskNumbers,
+    const AuditSpec& spec,
+    size_t maxWorkers
+) {
+    // 未指定磁盘时与 EnumerateDisks 一样枚举全部
+    vector<int> numbers = diskNumbers;
+    if (numbers.empty()) {
+        WMIManager wmi;
+        if (!wmi.Initialize(factory())) {
+            wcerr << L"❌ WMI 初始化失败" << endl;
+            return {};
+        }
+
+        auto enumerator = wmi.Query(L"SELECT * FROM MSFT_Disk");
+        StorageObjectPtr diskObj;
+        while (enumerator && wmi.Next(*enumerator, diskObj)) {
+            numbers.push_back((int)diskObj->GetInt(L"Number"));
+        }
+        sort(numbers.begin(), numbers.end());
+    }
+
+    vector<AuditDisk> results(numbers.size());
+    atomic<size_t> nextIndex(0);
+
+    auto worker = [&]() {
+        WMIManager wmi;
+        if (!wmi.Initialize(factory())) {
+            wcerr << L"❌ 审计线程无法连接存储提供程序" << endl;
+            return;
+        }
+
+        for (size_t i = nextIndex++; i < results.size(); i = nextIndex++) {
+            AuditDisk& disk = results[i];
+            disk.started = wmi.Now();
+            AuditWmiDisk(wmi, numbers[i], spec, disk);
+            disk.finished = wmi.Now();
+        }
+    };
+
+    size_t workerCount = min(maxWorkers, results.size());
+    if (workerCount <= 1) {
+        worker();
+    }
+    else {
+        vector<thread> workers;
+        for (size_t i = 0; i < workerCount; i++) {
+            workers.emplace_back(worker);
+        }
+        for (auto& t : workers) {
+            t.join();
+        }
+    }
+
+    // 未执行的磁盘 (工作线程初始化失败)
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i].diskNumber < 0) {
+            results[i].diskNumber = numbers[i];
+            results[i].source = L"磁盘 " + to_wstring(numbers[i]);
+            results[i].error = L"未执行审计";
+        }
+    }
+
+    return results;
+}
+
+// ================================
+// 镜像审计
+// ================================
+
+// 引导扇区中的簇大小; 无法识别时为 0
+static ULONGLONG ProbeClusterBytes(const vector<uint8_t>& boot, const wstring& fileSystem) {
+    if (fileSystem == L"FAT32" || fileSystem == L"NTFS") {
+        ULONGLONG bytesPerSector = GetLE16(&boot[11]);
+        unsigned sectorsPerCluster = boot[13];
+        // NTFS 每簇扇区数大于 128 时以 2 的负幂次表示
+        if (fileSystem == L"NTFS" && sectorsPerCluster > 0x80) return bytesPerSector << (256 - sectorsPerCluster);
+        return bytesPerSector * sectorsPerCluster;
+    }
+    if (fileSystem == L"exFAT" && boot.size() > 109) {
+        return 1ULL << (boot[108] + boot[109]);
+    }
+    return 0;
+}
+
+static bool IsExtendedType(uint8_t type) {
+    return type == 0x05 || type == 0x0F || type == 0x85;
+}
+
+// MBR 主分区与扩展分区中的逻辑分区 (编号从 5 开始)
+static bool ReadMbrPartitions(DiskImage& image, const vector<uint8_t>& mbr, AuditDisk& disk) {
+    const ULONGLONG sector = disk.logicalSectorSize;
+
+    for (int slot = 0; slot < 4; slot++) {
+        const uint8_t* e = &mbr[446 + slot * 16];
+        uint8_t type = e[4];
+        ULONGLONG start = GetLE32(e + 8);
+        ULONGLONG count = GetLE32(e + 12);
+        if (type == 0 || count == 0) continue;
+
+        if (!IsExtendedType(type)) {
+            AuditPartition part;
+            part.number = slot + 1;
+            part.offset = start * sector;
+            part.size = count * sector;
+            part.type = PartitionTypeName(L"", type);
+            disk.partitions.push_back(part);
+            continue;
+        }
+
+        // EBR 链: 每个 EBR 的第一项为逻辑分区 (相对本 EBR), 第二项指向下一个 EBR (相对扩展分区起点)
+        ULONGLONG ebrLba = start;
+        vector<uint8_t> ebr(512);
+        for (int number = 5; number < 5 + MAX_LOGICAL_PARTITIONS; number++) {
+            if (!image.Read(ebrLba * sector, ebr.data(), ebr.size())) return false;
+            if (ebr[510] != 0x55 || ebr[511] != 0xAA) break;
+
+            const uint8_t* logical = &ebr[446];
+            if (logical[4] != 0 && GetLE32(logical + 12) != 0) {
+                AuditPartition part;
+                part.number = number;
+                part.offset = (ebrLba + GetLE32(logical + 8)) * sector;
+                part.size = (ULONGLONG)GetLE32(logical + 12) * sector;
+                part.minOffset = (ebrLba + 1) * sector;
+                part.type = PartitionTypeName(L"", logical[4]);
+                disk.partitions.push_back(part);
+            }
+
+            const uint8_t* next = &ebr[446 + 16];
+            if (!IsExtendedType(next[4]) || GetLE32(next + 8) == 0) break;
+            ebrLba = start + GetLE32(next + 8);
+        }
+    }
+    return true;
+}
+
+bool AuditImage(const wstring& path, const AuditSpec& spec, AuditDisk& disk) {
+    disk.source = path;
+
+    error_code ec;
+    if (!fs::is_regular_file(fs::path(path), ec)) {
+        disk.error = L"镜像文件不存在";
+        return false;
+    }
+
+    // 只读, 不会用到随机数
+    mt19937_64 rng(0);
+    DiskImage image;
+    if (!image.Open(path, rng)) {
+        disk.error = L"无法打开镜像";
+        return false;
+    }
+
+    disk.name = image.IsVhdx() ? L"VHDX" : L"RAW";
+    disk.size = image.Size();
+    // raw 镜像没有物理扇区信息, 按 512e 的 4K 检查
+    disk.logicalSectorSize = image.IsVhdx() ? image.VhdxSectorSize() : 512;
+    disk.physicalSectorSize = image.IsVhdx() ? image.VhdxPhysicalSectorSize() : 4096;
+
+    vector<uint8_t> mbr(512);
+    if (!image.Read(0, mbr.data(), mbr.size())) {
+        disk.error = L"读取 MBR 失败";
+        return false;
+    }
+
+    bool hasSignature = mbr[510] == 0x55 && mbr[511] == 0xAA;
+    bool protective = false;
+    bool hasEntries = false;
+    for (int slot = 0; slot < 4; slot++) {
+        uint8_t type = mbr[446 + slot * 16 + 4];
+        if (type == 0xEE) protective = true;
+        if (type != 0) hasEntries = true;
+    }
+
+    if (hasSignature && protective) {
+        GptState gpt;
+        if (!ReadGpt(image, image.IsVhdx() ? disk.logicalSectorSize : 0, gpt)) {
+            disk.error = L"GPT 无效";
+            return false;
+        }
+
+        disk.partitionStyle = L"GPT";
+        disk.logicalSectorSize = gpt.sectorSize;
+        disk.physicalSectorSize = max(disk.physicalSectorSize, gpt.sectorSize);
+        disk.firstUsable = gpt.FirstUsableLba() * gpt.sectorSize;
+
+        for (uint32_t number = 1; number <= gpt.entryCount; number++) {
+            if (!gpt.IsUsed(number)) continue;
+
+            const uint8_t* e = gpt.Entry(number);
+            Guid type;
+            memcpy(type.bytes, e, 16);
+
+            AuditPartition part;
+            part.number = (int)number;
+            part.offset = GetLE64(e + 32) * gpt.sectorSize;
+            part.size = (GetLE64(e + 40) - GetLE64(e + 32) + 1) * gpt.sectorSize;
+            part.type = PartitionTypeName(FormatGuid(type), 0);
+            disk.partitions.push_back(part);
+        }
+    }
+    else if (hasSignature && hasEntries) {
+        disk.partitionStyle = L"MBR";
+        disk.firstUsable = disk.logicalSectorSize;
+        if (!ReadMbrPartitions(image, mbr, disk)) {
+            disk.error = L"读取扩展分区失败";
+            return false;
+        }
+    }
+    else {
+        disk.partitionStyle = L"RAW";
+    }
+
+    // 文件系统与簇大小取自各分区的引导扇区
+    for (auto& part : disk.partitions) {
+        vector<uint8_t> boot(max<size_t>(512, disk.logicalSectorSize));
+        if (part.offset + boot.size() > disk.size || !image.Read(part.offset, boot.data(), boot.size())) continue;
+        part.fileSystem = ProbeFileSystem(boot);
+        part.clusterBytes = ProbeClusterBytes(boot, part.fileSystem);
+    }
+
+    image.Close();
+    AnalyzeDisk(disk, spec);
+    return true;
+}
+
+// ================================
+// 报告
+// ================================
+
+static const wchar_t* UnitName(const wstring& unit) {
+    if (unit == L"logical") return L"逻辑扇区";
+    if (unit == L"physical") return L"物理扇区";
+    if (unit == L"stripe") return L"条带";
+    return L"擦除块";
+}
+
+void PrintAuditReport(wostream& out, const vector<AuditDisk>& disks, const AuditSpec& spec, bool verbose) {
+    size_t partitions = 0;
+    size_t misaligned = 0;
+    size_t misalignedDisks = 0;
+    size_t errors = 0;
+    double worst = 1.0;
+
+    out << L"\n📏 分区对齐审计" << endl;
+    out << L"==========================================" << endl;
+    out << L"  检查: 逻辑/物理扇区";
+    if (spec.stripeBytes) out << L", 条带 " << FormatBytes(spec.stripeBytes);
+    if (spec.eraseBytes) out << L", 擦除块 " << FormatBytes(spec.eraseBytes);
+    out << endl;
+
+    for (const auto& disk : disks) {
+        if (!disk.error.empty()) {
+            errors++;
+            out << L"❌ " << disk.source << L": " << disk.error << endl;
+            continue;
+        }
+
+        size_t diskMisaligned = disk.Misaligned();
+        partitions += disk.partitions.size();
+        misaligned += diskMisaligned;
+        if (diskMisaligned) misalignedDisks++;
+        if (!verbose && diskMisaligned == 0) continue;
+
+        out << (diskMisaligned ? L"⚠️  " : L"✓ ") << disk.source;
+        if (!disk.name.empty()) out << L" (" << disk.name << L")";
+        out << L": " << disk.partitionStyle << L", 扇区 " << disk.logicalSectorSize << L"/" << disk.physicalSectorSize
+            << L", " << disk.partitions.size() << L" 个分区";
+        if (diskMisaligned) out << L", " << diskMisaligned << L" 个未对齐";
+        out << endl;
+
+        for (const auto& part : disk.partitions) {
+            worst = max(worst, part.penalty);
+            if (!verbose && part.Aligned()) continue;
+
+            out << L"    分区 " << part.number << L": 偏移 " << part.offset << L" (" << FormatBytes(part.offset)
+                << L"), 大小 " << FormatBytes(part.size) << L", " << part.type;
+            if (!part.fileSystem.empty()) out << L", " << part.fileSystem;
+            if (part.clusterBytes) out << L" " << FormatBytes(part.clusterBytes) << L" 簇";
+            out << endl;
+
+            if (part.Aligned()) {
+                out << L"      ✓ 已对齐" << endl;
+                continue;
+            }
+
+            out << L"      ⚠️  错位:";
+            for (const auto& check : part.checks) {
+                if (check.Aligned()) continue;
+                out << L" " << UnitName(check.unit) << L" +" << check.remainder;
+            }
+            out << L"; " << FormatBytes(part.ioBytes) << L" 随机写的读-改-写惩罚 ×"
+                << fixed << setprecision(2) << part.penalty << endl;
+
+            out << L"      修复: 偏移 " << part.offset << L" → " << part.targetOffset
+                << L" (对齐到 " << FormatBytes(part.alignment) << L")";
+            if (part.targetOffset > part.offset) {
+                out << L", 起点后移, 卷需先收缩 " << FormatBytes(part.size - part.targetSize);
+            }
+            out << endl;
+            out << L"            备份数据 → 删除分区 → --create-part=offset=" << part.targetOffset
+                << L",size=" << part.targetSize << L" → 恢复数据" << endl;
+        }
+    }
+
+    out << L"\n📊 " << disks.size() << L" 块磁盘, " << partitions << L" 个分区, "
+        << misaligned << L" 个未对齐 (" << misalignedDisks << L" 块磁盘)";
+    if (errors) out << L", " << errors << L" 块无法审计";
+    if (misaligned) out << L", 最大惩罚 ×" << fixed << setprecision(2) << worst;
+    out << endl;
+}
+
+// ================================
+// JSON 报告
+// ================================
+
+static string JsonString(const wstring& text) {
+    string utf8 = ToUtf8(text);
+    string result = "\"";
+    for (unsigned char c : utf8) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += (char)c;
+        }
+        else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            result += escaped;
+        }
+        else {
+            result += (char)c;
+        }
+    }
+    return result + "\"";
+}
+
+bool WriteAuditJson(const vector<AuditDisk>& disks, const AuditSpec& spec) {
+    ostringstream json;
+    json << fixed << setprecision(3);
+    json << "{\n  \"spec\": {\"stripe\": " << spec.stripeBytes << ", \"erase\": " << spec.eraseBytes
+        << ", \"io\": " << spec.ioBytes << "},\n  \"disks\": [";
+
+    size_t partitions = 0;
+    size_t misaligned = 0;
+    size_t errors = 0;
+
+    for (size_t d = 0; d < disks.size(); d++) {
+        const AuditDisk& disk = disks[d];
+        json << (d ? "," : "") << "\n    {";
+        if (disk.diskNumber >= 0) json << "\"disk\": " << disk.diskNumber;
+        else json << "\"image\": " << JsonString(disk.source);
+
+        if (!disk.error.empty()) {
+            errors++;
+            json << ", \"error\": " << JsonString(disk.error) << "}";
+            continue;
+        }
+
+        json << ", \"name\": " << JsonString(disk.name) << ", \"size\": " << disk.size
+            << ", \"partition_style\": " << JsonString(disk.partitionStyle)
+            << ", \"logical_sector\": " << disk.logicalSectorSize
+            << ", \"physical_sector\": " << disk.physicalSectorSize
+            << ", \"misaligned\": " << disk.Misaligned() << ", \"partitions\": [";
+
+        for (size_t p = 0; p < disk.partitions.size(); p++) {
+            const AuditPartition& part = disk.partitions[p];
+            partitions++;
+            if (!part.Aligned()) misaligned++;
+
+            json << (p ? "," : "") << "\n      {\"number\": " << part.number
+                << ", \"offset\": " << part.offset << ", \"size\": " << part.size
+                << ", \"type\": " << JsonString(part.type)
+                << ", \"file_system\": " << JsonString(part.fileSystem)
+                << ", \"cluster\": " << part.clusterBytes << ", \"io\": " << part.ioBytes
+                << ", \"aligned\": " << (part.Aligned() ? "true" : "false")
+                << ", \"penalty\": " << part.penalty << ", \"checks\": {";
+
+            for (size_t c = 0; c < part.checks.size(); c++) {
+                const AlignmentCheck& check = part.checks[c];
+                json << (c ? ", " : "") << JsonString(check.unit) << ": {\"unit\": " << check.bytes
+                    << ", \"remainder\": " << check.remainder << ", \"penalty\": " << check.penalty << "}";
+            }
+
+            json << "}, \"remediation\": ";
+            if (part.Aligned()) {
+                json << "null}";
+            }
+            else {
+                json << "{\"alignment\": " << part.alignment << ", \"offset\": " << part.targetOffset
+                    << ", \"size\": " << part.targetSize
+                    << ", \"shrink\": " << (part.size - part.targetSize) << "}}";
+            }
+        }
+        json << (disk.partitions.empty() ? "]}" : "\n    ]}");
+    }
+
+    json << (disks.empty() ? "]" : "\n  ]") << ",\n  \"summary\": {\"disks\": " << disks.size()
+        << ", \"partitions\": " << partitions << ", \"misaligned\": " << misaligned
+        << ", \"errors\": " << errors << "}\n}\n";
+
+    string text = json.str();
+    OutputStream stream;
+    if (!stream.Open(spec.jsonPath)) return false;
+    if (!stream.Write(text.data(), text.size()) || !stream.Close()) return false;
+    return true;
+}
+
+int FinishAudit(const vector<AuditDisk>& disks, const AuditSpec& spec, bool verbose) {
+    PrintAuditReport(spec.jsonPath == L"-" ? wcerr : wcout, disks, spec, verbose);
+
+    if (!spec.jsonPath.empty()) {
+        if (!WriteAuditJson(disks, spec)) return 1;
+        if (spec.jsonPath != L"-") wcout << L"✓ 审计报告已写入 " << spec.jsonPath << endl;
+    }
+
+    bool clean = all_of(disks.begin(), disks.end(),
+        [](const AuditDisk& d) { return d.error.empty() && d.Misaligned() == 0; });
+    return clean ? 0 : 1;
+}
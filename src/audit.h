@@ -0,0 +1,108 @@
+﻿#pragma once
+
+/*
+ * 已有磁盘的分区对齐审计 (--audit)
+ *
+ * 与 EnumerateDisks 相同的 WMI 枚举 (MSFT_Disk -> MSFT_Partition -> MSFT_Volume), 只读:
+ * 每个分区的起始偏移分别对照逻辑扇区、物理扇区、条带单元 (stripe=) 与擦除块 (erase=),
+ * 估算随机写的读-改-写惩罚, 并给出修复方案 (对齐后的偏移与大小)。
+ * 多块磁盘时最多 64 个工作线程并发, 每个线程持有自己的后端会话。
+ * --image=<已有镜像> --audit 对 raw / VHDX 镜像做同样的分析 (GPT 或 MBR, 含扩展分区)。
+ * json= 输出机器可读的报告。
+ */
+
+#include "storage_backend.h"
+#include "utils.h"
+
+#include <chrono>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+struct AuditSpec {
+    bool enabled = false;
+    ULONGLONG stripeBytes = 64 * 1024;             // stripe=, RAID 条带单元 / 存储空间交错, 0 不检查
+    ULONGLONG eraseBytes = 1024 * 1024;            // erase=, SSD 擦除块, 0 不检查
+    ULONGLONG ioBytes = 0;                         // io=, 估算惩罚的随机写大小, 0 取卷的簇大小 (未知时 4K)
+    std::wstring jsonPath;                         // json=<文件|->
+};
+
+// 形式: stripe=64K,erase=1M,io=4K,json=audit.json
+bool ParseAuditSpec(const std::wstring& params, AuditSpec& spec);
+
+// 分区起点对一种对齐单元的检查
+struct AlignmentCheck {
+    std::wstring unit;                 // logical / physical / stripe / erase
+    ULONGLONG bytes = 0;
+    ULONGLONG remainder = 0;           // 偏移 % 单元
+    double penalty = 1.0;              // 随机写的设备操作数之比 (错位 / 对齐), 1 为无惩罚
+
+    bool Aligned() const { return remainder == 0; }
+};
+
+struct AuditPartition {
+    int number = 0;
+    ULONGLONG offset = 0;
+    ULONGLONG size = 0;
+    std::wstring type;
+    std::wstring fileSystem;
+    ULONGLONG clusterBytes = 0;        // 0 为未知
+    ULONGLONG ioBytes = 0;             // 估算惩罚使用的写大小
+    ULONGLONG minOffset = 0;           // 起点前移的下限 (MBR 逻辑分区为其 EBR 之后)
+
+    std::vector<AlignmentCheck> checks;
+    double penalty = 1.0;              // 各项检查中的最大惩罚
+
+    // 修复方案: 对齐到全部单元的最小公倍数; 起点只能后移时大小相应减少
+    ULONGLONG alignment = 0;
+    ULONGLONG targetOffset = 0;
+    ULONGLONG targetSize = 0;
+
+    bool Aligned() const;
+};
+
+struct AuditDisk {
+    int diskNumber = -1;               // 镜像时为 -1
+    std::wstring source;               // "磁盘 N" 或镜像路径
+    std::wstring name;
+    ULONGLONG size = 0;
+    std::wstring partitionStyle;       // GPT / MBR / RAW
+    unsigned logicalSectorSize = 512;
+    unsigned physicalSectorSize = 512;
+    ULONGLONG firstUsable = 0;         // 第一个可用字节 (修复方案中起点前移的下限)
+
+    std::vector<AuditPartition> partitions;
+    std::wstring error;                // 非空表示无法审计
+
+    std::chrono::nanoseconds started{ 0 };    // 后端时钟 (模拟时为虚拟时间)
+    std::chrono::nanoseconds finished{ 0 };
+
+    size_t Misaligned() const;
+};
+
+// 按几何参数计算各分区的检查、惩罚与修复方案 (WMI 与镜像共用)
+void AnalyzeDisk(AuditDisk& disk, const AuditSpec& spec);
+
+// 审计工作线程数上限 (只读查询)
+const size_t AUDIT_MAX_WORKERS = 64;
+
+// 并发审计; diskNumbers 为空时审计全部磁盘
+std::vector<AuditDisk> RunAudit(
+    const BackendFactory& factory,
+    const std::vector<int>& diskNumbers,
+    const AuditSpec& spec,
+    size_t maxWorkers
+);
+
+// 审计 raw / VHDX 镜像
+bool AuditImage(const std::wstring& path, const AuditSpec& spec, AuditDisk& disk);
+
+// 审计报告; verbose 时列出每个分区, 否则只列出未对齐的分区
+void PrintAuditReport(std::wostream& out, const std::vector<AuditDisk>& disks, const AuditSpec& spec, bool verbose);
+
+// 写出 JSON 报告 (spec.jsonPath, "-" 为标准输出)
+bool WriteAuditJson(const std::vector<AuditDisk>& disks, const AuditSpec& spec);
+
+// 输出报告 (JSON 写到标准输出时报告改写到标准错误) 与 JSON,
+// 返回退出码: 存在未对齐的分区或无法审计的磁盘时为 1
+int FinishAudit(const std::vector<AuditDisk>& disks, const AuditSpec& spec, bool verbose);
@@ -0,0 +1,86 @@
+﻿#include "call_stats.h"
+
+#include <cwchar>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+
+static const wchar_t* const CALL_KIND_NAMES[CALL_KIND_COUNT] = {
+    L"ExecQuery",
+    L"Next",
+    L"GetObject",
+    L"GetMethod",
+    L"SpawnInstance",
+    L"ExecMethod",
+    L"PutInstance",
+};
+
+const wchar_t* CallKindName(CallKind kind) {
+    size_t i = (size_t)kind;
+    return i < CALL_KIND_COUNT ? CALL_KIND_NAMES[i] : L"?";
+}
+
+bool ParseCallKind(const wchar_t* name, CallKind& kind) {
+    for (size_t i = 0; i < CALL_KIND_COUNT; i++) {
+        if (wcscmp(name, CALL_KIND_NAMES[i]) == 0) {
+            kind = (CallKind)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned long long CallStats::Total() const {
+    unsigned long long total = 0;
+    for (auto n : count) total += n;
+    return total;
+}
+
+chrono::nanoseconds CallStats::TotalElapsed() const {
+    chrono::nanoseconds total{ 0 };
+    for (auto d : elapsed) total += d;
+    return total;
+}
+
+CallStats& CallStats::operator+=(const CallStats& other) {
+    for (size_t i = 0; i < CALL_KIND_COUNT; i++) {
+        count[i] += other.count[i];
+        failed[i] += other.failed[i];
+        elapsed[i] += other.elapsed[i];
+    }
+    return *this;
+}
+
+void PrintCallStats(const CallStats& stats, size_t diskCount, size_t partitionCount) {
+    auto ms = [](chrono::nanoseconds d) { return chrono::duration<double, milli>(d).count(); };
+
+    wcout << L"\n📞 WMI 往返统计" << endl;
+    wcout << L"==========================================" << endl;
+    // 汉字占两列, 表头宽度按显示宽度扣除
+    wcout << L"  " << left << setw(13) << L"调用" << right
+        << setw(7) << L"次数" << setw(5) << L"失败"
+        << setw(10) << L"总耗时 ms" << setw(9) << L"平均 ms"
+        << setw(7) << L"每盘" << setw(6) << L"每分区" << endl;
+
+    wcout << fixed;
+    for (size_t i = 0; i < CALL_KIND_COUNT + 1; i++) {
+        bool isTotal = i == CALL_KIND_COUNT;
+        unsigned long long count = isTotal ? stats.Total() : stats.count[i];
+        unsigned long long failed = 0;
+        chrono::nanoseconds elapsed = isTotal ? stats.TotalElapsed() : stats.elapsed[i];
+        if (isTotal) {
+            for (auto n : stats.failed) failed += n;
+        }
+        else {
+            failed = stats.failed[i];
+        }
+
+        wcout << L"  " << left << setw(isTotal ? 13 : 15) << (isTotal ? L"合计" : CALL_KIND_NAMES[i]) << right
+            << setw(9) << count << setw(7) << failed
+            << setprecision(1) << setw(13) << ms(elapsed)
+            << setprecision(2) << setw(11) << (count ? ms(elapsed) / count : 0.0)
+            << setw(9) << (diskCount ? (double)count / diskCount : 0.0)
+            << setw(9) << (partitionCount ? (double)count / partitionCount : 0.0) << endl;
+    }
+}
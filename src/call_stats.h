@@ -0,0 +1,55 @@
+﻿#pragma once
+
+/*
+ * WMI 往返调用统计
+ *
+ * WMIManager 对每一次跨进程调用按类型计数并计时 (使用后端时钟,
+ * 模拟/回放时为虚拟时间), 用于 --stats 输出与往返次数预算检查。
+ */
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+enum class CallKind {
+    ExecQuery,
+    Next,
+    GetObject,
+    GetMethod,
+    SpawnInstance,
+    ExecMethod,
+    PutInstance,
+    Count
+};
+
+constexpr size_t CALL_KIND_COUNT = (size_t)CallKind::Count;
+
+// 调用类型名 (与 --sim-latency 的操作名一致)
+const wchar_t* CallKindName(CallKind kind);
+
+// 按名称查找调用类型, 未知名称返回 false
+bool ParseCallKind(const wchar_t* name, CallKind& kind);
+
+struct CallStats {
+    std::array<unsigned long long, CALL_KIND_COUNT> count{};
+    std::array<unsigned long long, CALL_KIND_COUNT> failed{};
+    std::array<std::chrono::nanoseconds, CALL_KIND_COUNT> elapsed{};
+
+    void Record(CallKind kind, std::chrono::nanoseconds duration, bool ok) {
+        size_t i = (size_t)kind;
+        count[i]++;
+        if (!ok) failed[i]++;
+        elapsed[i] += duration;
+    }
+
+    unsigned long long Count(CallKind kind) const { return count[(size_t)kind]; }
+
+    // 全部类型的往返次数
+    unsigned long long Total() const;
+    std::chrono::nanoseconds TotalElapsed() const;
+
+    CallStats& operator+=(const CallStats& other);
+};
+
+// 输出按类型的调用次数/耗时表, 以及每盘、每分区的平均往返次数
+void PrintCallStats(const CallStats& stats, size_t diskCount, size_t partitionCount);
@@ -0,0 +1,24 @@
+﻿#pragma once
+
+/*
+ * 校验和
+ *   - CRC32  (IEEE 802.3, 反射多项式 0xEDB88320): GPT 头与分区表
+ *   - CRC32C (Castagnoli, 反射多项式 0x82F63B78): VHDX 头、区域表
+ *   - SHA-256 (FIPS 180-4): 布局缓存的内容寻址键
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+uint32_t Crc32(const void* data, size_t length, uint32_t crc = 0);
+
+uint32_t Crc32c(const void* data, size_t length, uint32_t crc = 0);
+
+typedef std::array<uint8_t, 32> Sha256Digest;
+
+Sha256Digest Sha256(const void* data, size_t length);
+
+// 小写十六进制
+std::string DigestToHex(const Sha256Digest& digest);
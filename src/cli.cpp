@@ -0,0 +1,498 @@
+﻿#include "cli.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+// 形式: number=2,size=80G | number=2,size=max
+static bool ParseResizeSpec(const wstring& params, CommandLineArgs::ResizeSpec& spec) {
+    auto paramMap = ParseParams(params);
+    if (!paramMap.count(L"number") || !paramMap.count(L"size")) return false;
+
+    try {
+        spec.partitionNumber = stoi(paramMap[L"number"]);
+
+        if (paramMap[L"size"] == L"max") spec.useMaximum = true;
+        else spec.size = ParseSizeString(paramMap[L"size"]);
+    }
+    catch (const exception&) {
+        return false;
+    }
+
+    return spec.partitionNumber > 0 && (spec.useMaximum || spec.size > 0);
+}
+
+// 形式: size=5G,offset=1M,label=Data,type=basic
+// size 省略时使用剩余空间: 镜像按最大空闲区间规划, WMI 与模拟提供程序以 UseMaximumSize 创建
+static bool ParsePartitionSpec(const wstring& params, CommandLineArgs::PartitionSpec& spec) {
+    auto paramMap = ParseParams(params);
+
+    try {
+        if (paramMap.count(L"size"))
+            spec.size = ParseSizeString(paramMap[L"size"]);
+
+        if (paramMap.count(L"offset"))
+            spec.offset = ParseSizeString(paramMap[L"offset"]);
+    }
+    catch (const exception&) {
+        return false;
+    }
+
+    if (paramMap.count(L"label"))
+        spec.label = paramMap[L"label"];
+
+    if (paramMap.count(L"type"))
+        spec.type = paramMap[L"type"];
+
+    return true;
+}
+
+// 形式: fs=ntfs,vol=Data,quick=1,unit=64K
+static bool ParseFormatSpec(const wstring& params, CommandLineArgs::FormatSpec& spec) {
+    auto paramMap = ParseParams(params);
+
+    if (paramMap.count(L"fs"))
+        spec.fileSystem = paramMap[L"fs"];
+
+    if (paramMap.count(L"vol"))
+        spec.volumeLabel = paramMap[L"vol"];
+
+    if (paramMap.count(L"quick"))
+        spec.quickFormat = (paramMap[L"quick"] == L"1" || paramMap[L"quick"] == L"true");
+
+    try {
+        if (paramMap.count(L"unit"))
+            spec.allocationUnitSize = ParseSizeString(paramMap[L"unit"]);
+    }
+    catch (const exception&) {
+        return false;
+    }
+
+    // 簇大小: 512 - 2M 的 2 的幂
+    ULONGLONG unit = spec.allocationUnitSize;
+    return unit == 0 || (unit >= 512 && unit <= 2 * 1024 * 1024 && (unit & (unit - 1)) == 0);
+}
+
+CommandLineArgs ParseCommandLine(int argc, wchar_t* argv[]) {
+    CommandLineArgs args;
+
+    for (int i = 1; i < argc; i++) {
+        wstring arg = argv[i];
+
+        // -------------------------
+        // --disk=N | --disk=1,3,5-8
+        // -------------------------
+        if (arg.find(L"--disk=") == 0) {
+            ParseNumberArg(arg, args.invalid, [&]() { args.diskNumbers = ParseNumberList(arg.substr(7)); });
+        }
+
+        // -------------------------
+        // --gpt
+        // -------------------------
+        else if (arg == L"--gpt") {
+            args.initGpt = true;
+        }
+
+        // -------------------------
+        // --list
+        // -------------------------
+        else if (arg == L"--list") {
+            args.listDisks = true;
+        }
+
+        // -------------------------
+        // --create-part [=] params
+        // -------------------------
+        else if (arg == L"--create-part") {
+            // 形式：--create-part size=5G,label=Data
+            if (i + 1 < argc) {
+                wstring params = argv[++i];
+                CommandLineArgs::PartitionSpec spec;
+                if (ParsePartitionSpec(params, spec)) {
+                    args.partitions.push_back(spec);
+                }
+                else {
+                    wcerr << L"❌ 无法解析分区参数: " << params << endl;
+                    args.invalid = true;
+                }
+            }
+        }
+        else if (arg.find(L"--create-part=") == 0) {
+            // 形式：--create-part=size=5G,label=Data
+            wstring params = arg.substr(14);
+            CommandLineArgs::PartitionSpec spec;
+            if (ParsePartitionSpec(params, spec)) {
+                args.partitions.push_back(spec);
+            }
+            else {
+                wcerr << L"❌ 无法解析分区参数: " << params << endl;
+                args.invalid = true;
+            }
+        }
+
+        // -------------------------
+        // --format [=] params
+        // -------------------------
+        else if (arg == L"--format" || arg.find(L"--format=") == 0) {
+            // 形式：--format fs=ntfs,vol=Data 或 --format=fs=ntfs,vol=Data
+            wstring params;
+            if (arg == L"--format") {
+                if (i + 1 >= argc) continue;
+                params = argv[++i];
+            }
+            else {
+                params = arg.substr(9);
+            }
+
+            CommandLineArgs::FormatSpec spec;
+            if (ParseFormatSpec(params, spec)) {
+                args.formats.push_back(spec);
+            }
+            else {
+                wcerr << L"❌ 无法解析格式化参数: " << params << endl;
+                args.invalid = true;
+            }
+        }
+
+        // -------------------------
+        // --resize-part [=] params
+        // -------------------------
+        else if (arg == L"--resize-part" || arg.find(L"--resize-part=") == 0) {
+            wstring params;
+            if (arg == L"--resize-part") {
+                if (i + 1 < argc) params = argv[++i];
+            }
+            else {
+                params = arg.substr(14);
+            }
+
+            CommandLineArgs::ResizeSpec spec;
+            if (ParseResizeSpec(params, spec)) {
+                args.resizes.push_back(spec);
+            }
+            else {
+                wcerr << L"❌ 无法解析分区调整参数: " << arg << endl;
+                args.invalid = true;
+            }
+        }
+
+        // -------------------------
+        // --bulk / --access-path= / --guid-paths
+        // -------------------------
+        else if (arg == L"--bulk") {
+            args.bulk = true;
+        }
+        else if (arg.find(L"--access-path=") == 0) {
+            args.accessPathRoot = arg.substr(14);
+        }
+        else if (arg == L"--guid-paths") {
+            args.guidPaths = true;
+        }
+
+        // -------------------------
+        // --concurrency=K / --quiet
+        // -------------------------
+        else if (arg.find(L"--concurrency=") == 0) {
+            ParseNumberArg(arg, args.invalid, [&]() { args.concurrency = max(1, stoi(arg.substr(14))); });
+        }
+        else if (arg == L"--quiet") {
+            args.quiet = true;
+        }
+
+        // -------------------------
+        // --stats / --record= / --replay=
+        // -------------------------
+        else if (arg == L"--stats") {
+            args.stats = true;
+        }
+        else if (arg.find(L"--record=") == 0) {
+            args.recordPath = arg.substr(9);
+        }
+        else if (arg.find(L"--replay=") == 0) {
+            args.replayPath = arg.substr(9);
+        }
+
+        // -------------------------
+        // --image= / --image-size= / --image-sector= / --image-block= / --export= / --stamp=
+        // --seed= / --cache= / --farm=
+        // -------------------------
+        else if (arg.find(L"--image=") == 0) {
+            args.imagePath = arg.substr(8);
+        }
+        else if (arg.find(L"--image-size=") == 0) {
+            ParseNumberArg(arg, args.invalid, [&]() { args.imageSize = ParseSizeString(arg.substr(13)); });
+        }
+        else if (arg.find(L"--image-sector=") == 0) {
+            ParseNumberArg(arg, args.invalid, [&]() { args.imageSectorSize = (unsigned)stoul(arg.substr(15)); });
+        }
+        else if (arg.find(L"--image-block=") == 0) {
+            ParseNumberArg(arg, args.invalid, [&]() { args.imageBlockSize = ParseSizeString(arg.substr(14)); });
+        }
+        else if (arg.find(L"--export=") == 0) {
+            args.exportPath = arg.substr(9);
+        }
+        else if (arg.find(L"--stamp=") == 0) {
+            ParseNumberArg(arg, args.invalid, [&]() { args.stampCount = stoi(arg.substr(8)); });
+        }
+        else if (arg.find(L"--seed=") == 0) {
+            args.hasImageSeed = true;
+            ParseNumberArg(arg, args.invalid, [&]() { args.imageSeed = stoull(arg.substr(7), nullptr, 0); });
+        }
+        else if (arg.find(L"--cache=") == 0) {
+            args.cacheDir = arg.substr(8);
+        }
+        else if (arg.find(L"--farm=") == 0) {
+            args.farm.enabled = true;
+            if (!ParseFarmSpec(arg.substr(7), args.farm)) {
+                wcerr << L"❌ 无法解析批量参数: " << arg << endl;
+                args.invalid = true;
+            }
+        }
+
+        // -------------------------
+        // --audit [=] params
+        // -------------------------
+        else if (arg == L"--audit") {
+            args.audit.enabled = true;
+        }
+        else if (arg.find(L"--audit=") == 0) {
+            args.audit.enabled = true;
+            if (!ParseAuditSpec(arg.substr(8), args.audit)) {
+                wcerr << L"❌ 无法解析审计参数: " << arg << endl;
+                args.invalid = true;
+            }
+        }
+
+        // -------------------------
+        // --preflight [=] params
+        // -------------------------
+        else if (arg == L"--preflight") {
+            args.preflight.enabled = true;
+        }
+        else if (arg.find(L"--preflight=") == 0) {
+            args.preflight.enabled = true;
+            if (!ParsePreflightSpec(arg.substr(12), args.preflight)) {
+                wcerr << L"❌ 无法解析预检参数: " << arg << endl;
+                args.invalid = true;
+            }
+        }
+
+        // -------------------------
+        // --pool [=] params
+        // -------------------------
+        else if (arg == L"--pool") {
+            args.pool.enabled = true;
+        }
+        else if (arg.find(L"--pool=") == 0) {
+            args.pool.enabled = true;
+            if (!ParsePoolSpec(arg.substr(7), args.pool)) {
+                wcerr << L"❌ 无法解析存储池参数: " << arg << endl;
+                args.invalid = true;
+            }
+        }
+
+        // -------------------------
+        // --qualify [=] params
+        // -------------------------
+        else if (arg == L"--qualify") {
+            args.qualify.enabled = true;
+        }
+        else if (arg.find(L"--qualify=") == 0) {
+            args.qualify.enabled = true;
+            if (!ParseQualifySpec(arg.substr(10), args.qualify)) {
+                wcerr << L"❌ 无法解析验收参数: " << arg << endl;
+                args.invalid = true;
+            }
+        }
+
+        // -------------------------
+        // --retrim [=] params
+        // -------------------------
+        else if (arg == L"--retrim") {
+            args.retrim.enabled = true;
+        }
+        else if (arg.find(L"--retrim=") == 0) {
+            args.retrim.enabled = true;
+            if (!ParseRetrimSpec(arg.substr(9), args.retrim)) {
+                wcerr << L"❌ 无法解析回收参数: " << arg << endl;
+                args.invalid = true;
+            }
+        }
+
+        // -------------------------
+        // --apply= / --apply-to=
+        // -------------------------
+        else if (arg.find(L"--apply=") == 0) {
+            args.applyPath = arg.substr(8);
+        }
+        else if (arg.find(L"--apply-to=") == 0) {
+            args.applyTarget = arg.substr(11);
+        }
+
+        // -------------------------
+        // --sim [=] params / --sim-latency= / --sim-fail= / --sim-health= / --sim-partitions=
+        // -------------------------
+        else if (arg == L"--sim") {
+            args.simulate = true;
+        }
+        else if (arg.find(L"--sim=") == 0) {
+            args.simulate = true;
+            if (!ParseSimConfig(arg.substr(6), args.simConfig)) {
+                wcerr << L"❌ 无法解析模拟参数: " << arg << endl;
+                args.invalid = true;
+            }
+        }
+        else if (arg.find(L"--sim-latency=") == 0) {
+            if (!ParseLatencySpec(arg.substr(14), args.simConfig)) {
+                wcerr << L"❌ 无法解析延迟模型: " << arg << endl;
+                args.invalid = true;
+            }
+        }
+        else if (arg.find(L"--sim-fail=") == 0) {
+            if (!ParseFailureSpec(arg.substr(11), args.simConfig)) {
+                wcerr << L"❌ 无法解析失败率: " << arg << endl;
+                args.invalid = true;
+            }
+        }
+        else if (arg.find(L"--sim-health=") == 0) {
+            if (!ParseHealthSpec(arg.substr(13), args.simConfig)) {
+                wcerr << L"❌ 无法解析健康状态: " << arg << endl;
+                args.invalid = true;
+            }
+        }
+        else if (arg.find(L"--sim-partitions=") == 0) {
+            if (!ParsePartitionsSpec(arg.substr(17), args.simConfig)) {
+                wcerr << L"❌ 无法解析预置分区: " << arg << endl;
+                args.invalid = true;
+            }
+        }
+    }
+
+    return args;
+}
+
+void PrintUsage() {
+    wcout << L"\n磁盘分区与格式化工具 - Windows Storage Management API (ATL 版本)\n" << endl;
+    wcout << L"用法:" << endl;
+    wcout << L"  DiskPartitionTool.exe [选项]\n" << endl;
+    wcout << L"选项:" << endl;
+    wcout << L"  --list                          列出所有磁盘" << endl;
+    wcout << L"  --disk=<N>                      指定磁盘编号 (支持列表: 1,3,5-8)" << endl;
+    wcout << L"  --gpt                           初始化为 GPT 分区表" << endl;
+    wcout << L"  --create-part <参数>            创建分区" << endl;
+    wcout << L"      参数: size=<大小>,label=<标签>,type=<类型>,offset=<偏移>" << endl;
+    wcout << L"      大小支持: 10G, 500M, 1T 等" << endl;
+    wcout << L"      类型: basic, efi, msr 或完整 GUID" << endl;
+    wcout << L"  --format <参数>                 格式化分区" << endl;
+    wcout << L"      参数: fs=<文件系统>,vol=<卷标>,quick=<0|1>,unit=<簇大小>" << endl;
+    wcout << L"      文件系统: ntfs, fat32, exfat, refs" << endl;
+    wcout << L"      簇大小: 512 - 2M 的 2 的幂 (如 4K, 64K), 省略时按容量取文件系统默认值" << endl;
+    wcout << L"  --resize-part <参数>            原地扩展/收缩已有分区, 不移动起点, 保留数据" << endl;
+    wcout << L"      参数: number=<分区号>,size=<大小>|max  (max 为扩展到相邻空闲空间末尾)" << endl;
+    wcout << L"  --bulk                          批量提交: 新分区不分配盘符, 不逐个等待挂载, 最后统一刷新一次" << endl;
+    wcout << L"      适合单盘上百个分区; 卷可用 --access-path 或 --guid-paths 访问" << endl;
+    wcout << L"  --access-path=<目录>            把每个新卷挂载到 <目录>\\Disk<N>\\Part<P> (NTFS 目录)" << endl;
+    wcout << L"  --guid-paths                    输出每个新卷的 \\\\?\\Volume{GUID}\\ 路径" << endl;
+    wcout << L"  --concurrency=<K>               多盘时的并发数 (默认 1)" << endl;
+    wcout << L"  --quiet                         只输出错误与汇总" << endl;
+    wcout << L"  --stats                         输出 WMI 往返调用次数与耗时 (按调用类型)" << endl;
+    wcout << L"  --record=<文件>                 录制本次会话的全部 WMI 调用" << endl;
+    wcout << L"  --replay=<文件>                 回放录制的调用日志 (不访问真实磁盘)" << endl;
+    wcout << L"  --audit[=<参数>]                审计已有分区的起点对齐 (只读), 估算读-改-写惩罚并给出修复方案" << endl;
+    wcout << L"      参数: stripe=<条带单元>,erase=<擦除块>,io=<随机写大小>,json=<文件|->" << endl;
+    wcout << L"      默认: stripe=64K,erase=1M, io 取卷的簇大小; 未指定 --disk 时审计全部磁盘; 与 --image 一起时审计镜像" << endl;
+    wcout << L"  --preflight[=<参数>]            配置前并发检查目标磁盘的健康状态、可靠性计数器与读延迟" << endl;
+    wcout << L"      参数: temp=<°C>,wear=<%>,read-errors=<N>,write-errors=<N>,latency=<ms>," << endl;
+    wcout << L"            probe=<探测读次数>,probe-latency=<ms>,action=exclude|flag" << endl;
+    wcout << L"      默认: temp=60,wear=90,read-errors=0,write-errors=0,probe=16,probe-latency=100,action=exclude" << endl;
+    wcout << L"  --pool[=<参数>]                 把选中的磁盘组成存储池, 在其中创建一个条带 (或镜像) 虚拟磁盘再分区格式化" << endl;
+    wcout << L"      参数: name=<池名>,resiliency=simple|mirror,copies=<2|3>,columns=auto|<N>," << endl;
+    wcout << L"            interleave=auto|<大小>,size=max|<大小>" << endl;
+    wcout << L"      自动时列数取 2 的幂, 条带宽度 (列数 × 交错) 与簇大小对齐; 未指定 unit= 时一并选定簇大小" << endl;
+    wcout << L"  --qualify[=<参数>]              格式化后在新卷上运行 I/O 验收 (顺序读写 + 4K 随机读)" << endl;
+    wcout << L"      参数: size=<测试大小>,time=<每项秒数>,qd=<1/4/32>," << endl;
+    wcout << L"            seq-read=<MB/s>,seq-write=<MB/s>,iops=<随机读 IOPS>  (低于阈值判为失败)" << endl;
+    wcout << L"  --retrim[=concurrency=<K>]      格式化后对每个卷执行 ReTrim (Optimize), 把空闲空间归还给精简置备的阵列" << endl;
+    wcout << L"      默认最多 4 块磁盘同时回收; 不带分区参数时只回收 --disk 上已有的卷;" << endl;
+    wcout << L"      与 --apply 一起时释放目标上未触碰的范围 (文件打洞 / 块设备 TRIM)\n" << endl;
+    wcout << L"镜像输出 (不经过 WMI, 无需管理员权限):" << endl;
+    wcout << L"  --image=<文件>                  直接生成磁盘镜像 (.vhdx 为动态 VHDX, 其他为稀疏 raw)" << endl;
+    wcout << L"  --image-size=<大小>             虚拟磁盘大小 (如 2T)" << endl;
+    wcout << L"  --image-sector=<512|4096>       逻辑扇区大小 (默认 512)" << endl;
+    wcout << L"  --image-block=<大小>            VHDX 块大小 (默认 32M)" << endl;
+    wcout << L"  --export=<文件|->               以稀疏流 (Android sparse 格式) 输出磁盘内容, - 为标准输出" << endl;
+    wcout << L"  --stamp=<N>                     生成 N 个同布局镜像: 克隆第一个, 其余只写入不同的 GUID/卷标扇区" << endl;
+    wcout << L"      --image 路径与 label= / vol= 中的 {n} 替换为序号 (从 1 开始)" << endl;
+    wcout << L"  --seed=<N>                      由种子确定 GUID 与卷序列号, 相同参数输出逐字节相同" << endl;
+    wcout << L"  --cache=<目录>                  缓存生成的元数据 (需要 --seed), 相同布局直接从缓存写出" << endl;
+    wcout << L"      只写入 GPT 与文件系统元数据; 原生格式化支持 ntfs, fat32" << endl;
+    wcout << L"  --farm=<作业文件>[,<参数>]      一个进程按作业文件批量生成镜像, 每批的写入与 fsync 经 io_uring 一起提交" << endl;
+    wcout << L"      作业文件: layout <名称> <参数...> 定义布局, <目标路径> <布局名称> 生成一个镜像" << endl;
+    wcout << L"      参数: batch=<每批镜像数>,engine=auto|io_uring|threads,fsync=<0|1>,workers=<线程数>" << endl;
+    wcout << L"      默认: batch=64,engine=auto,fsync=1, 线程数取 CPU 核数; 报告总吞吐与各目标目录的吞吐 (个/秒)" << endl;
+    wcout << L"  --apply=<文件|->                读取稀疏流, 只写入数据并清零零区段, - 为标准输入" << endl;
+    wcout << L"  --apply-to=<目标>               镜像文件或设备 (如 \\\\.\\PhysicalDrive2, /dev/sdb)\n" << endl;
+    wcout << L"模拟提供程序 (无需真实磁盘, 任意平台可用):" << endl;
+    wcout << L"  --sim[=<参数>]                  使用进程内模拟的 Storage 提供程序" << endl;
+    wcout << L"      参数: disks=<N>,first=<起始编号>,size=<大小>,style=raw|mbr|gpt," << endl;
+    wcout << L"            sector=<逻辑>/<物理>,seed=<种子>,realtime=<0|1>,scale=<缩放>," << endl;
+    wcout << L"            thin=<0|1>,slab=<阵列分配单位>,written=<大小|all>  (精简置备, 供 --retrim 使用)" << endl;
+    wcout << L"  --sim-latency=<操作>:<分布>:<参数>[:<参数>][:serial]" << endl;
+    wcout << L"      分布: fixed:<值> | uniform:<下限>:<上限> | normal:<均值>:<标准差>" << endl;
+    wcout << L"            lognormal:<均值>:<标准差> | exp:<均值>  (单位 ns/us/ms/s)" << endl;
+    wcout << L"      操作: ExecQuery, Next, GetObject, GetMethod, SpawnInstance, PutInstance, ExecMethod," << endl;
+    wcout << L"            Clear, Initialize, CreatePartition, Format, FormatFull(每 GiB), MountLetter," << endl;
+    wcout << L"            GetSupportedSize, Resize, AddAccessPath, UpdateHostStorageCache, ProbeRead," << endl;
+    wcout << L"            CreateStoragePool, CreateVirtualDisk, Optimize, ReTrim(每 GiB)" << endl;
+    wcout << L"  --sim-fail=<操作>:<概率>        注入失败 (0..1)" << endl;
+    wcout << L"  --sim-health=<磁盘>:<参数>      磁盘健康状态与可靠性计数器 (供 --preflight 使用)" << endl;
+    wcout << L"      参数: health=healthy|warning|unhealthy,status=<运行状态码/...>,temp=<°C>,wear=<%>," << endl;
+    wcout << L"            read-errors=<N>,write-errors=<N>,read-latency=<ms>,write-latency=<ms>," << endl;
+    wcout << L"            counters=<0|1>,probe=<探测读延迟>" << endl;
+    wcout << L"  --sim-partitions=<磁盘>:<偏移>+<大小>[/<偏移>+<大小>...]" << endl;
+    wcout << L"      预置其他工具留下的分区 (4K 簇 NTFS 卷, 供 --audit 使用)\n" << endl;
+    wcout << L"示例:" << endl;
+    wcout << L"  列出磁盘:" << endl;
+    wcout << L"    DiskPartitionTool.exe --list\n" << endl;
+    wcout << L"  完整操作示例:" << endl;
+    wcout << L"    DiskPartitionTool.exe --disk=1 --gpt \\" << endl;
+    wcout << L"      --create-part size=100M,label=EFI,type=efi \\" << endl;
+    wcout << L"      --format fs=fat32,quick=1 \\" << endl;
+    wcout << L"      --create-part size=50G,label=Windows,type=basic \\" << endl;
+    wcout << L"      --format fs=ntfs,vol=System,quick=1\n" << endl;
+    wcout << L"  把磁盘 1 的分区 2 扩展到相邻空闲空间末尾 (不清除数据):" << endl;
+    wcout << L"    DiskPartitionTool.exe --disk=1 --resize-part=number=2,size=max\n" << endl;
+    wcout << L"  在磁盘 1 上批量创建 120 个分区, 挂载到 D:\\Mounts 下:" << endl;
+    wcout << L"    DiskPartitionTool.exe --disk=1 --bulk --access-path=D:\\Mounts \\" << endl;
+    wcout << L"      --create-part=size=8G --format=fs=ntfs ...  (每个分区一组)\n" << endl;
+    wcout << L"  容量规划 (模拟 1000 块盘, 并发 16):" << endl;
+    wcout << L"    DiskPartitionTool.exe --sim=disks=1000 --disk=1-1000 --concurrency=16 --quiet \\" << endl;
+    wcout << L"      --create-part=size=50G --format=fs=ntfs,vol=Data\n" << endl;
+    wcout << L"  先预检 60 块盘, 排除温度超过 55°C 或有未纠正错误的盘, 其余并发配置:" << endl;
+    wcout << L"    DiskPartitionTool.exe --disk=1-60 --preflight=temp=55 --concurrency=16 \\" << endl;
+    wcout << L"      --create-part=size=50G --format=fs=ntfs,vol=Data\n" << endl;
+    wcout << L"  把磁盘 1-8 组成条带卷, 格式化为 NTFS (条带宽度 = 簇大小 = 512K):" << endl;
+    wcout << L"    DiskPartitionTool.exe --disk=1-8 --pool=name=Scratch --create-part=label=Scratch \\" << endl;
+    wcout << L"      --format=fs=ntfs,vol=Scratch\n" << endl;
+    wcout << L"  完全格式化 SAN LUN 后把空闲空间归还给阵列:" << endl;
+    wcout << L"    DiskPartitionTool.exe --disk=1-32 --concurrency=8 --create-part=size=2T \\" << endl;
+    wcout << L"      --format=fs=ntfs,quick=0 --retrim=concurrency=4\n" << endl;
+    wcout << L"  审计全部磁盘的分区对齐 (RAID 条带 256K), 输出 JSON 报告:" << endl;
+    wcout << L"    DiskPartitionTool.exe --audit=stripe=256K,json=audit.json --quiet\n" << endl;
+    wcout << L"  生成 2 TB 的 VHDX 镜像 (EFI + MSR + 数据分区):" << endl;
+    wcout << L"    DiskPartitionTool.exe --image=disk.vhdx --image-size=2T \\" << endl;
+    wcout << L"      --create-part=size=100M,type=efi,label=EFI --format=fs=fat32 \\" << endl;
+    wcout << L"      --create-part=size=16M,type=msr --create-part=label=Data\n" << endl;
+    wcout << L"  盖印 1000 个 VHDX 镜像:" << endl;
+    wcout << L"    DiskPartitionTool.exe --image=out/disk{n}.vhdx --stamp=1000 --image-size=64G --quiet \\" << endl;
+    wcout << L"      --create-part=size=100M,type=efi --format=fs=fat32,vol=ESP{n}\n" << endl;
+    wcout << L"  CI 按作业文件批量生成镜像 (每批 256 个):" << endl;
+    wcout << L"    DiskPartitionTool.exe --farm=jobs.txt,batch=256 --quiet" << endl;
+    wcout << L"      jobs.txt:  layout efi --image-size=8G --create-part=size=100M,type=efi --format=fs=fat32,vol=ESP{n}" << endl;
+    wcout << L"                out/ci-0001.img efi\n" << endl;
+    wcout << L"  以稀疏流发送到刷写站并写入磁盘 2:" << endl;
+    wcout << L"    DiskPartitionTool.exe --export=- --image-size=2T ... | ssh station DiskPartitionTool.exe \\" << endl;
+    wcout << L"      --apply=- --apply-to=\\\\.\\PhysicalDrive2\n" << endl;
+    wcout << L"⚠️  警告: 此工具会清除磁盘数据，请谨慎使用!" << endl;
+}
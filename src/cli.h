@@ -0,0 +1,119 @@
+﻿#pragma once
+
+/*
+ * 命令行参数解析
+ */
+
+#include "audit.h"
+#include "image_farm.h"
+#include "preflight.h"
+#include "qualify.h"
+#include "retrim.h"
+#include "sim_backend.h"
+#include "storage_pool.h"
+#include "utils.h"
+
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct CommandLineArgs {
+    std::vector<int> diskNumbers;   // --disk=1 或 --disk=1,3,5-8
+    bool initGpt = false;
+
+    struct PartitionSpec {
+        ULONGLONG size = 0;
+        ULONGLONG offset = 0;
+        std::wstring label;
+        std::wstring type = L"basic";
+    };
+    std::vector<PartitionSpec> partitions;
+
+    struct FormatSpec {
+        std::wstring fileSystem = L"ntfs";
+        std::wstring volumeLabel;
+        bool quickFormat = true;
+        ULONGLONG allocationUnitSize = 0;   // unit=, 簇大小; 0 为文件系统默认
+    };
+    std::vector<FormatSpec> formats;
+
+    // 原地调整已有分区 (--resize-part=number=N,size=<大小>|max), 不移动分区起点
+    struct ResizeSpec {
+        int partitionNumber = 0;
+        ULONGLONG size = 0;
+        bool useMaximum = false;    // size=max: 扩展到相邻空闲空间的末尾
+    };
+    std::vector<ResizeSpec> resizes;
+
+    // 批量提交 (--bulk): 不分配盘符, 跳过逐分区的挂载等待, 最后统一刷新宿主机存储缓存
+    bool bulk = false;
+    std::wstring accessPathRoot;    // --access-path=<目录>, 每个卷挂载到 <目录>\Disk<N>\Part<P>
+    bool guidPaths = false;         // --guid-paths, 输出各卷的 \\?\Volume{GUID}\ 路径
+
+    bool listDisks = false;
+
+    // 多盘并发
+    int concurrency = 1;
+    bool quiet = false;
+
+    // 模拟提供程序
+    bool simulate = false;
+    SimConfig simConfig = SimConfig::Default();
+
+    // 往返统计与调用录制/回放
+    bool stats = false;             // --stats
+    std::wstring recordPath;        // --record=<文件>
+    std::wstring replayPath;        // --replay=<文件>
+
+    // 镜像输出 (不经过 WMI)
+    std::wstring imagePath;         // --image=<文件>, .vhdx 为动态 VHDX, 其他为稀疏 raw
+    ULONGLONG imageSize = 0;        // --image-size=2T
+    unsigned imageSectorSize = 512; // --image-sector=512|4096
+    ULONGLONG imageBlockSize = 32ULL * 1024 * 1024;   // --image-block=32M (VHDX 块大小)
+    std::wstring exportPath;        // --export=<文件|->, 以稀疏流输出磁盘内容
+    int stampCount = 0;             // --stamp=<N>, 以第一个镜像为黄金镜像盖印 N 个
+    bool hasImageSeed = false;      // --seed=<N>, GUID 与卷序列号由种子确定, 输出逐字节可复现
+    unsigned long long imageSeed = 0;
+    std::wstring cacheDir;          // --cache=<目录>, 按规范化参数的 SHA-256 缓存生成的元数据
+
+    // 按作业文件批量生成镜像 (--farm=<作业文件>[,<参数>])
+    FarmSpec farm;
+
+    // 已有分区的对齐审计 (--audit[=<参数>]), 与 --image 一起时审计镜像
+    AuditSpec audit;
+
+    // 配置前的磁盘健康预检 (--preflight[=<参数>])
+    PreflightSpec preflight;
+
+    // 把选中的磁盘组成存储空间条带卷 (--pool[=<参数>]), 分区与格式化作用于虚拟磁盘
+    PoolSpec pool;
+
+    // 格式化后的 I/O 验收 (--qualify[=<参数>])
+    QualifySpec qualify;
+
+    // 格式化后回收精简置备空间 (--retrim[=<参数>]); 没有分区参数时只回收已有的卷
+    RetrimSpec retrim;
+
+    // 稀疏流写入
+    std::wstring applyPath;         // --apply=<文件|->
+    std::wstring applyTarget;       // --apply-to=<镜像文件|设备>
+
+    bool invalid = false;           // 存在无法解析的参数
+};
+
+CommandLineArgs ParseCommandLine(int argc, wchar_t* argv[]);
+
+// 数值参数 (--concurrency= / --seed= 等): 无法解析时报告并置位 invalid
+template <typename Parse>
+void ParseNumberArg(const std::wstring& arg, bool& invalid, Parse parse) {
+    try {
+        parse();
+    }
+    catch (const std::exception&) {
+        std::wcerr << L"❌ 无法解析参数: " << arg << std::endl;
+        invalid = true;
+    }
+}
+
+void PrintUsage();
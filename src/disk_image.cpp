@@ -0,0 +1,73 @@
+﻿#include "disk_image.h"
+
+#include "checksum.h"
+#include "image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+bool DiskImage::Open(const wstring& path, mt19937_64& rng) {
+    vhdx = IsVhdxPath(path);
+    if (vhdx) {
+        if (!vhdxFile.Open(path, rng)) return false;
+        diskSize = vhdxFile.DiskSize();
+        return true;
+    }
+    return raw.Open(path) && raw.QuerySize(diskSize);
+}
+
+bool ReadGpt(DiskImage& image, unsigned sectorSize, GptState& gpt) {
+    vector<unsigned> candidates = sectorSize ? vector<unsigned>{ sectorSize } : vector<unsigned>{ 512, 4096 };
+
+    for (unsigned candidate : candidates) {
+        if (image.Size() < candidate * 4ULL) continue;
+
+        vector<uint8_t> header(candidate);
+        if (!image.Read(candidate, header.data(), header.size())) return false;
+        if (memcmp(header.data(), "EFI PART", 8) != 0) continue;
+
+        uint32_t headerSize = GetLE32(&header[12]);
+        uint32_t crc = GetLE32(&header[16]);
+        if (headerSize < 92 || headerSize > candidate) continue;
+
+        PutLE32(&header[16], 0);
+        if (Crc32(header.data(), headerSize) != crc || GetLE64(&header[24]) != 1) {
+            wcerr << L"❌ 主 GPT 头校验失败" << endl;
+            return false;
+        }
+        PutLE32(&header[16], crc);
+
+        gpt.sectorSize = candidate;
+        gpt.header = header;
+        gpt.entryCount = GetLE32(&header[80]);
+        gpt.entrySize = GetLE32(&header[84]);
+        if (gpt.entrySize < 128 || gpt.entrySize % 8 != 0 || gpt.entryCount == 0
+            || (ULONGLONG)gpt.entryCount * gpt.entrySize > 4 * 1024 * 1024) {
+            wcerr << L"❌ GPT 分区表尺寸无效" << endl;
+            return false;
+        }
+
+        gpt.entries.resize((size_t)gpt.entryCount * gpt.entrySize);
+        if (!image.Read(gpt.EntriesLba() * candidate, gpt.entries.data(), gpt.entries.size())) return false;
+        if (Crc32(gpt.entries.data(), gpt.entries.size()) != GetLE32(&header[88])) {
+            wcerr << L"❌ GPT 分区表 CRC 校验失败" << endl;
+            return false;
+        }
+        return true;
+    }
+
+    wcerr << L"❌ 镜像中没有 GPT 分区表" << endl;
+    return false;
+}
+
+wstring ProbeFileSystem(const vector<uint8_t>& boot) {
+    if (all_of(boot.begin(), boot.end(), [](uint8_t b) { return b == 0; })) return L"";
+    if (boot.size() >= 90 && memcmp(&boot[82], "FAT32   ", 8) == 0) return L"FAT32";
+    if (memcmp(&boot[3], "NTFS    ", 8) == 0) return L"NTFS";
+    if (memcmp(&boot[3], "EXFAT   ", 8) == 0) return L"exFAT";
+    if (memcmp(&boot[3], "ReFS", 4) == 0) return L"ReFS";
+    return L"未知";
+}
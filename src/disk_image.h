@@ -0,0 +1,76 @@
+﻿#pragma once
+
+/*
+ * 已有镜像的随机读写与 GPT 读取
+ *
+ * raw 镜像直接按偏移读写, VHDX 经 BAT 映射; 供 --resize-part 与 --audit 的镜像模式使用。
+ */
+
+#include "byte_order.h"
+#include "file_io.h"
+#include "vhdx.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+class DiskImage {
+public:
+    // rng 只在 VHDX 首次写入时使用
+    bool Open(const std::wstring& path, std::mt19937_64& rng);
+
+    bool Read(ULONGLONG offset, void* data, size_t length) {
+        return vhdx ? vhdxFile.Read(offset, data, length) : raw.ReadAt(offset, data, length);
+    }
+
+    bool Write(ULONGLONG offset, const void* data, size_t length) {
+        bytesWritten += length;
+        return vhdx ? vhdxFile.Write(offset, data, length) : raw.WriteAt(offset, data, length);
+    }
+
+    bool Close() {
+        return vhdx ? vhdxFile.Close() : raw.Close();
+    }
+
+    bool IsVhdx() const { return vhdx; }
+    ULONGLONG Size() const { return diskSize; }
+    unsigned VhdxSectorSize() const { return vhdxFile.LogicalSectorSize(); }
+    unsigned VhdxPhysicalSectorSize() const { return vhdxFile.PhysicalSectorSize(); }
+    ULONGLONG BytesWritten() const { return bytesWritten; }
+
+private:
+    bool vhdx = false;
+    OutputFile raw;
+    VhdxFile vhdxFile;
+    ULONGLONG diskSize = 0;
+    ULONGLONG bytesWritten = 0;
+};
+
+// 主 GPT (头与分区表数组)
+struct GptState {
+    unsigned sectorSize = 512;
+    std::vector<uint8_t> header;
+    std::vector<uint8_t> entries;
+    uint32_t entryCount = 0;
+    uint32_t entrySize = 0;
+
+    ULONGLONG AlternateLba() const { return GetLE64(&header[32]); }
+    ULONGLONG FirstUsableLba() const { return GetLE64(&header[40]); }
+    ULONGLONG LastUsableLba() const { return GetLE64(&header[48]); }
+    ULONGLONG EntriesLba() const { return GetLE64(&header[72]); }
+    ULONGLONG EntryArraySectors() const { return (entries.size() + sectorSize - 1) / sectorSize; }
+
+    uint8_t* Entry(int number) { return &entries[(size_t)(number - 1) * entrySize]; }
+    bool IsUsed(int number) {
+        const uint8_t* e = Entry(number);
+        return std::any_of(e, e + 16, [](uint8_t b) { return b != 0; });
+    }
+};
+
+// 读取并校验主 GPT; sectorSize 为 0 时依次尝试 512 与 4096
+bool ReadGpt(DiskImage& image, unsigned sectorSize, GptState& gpt);
+
+// 文件系统名称 (引导扇区的 OEM 字段); 全零扇区视为空白分区, 无法识别时为 "未知"
+std::wstring ProbeFileSystem(const std::vector<uint8_t>& boot);
@@ -0,0 +1,500 @@
+﻿#include "disk_manager.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+wostream& DiskManager::Out() {
+    return verbose ? wcout : nullStream;
+}
+
+// 字节数按 GB 保留两位小数 (在局部流中格式化, 不改变 wcout/wcerr 的格式状态)
+static wstring FormatGb(ULONGLONG bytes) {
+    wostringstream text;
+    text << fixed << setprecision(2) << bytes / (1024.0 * 1024.0 * 1024.0);
+    return text.str();
+}
+
+// 枚举所有物理磁盘
+void DiskManager::EnumerateDisks() {
+    wcout << L"\n📀 枚举系统磁盘..." << endl;
+    wcout << L"==========================================\n" << endl;
+
+    auto pEnumerator = wmi.Query(L"SELECT * FROM MSFT_Disk");
+    if (!pEnumerator) return;
+
+    StorageObjectPtr pclsObj;
+
+    while (wmi.Next(*pEnumerator, pclsObj)) {
+        PropValue vtNumber, vtSize, vtModel, vtPartitionStyle, vtIsOffline;
+
+        pclsObj->Get(L"Number", vtNumber);
+        pclsObj->Get(L"Size", vtSize);
+        pclsObj->Get(L"Model", vtModel);
+        pclsObj->Get(L"PartitionStyle", vtPartitionStyle);
+        pclsObj->Get(L"IsOffline", vtIsOffline);
+
+        // Size 为 uint64, WMI 以 BSTR 返回, AsUInt64 负责统一转换
+        ULONGLONG sizeBytes = vtSize.AsUInt64();
+
+        // ============================
+        // 输出磁盘信息
+        // ============================
+        wcout << L"磁盘 " << vtNumber.AsInt() << L": ";
+
+        if (vtModel.GetKind() == PropValue::Kind::String)
+            wcout << vtModel.AsString();
+
+        wcout << endl;
+
+        wcout << L"  大小: " << fixed << setprecision(2)
+            << (sizeBytes / (1024.0 * 1024.0 * 1024.0)) << L" GB" << endl;
+
+        wcout << L"  分区样式: ";
+        switch (vtPartitionStyle.AsInt()) {
+        case 0: wcout << L"RAW (未初始化)"; break;
+        case 1: wcout << L"MBR"; break;
+        case 2: wcout << L"GPT"; break;
+        default: wcout << L"未知"; break;
+        }
+        wcout << endl;
+
+        wcout << L"  状态: " << (vtIsOffline.AsBool() ? L"离线" : L"在线") << endl;
+        wcout << endl;
+    }
+}
+
+bool DiskManager::InitializeAsGPT(int diskNumber) {
+    Out() << L"\n🔧 初始化磁盘 " << diskNumber << L" 为 GPT..." << endl;
+
+    wstringstream query;
+    query << L"SELECT * FROM MSFT_Disk WHERE Number = " << diskNumber;
+
+    auto pEnumerator = wmi.Query(query.str());
+    if (!pEnumerator) {
+        wcerr << L"❌ 查询磁盘失败" << endl;
+        return false;
+    }
+
+    StorageObjectPtr pDiskObj;
+    if (!wmi.Next(*pEnumerator, pDiskObj)) {
+        wcerr << L"❌ 未找到磁盘 " << diskNumber << endl;
+        return false;
+    }
+
+    PropValue vtPath;
+    pDiskObj->Get(L"__PATH", vtPath);
+    if (vtPath.GetKind() != PropValue::Kind::String) {
+        wcerr << L"❌ 无法获取磁盘对象路径 (__PATH)" << endl;
+        return false;
+    }
+    wstring diskPath = vtPath.AsString();
+
+    // Clear()
+    {
+        auto pInParams = wmi.PrepareMethod(L"MSFT_Disk", L"Clear");
+        if (!pInParams) return false;
+
+        pInParams->Put(L"RemoveData", true);
+
+        StorageObjectPtr pOutParams;
+        if (!wmi.ExecMethod(diskPath, L"Clear", pInParams, pOutParams)) {
+            wcerr << L"❌ Clear() 失败，无法继续初始化" << endl;
+            return false;
+        }
+
+        Out() << L"✓ Clear() 成功" << endl;
+    }
+
+    // Initialize()
+    {
+        auto pInParams = wmi.PrepareMethod(L"MSFT_Disk", L"Initialize");
+        if (!pInParams) return false;
+
+        pInParams->Put(L"PartitionStyle", 2L);
+
+        StorageObjectPtr pOutParams;
+        if (!wmi.ExecMethod(diskPath, L"Initialize", pInParams, pOutParams)) {
+            wcerr << L"❌ Initialize() 失败" << endl;
+            return false;
+        }
+
+        Out() << L"✓ Initialize(GPT) 成功" << endl;
+    }
+
+    return true;
+}
+
+// 创建 GPT 分区
+bool DiskManager::CreatePartition(
+    int diskNumber,
+    ULONGLONG size,
+    const wstring& gptLabel,
+    const wstring& gptType,
+    ULONGLONG offset
+) {
+    Out() << L"\n📝 在磁盘 " << diskNumber << L" 上创建分区..." << endl;
+    if (size > 0) {
+        Out() << L"  大小: " << (size / (1024.0 * 1024.0 * 1024.0)) << L" GB" << endl;
+    }
+    else {
+        Out() << L"  大小: 剩余空间" << endl;
+    }
+    Out() << L"  GPT 标签: " << gptLabel << endl;
+
+    wstring diskPath = L"\\\\.\\ROOT\\Microsoft\\Windows\\Storage:MSFT_Disk.Number=" + to_wstring(diskNumber);
+
+    // 获取 MSFT_Disk 类
+    auto pClass = wmi.GetObjectByPath(L"MSFT_Disk");
+    if (!pClass) {
+        wcerr << L"❌ 获取 MSFT_Disk 类失败" << endl;
+        return false;
+    }
+
+    // 获取 CreatePartition 方法
+    auto pInParamsDefinition = wmi.GetMethod(pClass, L"CreatePartition");
+    if (!pInParamsDefinition) {
+        wcerr << L"❌ 获取 CreatePartition 方法失败" << endl;
+        return false;
+    }
+
+    // 创建方法参数实例
+    auto pInParams = wmi.SpawnInstance(pInParamsDefinition);
+    if (!pInParams) {
+        wcerr << L"❌ 创建 CreatePartition 参数实例失败" << endl;
+        return false;
+    }
+
+    // Size (UINT64); 未指定时 UseMaximumSize 占用最大的空闲区间 (存储池的虚拟磁盘即整盘一个分区)
+    if (size > 0) {
+        pInParams->Put(L"Size", size);
+    }
+    pInParams->Put(L"UseMaximumSize", size == 0);
+
+    // Offset (如果指定)
+    if (offset > 0) {
+        pInParams->Put(L"Offset", offset);
+    }
+
+    // GptType (分区类型 GUID)
+    wstring guid = PartitionTypeToGuid(gptType);
+    pInParams->Put(L"GptType", guid);
+
+    // 批量模式下不分配盘符: 省去每个分区的挂载与 shell 通知, 也不受 26 个盘符的限制
+    // (未指定时保持系统默认: 基础数据分区分配盘符)
+    if (bulk) {
+        pInParams->Put(L"AssignDriveLetter", false);
+    }
+
+    // 执行方法
+    StorageObjectPtr pOutParams;
+    bool result = wmi.ExecMethod(diskPath, L"CreatePartition", pInParams, pOutParams);
+
+    // 获取创建的分区对象
+    wstring partitionPath;
+    if (result && pOutParams) {
+        PropValue varPartition;
+        pOutParams->Get(L"CreatedPartition", varPartition);
+
+        auto pPartition = varPartition.AsObject();
+        if (pPartition) {
+            PropValue varPath;
+            pPartition->Get(L"__PATH", varPath);
+            if (varPath.GetKind() == PropValue::Kind::String) {
+                partitionPath = varPath.AsString();
+                Out() << L"✓ 分区创建成功" << endl;
+
+                // 设置 GPT 分区标签
+                if (!gptLabel.empty()) {
+                    SetGptPartitionName(partitionPath, gptLabel);
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+// 设置 GPT 分区名称
+bool DiskManager::SetGptPartitionName(const wstring& partitionPath, const wstring& gptLabel) {
+    Out() << L"  设置 GPT 分区名称: " << gptLabel << endl;
+
+    // 获取分区对象
+    auto pPartition = wmi.GetObjectByPath(partitionPath);
+    if (!pPartition) {
+        wcerr << L"❌ 获取分区对象失败" << endl;
+        return false;
+    }
+
+    // 设置 GptPartitionName 属性
+    if (!pPartition->Put(L"GptPartitionName", gptLabel)) {
+        wcerr << L"❌ 设置 GptPartitionName 属性失败" << endl;
+        return false;
+    }
+
+    // 提交更改
+    if (!wmi.PutInstance(pPartition)) {
+        wcerr << L"❌ 提交 GPT 分区名称失败. 错误代码: 0x" << hex << wmi.GetBackend()->LastError() << dec << endl;
+        return false;
+    }
+
+    Out() << L"  ✓ GPT 分区名称设置成功" << endl;
+    return true;
+}
+
+// 格式化分区
+bool DiskManager::FormatPartition(
+    int diskNumber,
+    int partitionNumber,
+    const wstring& fileSystem,
+    const wstring& volumeLabel,
+    bool quickFormat,
+    ULONGLONG allocationUnitSize,
+    wchar_t* driveLetter,
+    wstring* volumePath
+) {
+    Out() << L"\n💾 格式化分区 (磁盘 " << diskNumber
+        << L", 分区 " << partitionNumber << L")..." << endl;
+    Out() << L"  文件系统: " << fileSystem << endl;
+    Out() << L"  卷标: " << volumeLabel << endl;
+    Out() << L"  快速格式化: " << (quickFormat ? L"是" : L"否") << endl;
+    if (allocationUnitSize != 0) {
+        Out() << L"  簇大小: " << FormatBytes(allocationUnitSize) << endl;
+    }
+
+    // 构建查询获取分区
+    wstringstream query;
+    query << L"SELECT * FROM MSFT_Partition WHERE DiskNumber = " << diskNumber
+        << L" AND PartitionNumber = " << partitionNumber;
+
+    auto pEnumerator = wmi.Query(query.str());
+    if (!pEnumerator) return false;
+
+    StorageObjectPtr pPartition;
+    if (!wmi.Next(*pEnumerator, pPartition)) {
+        wcerr << L"❌ 未找到指定分区" << endl;
+        return false;
+    }
+
+    // 获取分区路径
+    wstring partitionPath = pPartition->Path();
+
+    // 获取 MSFT_Partition 类
+    auto pClass = wmi.GetObjectByPath(L"MSFT_Partition");
+    if (!pClass) {
+        wcerr << L"❌ 获取 MSFT_Partition 类失败" << endl;
+        return false;
+    }
+
+    // 获取 Format 方法 (Windows 10+)
+    auto pInParamsDefinition = wmi.GetMethod(pClass, L"Format");
+    if (!pInParamsDefinition) {
+        wcerr << L"❌ 获取 Format 方法失败" << endl;
+        return false;
+    }
+
+    // 创建方法参数实例
+    auto pInParams = wmi.SpawnInstance(pInParamsDefinition);
+    if (!pInParams) {
+        wcerr << L"❌ 创建 Format 参数实例失败" << endl;
+        return false;
+    }
+
+    // FileSystem (NTFS=7, FAT32=5, exFAT=8, ReFS=9)
+    auto fsIt = FILE_SYSTEMS.find(fileSystem);
+    if (fsIt != FILE_SYSTEMS.end()) {
+        pInParams->Put(L"FileSystem", fsIt->second);
+    }
+
+    // FileSystemLabel
+    if (!volumeLabel.empty()) {
+        pInParams->Put(L"FileSystemLabel", volumeLabel);
+    }
+
+    // Full (快速格式化 = false, 完全格式化 = true)
+    pInParams->Put(L"Full", !quickFormat);
+
+    // AllocationUnitSize (字节, 省略时由文件系统按容量选择)
+    if (allocationUnitSize != 0) {
+        pInParams->Put(L"AllocationUnitSize", (unsigned int)allocationUnitSize);
+    }
+
+    // 执行格式化
+    Out() << L"  正在格式化，请稍候..." << endl;
+
+    StorageObjectPtr pOutParams;
+    bool result = wmi.ExecMethod(partitionPath, L"Format", pInParams, pOutParams);
+
+    if (result) {
+        Out() << L"✓ 分区格式化成功" << endl;
+
+        // FormattedVolume 为格式化后的 MSFT_Volume
+        if (volumePath && pOutParams) {
+            auto pVolume = pOutParams->Prop(L"FormattedVolume").AsObject();
+            if (pVolume) *volumePath = pVolume->GetString(L"Path");
+        }
+
+        // 批量模式没有盘符可等
+        if (bulk) {
+            if (driveLetter) *driveLetter = 0;
+            return result;
+        }
+
+        // 等待格式化完成并分配盘符
+        wmi.Sleep(chrono::seconds(2));
+
+        // 查询新的盘符
+        wchar_t letter = GetPartitionDriveLetter(diskNumber, partitionNumber);
+        if (driveLetter) *driveLetter = letter;
+    }
+
+    return result;
+}
+
+// 查询分区可调整的大小范围
+bool DiskManager::GetSupportedSize(const wstring& partitionPath, ULONGLONG& sizeMin, ULONGLONG& sizeMax) {
+    // GetSupportedSize 没有输入参数
+    StorageObjectPtr pOutParams;
+    if (!wmi.ExecMethod(partitionPath, L"GetSupportedSize", nullptr, pOutParams) || !pOutParams) {
+        wcerr << L"❌ GetSupportedSize() 失败" << endl;
+        return false;
+    }
+
+    // SizeMin / SizeMax 为 uint64, 以 BSTR 返回
+    PropValue vtMin, vtMax;
+    pOutParams->Get(L"SizeMin", vtMin);
+    pOutParams->Get(L"SizeMax", vtMax);
+    sizeMin = vtMin.AsUInt64();
+    sizeMax = vtMax.AsUInt64();
+    return true;
+}
+
+// 原地调整分区大小
+bool DiskManager::ResizePartition(int diskNumber, int partitionNumber, ULONGLONG size, bool useMaximum) {
+    Out() << L"\n📐 调整分区大小 (磁盘 " << diskNumber
+        << L", 分区 " << partitionNumber << L")..." << endl;
+
+    wstringstream query;
+    query << L"SELECT * FROM MSFT_Partition WHERE DiskNumber = " << diskNumber
+        << L" AND PartitionNumber = " << partitionNumber;
+
+    auto pEnumerator = wmi.Query(query.str());
+    if (!pEnumerator) return false;
+
+    StorageObjectPtr pPartition;
+    if (!wmi.Next(*pEnumerator, pPartition)) {
+        wcerr << L"❌ 未找到指定分区" << endl;
+        return false;
+    }
+
+    wstring partitionPath = pPartition->Path();
+
+    PropValue vtSize;
+    pPartition->Get(L"Size", vtSize);
+    ULONGLONG currentSize = vtSize.AsUInt64();
+
+    // 预检查: 目标大小必须落在提供程序支持的范围内
+    ULONGLONG sizeMin = 0, sizeMax = 0;
+    if (!GetSupportedSize(partitionPath, sizeMin, sizeMax)) {
+        return false;
+    }
+
+    Out() << L"  当前大小: " << FormatGb(currentSize) << L" GB" << endl;
+    Out() << L"  支持范围: " << FormatGb(sizeMin) << L" GB - " << FormatGb(sizeMax) << L" GB" << endl;
+
+    if (useMaximum) size = sizeMax;
+    if (size < sizeMin || size > sizeMax) {
+        wcerr << L"❌ 目标大小 " << FormatGb(size) << L" GB 超出支持范围 ("
+            << FormatGb(sizeMin) << L" GB - " << FormatGb(sizeMax) << L" GB)" << endl;
+        return false;
+    }
+
+    if (size == currentSize) {
+        Out() << L"✓ 已是目标大小, 无需调整" << endl;
+        return true;
+    }
+
+    auto pInParams = wmi.PrepareMethod(L"MSFT_Partition", L"Resize");
+    if (!pInParams) return false;
+
+    pInParams->Put(L"Size", size);
+
+    Out() << L"  " << (size > currentSize ? L"扩展" : L"收缩") << L"到: " << FormatGb(size) << L" GB" << endl;
+
+    StorageObjectPtr pOutParams;
+    if (!wmi.ExecMethod(partitionPath, L"Resize", pInParams, pOutParams)) {
+        wcerr << L"❌ Resize() 失败 (磁盘 " << diskNumber << L", 分区 " << partitionNumber << L")" << endl;
+        return false;
+    }
+
+    Out() << L"✓ 分区大小调整成功" << endl;
+    return true;
+}
+
+// 把分区挂载到文件夹
+bool DiskManager::AddAccessPath(int diskNumber, int partitionNumber, const wstring& accessPath) {
+    wstringstream query;
+    query << L"SELECT * FROM MSFT_Partition WHERE DiskNumber = " << diskNumber
+        << L" AND PartitionNumber = " << partitionNumber;
+
+    auto pEnumerator = wmi.Query(query.str());
+    if (!pEnumerator) return false;
+
+    StorageObjectPtr pPartition;
+    if (!wmi.Next(*pEnumerator, pPartition)) {
+        wcerr << L"❌ 未找到指定分区" << endl;
+        return false;
+    }
+
+    auto pInParams = wmi.PrepareMethod(L"MSFT_Partition", L"AddAccessPath");
+    if (!pInParams) return false;
+
+    pInParams->Put(L"AccessPath", accessPath);
+
+    StorageObjectPtr pOutParams;
+    if (!wmi.ExecMethod(pPartition->Path(), L"AddAccessPath", pInParams, pOutParams)) {
+        wcerr << L"❌ AddAccessPath() 失败: " << accessPath << endl;
+        return false;
+    }
+
+    Out() << L"  挂载到: " << accessPath << endl;
+    return true;
+}
+
+// 刷新宿主机存储缓存
+bool DiskManager::UpdateHostStorageCache() {
+    // 静态方法, 没有输入参数
+    StorageObjectPtr pOutParams;
+    if (!wmi.ExecMethod(L"MSFT_StorageSetting", L"UpdateHostStorageCache", nullptr, pOutParams)) {
+        wcerr << L"❌ UpdateHostStorageCache() 失败" << endl;
+        return false;
+    }
+
+    Out() << L"✓ 已刷新宿主机存储缓存" << endl;
+    return true;
+}
+
+// 获取分区盘符
+wchar_t DiskManager::GetPartitionDriveLetter(int diskNumber, int partitionNumber) {
+    wstringstream query;
+    query << L"SELECT * FROM MSFT_Partition WHERE DiskNumber = " << diskNumber
+        << L" AND PartitionNumber = " << partitionNumber;
+
+    auto pEnumerator = wmi.Query(query.str());
+    if (!pEnumerator) return 0;
+
+    StorageObjectPtr pPartition;
+    if (!wmi.Next(*pEnumerator, pPartition)) return 0;
+
+    // DriveLetter 为 char16, 未分配时为 0
+    PropValue varLetter;
+    pPartition->Get(L"DriveLetter", varLetter);
+
+    if (varLetter.GetKind() == PropValue::Kind::Int && varLetter.AsInt() != 0) {
+        Out() << L"  分配盘符: " << (wchar_t)varLetter.AsInt() << L":\\" << endl;
+        return (wchar_t)varLetter.AsInt();
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+﻿#pragma once
+
+/*
+ * 磁盘管理类
+ *
+ * 通过 WMIManager 调用 MSFT_Disk / MSFT_Partition 方法完成初始化、分区、格式化与调整大小。
+ */
+
+#include "wmi_manager.h"
+
+#include <ostream>
+#include <string>
+
+class DiskManager {
+private:
+    WMIManager& wmi;
+    bool verbose;
+    bool bulk;
+
+    // 无缓冲区的流: 所有写入都被忽略 (每个实例一个, 并发的工作线程不共享流状态)
+    std::wostream nullStream{ nullptr };
+
+    // 进度输出 (quiet 模式下丢弃), 错误信息始终输出到 wcerr
+    std::wostream& Out();
+
+public:
+    DiskManager(WMIManager& wmiMgr) : wmi(wmiMgr), verbose(true), bulk(false) {}
+
+    void SetVerbose(bool enabled) { verbose = enabled; }
+
+    // 批量模式: 新分区不分配盘符, 格式化后不等待挂载、不查询盘符
+    // (宿主机存储缓存由调用方在最后统一刷新, 见 UpdateHostStorageCache)
+    void SetBulk(bool enabled) { bulk = enabled; }
+
+    WMIManager& Wmi() { return wmi; }
+
+    // 枚举所有物理磁盘
+    void EnumerateDisks();
+
+    bool InitializeAsGPT(int diskNumber);
+
+    // 创建 GPT 分区; size 为 0 时使用最大的空闲区间 (UseMaximumSize)
+    bool CreatePartition(
+        int diskNumber,
+        ULONGLONG size,
+        const std::wstring& gptLabel,
+        const std::wstring& gptType,
+        ULONGLONG offset = 0
+    );
+
+    // 设置 GPT 分区名称
+    bool SetGptPartitionName(const std::wstring& partitionPath, const std::wstring& gptLabel);
+
+    // 格式化分区; allocationUnitSize 为 0 时使用默认簇大小;
+    // driveLetter 非空时返回分配的盘符 (未分配为 0),
+    // volumePath 非空时返回卷 GUID 路径 (\\?\Volume{...}\)
+    bool FormatPartition(
+        int diskNumber,
+        int partitionNumber,
+        const std::wstring& fileSystem,
+        const std::wstring& volumeLabel,
+        bool quickFormat,
+        ULONGLONG allocationUnitSize = 0,
+        wchar_t* driveLetter = nullptr,
+        std::wstring* volumePath = nullptr
+    );
+
+    // 把分区挂载到文件夹 (MSFT_Partition.AddAccessPath), 路径以 \ 结尾
+    bool AddAccessPath(int diskNumber, int partitionNumber, const std::wstring& accessPath);
+
+    // 刷新宿主机存储缓存 (MSFT_StorageSetting.UpdateHostStorageCache)
+    bool UpdateHostStorageCache();
+
+    // 查询分区可调整的大小范围 (MSFT_Partition.GetSupportedSize)
+    bool GetSupportedSize(const std::wstring& partitionPath, ULONGLONG& sizeMin, ULONGLONG& sizeMax);
+
+    // 原地调整分区大小 (MSFT_Partition.Resize): 先检查支持的范围, 分区起点不变;
+    // useMaximum 时扩展到支持的上限 (相邻空闲空间末尾)
+    bool ResizePartition(int diskNumber, int partitionNumber, ULONGLONG size, bool useMaximum);
+
+    // 获取分区盘符, 未分配时返回 0
+    wchar_t GetPartitionDriveLetter(int diskNumber, int partitionNumber);
+};
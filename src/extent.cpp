@@ -0,0 +1,195 @@
+﻿#include "extent.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+void ExpandFill(uint32_t fill, ULONGLONG position, void* buffer, size_t length) {
+    uint8_t* out = (uint8_t*)buffer;
+    if (fill == (fill & 0xFF) * 0x01010101u) {
+        memset(out, (int)(fill & 0xFF), length);
+        return;
+    }
+    for (size_t i = 0; i < length; i++) out[i] = FillByte(fill, position + i);
+}
+
+// 数据区段与数据区段、同值的填充区段之间可以合并
+static bool SameKind(const ImageExtent& a, const ImageExtent& b) {
+    return a.data.empty() == b.data.empty() && (!a.data.empty() || a.fill == b.fill);
+}
+
+void ExtentList::Punch(ULONGLONG offset, ULONGLONG length) {
+    if (length == 0) return;
+    const ULONGLONG end = offset + length;
+
+    // 第一个可能重叠的区段: 起点在 offset 之前且跨过 offset 的那个
+    auto it = extents.upper_bound(offset);
+    if (it != extents.begin() && prev(it)->second.End() > offset) {
+        --it;
+    }
+
+    vector<ImageExtent> remainders;
+    while (it != extents.end() && it->second.offset < end) {
+        ImageExtent& ext = it->second;
+
+        // 保留重叠区间之前的部分
+        if (ext.offset < offset) {
+            ImageExtent head;
+            head.offset = ext.offset;
+            head.length = offset - ext.offset;
+            head.fill = ext.fill;
+            if (!ext.data.empty()) head.data.assign(ext.data.begin(), ext.data.begin() + (size_t)head.length);
+            remainders.push_back(move(head));
+        }
+
+        // 保留重叠区间之后的部分
+        if (ext.End() > end) {
+            ImageExtent tail;
+            tail.offset = end;
+            tail.length = ext.End() - end;
+            tail.fill = ext.fill;
+            if (!ext.data.empty()) tail.data.assign(ext.data.end() - (size_t)tail.length, ext.data.end());
+            remainders.push_back(move(tail));
+        }
+
+        it = extents.erase(it);
+    }
+
+    for (auto& piece : remainders) {
+        ULONGLONG key = piece.offset;
+        extents[key] = move(piece);
+    }
+}
+
+void ExtentList::Coalesce(map<ULONGLONG, ImageExtent>::iterator it) {
+    // 先与后继合并
+    auto next = std::next(it);
+    if (next != extents.end() && next->second.offset == it->second.End() && SameKind(next->second, it->second)) {
+        ImageExtent& ext = it->second;
+        if (!ext.data.empty()) ext.data.insert(ext.data.end(), next->second.data.begin(), next->second.data.end());
+        ext.length += next->second.length;
+        extents.erase(next);
+    }
+
+    // 再与前驱合并
+    if (it != extents.begin()) {
+        auto previous = prev(it);
+        if (previous->second.End() == it->second.offset && SameKind(previous->second, it->second)) {
+            ImageExtent& ext = previous->second;
+            if (!ext.data.empty()) ext.data.insert(ext.data.end(), it->second.data.begin(), it->second.data.end());
+            ext.length += it->second.length;
+            extents.erase(it);
+        }
+    }
+}
+
+void ExtentList::Write(ULONGLONG offset, const void* data, size_t length) {
+    if (length == 0) return;
+    Punch(offset, length);
+
+    ImageExtent ext;
+    ext.offset = offset;
+    ext.length = length;
+    ext.data.assign((const uint8_t*)data, (const uint8_t*)data + length);
+
+    auto it = extents.emplace(offset, move(ext)).first;
+    Coalesce(it);
+}
+
+void ExtentList::Fill(ULONGLONG offset, ULONGLONG length, uint32_t fill) {
+    if (length == 0) return;
+    Punch(offset, length);
+
+    ImageExtent ext;
+    ext.offset = offset;
+    ext.length = length;
+    ext.fill = fill;
+
+    auto it = extents.emplace(offset, move(ext)).first;
+    Coalesce(it);
+}
+
+void ExtentList::Read(ULONGLONG offset, void* buffer, size_t length) const {
+    uint8_t* out = (uint8_t*)buffer;
+    memset(out, 0, length);
+    const ULONGLONG end = offset + length;
+
+    auto it = extents.upper_bound(offset);
+    if (it != extents.begin()) --it;
+
+    for (; it != extents.end() && it->second.offset < end; ++it) {
+        const ImageExtent& ext = it->second;
+        if (ext.IsZero() || ext.End() <= offset) continue;
+
+        ULONGLONG from = max(offset, ext.offset);
+        ULONGLONG to = min(end, ext.End());
+        if (ext.IsFill()) ExpandFill(ext.fill, from, out + (from - offset), (size_t)(to - from));
+        else memcpy(out + (from - offset), ext.data.data() + (from - ext.offset), (size_t)(to - from));
+    }
+}
+
+ULONGLONG ExtentList::DataBytes() const {
+    ULONGLONG total = 0;
+    for (const auto& entry : extents) {
+        if (!entry.second.IsZero()) total += entry.second.length;
+    }
+    return total;
+}
+
+ULONGLONG ExtentList::ZeroBytes() const {
+    ULONGLONG total = 0;
+    for (const auto& entry : extents) {
+        if (entry.second.IsZero()) total += entry.second.length;
+    }
+    return total;
+}
+
+ULONGLONG ExtentList::StoredBytes() const {
+    ULONGLONG total = 0;
+    for (const auto& entry : extents) {
+        total += entry.second.data.size();
+    }
+    return total;
+}
+
+vector<pair<ULONGLONG, ULONGLONG>> DiffExtents(const ExtentList& base, const ExtentList& other, unsigned granularity) {
+    // 任一侧的数据区段 (按粒度扩展) 的并集
+    vector<pair<ULONGLONG, ULONGLONG>> candidates;
+    for (const ExtentList* list : { &base, &other }) {
+        for (const auto& entry : list->Extents()) {
+            const ImageExtent& ext = entry.second;
+            if (ext.IsZero()) continue;
+            ULONGLONG first = ext.offset / granularity * granularity;
+            ULONGLONG end = (ext.End() + granularity - 1) / granularity * granularity;
+            candidates.push_back({ first, end });
+        }
+    }
+    sort(candidates.begin(), candidates.end());
+
+    vector<pair<ULONGLONG, ULONGLONG>> merged;
+    for (const auto& range : candidates) {
+        if (!merged.empty() && range.first <= merged.back().second) {
+            merged.back().second = max(merged.back().second, range.second);
+        }
+        else {
+            merged.push_back(range);
+        }
+    }
+
+    // 逐粒度比较, 不同的相邻单元合并为一个范围
+    vector<pair<ULONGLONG, ULONGLONG>> diffs;
+    vector<uint8_t> a(granularity);
+    vector<uint8_t> b(granularity);
+    for (const auto& range : merged) {
+        for (ULONGLONG pos = range.first; pos < range.second; pos += granularity) {
+            base.Read(pos, a.data(), granularity);
+            other.Read(pos, b.data(), granularity);
+            if (memcmp(a.data(), b.data(), granularity) == 0) continue;
+
+            if (!diffs.empty() && diffs.back().second == pos) diffs.back().second = pos + granularity;
+            else diffs.push_back({ pos, pos + granularity });
+        }
+    }
+    return diffs;
+}
@@ -0,0 +1,84 @@
+﻿#pragma once
+
+/*
+ * 镜像区段列表
+ *
+ * 生成的镜像只由少量元数据构成 (保护性 MBR、GPT、文件系统元数据),
+ * 其余部分均为空洞。区段列表按虚拟偏移记录互不重叠的区间:
+ *   - 数据区段: 带内容的字节
+ *   - 零区段:   必须读出为零的区间 (写入新镜像时无需落盘,
+ *               写入已有磁盘时需要显式清零)
+ *   - 填充区段: 按 4 字节值重复的内容 (如 NTFS 空日志的 0xFF), 只记录填充值,
+ *               稀疏流导出为 FILL 块组, 写出镜像文件时才展开
+ * 未被任何区段覆盖的范围是空洞, 内容无关紧要。
+ */
+
+#include "utils.h"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// 填充值在绝对偏移 position 处的字节 (填充值按小端 4 字节从偏移 0 起重复)
+inline uint8_t FillByte(uint32_t fill, ULONGLONG position) {
+    return (uint8_t)(fill >> (8 * (position % 4)));
+}
+
+// 把 [position, position + length) 的填充内容展开到 buffer
+void ExpandFill(uint32_t fill, ULONGLONG position, void* buffer, size_t length);
+
+struct ImageExtent {
+    ULONGLONG offset = 0;
+    ULONGLONG length = 0;
+    std::vector<uint8_t> data;     // 为空表示零区段或填充区段
+    uint32_t fill = 0;             // 无数据时的填充值, 0 为零区段
+
+    bool IsZero() const { return data.empty() && fill == 0; }
+    bool IsFill() const { return data.empty() && fill != 0; }
+    ULONGLONG End() const { return offset + length; }
+};
+
+class ExtentList {
+public:
+    // 写入数据, 覆盖与之重叠的已有区段; 与相邻数据区段合并
+    void Write(ULONGLONG offset, const void* data, size_t length);
+    void Write(ULONGLONG offset, const std::vector<uint8_t>& data) {
+        Write(offset, data.data(), data.size());
+    }
+
+    // 标记必须为零的区间
+    void Zero(ULONGLONG offset, ULONGLONG length) { Fill(offset, length, 0); }
+
+    // 标记按填充值重复的区间 (0 即零区段); 与相邻的同值填充区段合并
+    void Fill(ULONGLONG offset, ULONGLONG length, uint32_t fill);
+
+    // 读取区间内容 (空洞与零区段读出为零, 填充区段展开)
+    void Read(ULONGLONG offset, void* buffer, size_t length) const;
+
+    const std::map<ULONGLONG, ImageExtent>& Extents() const { return extents; }
+    size_t Count() const { return extents.size(); }
+    bool Empty() const { return extents.empty(); }
+
+    ULONGLONG DataBytes() const;       // 数据与填充区段
+    ULONGLONG ZeroBytes() const;
+    ULONGLONG StoredBytes() const;     // 实际保存的字节 (只含数据区段)
+
+    void Clear() { extents.clear(); }
+
+private:
+    // 移除 [offset, offset + length) 与已有区段的重叠部分
+    void Punch(ULONGLONG offset, ULONGLONG length);
+
+    // 与前后相邻的同类区段 (填充区段须同值) 合并
+    void Coalesce(std::map<ULONGLONG, ImageExtent>::iterator it);
+
+    std::map<ULONGLONG, ImageExtent> extents;   // 键为 offset
+};
+
+// 两份区段列表内容不同的范围 [offset, end), 按 granularity 字节对齐并合并相邻范围;
+// 只比较数据区段覆盖的范围 (两侧都为零/空洞的范围视为相同)
+std::vector<std::pair<ULONGLONG, ULONGLONG>> DiffExtents(
+    const ExtentList& base,
+    const ExtentList& other,
+    unsigned granularity
+);
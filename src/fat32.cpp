@@ -0,0 +1,175 @@
+﻿#include "fat32.h"
+
+#include "byte_order.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+static const uint32_t FAT32_EOC = 0x0FFFFFFF;
+static const uint8_t MEDIA_FIXED_DISK = 0xF8;
+
+// Microsoft FAT 规范中的 FAT32 默认簇大小
+static unsigned DefaultClusterBytes(ULONGLONG partitionSize) {
+    const ULONGLONG MiB = 1024ULL * 1024;
+    if (partitionSize <= 260 * MiB) return 512;
+    if (partitionSize <= 8192 * MiB) return 4096;
+    if (partitionSize <= 16384 * MiB) return 8192;
+    if (partitionSize <= 32768 * MiB) return 16384;
+    return 32768;
+}
+
+bool PlanFat32(ULONGLONG partitionSize, unsigned sectorSize, unsigned clusterBytes, Fat32Geometry& geometry) {
+    geometry = Fat32Geometry();
+    geometry.bytesPerSector = sectorSize;
+    geometry.totalSectors = partitionSize / sectorSize;
+
+    if (clusterBytes == 0) clusterBytes = DefaultClusterBytes(partitionSize);
+    if (clusterBytes < sectorSize) clusterBytes = sectorSize;
+    if (clusterBytes % sectorSize != 0 || clusterBytes / sectorSize > 128
+        || ((clusterBytes / sectorSize) & (clusterBytes / sectorSize - 1)) != 0) {
+        wcerr << L"❌ 无效的 FAT32 簇大小: " << clusterBytes << endl;
+        return false;
+    }
+    geometry.sectorsPerCluster = clusterBytes / sectorSize;
+
+    const ULONGLONG spc = geometry.sectorsPerCluster;
+    const ULONGLONG entriesPerSector = sectorSize / 4;
+
+    if (geometry.totalSectors > 0xFFFFFFFFULL) {
+        wcerr << L"❌ 分区超过 FAT32 的 2^32 扇区上限" << endl;
+        return false;
+    }
+    if (geometry.totalSectors <= geometry.reservedSectors + spc) {
+        wcerr << L"❌ 分区太小, 无法格式化为 FAT32" << endl;
+        return false;
+    }
+
+    // FAT 大小按不计 FAT 本身时的簇数估算 (略大于实际所需)
+    ULONGLONG clustersUpperBound = (geometry.totalSectors - geometry.reservedSectors) / spc;
+    geometry.fatSectors = (clustersUpperBound + 2 + entriesPerSector - 1) / entriesPerSector;
+
+    // 数据区起点对齐到 1 MiB, 多出的扇区并入保留区
+    const ULONGLONG alignSectors = PARTITION_ALIGNMENT / sectorSize;
+    ULONGLONG dataStart = geometry.DataStartSector();
+    ULONGLONG aligned = (dataStart + alignSectors - 1) / alignSectors * alignSectors;
+    if (aligned < geometry.totalSectors && geometry.reservedSectors + (aligned - dataStart) <= 0xFFFF) {
+        geometry.reservedSectors += (unsigned)(aligned - dataStart);
+    }
+
+    if (geometry.DataStartSector() >= geometry.totalSectors) {
+        wcerr << L"❌ 分区太小, 无法格式化为 FAT32" << endl;
+        return false;
+    }
+
+    geometry.clusterCount = (geometry.totalSectors - geometry.DataStartSector()) / spc;
+    if (geometry.clusterCount < FAT32_MIN_CLUSTERS || geometry.clusterCount > FAT32_MAX_CLUSTERS) {
+        wcerr << L"❌ FAT32 簇数 " << geometry.clusterCount << L" 超出有效范围 ("
+            << FAT32_MIN_CLUSTERS << L" - " << FAT32_MAX_CLUSTERS << L"), 请调整分区或簇大小" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+// 卷标: 大写 ASCII, 11 字节空格填充
+static void CopyVolumeLabel(uint8_t* dest, const wstring& label) {
+    memset(dest, ' ', 11);
+    for (size_t i = 0; i < label.size() && i < 11; i++) {
+        wchar_t c = towupper(label[i]);
+        bool valid = c >= 0x20 && c < 0x7F && !wcschr(L"\"*+,./:;<=>?[\\]|", c);
+        dest[i] = valid ? (uint8_t)c : '_';
+    }
+}
+
+bool FormatFat32(
+    const DiskLayout& layout,
+    const PlannedPartition& partition,
+    uint32_t volumeSerial,
+    ExtentList& extents
+) {
+    Fat32Geometry geo;
+    const ULONGLONG clusterBytes = partition.formatSpec.allocationUnitSize;
+    if (clusterBytes > 0xFFFFFFFFULL || !PlanFat32(partition.size, layout.sectorSize, (unsigned)clusterBytes, geo)) {
+        return false;
+    }
+
+    const ULONGLONG base = partition.offset;
+    const unsigned bps = geo.bytesPerSector;
+    const wstring& label = partition.formatSpec.volumeLabel;
+
+    // 完全格式化: 整个分区清零; 快速格式化: 仅清零保留区、FAT 与根目录簇
+    if (!partition.formatSpec.quickFormat) {
+        extents.Zero(base, partition.size);
+    }
+    else {
+        extents.Zero(base, geo.DataStartSector() * bps + geo.ClusterBytes());
+    }
+
+    // ---------- 引导扇区 ----------
+    vector<uint8_t> boot(bps, 0);
+    uint8_t* b = boot.data();
+
+    b[0] = 0xEB; b[1] = 0x58; b[2] = 0x90;
+    memcpy(b + 3, "MSDOS5.0", 8);
+    PutLE16(b + 11, (uint16_t)bps);
+    b[13] = (uint8_t)geo.sectorsPerCluster;
+    PutLE16(b + 14, (uint16_t)geo.reservedSectors);
+    b[16] = (uint8_t)geo.fatCount;
+    b[21] = MEDIA_FIXED_DISK;
+    PutLE16(b + 24, 63);                                      // 每磁道扇区数
+    PutLE16(b + 26, 255);                                     // 磁头数
+    PutLE32(b + 28, (uint32_t)min<ULONGLONG>(base / bps, 0xFFFFFFFFULL));   // 隐藏扇区
+    PutLE32(b + 32, (uint32_t)geo.totalSectors);
+    PutLE32(b + 36, (uint32_t)geo.fatSectors);
+    PutLE32(b + 44, 2);                                       // 根目录簇
+    PutLE16(b + 48, 1);                                       // FSInfo 扇区
+    PutLE16(b + 50, 6);                                       // 备份引导扇区
+    b[64] = 0x80;                                             // 驱动器号
+    b[66] = 0x29;                                             // 扩展引导签名
+    PutLE32(b + 67, volumeSerial);
+    if (label.empty()) memcpy(b + 71, "NO NAME    ", 11);
+    else CopyVolumeLabel(b + 71, label);
+    memcpy(b + 82, "FAT32   ", 8);
+    b[510] = 0x55;
+    b[511] = 0xAA;
+
+    // ---------- FSInfo ----------
+    vector<uint8_t> fsInfo(bps, 0);
+    PutLE32(&fsInfo[0], 0x41615252);
+    PutLE32(&fsInfo[484], 0x61417272);
+    PutLE32(&fsInfo[488], (uint32_t)(geo.clusterCount - 1));  // 根目录占用 1 簇
+    PutLE32(&fsInfo[492], 3);
+    PutLE32(&fsInfo[508], 0xAA550000);
+
+    extents.Write(base, boot);
+    extents.Write(base + 1ULL * bps, fsInfo);
+    extents.Write(base + 6ULL * bps, boot);
+    extents.Write(base + 7ULL * bps, fsInfo);
+
+    // ---------- FAT: 介质描述、保留项与根目录簇链 ----------
+    uint8_t fatHead[12];
+    PutLE32(fatHead + 0, 0x0FFFFF00 | MEDIA_FIXED_DISK);
+    PutLE32(fatHead + 4, FAT32_EOC);
+    PutLE32(fatHead + 8, FAT32_EOC);
+
+    for (unsigned i = 0; i < geo.fatCount; i++) {
+        ULONGLONG fatOffset = base + (geo.reservedSectors + i * geo.fatSectors) * bps;
+        extents.Write(fatOffset, fatHead, sizeof(fatHead));
+    }
+
+    // ---------- 根目录: 卷标项 ----------
+    if (!label.empty()) {
+        uint8_t entry[32] = {};
+        CopyVolumeLabel(entry, label);
+        entry[11] = 0x08;                                     // ATTR_VOLUME_ID
+        extents.Write(base + geo.DataStartSector() * bps, entry, sizeof(entry));
+    }
+
+    return true;
+}
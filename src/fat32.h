@@ -0,0 +1,42 @@
+﻿#pragma once
+
+/*
+ * FAT32 原生格式化 (镜像模式)
+ *
+ * 直接生成引导扇区 (及位于扇区 6 的备份)、FSInfo、两份 FAT 与根目录簇,
+ * 不经过 MSFT_Partition.Format。簇大小默认按 Microsoft FAT 规范的容量表选择,
+ * 数据区起点对齐到 1 MiB (与 Windows 格式化结果一致)。
+ */
+
+#include "extent.h"
+#include "layout.h"
+
+#include <cstdint>
+
+// FAT32 有效簇数范围
+constexpr ULONGLONG FAT32_MIN_CLUSTERS = 65525;
+constexpr ULONGLONG FAT32_MAX_CLUSTERS = 0x0FFFFFF5;
+
+struct Fat32Geometry {
+    unsigned bytesPerSector = 512;
+    unsigned sectorsPerCluster = 1;
+    unsigned reservedSectors = 32;
+    unsigned fatCount = 2;
+    ULONGLONG fatSectors = 0;          // 每份 FAT 的扇区数
+    ULONGLONG totalSectors = 0;
+    ULONGLONG clusterCount = 0;
+
+    unsigned ClusterBytes() const { return bytesPerSector * sectorsPerCluster; }
+    ULONGLONG DataStartSector() const { return reservedSectors + fatCount * fatSectors; }
+};
+
+// 计算 FAT32 几何参数; clusterBytes 为 0 时按容量表选择
+bool PlanFat32(ULONGLONG partitionSize, unsigned sectorSize, unsigned clusterBytes, Fat32Geometry& geometry);
+
+// 在分区范围内生成 FAT32 元数据
+bool FormatFat32(
+    const DiskLayout& layout,
+    const PlannedPartition& partition,
+    uint32_t volumeSerial,
+    ExtentList& extents
+);
@@ -0,0 +1,833 @@
+﻿#include "file_io.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <winioctl.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/falloc.h>
+#include <linux/fs.h>
+#endif
+#endif
+
+using namespace std;
+
+// 顺序流的缓冲区大小
+static const size_t STREAM_BUFFER_BYTES = 1024 * 1024;
+
+// 写零时每次写入的大小
+static const size_t ZERO_WRITE_BYTES = 1024 * 1024;
+
+// ================================
+// 平台无关部分
+// ================================
+
+const wchar_t* CloneMethodName(CloneMethod method) {
+    switch (method) {
+    case CloneMethod::Reflink: return L"reflink";
+    case CloneMethod::CopyRange: return L"copy_file_range";
+    default: return L"copy";
+    }
+}
+
+bool OutputFile::WriteZeros(ULONGLONG offset, ULONGLONG length) {
+    static const vector<uint8_t> zeros(ZERO_WRITE_BYTES, 0);
+
+    while (length > 0) {
+        size_t chunk = (size_t)min<ULONGLONG>(length, zeros.size());
+        if (!WriteAt(offset, zeros.data(), chunk)) return false;
+        offset += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool OutputStream::Write(const void* data, size_t length) {
+    if (failed) return false;
+    const uint8_t* p = (const uint8_t*)data;
+
+    // 大块直接写出, 小块先进入缓冲区
+    if (buffer.size() + length > STREAM_BUFFER_BYTES) {
+        if (!FlushBuffer()) return false;
+        if (length >= STREAM_BUFFER_BYTES) {
+            if (!WriteRaw(p, length)) return false;
+            bytesWritten += length;
+            return true;
+        }
+    }
+
+    buffer.insert(buffer.end(), p, p + length);
+    bytesWritten += length;
+    return true;
+}
+
+bool OutputStream::FlushBuffer() {
+    if (buffer.empty()) return true;
+    bool ok = WriteRaw(buffer.data(), buffer.size());
+    buffer.clear();
+    return ok;
+}
+
+bool InputStream::Read(void* data, size_t length) {
+    uint8_t* p = (uint8_t*)data;
+
+    while (length > 0) {
+        if (bufferPos == bufferEnd) {
+            // 大块直接读入目标, 小块经缓冲区
+            if (length >= STREAM_BUFFER_BYTES) {
+                long long got = ReadSome(p, length);
+                if (got <= 0) break;
+                p += got;
+                length -= (size_t)got;
+                bytesRead += (ULONGLONG)got;
+                continue;
+            }
+
+            buffer.resize(STREAM_BUFFER_BYTES);
+            long long got = ReadSome(buffer.data(), buffer.size());
+            if (got <= 0) break;
+            bufferPos = 0;
+            bufferEnd = (size_t)got;
+        }
+
+        size_t take = min(length, bufferEnd - bufferPos);
+        memcpy(p, buffer.data() + bufferPos, take);
+        bufferPos += take;
+        p += take;
+        length -= take;
+        bytesRead += take;
+    }
+
+    if (length > 0) {
+        wcerr << L"❌ 读取 " << path << L" 失败: 流意外结束" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool InputStream::Skip(ULONGLONG length) {
+    uint8_t scratch[4096];
+    while (length > 0) {
+        size_t chunk = (size_t)min<ULONGLONG>(length, sizeof(scratch));
+        if (!Read(scratch, chunk)) return false;
+        length -= chunk;
+    }
+    return true;
+}
+
+#ifdef _WIN32
+
+bool OutputFile::Create(const wstring& filePath) {
+    Close();
+    path = filePath;
+    device = false;
+
+    handle = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        wcerr << L"❌ 无法创建文件 " << path << L". 错误代码: " << GetLastError() << endl;
+        return false;
+    }
+
+    // 稀疏文件: 未写入的范围不占用空间 (不支持时退化为普通文件)
+    DWORD returned = 0;
+    DeviceIoControl(handle, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &returned, NULL);
+    return true;
+}
+
+bool OutputFile::Open(const wstring& filePath) {
+    Close();
+    path = filePath;
+    device = path.find(L"\\\\.\\") == 0;
+
+    handle = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+        device ? OPEN_EXISTING : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        wcerr << L"❌ 无法打开 " << path << L". 错误代码: " << GetLastError() << endl;
+        return false;
+    }
+
+    if (!device) {
+        DWORD returned = 0;
+        DeviceIoControl(handle, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &returned, NULL);
+    }
+    return true;
+}
+
+bool OutputFile::QuerySize(ULONGLONG& size) {
+    if (device) {
+        GET_LENGTH_INFORMATION info = {};
+        DWORD returned = 0;
+        if (!DeviceIoControl(handle, IOCTL_DISK_GET_LENGTH_INFO, NULL, 0, &info, sizeof(info), &returned, NULL)) {
+            wcerr << L"❌ 无法获取设备容量 " << path << L". 错误代码: " << GetLastError() << endl;
+            return false;
+        }
+        size = (ULONGLONG)info.Length.QuadPart;
+        return true;
+    }
+
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(handle, &length)) {
+        wcerr << L"❌ 无法获取文件大小 " << path << L". 错误代码: " << GetLastError() << endl;
+        return false;
+    }
+    size = (ULONGLONG)length.QuadPart;
+    return true;
+}
+
+bool OutputFile::SetSize(ULONGLONG size) {
+    LARGE_INTEGER position;
+    position.QuadPart = (LONGLONG)size;
+    if (!SetFilePointerEx(handle, position, NULL, FILE_BEGIN) || !SetEndOfFile(handle)) {
+        wcerr << L"❌ 设置文件大小失败 " << path << L". 错误代码: " << GetLastError() << endl;
+        return false;
+    }
+    return true;
+}
+
+bool OutputFile::WriteAt(ULONGLONG offset, const void* data, size_t length) {
+    const uint8_t* p = (const uint8_t*)data;
+
+    while (length > 0) {
+        OVERLAPPED ov = {};
+        ov.Offset = (DWORD)offset;
+        ov.OffsetHigh = (DWORD)(offset >> 32);
+
+        DWORD chunk = (DWORD)min<size_t>(length, 64u * 1024 * 1024);
+        DWORD written = 0;
+        if (!WriteFile(handle, p, chunk, &written, &ov) || written == 0) {
+            wcerr << L"❌ 写入文件失败 " << path << L". 错误代码: " << GetLastError() << endl;
+            return false;
+        }
+
+        p += written;
+        offset += written;
+        length -= written;
+        bytesWritten += written;
+    }
+
+    writeCount++;
+    return true;
+}
+
+bool OutputFile::ReadAt(ULONGLONG offset, void* data, size_t length) {
+    uint8_t* p = (uint8_t*)data;
+
+    while (length > 0) {
+        OVERLAPPED ov = {};
+        ov.Offset = (DWORD)offset;
+        ov.OffsetHigh = (DWORD)(offset >> 32);
+
+        DWORD chunk = (DWORD)min<size_t>(length, 64u * 1024 * 1024);
+        DWORD got = 0;
+        if (!ReadFile(handle, p, chunk, &got, &ov) || got == 0) {
+            wcerr << L"❌ 读取文件失败 " << path << L". 错误代码: " << GetLastError() << endl;
+            return false;
+        }
+
+        p += got;
+        offset += got;
+        length -= got;
+    }
+    return true;
+}
+
+bool OutputFile::ZeroRange(ULONGLONG offset, ULONGLONG length) {
+    if (length == 0) return true;
+
+    // 稀疏文件: 释放范围内的已分配空间, 读出为零
+    if (!device) {
+        FILE_ZERO_DATA_INFORMATION info = {};
+        info.FileOffset.QuadPart = (LONGLONG)offset;
+        info.BeyondFinalZero.QuadPart = (LONGLONG)(offset + length);
+
+        DWORD returned = 0;
+        if (DeviceIoControl(handle, FSCTL_SET_ZERO_DATA, &info, sizeof(info), NULL, 0, &returned, NULL)) {
+            zeroedBytes += length;
+            return true;
+        }
+    }
+
+    if (!WriteZeros(offset, length)) return false;
+    zeroedBytes += length;
+    return true;
+}
+
+bool OutputFile::Discard(ULONGLONG offset, ULONGLONG length) {
+    if (length == 0) return true;
+
+    DWORD returned = 0;
+    BOOL ok = FALSE;
+
+    if (!device) {
+        // 稀疏文件中置零的范围即被释放
+        FILE_ZERO_DATA_INFORMATION info = {};
+        info.FileOffset.QuadPart = (LONGLONG)offset;
+        info.BeyondFinalZero.QuadPart = (LONGLONG)(offset + length);
+        ok = DeviceIoControl(handle, FSCTL_SET_ZERO_DATA, &info, sizeof(info), NULL, 0, &returned, NULL);
+    }
+    else {
+        // 数据集管理 (DSM) TRIM: 属性头后紧跟一个范围
+        struct TrimRequest {
+            DEVICE_MANAGE_DATA_SET_ATTRIBUTES attributes;
+            DEVICE_DATA_SET_RANGE range;
+        } request = {};
+        request.attributes.Size = sizeof(request.attributes);
+        request.attributes.Action = DeviceDsmAction_Trim;
+        request.attributes.DataSetRangesOffset = (DWORD)offsetof(TrimRequest, range);
+        request.attributes.DataSetRangesLength = sizeof(request.range);
+        request.range.StartingOffset = (LONGLONG)offset;
+        request.range.LengthInBytes = length;
+        ok = DeviceIoControl(handle, IOCTL_STORAGE_MANAGE_DATA_SET_ATTRIBUTES, &request, sizeof(request),
+            NULL, 0, &returned, NULL);
+    }
+
+    if (!ok) return false;
+    discardedBytes += length;
+    return true;
+}
+
+bool OutputFile::QueryAllocated(ULONGLONG& bytes) {
+    FILE_STANDARD_INFO info = {};
+    if (device || !GetFileInformationByHandleEx(handle, FileStandardInfo, &info, sizeof(info))) return false;
+
+    bytes = (ULONGLONG)info.AllocationSize.QuadPart;
+    return true;
+}
+
+bool OutputFile::CloneFrom(const wstring& sourcePath, CloneMethod& method) {
+    HANDLE source = CreateFileW(sourcePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (source == INVALID_HANDLE_VALUE) {
+        wcerr << L"❌ 无法打开 " << sourcePath << L". 错误代码: " << GetLastError() << endl;
+        return false;
+    }
+
+    LARGE_INTEGER sourceSize;
+    bool ok = GetFileSizeEx(source, &sourceSize) != FALSE && SetSize((ULONGLONG)sourceSize.QuadPart);
+
+    // 源文件的已分配范围 (稀疏文件的空洞不复制)
+    vector<FILE_ALLOCATED_RANGE_BUFFER> ranges;
+    if (ok) {
+        FILE_ALLOCATED_RANGE_BUFFER query = {};
+        query.Length.QuadPart = sourceSize.QuadPart;
+
+        for (;;) {
+            FILE_ALLOCATED_RANGE_BUFFER found[64];
+            DWORD returned = 0;
+            BOOL done = DeviceIoControl(source, FSCTL_QUERY_ALLOCATED_RANGES, &query, sizeof(query),
+                found, sizeof(found), &returned, NULL);
+            if (!done && GetLastError() != ERROR_MORE_DATA) {
+                // 不支持稀疏查询的文件系统: 整个文件视为已分配
+                ranges.assign(1, query);
+                break;
+            }
+
+            DWORD count = returned / sizeof(FILE_ALLOCATED_RANGE_BUFFER);
+            ranges.insert(ranges.end(), found, found + count);
+            if (done || count == 0) break;
+
+            const auto& last = found[count - 1];
+            query.FileOffset.QuadPart = last.FileOffset.QuadPart + last.Length.QuadPart;
+            query.Length.QuadPart = sourceSize.QuadPart - query.FileOffset.QuadPart;
+        }
+    }
+
+    // ReFS 块克隆失败一次后改为读写复制
+    method = CloneMethod::Reflink;
+    vector<uint8_t> buffer;
+
+    for (const auto& range : ranges) {
+        if (!ok) break;
+
+        if (method == CloneMethod::Reflink) {
+            DUPLICATE_EXTENTS_DATA clone = {};
+            clone.FileHandle = source;
+            clone.SourceFileOffset = range.FileOffset;
+            clone.TargetFileOffset = range.FileOffset;
+            clone.ByteCount = range.Length;
+
+            DWORD returned = 0;
+            if (DeviceIoControl(handle, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &clone, sizeof(clone), NULL, 0, &returned, NULL)) {
+                continue;
+            }
+            method = CloneMethod::Copy;
+        }
+
+        ULONGLONG offset = (ULONGLONG)range.FileOffset.QuadPart;
+        ULONGLONG remaining = (ULONGLONG)range.Length.QuadPart;
+        buffer.resize(ZERO_WRITE_BYTES);
+
+        while (ok && remaining > 0) {
+            OVERLAPPED ov = {};
+            ov.Offset = (DWORD)offset;
+            ov.OffsetHigh = (DWORD)(offset >> 32);
+
+            DWORD got = 0;
+            if (!ReadFile(source, buffer.data(), (DWORD)min<ULONGLONG>(remaining, buffer.size()), &got, &ov) || got == 0) {
+                wcerr << L"❌ 读取 " << sourcePath << L" 失败. 错误代码: " << GetLastError() << endl;
+                ok = false;
+                break;
+            }
+
+            ok = WriteAt(offset, buffer.data(), got);
+            offset += got;
+            remaining -= got;
+            copiedBytes += got;
+        }
+    }
+
+    CloseHandle(source);
+    return ok;
+}
+
+bool OutputFile::Flush() {
+    if (!FlushFileBuffers(handle)) {
+        wcerr << L"❌ 刷新失败 " << path << L". 错误代码: " << GetLastError() << endl;
+        return false;
+    }
+    return true;
+}
+
+bool OutputFile::Close() {
+    if (handle == INVALID_HANDLE_VALUE) return true;
+
+    bool ok = FlushFileBuffers(handle) != FALSE;
+    ok = CloseHandle(handle) != FALSE && ok;
+    handle = INVALID_HANDLE_VALUE;
+    return ok;
+}
+
+bool OutputFile::IsOpen() const {
+    return handle != INVALID_HANDLE_VALUE;
+}
+
+bool OutputStream::Open(const wstring& streamPath) {
+    Close();
+    path = streamPath;
+    failed = false;
+    toStdout = path == L"-";
+
+    if (toStdout) {
+        // 控制台输出为 UTF-16 文本模式, 数据流需要切换为二进制
+        _setmode(_fileno(stdout), _O_BINARY);
+        handle = GetStdHandle(STD_OUTPUT_HANDLE);
+    }
+    else {
+        handle = CreateFileW(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    }
+
+    if (handle == INVALID_HANDLE_VALUE || handle == NULL) {
+        wcerr << L"❌ 无法打开输出 " << path << L". 错误代码: " << GetLastError() << endl;
+        handle = INVALID_HANDLE_VALUE;
+        return false;
+    }
+    return true;
+}
+
+bool OutputStream::WriteRaw(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        DWORD chunk = (DWORD)min<size_t>(length, 64u * 1024 * 1024);
+        DWORD written = 0;
+        if (!WriteFile(handle, data, chunk, &written, NULL) || written == 0) {
+            wcerr << L"❌ 写入 " << path << L" 失败. 错误代码: " << GetLastError() << endl;
+            failed = true;
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+bool OutputStream::Close() {
+    if (handle == INVALID_HANDLE_VALUE) return !failed;
+
+    bool ok = FlushBuffer() && !failed;
+    if (!toStdout) ok = CloseHandle(handle) != FALSE && ok;
+    handle = INVALID_HANDLE_VALUE;
+    return ok;
+}
+
+bool InputStream::Open(const wstring& streamPath) {
+    Close();
+    path = streamPath;
+    fromStdin = path == L"-";
+    bufferPos = bufferEnd = 0;
+
+    if (fromStdin) {
+        _setmode(_fileno(stdin), _O_BINARY);
+        handle = GetStdHandle(STD_INPUT_HANDLE);
+    }
+    else {
+        handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    }
+
+    if (handle == INVALID_HANDLE_VALUE || handle == NULL) {
+        wcerr << L"❌ 无法打开输入 " << path << L". 错误代码: " << GetLastError() << endl;
+        handle = INVALID_HANDLE_VALUE;
+        return false;
+    }
+    return true;
+}
+
+long long InputStream::ReadSome(uint8_t* data, size_t length) {
+    DWORD got = 0;
+    if (!ReadFile(handle, data, (DWORD)min<size_t>(length, 64u * 1024 * 1024), &got, NULL)) {
+        // 管道写端关闭视为流结束
+        if (GetLastError() == ERROR_BROKEN_PIPE) return 0;
+        wcerr << L"❌ 读取 " << path << L" 失败. 错误代码: " << GetLastError() << endl;
+        return -1;
+    }
+    return got;
+}
+
+void InputStream::Close() {
+    if (handle == INVALID_HANDLE_VALUE) return;
+    if (!fromStdin) CloseHandle(handle);
+    handle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool OutputFile::Create(const wstring& filePath) {
+    Close();
+    path = filePath;
+    device = false;
+
+    fd = open(ToUtf8(path).c_str(), O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        wcerr << L"❌ 无法创建文件 " << path << L": " << FromUtf8(strerror(errno)) << endl;
+        return false;
+    }
+    return true;
+}
+
+bool OutputFile::Open(const wstring& filePath) {
+    Close();
+    path = filePath;
+
+    fd = open(ToUtf8(path).c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        wcerr << L"❌ 无法打开 " << path << L": " << FromUtf8(strerror(errno)) << endl;
+        return false;
+    }
+
+    struct stat st;
+    device = fstat(fd, &st) == 0 && S_ISBLK(st.st_mode);
+    return true;
+}
+
+bool OutputFile::QuerySize(ULONGLONG& size) {
+#ifdef __linux__
+    if (device) {
+        uint64_t bytes = 0;
+        if (ioctl(fd, BLKGETSIZE64, &bytes) != 0) {
+            wcerr << L"❌ 无法获取设备容量 " << path << L": " << FromUtf8(strerror(errno)) << endl;
+            return false;
+        }
+        size = bytes;
+        return true;
+    }
+#endif
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        wcerr << L"❌ 无法获取文件大小 " << path << L": " << FromUtf8(strerror(errno)) << endl;
+        return false;
+    }
+    size = (ULONGLONG)st.st_size;
+    return true;
+}
+
+bool OutputFile::SetSize(ULONGLONG size) {
+    if (ftruncate(fd, (off_t)size) != 0) {
+        wcerr << L"❌ 设置文件大小失败 " << path << L": " << FromUtf8(strerror(errno)) << endl;
+        return false;
+    }
+    return true;
+}
+
+bool OutputFile::WriteAt(ULONGLONG offset, const void* data, size_t length) {
+    const uint8_t* p = (const uint8_t*)data;
+
+    while (length > 0) {
+        ssize_t written = pwrite(fd, p, length, (off_t)offset);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) {
+            wcerr << L"❌ 写入文件失败 " << path << L": " << FromUtf8(strerror(errno)) << endl;
+            return false;
+        }
+
+        p += written;
+        offset += (ULONGLONG)written;
+        length -= (size_t)written;
+        bytesWritten += (ULONGLONG)written;
+    }
+
+    writeCount++;
+    return true;
+}
+
+bool OutputFile::ReadAt(ULONGLONG offset, void* data, size_t length) {
+    uint8_t* p = (uint8_t*)data;
+
+    while (length > 0) {
+        ssize_t got = pread(fd, p, length, (off_t)offset);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) {
+            wcerr << L"❌ 读取文件失败 " << path << L": "
+                << (got < 0 ? FromUtf8(strerror(errno)) : wstring(L"超出文件末尾")) << endl;
+            return false;
+        }
+
+        p += got;
+        offset += (ULONGLONG)got;
+        length -= (size_t)got;
+    }
+    return true;
+}
+
+bool OutputFile::ZeroRange(ULONGLONG offset, ULONGLONG length) {
+    if (length == 0) return true;
+
+#ifdef __linux__
+    // 文件打洞 (读出为零且释放空间); 块设备使用 BLKZEROOUT (可由设备卸载为 WRITE ZEROES)
+    if (!device) {
+        if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)offset, (off_t)length) == 0) {
+            zeroedBytes += length;
+            return true;
+        }
+    }
+    else {
+        uint64_t range[2] = { offset, length };
+        if (ioctl(fd, BLKZEROOUT, range) == 0) {
+            zeroedBytes += length;
+            return true;
+        }
+    }
+#endif
+
+    if (!WriteZeros(offset, length)) return false;
+    zeroedBytes += length;
+    return true;
+}
+
+bool OutputFile::Discard(ULONGLONG offset, ULONGLONG length) {
+    if (length == 0) return true;
+
+#ifdef __linux__
+    // 文件打洞; 块设备 BLKDISCARD (TRIM / UNMAP)
+    int ret = -1;
+    if (!device) {
+        ret = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)offset, (off_t)length);
+    }
+    else {
+        uint64_t range[2] = { offset, length };
+        ret = ioctl(fd, BLKDISCARD, range);
+    }
+    if (ret == 0) {
+        discardedBytes += length;
+        return true;
+    }
+#else
+    (void)offset;
+#endif
+    return false;
+}
+
+bool OutputFile::QueryAllocated(ULONGLONG& bytes) {
+    struct stat st;
+    if (device || fstat(fd, &st) != 0) return false;
+
+    // st_blocks 以 512 字节为单位
+    bytes = (ULONGLONG)st.st_blocks * 512;
+    return true;
+}
+
+// [offset, offset + length) 从 source 复制到 target; copy_file_range 不可用时退化为读写
+static bool CopyFileRange(int source, int target, ULONGLONG offset, ULONGLONG length,
+    CloneMethod& method, ULONGLONG& copied) {
+#ifdef __linux__
+    while (method == CloneMethod::CopyRange && length > 0) {
+        loff_t in = (loff_t)offset;
+        loff_t out = (loff_t)offset;
+        ssize_t n = copy_file_range(source, &in, target, &out, (size_t)length, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            method = CloneMethod::Copy;
+            break;
+        }
+        offset += (ULONGLONG)n;
+        length -= (ULONGLONG)n;
+        copied += (ULONGLONG)n;
+    }
+#endif
+
+    vector<uint8_t> buffer;
+    while (length > 0) {
+        method = CloneMethod::Copy;
+        buffer.resize((size_t)min<ULONGLONG>(length, ZERO_WRITE_BYTES));
+
+        ssize_t n = pread(source, buffer.data(), buffer.size(), (off_t)offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0 || pwrite(target, buffer.data(), (size_t)n, (off_t)offset) != n) return false;
+
+        offset += (ULONGLONG)n;
+        length -= (ULONGLONG)n;
+        copied += (ULONGLONG)n;
+    }
+    return true;
+}
+
+bool OutputFile::CloneFrom(const wstring& sourcePath, CloneMethod& method) {
+    int source = open(ToUtf8(sourcePath).c_str(), O_RDONLY | O_CLOEXEC);
+    if (source < 0) {
+        wcerr << L"❌ 无法打开 " << sourcePath << L": " << FromUtf8(strerror(errno)) << endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(source, &st) != 0) {
+        close(source);
+        return false;
+    }
+
+#ifdef FICLONE
+    // 同一文件系统 (btrfs / XFS) 上共享全部区段, 不复制数据
+    if (ioctl(fd, FICLONE, source) == 0) {
+        method = CloneMethod::Reflink;
+        close(source);
+        return true;
+    }
+#endif
+
+    method = CloneMethod::CopyRange;
+    bool ok = SetSize((ULONGLONG)st.st_size);
+    const ULONGLONG size = (ULONGLONG)st.st_size;
+
+    // 只复制数据段, 空洞保持为空洞
+    ULONGLONG pos = 0;
+    while (ok && pos < size) {
+        ULONGLONG dataStart = pos;
+        ULONGLONG dataEnd = size;
+#ifdef SEEK_DATA
+        off_t data = lseek(source, (off_t)pos, SEEK_DATA);
+        if (data < 0) break;   // 之后全是空洞
+        off_t hole = lseek(source, data, SEEK_HOLE);
+        dataStart = (ULONGLONG)data;
+        dataEnd = hole < 0 ? size : (ULONGLONG)hole;
+#endif
+        ok = CopyFileRange(source, fd, dataStart, dataEnd - dataStart, method, copiedBytes);
+        pos = dataEnd;
+    }
+
+    if (!ok) {
+        wcerr << L"❌ 复制 " << sourcePath << L" 到 " << path << L" 失败: " << FromUtf8(strerror(errno)) << endl;
+    }
+    close(source);
+    return ok;
+}
+
+bool OutputFile::Flush() {
+    if (fsync(fd) != 0) {
+        wcerr << L"❌ 刷新失败 " << path << L": " << FromUtf8(strerror(errno)) << endl;
+        return false;
+    }
+    return true;
+}
+
+bool OutputFile::Close() {
+    if (fd < 0) return true;
+
+    bool ok = close(fd) == 0;
+    fd = -1;
+    return ok;
+}
+
+bool OutputFile::IsOpen() const {
+    return fd >= 0;
+}
+
+bool OutputStream::Open(const wstring& streamPath) {
+    Close();
+    path = streamPath;
+    failed = false;
+    toStdout = path == L"-";
+
+    fd = toStdout ? STDOUT_FILENO : open(ToUtf8(path).c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        wcerr << L"❌ 无法打开输出 " << path << L": " << FromUtf8(strerror(errno)) << endl;
+        return false;
+    }
+    return true;
+}
+
+bool OutputStream::WriteRaw(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) {
+            wcerr << L"❌ 写入 " << path << L" 失败: " << FromUtf8(strerror(errno)) << endl;
+            failed = true;
+            return false;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+bool OutputStream::Close() {
+    if (fd < 0) return !failed;
+
+    bool ok = FlushBuffer() && !failed;
+    if (!toStdout) ok = close(fd) == 0 && ok;
+    fd = -1;
+    return ok;
+}
+
+bool InputStream::Open(const wstring& streamPath) {
+    Close();
+    path = streamPath;
+    fromStdin = path == L"-";
+    bufferPos = bufferEnd = 0;
+
+    fd = fromStdin ? STDIN_FILENO : open(ToUtf8(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        wcerr << L"❌ 无法打开输入 " << path << L": " << FromUtf8(strerror(errno)) << endl;
+        return false;
+    }
+    return true;
+}
+
+long long InputStream::ReadSome(uint8_t* data, size_t length) {
+    for (;;) {
+        ssize_t got = read(fd, data, length);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) {
+            wcerr << L"❌ 读取 " << path << L" 失败: " << FromUtf8(strerror(errno)) << endl;
+        }
+        return got;
+    }
+}
+
+void InputStream::Close() {
+    if (fd < 0) return;
+    if (!fromStdin) close(fd);
+    fd = -1;
+}
+
+#endif
@@ -0,0 +1,171 @@
+﻿#pragma once
+
+/*
+ * 镜像文件输出
+ *
+ * 按偏移写入 (pwrite / 带 OVERLAPPED 偏移的 WriteFile), 文件尽量设为稀疏,
+ * 只有真正写入的字节占用空间。统计写入字节数与写入次数用于汇总输出。
+ *
+ * OutputStream / InputStream 为顺序读写的流 (文件、管道或 "-" 表示标准输出/输入),
+ * 以二进制方式读写, 内部缓冲以减少小块读写的系统调用。
+ */
+
+#include "utils.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 复制文件内容的方式 (由快到慢)
+enum class CloneMethod {
+    Reflink,        // 共享区段 (Linux FICLONE / ReFS 块克隆), 不复制数据
+    CopyRange,      // 内核内复制已分配范围 (copy_file_range)
+    Copy,           // 读写复制已分配范围
+};
+
+const wchar_t* CloneMethodName(CloneMethod method);
+
+class OutputFile {
+public:
+    OutputFile() = default;
+    ~OutputFile() { Close(); }
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    // 创建 (或截断) 文件
+    bool Create(const std::wstring& path);
+
+    // 打开已有文件或块设备 (如 \\.\PhysicalDrive2, /dev/sdb) 且不截断; 文件不存在时创建
+    bool Open(const std::wstring& path);
+
+    // 设置文件长度 (扩展部分为空洞)
+    bool SetSize(ULONGLONG size);
+
+    // 当前长度 (块设备为容量)
+    bool QuerySize(ULONGLONG& size);
+
+    bool WriteAt(ULONGLONG offset, const void* data, size_t length);
+
+    // 读满 length 字节 (用于原地修改已有镜像)
+    bool ReadAt(ULONGLONG offset, void* data, size_t length);
+
+    // 将范围清零: 文件打洞, 块设备优先使用设备清零命令, 都不支持时写入零
+    bool ZeroRange(ULONGLONG offset, ULONGLONG length);
+
+    // 释放范围占用的存储 (文件打洞, 块设备 TRIM / UNMAP), 之后的内容不确定;
+    // 不支持时返回 false 且不写入任何数据
+    bool Discard(ULONGLONG offset, ULONGLONG length);
+
+    // 文件实际占用的空间 (稀疏文件不含空洞); 块设备不支持
+    bool QueryAllocated(ULONGLONG& bytes);
+
+    // 用 sourcePath 的内容填充本文件 (应为刚 Create 的空文件): 优先共享区段,
+    // 否则只复制源文件的已分配范围, 空洞保持为空洞
+    bool CloneFrom(const std::wstring& sourcePath, CloneMethod& method);
+
+    // 将已写入的数据刷到存储
+    bool Flush();
+
+    // 刷新并关闭, 返回是否成功
+    bool Close();
+
+    bool IsOpen() const;
+    bool IsDevice() const { return device; }
+    const std::wstring& Path() const { return path; }
+
+    ULONGLONG BytesWritten() const { return bytesWritten; }
+    ULONGLONG WriteCount() const { return writeCount; }
+    ULONGLONG ZeroedBytes() const { return zeroedBytes; }
+    ULONGLONG DiscardedBytes() const { return discardedBytes; }
+    ULONGLONG CopiedBytes() const { return copiedBytes; }  // CloneFrom 实际复制的字节数
+
+private:
+    bool WriteZeros(ULONGLONG offset, ULONGLONG length);
+
+    std::wstring path;
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+    bool device = false;
+    ULONGLONG bytesWritten = 0;
+    ULONGLONG writeCount = 0;
+    ULONGLONG zeroedBytes = 0;
+    ULONGLONG discardedBytes = 0;
+    ULONGLONG copiedBytes = 0;
+};
+
+class OutputStream {
+public:
+    OutputStream() = default;
+    ~OutputStream() { Close(); }
+
+    OutputStream(const OutputStream&) = delete;
+    OutputStream& operator=(const OutputStream&) = delete;
+
+    // "-" 为标准输出
+    bool Open(const std::wstring& path);
+
+    bool Write(const void* data, size_t length);
+
+    // 写出缓冲区并关闭, 返回是否成功
+    bool Close();
+
+    bool IsStdout() const { return toStdout; }
+    ULONGLONG BytesWritten() const { return bytesWritten; }
+
+private:
+    bool WriteRaw(const uint8_t* data, size_t length);
+    bool FlushBuffer();
+
+    std::wstring path;
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+    bool toStdout = false;
+    bool failed = false;
+    std::vector<uint8_t> buffer;
+    ULONGLONG bytesWritten = 0;
+};
+
+class InputStream {
+public:
+    InputStream() = default;
+    ~InputStream() { Close(); }
+
+    InputStream(const InputStream&) = delete;
+    InputStream& operator=(const InputStream&) = delete;
+
+    // "-" 为标准输入
+    bool Open(const std::wstring& path);
+
+    // 读满 length 字节; 流提前结束或出错时返回 false
+    bool Read(void* data, size_t length);
+
+    // 跳过 length 字节
+    bool Skip(ULONGLONG length);
+
+    void Close();
+
+    ULONGLONG BytesRead() const { return bytesRead; }
+
+private:
+    // 读取最多 length 字节, 返回实际字节数 (0 为流结束, -1 为出错)
+    long long ReadSome(uint8_t* data, size_t length);
+
+    std::wstring path;
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+    bool fromStdin = false;
+    std::vector<uint8_t> buffer;
+    size_t bufferPos = 0;
+    size_t bufferEnd = 0;
+    ULONGLONG bytesRead = 0;
+};
@@ -0,0 +1,93 @@
+﻿#include "gpt.h"
+
+#include "byte_order.h"
+#include "checksum.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+vector<uint8_t> BuildGptEntries(const DiskLayout& layout) {
+    vector<uint8_t> entries((size_t)GPT_ENTRY_ARRAY_BYTES, 0);
+
+    for (const auto& part : layout.partitions) {
+        uint8_t* e = &entries[(size_t)(part.number - 1) * GPT_ENTRY_SIZE];
+
+        memcpy(e + 0, part.typeGuid.bytes, 16);
+        memcpy(e + 16, part.uniqueGuid.bytes, 16);
+        PutLE64(e + 32, part.offset / layout.sectorSize);
+        PutLE64(e + 40, part.End() / layout.sectorSize - 1);
+        PutLE64(e + 48, part.attributes);
+
+        // 名称: UTF-16LE, 最多 36 个字符
+        for (size_t i = 0; i < part.name.size() && i < GPT_NAME_CHARS; i++) {
+            PutLE16(e + 56 + i * 2, (uint16_t)part.name[i]);
+        }
+    }
+
+    return entries;
+}
+
+vector<uint8_t> BuildGptHeader(const DiskLayout& layout, const vector<uint8_t>& entries, bool primary) {
+    vector<uint8_t> header(layout.sectorSize, 0);
+    uint8_t* h = header.data();
+
+    const ULONGLONG lastLba = layout.SectorCount() - 1;
+    const ULONGLONG myLba = primary ? 1 : lastLba;
+    const ULONGLONG alternateLba = primary ? lastLba : 1;
+    const ULONGLONG entriesLba = primary ? 2 : lastLba - layout.EntryArraySectors();
+
+    memcpy(h, "EFI PART", 8);
+    PutLE32(h + 8, 0x00010000);                  // Revision 1.0
+    PutLE32(h + 12, 92);                         // HeaderSize
+    PutLE64(h + 24, myLba);
+    PutLE64(h + 32, alternateLba);
+    PutLE64(h + 40, layout.FirstUsableLba());
+    PutLE64(h + 48, layout.LastUsableLba());
+    memcpy(h + 56, layout.diskGuid.bytes, 16);
+    PutLE64(h + 72, entriesLba);
+    PutLE32(h + 80, GPT_ENTRY_COUNT);
+    PutLE32(h + 84, GPT_ENTRY_SIZE);
+    PutLE32(h + 88, Crc32(entries.data(), entries.size()));
+
+    // HeaderCRC32 计算时自身字段为零
+    PutLE32(h + 16, Crc32(h, 92));
+    return header;
+}
+
+vector<uint8_t> BuildProtectiveMbr(const DiskLayout& layout) {
+    vector<uint8_t> mbr(layout.sectorSize, 0);
+    uint8_t* p = mbr.data() + 446;
+
+    ULONGLONG sectors = min<ULONGLONG>(layout.SectorCount() - 1, 0xFFFFFFFFULL);
+
+    p[0] = 0x00;                                 // 非活动
+    p[1] = 0x00; p[2] = 0x02; p[3] = 0x00;       // 起始 CHS
+    p[4] = 0xEE;                                 // GPT 保护分区
+    p[5] = 0xFF; p[6] = 0xFF; p[7] = 0xFF;       // 结束 CHS
+    PutLE32(p + 8, 1);
+    PutLE32(p + 12, (uint32_t)sectors);
+
+    mbr[510] = 0x55;
+    mbr[511] = 0xAA;
+    return mbr;
+}
+
+void WriteGpt(const DiskLayout& layout, ExtentList& extents) {
+    const ULONGLONG sector = layout.sectorSize;
+    const ULONGLONG lastLba = layout.SectorCount() - 1;
+
+    // 分区表前后的保留区必须为零 (清除旧的分区表残留)
+    extents.Zero(0, layout.FirstUsableLba() * sector);
+    extents.Zero((layout.LastUsableLba() + 1) * sector, (lastLba - layout.LastUsableLba()) * sector);
+
+    auto entries = BuildGptEntries(layout);
+
+    extents.Write(0, BuildProtectiveMbr(layout));
+    extents.Write(1 * sector, BuildGptHeader(layout, entries, true));
+    extents.Write(2 * sector, entries);
+
+    extents.Write((lastLba - layout.EntryArraySectors()) * sector, entries);
+    extents.Write(lastLba * sector, BuildGptHeader(layout, entries, false));
+}
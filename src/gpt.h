@@ -0,0 +1,26 @@
+﻿#pragma once
+
+/*
+ * GPT 序列化
+ *
+ * 生成保护性 MBR、主 GPT 头与分区表 (LBA 1 起) 以及位于磁盘末尾的备份分区表与备份头,
+ * 头与分区表的 CRC32 按 UEFI 规范计算。
+ */
+
+#include "extent.h"
+#include "layout.h"
+
+#include <cstdint>
+#include <vector>
+
+// 分区表数组 (GPT_ENTRY_COUNT 项)
+std::vector<uint8_t> BuildGptEntries(const DiskLayout& layout);
+
+// GPT 头 (一个扇区), primary 为 false 时生成备份头
+std::vector<uint8_t> BuildGptHeader(const DiskLayout& layout, const std::vector<uint8_t>& entries, bool primary);
+
+// 保护性 MBR (LBA 0)
+std::vector<uint8_t> BuildProtectiveMbr(const DiskLayout& layout);
+
+// 写入全部 GPT 结构; 可用范围之外未被占用的扇区标记为零区段
+void WriteGpt(const DiskLayout& layout, ExtentList& extents);
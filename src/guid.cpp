@@ -0,0 +1,63 @@
+﻿#include "guid.h"
+
+#include <cstring>
+#include <cwctype>
+
+using namespace std;
+
+bool Guid::IsZero() const {
+    for (auto b : bytes) {
+        if (b != 0) return false;
+    }
+    return true;
+}
+
+bool Guid::operator==(const Guid& other) const {
+    return memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+}
+
+// 文本中 32 个十六进制数字对应的字节位置 (混合字节序)
+static const int GUID_BYTE_ORDER[16] = { 3, 2, 1, 0, 5, 4, 7, 6, 8, 9, 10, 11, 12, 13, 14, 15 };
+
+bool ParseGuid(const wstring& text, Guid& guid) {
+    wstring digits;
+    for (wchar_t c : text) {
+        if (c == L'{' || c == L'}' || c == L'-') continue;
+        if (!iswxdigit(c)) return false;
+        digits += c;
+    }
+    if (digits.size() != 32) return false;
+
+    for (int i = 0; i < 16; i++) {
+        guid.bytes[GUID_BYTE_ORDER[i]] = (uint8_t)stoul(digits.substr(i * 2, 2), nullptr, 16);
+    }
+    return true;
+}
+
+wstring FormatGuid(const Guid& guid) {
+    static const wchar_t* hexDigits = L"0123456789ABCDEF";
+
+    wstring text = L"{";
+    for (int i = 0; i < 16; i++) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) text += L'-';
+        uint8_t b = guid.bytes[GUID_BYTE_ORDER[i]];
+        text += hexDigits[b >> 4];
+        text += hexDigits[b & 0x0F];
+    }
+    text += L'}';
+    return text;
+}
+
+Guid RandomGuid(mt19937_64& rng) {
+    Guid guid;
+    uint64_t hi = rng();
+    uint64_t lo = rng();
+    for (int i = 0; i < 8; i++) {
+        guid.bytes[i] = (uint8_t)(hi >> (8 * i));
+        guid.bytes[8 + i] = (uint8_t)(lo >> (8 * i));
+    }
+
+    guid.bytes[7] = (uint8_t)((guid.bytes[7] & 0x0F) | 0x40);   // 版本 4 (第三段高 4 位)
+    guid.bytes[8] = (uint8_t)((guid.bytes[8] & 0x3F) | 0x80);   // RFC 4122 变体
+    return guid;
+}
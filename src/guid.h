@@ -0,0 +1,28 @@
+﻿#pragma once
+
+/*
+ * 磁盘结构中的 GUID
+ *
+ * GPT 与 VHDX 使用 Microsoft 混合字节序: 前三段小端, 后两段按字节顺序。
+ */
+
+#include <cstdint>
+#include <random>
+#include <string>
+
+struct Guid {
+    uint8_t bytes[16] = {};
+
+    bool IsZero() const;
+    bool operator==(const Guid& other) const;
+    bool operator!=(const Guid& other) const { return !(*this == other); }
+};
+
+// 解析 "{EBD0A0A2-B9E5-4433-87C0-68B6B72699C7}" (花括号可省略)
+bool ParseGuid(const std::wstring& text, Guid& guid);
+
+// 格式化为带花括号的大写形式
+std::wstring FormatGuid(const Guid& guid);
+
+// 随机 (版本 4) GUID
+Guid RandomGuid(std::mt19937_64& rng);
@@ -0,0 +1,369 @@
+﻿#include "image.h"
+
+#include "fat32.h"
+#include "file_io.h"
+#include "gpt.h"
+#include "layout_cache.h"
+#include "ntfs.h"
+#include "qualify.h"
+#include "sparse_stream.h"
+#include "vhdx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cwctype>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+using namespace std;
+
+// 展开填充区段时单次写入的上限
+static const ULONGLONG FILL_WRITE_BYTES = 8 * 1024 * 1024;
+
+mt19937_64 MakeImageRng(const CommandLineArgs& args, uint64_t stream) {
+    if (!args.hasImageSeed) {
+        return mt19937_64(random_device{}());
+    }
+
+    // seed_seq 的算法由标准规定, 不同平台/编译器得到相同序列
+    seed_seq seq = { (uint32_t)args.imageSeed, (uint32_t)(args.imageSeed >> 32), (uint32_t)stream };
+    return mt19937_64(seq);
+}
+
+bool IsVhdxPath(const wstring& path) {
+    if (path.size() < 5) return false;
+
+    wstring ext = path.substr(path.size() - 5);
+    for (auto& c : ext) c = towlower(c);
+    return ext == L".vhdx";
+}
+
+bool FormatImagePartition(
+    const DiskLayout& layout,
+    const PlannedPartition& partition,
+    mt19937_64& rng,
+    ExtentList& extents
+) {
+    const wstring& fs = partition.formatSpec.fileSystem;
+    // NTFS 的卷序列号为 64 位, FAT32 取低 32 位
+    uint64_t volumeSerial = rng();
+
+    if (fs == L"ntfs") {
+        return FormatNtfs(layout, partition, volumeSerial, extents);
+    }
+    if (fs == L"fat32") {
+        return FormatFat32(layout, partition, (uint32_t)volumeSerial, extents);
+    }
+
+    if (FILE_SYSTEMS.count(fs)) {
+        wcerr << L"⚠️  镜像模式暂不支持原生格式化 " << fs << L", 分区 " << partition.number
+            << L" 保持未格式化 (RAW)" << endl;
+        return true;
+    }
+
+    wcerr << L"❌ 未知的文件系统: " << fs << endl;
+    return false;
+}
+
+bool BuildImage(const CommandLineArgs& args, mt19937_64& rng, DiskLayout& layout, ExtentList& extents) {
+    extents.Clear();
+
+    if (!PlanLayout(args, args.imageSize, args.imageSectorSize, 4096, rng, layout)) {
+        return false;
+    }
+
+    WriteGpt(layout, extents);
+
+    for (const auto& part : layout.partitions) {
+        if (!part.format) continue;
+        if (!FormatImagePartition(layout, part, rng, extents)) {
+            wcerr << L"❌ 分区 " << part.number << L" 格式化失败" << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool BuildImageFile(
+    const CommandLineArgs& args,
+    const DiskLayout& layout,
+    const ExtentList& extents,
+    mt19937_64& rng,
+    ExtentList& content,
+    ImageWriteStats& stats
+) {
+    stats = ImageWriteStats();
+
+    if (IsVhdxPath(args.imagePath)) {
+        VhdxOptions options;
+        options.diskSize = layout.diskSize;
+        options.logicalSectorSize = layout.sectorSize;
+        options.physicalSectorSize = layout.physicalSectorSize;
+        options.blockSize = args.imageBlockSize;
+
+        VhdxStats vhdxStats;
+        if (!BuildVhdx(options, extents, rng, content, vhdxStats)) return false;
+
+        stats.fileSize = vhdxStats.fileSize;
+        stats.allocatedBlocks = vhdxStats.allocatedBlocks;
+        stats.totalBlocks = vhdxStats.totalBlocks;
+    }
+    else {
+        content = extents;
+        stats.fileSize = layout.diskSize;
+    }
+    return true;
+}
+
+// 填充区段按块展开后写入 (块大小是 4 的倍数, 每块的填充相位相同)
+static bool WriteFillExtent(OutputFile& file, const ImageExtent& ext, vector<uint8_t>& pattern) {
+    pattern.resize((size_t)min<ULONGLONG>(ext.length, FILL_WRITE_BYTES));
+    ExpandFill(ext.fill, ext.offset, pattern.data(), pattern.size());
+
+    for (ULONGLONG done = 0; done < ext.length; done += pattern.size()) {
+        size_t take = (size_t)min<ULONGLONG>(ext.length - done, pattern.size());
+        if (!file.WriteAt(ext.offset + done, pattern.data(), take)) return false;
+    }
+    return true;
+}
+
+bool WriteImageContent(const wstring& path, const ExtentList& content, ImageWriteStats& stats) {
+    OutputFile file;
+    if (!file.Create(path) || !file.SetSize(stats.fileSize)) {
+        return false;
+    }
+
+    // 新文件的空洞读出为零, 零区段无需写入
+    vector<uint8_t> pattern;
+    for (const auto& entry : content.Extents()) {
+        const ImageExtent& ext = entry.second;
+        if (ext.IsZero()) continue;
+        if (ext.IsFill()) {
+            if (!WriteFillExtent(file, ext, pattern)) return false;
+            continue;
+        }
+        if (!file.WriteAt(ext.offset, ext.data.data(), ext.data.size())) return false;
+    }
+
+    stats.bytesWritten = file.BytesWritten();
+    stats.writeCount = file.WriteCount();
+
+    if (!file.Close()) {
+        wcerr << L"❌ 关闭镜像文件失败: " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+bool WriteImageFile(
+    const CommandLineArgs& args,
+    const DiskLayout& layout,
+    const ExtentList& extents,
+    mt19937_64& rng,
+    ImageWriteStats& stats
+) {
+    ExtentList content;
+    return BuildImageFile(args, layout, extents, rng, content, stats)
+        && WriteImageContent(args.imagePath, content, stats);
+}
+
+static const wchar_t* PartitionTypeName(const Guid& type) {
+    Guid guid;
+    if (ParseGuid(GUID_EFI_SYSTEM_PARTITION, guid) && guid == type) return L"EFI";
+    if (ParseGuid(GUID_MICROSOFT_RESERVED, guid) && guid == type) return L"MSR";
+    if (ParseGuid(GUID_BASIC_DATA_PARTITION, guid) && guid == type) return L"Basic";
+    return L"Custom";
+}
+
+// 分区内不含数据区段的最大范围 (1 MiB 对齐); 零区段可以占用, 测试后会重新清零
+static bool FindScratchRange(const ExtentList& extents, const PlannedPartition& part, ULONGLONG& offset, ULONGLONG& length) {
+    ULONGLONG cursor = part.offset;
+    length = 0;
+
+    auto consider = [&](ULONGLONG begin, ULONGLONG end) {
+        begin = (begin + PARTITION_ALIGNMENT - 1) / PARTITION_ALIGNMENT * PARTITION_ALIGNMENT;
+        end = end / PARTITION_ALIGNMENT * PARTITION_ALIGNMENT;
+        if (end > begin && end - begin > length) {
+            offset = begin;
+            length = end - begin;
+        }
+    };
+
+    for (const auto& entry : extents.Extents()) {
+        const ImageExtent& ext = entry.second;
+        if (ext.IsZero() || ext.End() <= part.offset) continue;
+        if (ext.offset >= part.End()) break;
+
+        if (ext.offset > cursor) consider(cursor, ext.offset);
+        cursor = max(cursor, ext.End());
+    }
+    if (part.End() > cursor) consider(cursor, part.End());
+
+    return length > 0;
+}
+
+// 在 raw 镜像中各格式化分区的空闲范围上运行 I/O 验收, 之后将范围恢复为空洞
+static bool QualifyImagePartitions(
+    const CommandLineArgs& args,
+    const DiskLayout& layout,
+    const ExtentList& extents,
+    vector<QualifyResult>& results
+) {
+    bool ok = true;
+
+    for (const auto& part : layout.partitions) {
+        if (!part.format) continue;
+
+        QualifyResult result;
+        ULONGLONG offset = 0;
+        ULONGLONG length = 0;
+        if (!FindScratchRange(extents, part, offset, length)) {
+            result.target = args.imagePath + L" 分区 " + to_wstring(part.number);
+            result.skipReason = L"没有空闲范围";
+        }
+        else {
+            length = min(length, args.qualify.size) / PARTITION_ALIGNMENT * PARTITION_ALIGNMENT;
+            QualifyRange(args.imagePath, offset, length, args.qualify, result);
+
+            OutputFile file;
+            if (!file.Open(args.imagePath) || !file.ZeroRange(offset, length) || !file.Close()) {
+                wcerr << L"❌ 无法恢复验收范围: " << args.imagePath << L" @ " << FormatBytes(offset) << endl;
+                return false;
+            }
+        }
+
+        if (!result.Passed()) ok = false;
+        results.push_back(result);
+    }
+    return ok;
+}
+
+int RunImageMode(const CommandLineArgs& args) {
+    if (args.imageSize == 0) {
+        wcerr << L"❌ 错误: 镜像模式需要 --image-size=<大小>" << endl;
+        return 1;
+    }
+
+    if (!args.resizes.empty()) {
+        wcerr << L"⚠️  生成新镜像时忽略 --resize-part (调整已有镜像时不要指定 --create-part)" << endl;
+    }
+
+    auto start = chrono::steady_clock::now();
+
+    mt19937_64 rng = MakeImageRng(args, IMAGE_RNG_LAYOUT);
+    mt19937_64 containerRng = MakeImageRng(args, IMAGE_RNG_CONTAINER);
+    DiskLayout layout;
+    ExtentList extents;
+
+    // 未指定种子时输出不可复现, 缓存没有意义
+    unique_ptr<LayoutCache> cache;
+    if (!args.cacheDir.empty()) {
+        if (args.hasImageSeed) {
+            cache = make_unique<LayoutCache>(args.cacheDir);
+        } else {
+            wcerr << L"⚠️  --cache 需要 --seed, 本次不使用缓存" << endl;
+        }
+    }
+
+    string cacheKey;
+    bool cacheHit = false;
+    if (cache) {
+        cacheKey = ImageSpecKey(args);
+        cacheHit = cache->Load(cacheKey, layout, extents);
+    }
+
+    if (!cacheHit) {
+        if (!BuildImage(args, rng, layout, extents)) {
+            return 1;
+        }
+        if (cache) cache->Store(cacheKey, layout, extents);
+    }
+    if (cache) cache->RecordLookup(cacheHit);
+
+    ImageWriteStats stats;
+    if (!args.imagePath.empty() && !WriteImageFile(args, layout, extents, containerRng, stats)) {
+        return 1;
+    }
+
+    SparseStats sparse;
+    if (!args.exportPath.empty()) {
+        OutputStream stream;
+        if (!stream.Open(args.exportPath) || !ExportSparse(extents, layout.diskSize, stream, sparse)) {
+            return 1;
+        }
+        if (!stream.Close()) {
+            wcerr << L"❌ 写出稀疏流失败: " << args.exportPath << endl;
+            return 1;
+        }
+    }
+
+    double elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    bool vhdx = IsVhdxPath(args.imagePath);
+
+    // VHDX 中分区的数据块不连续, 只测试 raw 镜像
+    vector<QualifyResult> qualify;
+    bool qualified = true;
+    if (args.qualify.enabled) {
+        if (args.imagePath.empty() || vhdx) {
+            wcerr << L"⚠️  --qualify 只适用于 raw 镜像, 已跳过" << endl;
+        }
+        else {
+            qualified = QualifyImagePartitions(args, layout, extents, qualify);
+        }
+    }
+
+    // 稀疏流写到标准输出时, 汇总改写到标准错误
+    wostream& out = args.exportPath == L"-" ? wcerr : wcout;
+
+    out << L"\n💿 生成镜像: " << (args.imagePath.empty() ? wstring(L"(仅稀疏流)") : args.imagePath) << endl;
+    out << L"==========================================" << endl;
+    if (!args.imagePath.empty()) {
+        out << L"  格式: " << (vhdx ? L"VHDX (动态, 块 " + FormatBytes(args.imageBlockSize) + L")" : wstring(L"RAW (稀疏)")) << endl;
+    }
+    out << L"  虚拟大小: " << FormatBytes(layout.diskSize) << L", 逻辑扇区 " << layout.sectorSize << endl;
+    out << L"  磁盘 GUID: " << FormatGuid(layout.diskGuid) << endl;
+
+    if (!args.quiet) {
+        for (const auto& part : layout.partitions) {
+            out << L"  分区 " << part.number << L": " << FormatBytes(part.size)
+                << L" @ " << FormatBytes(part.offset) << L"  " << PartitionTypeName(part.typeGuid);
+            if (!part.name.empty()) out << L"  \"" << part.name << L"\"";
+            if (part.format) out << L"  " << part.formatSpec.fileSystem;
+            out << endl;
+        }
+    }
+
+    out << L"  元数据: " << extents.Count() << L" 个区段, 数据 " << FormatBytes(extents.DataBytes())
+        << L", 零区 " << FormatBytes(extents.ZeroBytes()) << endl;
+    if (!args.imagePath.empty()) {
+        out << L"  写入: " << FormatBytes(stats.bytesWritten) << L" (" << stats.writeCount << L" 次)";
+        if (vhdx) {
+            out << L", 分配块 " << stats.allocatedBlocks << L"/" << stats.totalBlocks;
+        }
+        out << endl;
+    }
+    if (!args.exportPath.empty()) {
+        out << L"  稀疏流: " << (args.exportPath == L"-" ? wstring(L"<stdout>") : args.exportPath)
+            << L", " << FormatBytes(sparse.streamBytes) << L" (" << sparse.chunks << L" 个块组: 数据 "
+            << sparse.rawChunks << L", 清零 " << sparse.fillChunks << L", 跳过 " << sparse.skipChunks << L")" << endl;
+    }
+    if (cache) {
+        PrintLayoutCacheStats(out, *cache, cacheHit, cacheKey);
+    }
+    out << L"  耗时: " << fixed << setprecision(1) << elapsedMs << L" ms" << endl;
+    if (!qualify.empty()) {
+        out << L"  I/O 验收:" << endl;
+        for (const auto& result : qualify) {
+            PrintQualifyResult(out, result);
+        }
+    }
+
+    if (!qualified) {
+        wcerr << L"\n❌ I/O 验收不合格" << endl;
+        return 1;
+    }
+    out << L"\n✓ 镜像已生成" << endl;
+    return 0;
+}
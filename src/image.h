@@ -0,0 +1,72 @@
+﻿#pragma once
+
+/*
+ * 镜像输出
+ *
+ * 不经过 WMI, 直接按 --create-part / --format 生成磁盘镜像:
+ * 布局规划 -> GPT -> 文件系统元数据 -> 区段列表 -> VHDX / raw 容器。
+ * 只有元数据所在的范围会被写入, 其余均为空洞。
+ */
+
+#include "cli.h"
+#include "extent.h"
+#include "layout.h"
+
+#include <random>
+#include <string>
+
+struct ImageWriteStats {
+    ULONGLONG bytesWritten = 0;
+    ULONGLONG writeCount = 0;
+    ULONGLONG fileSize = 0;
+    ULONGLONG allocatedBlocks = 0;     // 仅 VHDX
+    ULONGLONG totalBlocks = 0;
+};
+
+// 镜像随机数的用途: 布局与格式化 (GPT/卷 GUID、卷序列号) 与容器 (VHDX 标识),
+// 分开播种使缓存命中时跳过布局不影响容器的输出
+constexpr uint64_t IMAGE_RNG_LAYOUT = 0;
+constexpr uint64_t IMAGE_RNG_CONTAINER = 1;
+
+// 指定 --seed 时由种子与用途确定, 否则来自 random_device
+std::mt19937_64 MakeImageRng(const CommandLineArgs& args, uint64_t stream);
+
+// 镜像格式由扩展名决定: .vhdx 为动态 VHDX, 其他为稀疏 raw
+bool IsVhdxPath(const std::wstring& path);
+
+// 规划布局并生成 GPT 与文件系统元数据
+bool BuildImage(const CommandLineArgs& args, std::mt19937_64& rng, DiskLayout& layout, ExtentList& extents);
+
+// 生成单个分区的文件系统元数据
+bool FormatImagePartition(
+    const DiskLayout& layout,
+    const PlannedPartition& partition,
+    std::mt19937_64& rng,
+    ExtentList& extents
+);
+
+// 镜像文件内容 (按文件偏移的区段列表): raw 与磁盘内容相同, VHDX 为完整容器;
+// 文件长度见 stats.fileSize
+bool BuildImageFile(
+    const CommandLineArgs& args,
+    const DiskLayout& layout,
+    const ExtentList& extents,
+    std::mt19937_64& rng,
+    ExtentList& content,
+    ImageWriteStats& stats
+);
+
+// 将 BuildImageFile 的结果写到新文件
+bool WriteImageContent(const std::wstring& path, const ExtentList& content, ImageWriteStats& stats);
+
+// 生成并写出镜像文件
+bool WriteImageFile(
+    const CommandLineArgs& args,
+    const DiskLayout& layout,
+    const ExtentList& extents,
+    std::mt19937_64& rng,
+    ImageWriteStats& stats
+);
+
+// --image / --export 模式入口, 返回进程退出码
+int RunImageMode(const CommandLineArgs& args);
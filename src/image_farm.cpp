@@ -0,0 +1,839 @@
+﻿#include "image_farm.h"
+
+#include "cli.h"
+#include "file_io.h"
+#include "image.h"
+#include "stamp.h"
+#include "uring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cwctype>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/vfs.h>
+#elif defined(__APPLE__)
+#include <sys/mount.h>
+#endif
+#endif
+
+using namespace std;
+
+static const size_t FARM_MAX_BATCH = 4096;
+static const int FARM_MAX_WORKERS = 256;
+
+// io_uring 提交队列长度: 一批的全部写入 (或全部 fsync) 通常一次提交完
+static const unsigned FARM_RING_ENTRIES = 1024;
+
+// 写入缓冲区的块大小; 更大的请求单独成块
+static const size_t FARM_BUFFER_BLOCK = 16 * 1024 * 1024;
+
+// 填充区段 (NTFS 空日志) 展开后的共享块大小; 整个进程每种填充值只保留一块, 各镜像的写入请求共同引用
+static const size_t FARM_FILL_BYTES = 4 * 1024 * 1024;
+
+bool ParseFarmSpec(const wstring& params, FarmSpec& spec) {
+    // 作业文件在第一个逗号之前
+    wstring options = params;
+    size_t comma = params.find(L',');
+    wstring first = params.substr(0, comma);
+    if (first.find(L'=') == wstring::npos) {
+        spec.jobFile = first;
+        options = comma == wstring::npos ? L"" : params.substr(comma + 1);
+    }
+
+    auto paramMap = ParseParams(options);
+
+    try {
+        if (paramMap.count(L"jobs"))
+            spec.jobFile = paramMap[L"jobs"];
+
+        if (paramMap.count(L"batch"))
+            spec.batch = (size_t)stoul(paramMap[L"batch"]);
+
+        if (paramMap.count(L"engine")) {
+            const wstring& engine = paramMap[L"engine"];
+            if (engine == L"auto") spec.engine = FarmEngine::Auto;
+            else if (engine == L"io_uring") spec.engine = FarmEngine::IoUring;
+            else if (engine == L"threads") spec.engine = FarmEngine::Threads;
+            else return false;
+        }
+
+        if (paramMap.count(L"fsync"))
+            spec.fsync = stoi(paramMap[L"fsync"]) != 0;
+
+        if (paramMap.count(L"workers"))
+            spec.workers = stoi(paramMap[L"workers"]);
+    }
+    catch (...) {
+        return false;
+    }
+
+    return !spec.jobFile.empty() && spec.batch >= 1 && spec.batch <= FARM_MAX_BATCH
+        && spec.workers >= 0 && spec.workers <= FARM_MAX_WORKERS;
+}
+
+double FarmDevice::ImagesPerSecond() const {
+    double seconds = chrono::duration<double>(last - first).count();
+    return seconds > 0 ? images / seconds : 0;
+}
+
+// ================================
+// 作业文件
+// ================================
+
+// 按空白拆分, 双引号内的空白保留; 引号不成对时返回 false
+static bool TokenizeJobLine(const wstring& line, vector<wstring>& tokens) {
+    tokens.clear();
+    wstring token;
+    bool quoted = false;
+    bool hasToken = false;
+
+    for (wchar_t c : line) {
+        if (c == L'"') {
+            quoted = !quoted;
+            hasToken = true;
+        }
+        else if (!quoted && iswspace(c)) {
+            if (hasToken) tokens.push_back(token);
+            token.clear();
+            hasToken = false;
+        }
+        else {
+            token += c;
+            hasToken = true;
+        }
+    }
+    if (hasToken) tokens.push_back(token);
+    return !quoted;
+}
+
+bool LoadFarmJobs(const wstring& path, FarmJobList& list) {
+#ifdef _WIN32
+    ifstream in(path.c_str(), ios::binary);
+#else
+    ifstream in(ToUtf8(path), ios::binary);
+#endif
+    if (!in) {
+        wcerr << L"❌ 无法打开作业文件: " << path << endl;
+        return false;
+    }
+
+    map<wstring, size_t> layoutNames;
+    set<wstring> targets;
+    string raw;
+    vector<wstring> tokens;
+    int lineNumber = 0;
+
+    auto fail = [&](const wstring& message) {
+        wcerr << L"❌ " << path << L":" << lineNumber << L": " << message << endl;
+        return false;
+    };
+
+    while (getline(in, raw)) {
+        lineNumber++;
+        if (lineNumber == 1 && raw.compare(0, 3, "\xEF\xBB\xBF") == 0) raw.erase(0, 3);
+        if (!raw.empty() && raw.back() == '\r') raw.pop_back();
+
+        if (!TokenizeJobLine(FromUtf8(raw), tokens)) return fail(L"引号不成对");
+        if (tokens.empty() || tokens[0][0] == L'#') continue;
+
+        if (tokens[0] == L"layout") {
+            if (tokens.size() < 3) return fail(L"格式应为 layout <名称> <参数...>");
+            if (layoutNames.count(tokens[1])) return fail(L"布局重复定义: " + tokens[1]);
+
+            layoutNames[tokens[1]] = list.layouts.size();
+            list.layouts.push_back({ tokens[1], vector<wstring>(tokens.begin() + 2, tokens.end()) });
+            continue;
+        }
+
+        if (tokens.size() != 2) return fail(L"格式应为 <目标路径> <布局名称>");
+        auto it = layoutNames.find(tokens[1]);
+        if (it == layoutNames.end()) return fail(L"未定义的布局: " + tokens[1]);
+        if (!targets.insert(tokens[0]).second) return fail(L"目标重复: " + tokens[0]);
+
+        list.jobs.push_back({ tokens[0], it->second });
+    }
+
+    if (list.jobs.empty()) {
+        wcerr << L"❌ 作业文件中没有作业: " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+// 布局参数按命令行解析; 目标路径由作业行给出
+static bool PrepareLayouts(const FarmJobList& list, vector<CommandLineArgs>& layouts) {
+    layouts.clear();
+
+    for (const auto& layout : list.layouts) {
+        vector<wstring> argStrings = { L"disk_part_fmt" };
+        argStrings.insert(argStrings.end(), layout.arguments.begin(), layout.arguments.end());
+
+        vector<wchar_t*> argv;
+        for (auto& arg : argStrings) argv.push_back(&arg[0]);
+
+        CommandLineArgs args;
+        try {
+            args = ParseCommandLine((int)argv.size(), argv.data());
+        }
+        catch (const exception&) {
+            args.invalid = true;
+        }
+
+        if (args.invalid) {
+            wcerr << L"❌ 无法解析布局 " << layout.name << L" 的参数" << endl;
+            return false;
+        }
+        if (args.imageSize == 0) {
+            wcerr << L"❌ 布局 " << layout.name << L" 需要 --image-size=<大小>" << endl;
+            return false;
+        }
+        if (!args.imagePath.empty() || !args.exportPath.empty() || args.stampCount > 0 || args.farm.enabled) {
+            wcerr << L"❌ 布局 " << layout.name << L" 不能指定 --image / --export / --stamp / --farm (目标路径由作业行给出)" << endl;
+            return false;
+        }
+
+        args.quiet = true;
+        layouts.push_back(move(args));
+    }
+    return true;
+}
+
+// 第 n 个作业 (从 1 开始) 的参数
+static CommandLineArgs JobArgs(const CommandLineArgs& layout, const FarmJob& job, int n) {
+    CommandLineArgs target = StampArgs(layout, n);
+    target.imagePath = job.target;
+    if (target.hasImageSeed) {
+        target.imageSeed = layout.imageSeed ^ ((unsigned long long)n * 0x9E3779B97F4A7C15ULL);
+    }
+    return target;
+}
+
+// ================================
+// 批次写入缓冲区
+// ================================
+
+// 生成后的数据区段复制到这里, 写入请求直接引用; 生成过程本身 (ExtentList) 仍在各工作线程的临时对象中分配。
+// 按块分配, 块内顺序切分; Reset 后保留全部块供下一批使用, 已分配的地址在 Reset 前不变
+class FarmWriteBuffer {
+public:
+    uint8_t* Allocate(size_t size) {
+        lock_guard<mutex> guard(lock);
+
+        // 按 8 字节对齐切分
+        size = (size + 7) & ~(size_t)7;
+        for (; current < blocks.size(); current++) {
+            Block& block = blocks[current];
+            if (block.size - block.used >= size) {
+                uint8_t* p = block.data.get() + block.used;
+                block.used += size;
+                return p;
+            }
+        }
+
+        Block block;
+        block.size = max(size, FARM_BUFFER_BLOCK);
+        block.data.reset(new uint8_t[block.size]);
+        block.used = size;
+        blocks.push_back(move(block));
+        capacity += blocks.back().size;
+        return blocks.back().data.get();
+    }
+
+    void Reset() {
+        for (auto& block : blocks) block.used = 0;
+        current = 0;
+    }
+
+    // 本批已切分的字节数 (含共享的填充块)
+    size_t Used() const {
+        size_t used = patterns.size() * FARM_FILL_BYTES;
+        for (const auto& block : blocks) used += block.used;
+        return used;
+    }
+
+    // 按填充值与相位 (起始偏移 % 4) 展开的共享块, Reset 后仍保留
+    const uint8_t* Pattern(uint32_t fill, ULONGLONG offset) {
+        lock_guard<mutex> guard(lock);
+
+        auto& block = patterns[{ fill, (unsigned)(offset % 4) }];
+        if (!block) {
+            block.reset(new uint8_t[FARM_FILL_BYTES]);
+            ExpandFill(fill, offset, block.get(), FARM_FILL_BYTES);
+            capacity += FARM_FILL_BYTES;
+        }
+        return block.get();
+    }
+
+    size_t Capacity() const { return capacity; }
+
+private:
+    struct Block {
+        unique_ptr<uint8_t[]> data;
+        size_t size = 0;
+        size_t used = 0;
+    };
+
+    mutex lock;
+    vector<Block> blocks;
+    map<pair<uint32_t, unsigned>, unique_ptr<uint8_t[]>> patterns;
+    size_t current = 0;
+    size_t capacity = 0;
+};
+
+// ================================
+// 批次
+// ================================
+
+struct FarmWrite {
+    ULONGLONG offset = 0;
+    const uint8_t* data = nullptr;
+    size_t length = 0;
+};
+
+struct FarmSlot {
+    size_t job = 0;
+    ULONGLONG fileSize = 0;
+    vector<FarmWrite> writes;          // 数据位于写入缓冲区
+    bool ok = false;
+    ULONGLONG bytesWritten = 0;
+    ULONGLONG writeCount = 0;
+    bool synced = false;
+    chrono::nanoseconds finished{ 0 };
+#ifdef HAVE_IO_URING
+    int fd = -1;
+#endif
+
+    // 槽位在批次之间复用 (保留 writes 的容量)
+    void Reset(size_t jobIndex) {
+        job = jobIndex;
+        fileSize = 0;
+        writes.clear();
+        ok = false;
+        bytesWritten = 0;
+        writeCount = 0;
+        synced = false;
+        finished = chrono::nanoseconds(0);
+#ifdef HAVE_IO_URING
+        fd = -1;
+#endif
+    }
+};
+
+// 生成镜像内容, 把数据区段复制进写入缓冲区; layout/extents/content 为工作线程复用的临时对象
+static bool BuildSlot(
+    const CommandLineArgs& target,
+    FarmWriteBuffer& buffer,
+    FarmSlot& slot,
+    DiskLayout& layout,
+    ExtentList& extents,
+    ExtentList& content
+) {
+    mt19937_64 rng = MakeImageRng(target, IMAGE_RNG_LAYOUT);
+    mt19937_64 containerRng = MakeImageRng(target, IMAGE_RNG_CONTAINER);
+
+    ImageWriteStats stats;
+    if (!BuildImage(target, rng, layout, extents)
+        || !BuildImageFile(target, layout, extents, containerRng, content, stats)) {
+        return false;
+    }
+
+    // 新文件的空洞读出为零, 零区段无需写入 (同 WriteImageContent); 填充区段引用共享的展开块
+    uint8_t* p = buffer.Allocate((size_t)content.StoredBytes());
+    slot.writes.clear();
+    for (const auto& entry : content.Extents()) {
+        const ImageExtent& ext = entry.second;
+        if (ext.IsZero()) continue;
+
+        if (ext.IsFill()) {
+            const uint8_t* pattern = buffer.Pattern(ext.fill, ext.offset);
+            for (ULONGLONG done = 0; done < ext.length; done += FARM_FILL_BYTES) {
+                slot.writes.push_back({ ext.offset + done, pattern, (size_t)min<ULONGLONG>(ext.length - done, FARM_FILL_BYTES) });
+            }
+            continue;
+        }
+
+        memcpy(p, ext.data.data(), ext.data.size());
+        slot.writes.push_back({ ext.offset, p, ext.data.size() });
+        p += ext.data.size();
+    }
+
+    slot.fileSize = stats.fileSize;
+    return true;
+}
+
+// 在 workers 个线程上对 [0, count) 执行 body
+template <typename Body>
+static void ParallelFor(size_t count, size_t workers, Body body) {
+    atomic<size_t> nextIndex(0);
+    auto worker = [&]() {
+        for (size_t i = nextIndex++; i < count; i = nextIndex++) {
+            body(i);
+        }
+    };
+
+    size_t workerCount = min(workers, count);
+    if (workerCount <= 1) {
+        worker();
+        return;
+    }
+
+    vector<thread> threads;
+    for (size_t i = 0; i < workerCount; i++) {
+        threads.emplace_back(worker);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+// 线程池: 每个镜像同步写入并刷新
+static void WriteSlotThreads(FarmSlot& slot, const wstring& path, bool fsync) {
+    OutputFile file;
+    bool ok = file.Create(path) && file.SetSize(slot.fileSize);
+    for (const auto& write : slot.writes) {
+        if (!ok) break;
+        ok = file.WriteAt(write.offset, write.data, write.length);
+    }
+    if (ok && fsync) {
+        ok = file.Flush();
+        slot.synced = ok;
+    }
+
+    slot.bytesWritten = file.BytesWritten();
+    slot.writeCount = file.WriteCount();
+    if (!file.Close() && ok) {
+        wcerr << L"❌ 关闭镜像文件失败: " << path << endl;
+        ok = false;
+    }
+    slot.ok = ok;
+}
+
+#ifdef HAVE_IO_URING
+
+struct RingOp {
+    size_t slot = 0;
+    bool fsync = false;
+    ULONGLONG offset = 0;
+    iovec iov{};
+};
+
+// 按提交队列容量分段: 每段排队后由一次 io_uring_enter 提交并等到整段完成;
+// 排队或等待失败时先回收全部在途请求 (它们引用 ops 与写入缓冲区中的数据) 再返回
+static bool SubmitRingOps(
+    Uring& ring,
+    vector<RingOp>& ops,
+    vector<FarmSlot>& slots,
+    const FarmJobList& list
+) {
+    for (size_t begin = 0; begin < ops.size();) {
+        size_t end = min(ops.size(), begin + ring.Capacity());
+        for (size_t i = begin; i < end; i++) {
+            RingOp& op = ops[i];
+            bool queued = op.fsync
+                ? ring.QueueFsync(slots[op.slot].fd, i)
+                : ring.Queue(slots[op.slot].fd, true, &op.iov, op.offset, i);
+            if (!queued) {
+                wcerr << L"❌ io_uring 排队失败: " << FromUtf8(strerror(errno)) << endl;
+                ring.Drain();
+                return false;
+            }
+        }
+
+        for (unsigned remaining = (unsigned)(end - begin); remaining > 0; remaining--) {
+            uint64_t tag = 0;
+            int res = 0;
+            if (!ring.Wait(tag, res, remaining)) {
+                wcerr << L"❌ io_uring 提交失败: " << FromUtf8(strerror(errno)) << endl;
+                ring.Drain();
+                return false;
+            }
+
+            const RingOp& op = ops[(size_t)tag];
+            FarmSlot& slot = slots[op.slot];
+            bool done = op.fsync ? res == 0 : res == (int)op.iov.iov_len;
+            if (!done) {
+                if (slot.ok) {
+                    wcerr << L"❌ " << (op.fsync ? L"刷新 " : L"写入 ") << list.jobs[slot.job].target << L" 失败: "
+                        << (res < 0 ? FromUtf8(strerror(-res)) : wstring(L"写入不完整")) << endl;
+                }
+                slot.ok = false;
+            }
+            else if (op.fsync) {
+                slot.synced = true;
+            }
+            else {
+                slot.bytesWritten += op.iov.iov_len;
+                slot.writeCount++;
+            }
+        }
+        begin = end;
+    }
+    return true;
+}
+
+// io_uring: 整批的写入一起提交, 全部完成后再一起提交 fsync
+static void WriteBatchRing(Uring& ring, vector<FarmSlot>& slots, size_t count, const FarmJobList& list, bool fsync) {
+    vector<RingOp> ops;
+
+    for (size_t i = 0; i < count; i++) {
+        FarmSlot& slot = slots[i];
+        if (!slot.ok) continue;
+
+        const wstring& path = list.jobs[slot.job].target;
+        slot.fd = open(ToUtf8(path).c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+        if (slot.fd < 0) {
+            wcerr << L"❌ 无法创建文件 " << path << L": " << FromUtf8(strerror(errno)) << endl;
+            slot.ok = false;
+            continue;
+        }
+        if (ftruncate(slot.fd, (off_t)slot.fileSize) != 0) {
+            wcerr << L"❌ 设置文件大小失败 " << path << L": " << FromUtf8(strerror(errno)) << endl;
+            slot.ok = false;
+            continue;
+        }
+
+        for (const auto& write : slot.writes) {
+            RingOp op;
+            op.slot = i;
+            op.offset = write.offset;
+            op.iov.iov_base = (void*)write.data;
+            op.iov.iov_len = write.length;
+            ops.push_back(op);
+        }
+    }
+
+    bool submitted = SubmitRingOps(ring, ops, slots, list);
+
+    if (submitted && fsync) {
+        ops.clear();
+        for (size_t i = 0; i < count; i++) {
+            if (!slots[i].ok) continue;
+            RingOp op;
+            op.slot = i;
+            op.fsync = true;
+            ops.push_back(op);
+        }
+        submitted = SubmitRingOps(ring, ops, slots, list);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        FarmSlot& slot = slots[i];
+        if (slot.fd < 0) continue;
+        if (close(slot.fd) != 0 && slot.ok) {
+            wcerr << L"❌ 关闭镜像文件失败: " << list.jobs[slot.job].target << endl;
+            slot.ok = false;
+        }
+        slot.fd = -1;
+        if (!submitted) slot.ok = false;
+    }
+}
+
+#endif
+
+bool FarmIoUringAvailable() {
+#ifdef HAVE_IO_URING
+    Uring ring;
+    return ring.Setup(8);
+#else
+    return false;
+#endif
+}
+
+// ================================
+// 目标目录
+// ================================
+
+// 目录所在的文件系统 (及驱动器类型)
+static wstring DescribeDirectory(const filesystem::path& directory) {
+#ifdef _WIN32
+    wchar_t root[MAX_PATH] = {};
+    if (!GetVolumePathNameW(directory.c_str(), root, MAX_PATH)) return L"未知";
+
+    wchar_t fileSystem[MAX_PATH] = {};
+    GetVolumeInformationW(root, NULL, 0, NULL, NULL, NULL, fileSystem, MAX_PATH);
+
+    const wchar_t* kind = L"未知";
+    switch (GetDriveTypeW(root)) {
+    case DRIVE_FIXED: kind = L"本地磁盘"; break;
+    case DRIVE_REMOTE: kind = L"网络"; break;
+    case DRIVE_RAMDISK: kind = L"内存盘"; break;
+    case DRIVE_REMOVABLE: kind = L"可移动"; break;
+    }
+    return wstring(fileSystem[0] ? fileSystem : L"?") + L", " + kind;
+#elif defined(__linux__)
+    struct statfs info;
+    if (statfs(directory.c_str(), &info) != 0) return L"未知";
+
+    static const map<unsigned long, const wchar_t*> names = {
+        { 0xEF53, L"ext4" },
+        { 0x58465342, L"xfs" },
+        { 0x9123683E, L"btrfs" },
+        { 0x2FC12FC1, L"zfs" },
+        { 0xF2F52010, L"f2fs" },
+        { 0x01021994, L"tmpfs" },
+        { 0x794C7630, L"overlayfs" },
+        { 0x6969, L"nfs" },
+        { 0xFF534D42, L"cifs" },
+        { 0x65735546, L"fuse" },
+        { 0x5346544E, L"ntfs" },
+        { 0x4D44, L"vfat" },
+    };
+    auto it = names.find((unsigned long)info.f_type);
+    if (it != names.end()) return it->second;
+
+    wostringstream text;
+    text << L"0x" << hex << (unsigned long)info.f_type;
+    return text.str();
+#elif defined(__APPLE__)
+    struct statfs info;
+    if (statfs(directory.c_str(), &info) != 0) return L"未知";
+    return FromUtf8(info.f_fstypename);
+#else
+    (void)directory;
+    return L"未知";
+#endif
+}
+
+// 按目标所在目录分组 (并创建缺少的目录), 返回每个作业的分组下标
+static vector<size_t> GroupDevices(const FarmJobList& list, vector<FarmDevice>& devices) {
+    map<wstring, size_t> index;
+    vector<size_t> groups;
+
+    for (const auto& job : list.jobs) {
+        error_code ec;
+        filesystem::path directory = filesystem::absolute(filesystem::path(job.target), ec).parent_path();
+        if (ec) directory = filesystem::path(job.target).parent_path();
+
+        auto it = index.find(directory.wstring());
+        if (it == index.end()) {
+            filesystem::create_directories(directory, ec);
+
+            FarmDevice device;
+            device.directory = directory.wstring();
+            device.type = DescribeDirectory(directory);
+            it = index.emplace(device.directory, devices.size()).first;
+            devices.push_back(device);
+        }
+        groups.push_back(it->second);
+    }
+    return groups;
+}
+
+// ================================
+// 执行
+// ================================
+
+bool RunFarm(const FarmSpec& spec, const FarmJobList& list, FarmResult& result) {
+    result = FarmResult();
+
+    vector<CommandLineArgs> layouts;
+    if (!PrepareLayouts(list, layouts)) {
+        result.failed = list.jobs.size();
+        return false;
+    }
+
+    size_t workers = spec.workers > 0 ? (size_t)spec.workers : max(1u, thread::hardware_concurrency());
+    result.engine = L"threads";
+
+#ifdef HAVE_IO_URING
+    Uring ring;
+    bool useRing = false;
+    if (spec.engine != FarmEngine::Threads) {
+        useRing = ring.Setup(FARM_RING_ENTRIES);
+        if (useRing) result.engine = L"io_uring";
+        else if (spec.engine == FarmEngine::IoUring) wcerr << L"⚠️  io_uring 不可用 (内核不支持或被禁止), 改用线程池" << endl;
+    }
+#else
+    if (spec.engine == FarmEngine::IoUring) {
+        wcerr << L"⚠️  此平台不支持 io_uring, 改用线程池" << endl;
+    }
+#endif
+
+    vector<size_t> groups = GroupDevices(list, result.devices);
+    vector<bool> deviceSeen(result.devices.size(), false);
+
+    FarmWriteBuffer buffer;
+    vector<FarmSlot> slots(min(spec.batch, list.jobs.size()));
+
+    // 工作线程的临时对象, 批次之间复用
+    struct Scratch {
+        DiskLayout layout;
+        ExtentList extents;
+        ExtentList content;
+    };
+    mutex scratchLock;
+    vector<unique_ptr<Scratch>> scratchPool;
+
+    auto start = chrono::steady_clock::now();
+    auto elapsed = [&]() { return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start); };
+
+    for (size_t base = 0; base < list.jobs.size(); base += spec.batch) {
+        size_t count = min(spec.batch, list.jobs.size() - base);
+        auto batchStart = elapsed();
+        buffer.Reset();
+
+        // 1. 并发生成元数据
+        ParallelFor(count, workers, [&](size_t i) {
+            unique_ptr<Scratch> scratch;
+            {
+                lock_guard<mutex> guard(scratchLock);
+                if (!scratchPool.empty()) {
+                    scratch = move(scratchPool.back());
+                    scratchPool.pop_back();
+                }
+            }
+            if (!scratch) scratch.reset(new Scratch());
+
+            FarmSlot& slot = slots[i];
+            slot.Reset(base + i);
+
+            const FarmJob& job = list.jobs[slot.job];
+            CommandLineArgs target = JobArgs(layouts[job.layout], job, (int)slot.job + 1);
+            slot.ok = BuildSlot(target, buffer, slot, scratch->layout, scratch->extents, scratch->content);
+            if (!slot.ok) {
+                wcerr << L"❌ 生成失败: " << job.target << endl;
+            }
+
+            lock_guard<mutex> guard(scratchLock);
+            scratchPool.push_back(move(scratch));
+        });
+
+        auto built = elapsed();
+        result.bufferPeak = max(result.bufferPeak, buffer.Used());
+        result.buildSeconds += chrono::duration<double>(built - batchStart).count();
+
+        // 2. 写入与刷新
+#ifdef HAVE_IO_URING
+        if (useRing) {
+            WriteBatchRing(ring, slots, count, list, spec.fsync);
+            for (size_t i = 0; i < count; i++) slots[i].finished = elapsed();
+
+            // 回收在途请求失败时环已关闭, 之后的批次改用线程池
+            if (!ring.Ready()) {
+                wcerr << L"⚠️  io_uring 已关闭, 其余批次改用线程池" << endl;
+                useRing = false;
+            }
+        }
+        else
+#endif
+        {
+            ParallelFor(count, workers, [&](size_t i) {
+                if (slots[i].ok) WriteSlotThreads(slots[i], list.jobs[slots[i].job].target, spec.fsync);
+                slots[i].finished = elapsed();
+            });
+        }
+
+        result.writeSeconds += chrono::duration<double>(elapsed() - built).count();
+        result.batches++;
+
+        for (size_t i = 0; i < count; i++) {
+            const FarmSlot& slot = slots[i];
+            FarmDevice& device = result.devices[groups[slot.job]];
+            if (!deviceSeen[groups[slot.job]]) {
+                deviceSeen[groups[slot.job]] = true;
+                device.first = batchStart;
+            }
+            device.last = max(device.last, slot.finished);
+
+            if (slot.ok) {
+                result.images++;
+                device.images++;
+            }
+            else {
+                result.failed++;
+                device.failed++;
+            }
+            result.bytesWritten += slot.bytesWritten;
+            result.writes += slot.writeCount;
+            if (slot.synced) result.fsyncs++;
+        }
+    }
+
+    result.seconds = chrono::duration<double>(elapsed()).count();
+    result.bufferBytes = buffer.Capacity();
+    result.workers = workers;
+#ifdef HAVE_IO_URING
+    if (useRing) result.enters = ring.Enters();
+#endif
+    return result.failed == 0;
+}
+
+// ================================
+// 报告
+// ================================
+
+void PrintFarmReport(wostream& out, const FarmSpec& spec, const FarmJobList& list, const FarmResult& result, bool verbose) {
+    out << L"\n🏭 批量镜像: " << spec.jobFile << endl;
+    out << L"==========================================" << endl;
+    out << fixed << setprecision(1);
+
+    out << L"  作业: " << list.jobs.size() << L" 个镜像, " << list.layouts.size() << L" 种布局, 每批 "
+        << spec.batch << L" 个 (" << result.batches << L" 批)" << endl;
+    if (verbose) {
+        vector<size_t> perLayout(list.layouts.size(), 0);
+        for (const auto& job : list.jobs) perLayout[job.layout]++;
+        for (size_t i = 0; i < list.layouts.size(); i++) {
+            out << L"    布局 " << list.layouts[i].name << L": " << perLayout[i] << L" 个" << endl;
+        }
+    }
+
+    out << L"  引擎: " << result.engine << L", 线程 " << result.workers;
+    if (result.enters > 0) {
+        out << L", io_uring_enter " << result.enters << L" 次 (平均每次 "
+            << (double)(result.writes + result.fsyncs) / result.enters << L" 个请求)";
+    }
+    out << endl;
+
+    out << L"  写入: " << FormatBytes(result.bytesWritten) << L" (" << result.writes << L" 次), 刷新 "
+        << result.fsyncs << L" 次" << (spec.fsync ? L"" : L" (fsync=0)") << endl;
+    out << L"  写入缓冲区: 峰值 " << FormatBytes(result.bufferPeak) << L" / 容量 " << FormatBytes(result.bufferBytes)
+        << L", " << result.batches << L" 批复用" << endl;
+    out << L"  耗时: 生成 " << result.buildSeconds * 1000 << L" ms, 写入 " << result.writeSeconds * 1000
+        << L" ms, 共 " << result.seconds * 1000 << L" ms (" << setprecision(0) << result.ImagesPerSecond()
+        << L" 个/秒)" << endl;
+
+    out << L"  目标目录:" << endl;
+    for (const auto& device : result.devices) {
+        out << L"    " << device.directory << L" (" << device.type << L"): " << device.images << L" 个";
+        if (device.failed > 0) out << L", 失败 " << device.failed;
+        out << L", " << setprecision(0) << device.ImagesPerSecond() << L" 个/秒" << endl;
+    }
+}
+
+int RunFarmMode(const FarmSpec& spec, bool quiet) {
+    FarmJobList list;
+    if (!LoadFarmJobs(spec.jobFile, list)) {
+        return 1;
+    }
+
+    FarmResult result;
+    bool ok = RunFarm(spec, list, result);
+    if (result.batches == 0) {
+        return 1;
+    }
+
+    PrintFarmReport(wcout, spec, list, result, !quiet);
+
+    if (!ok) {
+        wcerr << L"\n❌ " << result.failed << L" 个镜像生成失败" << endl;
+        return 1;
+    }
+    wcout << L"\n✓ 已生成 " << result.images << L" 个镜像" << endl;
+    return 0;
+}
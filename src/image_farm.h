@@ -0,0 +1,113 @@
+﻿#pragma once
+
+/*
+ * 批量镜像 (--farm)
+ *
+ * 一个进程按作业文件生成大量镜像, 省去每个镜像的进程启动与同步的写入-刷新链。
+ * 作业文件每行一条:
+ *   layout <名称> <参数...>      定义布局 (--image-size= / --create-part= / --format= / --seed= 等)
+ *   <目标路径> <布局名称>        生成一个镜像 (.vhdx 为动态 VHDX, 其他为稀疏 raw)
+ * 空行与 # 开头的行忽略, 含空格的路径用双引号。label= / vol= 中的 {n} 替换为作业序号 (从 1 开始);
+ * 布局指定 --seed 时第 n 个作业的种子与 n 混合, 输出可复现且各镜像的 GUID 互不相同。
+ *
+ * 作业按批处理 (batch=, 默认 64):
+ *   1. 工作线程并发生成一批镜像的 GPT 与文件系统元数据, 数据区段复制进批次写入缓冲区
+ *      (按块分配, 批次之间复用, 不再为每个镜像单独分配写入缓冲区);
+ *   2. 整批的写入一起放入 io_uring 提交队列, 一次 io_uring_enter 提交并等待全部完成,
+ *      再同样批量提交每个文件的 fsync;
+ *   3. 内核不支持 io_uring (或 engine=threads, 或 Windows) 时由线程池逐个写入并刷新。
+ * 报告总吞吐 (个/秒) 以及按目标目录 (文件系统类型) 分组的吞吐, 用于比较批大小与设备类型。
+ */
+
+#include "utils.h"
+
+#include <chrono>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+enum class FarmEngine {
+    Auto,           // 可用时使用 io_uring, 否则线程池
+    IoUring,
+    Threads,
+};
+
+struct FarmSpec {
+    bool enabled = false;
+    std::wstring jobFile;
+    size_t batch = 64;                 // 每批镜像数
+    FarmEngine engine = FarmEngine::Auto;
+    bool fsync = true;                 // 写完后刷新每个镜像
+    int workers = 0;                   // 生成元数据与线程池写入的线程数, 0 为 CPU 核数
+};
+
+// 形式: <作业文件>,batch=64,engine=auto|io_uring|threads,fsync=0|1,workers=<N>
+bool ParseFarmSpec(const std::wstring& params, FarmSpec& spec);
+
+struct FarmLayout {
+    std::wstring name;
+    std::vector<std::wstring> arguments;   // 命令行参数 (不含程序名)
+};
+
+struct FarmJob {
+    std::wstring target;
+    size_t layout = 0;                 // FarmJobList::layouts 的下标
+};
+
+struct FarmJobList {
+    std::vector<FarmLayout> layouts;
+    std::vector<FarmJob> jobs;
+};
+
+// 读取作业文件; 格式错误时输出行号并返回 false
+bool LoadFarmJobs(const std::wstring& path, FarmJobList& list);
+
+// 同一目标目录 (通常即同一设备) 的镜像
+struct FarmDevice {
+    std::wstring directory;
+    std::wstring type;                 // 文件系统 (及驱动器类型)
+    size_t images = 0;
+    size_t failed = 0;
+    std::chrono::nanoseconds first{ 0 };   // 相对开始时间: 首个镜像所在批次开始
+    std::chrono::nanoseconds last{ 0 };    //                最后一个镜像刷新完成
+
+    double ImagesPerSecond() const;
+};
+
+struct FarmResult {
+    std::wstring engine;               // io_uring / threads
+    size_t workers = 0;
+    size_t images = 0;                 // 成功的镜像数
+    size_t failed = 0;
+    size_t batches = 0;
+    ULONGLONG bytesWritten = 0;
+    ULONGLONG writes = 0;
+    ULONGLONG fsyncs = 0;
+    ULONGLONG enters = 0;              // io_uring_enter 调用次数
+    size_t bufferBytes = 0;            // 写入缓冲区的容量
+    size_t bufferPeak = 0;             // 单批使用的最大字节数
+    double buildSeconds = 0;
+    double writeSeconds = 0;
+    double seconds = 0;
+    std::vector<FarmDevice> devices;
+
+    double ImagesPerSecond() const { return seconds > 0 ? images / seconds : 0; }
+};
+
+// io_uring 在本机是否可用 (engine=auto 时是否会使用)
+bool FarmIoUringAvailable();
+
+// 执行全部作业; 返回是否全部成功
+bool RunFarm(const FarmSpec& spec, const FarmJobList& list, FarmResult& result);
+
+// 批量报告; verbose 时列出每种布局的镜像数
+void PrintFarmReport(
+    std::wostream& out,
+    const FarmSpec& spec,
+    const FarmJobList& list,
+    const FarmResult& result,
+    bool verbose
+);
+
+// --farm 模式入口, 返回进程退出码
+int RunFarmMode(const FarmSpec& spec, bool quiet);
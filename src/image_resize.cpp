@@ -0,0 +1,305 @@
+﻿#include "image_resize.h"
+
+#include "byte_order.h"
+#include "checksum.h"
+#include "disk_image.h"
+#include "fat32.h"
+#include "file_io.h"
+#include "image.h"
+#include "ntfs.h"
+#include "vhdx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+static const uint32_t FSINFO_LEAD_SIGNATURE = 0x41615252;
+static const uint32_t FSINFO_STRUCT_SIGNATURE = 0x61417272;
+static const uint32_t FSINFO_UNKNOWN = 0xFFFFFFFF;
+
+namespace {
+
+// 待写入的扇区
+struct PendingWrite {
+    ULONGLONG offset = 0;
+    vector<uint8_t> data;
+};
+
+// FAT32 卷的几何参数与 FAT 使用情况
+struct Fat32Volume {
+    vector<uint8_t> boot;
+    unsigned bytesPerSector = 0;
+    unsigned sectorsPerCluster = 0;
+    ULONGLONG dataStart = 0;           // 扇区, 相对分区起点
+    ULONGLONG fatCapacity = 0;         // FAT 能描述的簇数
+    ULONGLONG highestUsed = 0;         // 最后一个非空 FAT 项的簇号 (没有时为 0)
+    ULONGLONG usedClusters = 0;
+};
+
+}
+
+// 重算 CRC 并生成主、备份 GPT 的写入项 (备份按主 GPT 重建)
+static void BuildGptWrites(GptState& gpt, vector<PendingWrite>& writes) {
+    const ULONGLONG sector = gpt.sectorSize;
+
+    PutLE32(&gpt.header[88], Crc32(gpt.entries.data(), gpt.entries.size()));
+    PutLE32(&gpt.header[16], 0);
+    PutLE32(&gpt.header[16], Crc32(gpt.header.data(), GetLE32(&gpt.header[12])));
+
+    vector<uint8_t> backup = gpt.header;
+    const ULONGLONG backupLba = gpt.AlternateLba();
+    const ULONGLONG backupEntriesLba = backupLba - gpt.EntryArraySectors();
+    PutLE64(&backup[24], backupLba);
+    PutLE64(&backup[32], 1);
+    PutLE64(&backup[72], backupEntriesLba);
+    PutLE32(&backup[16], 0);
+    PutLE32(&backup[16], Crc32(backup.data(), GetLE32(&backup[12])));
+
+    writes.push_back({ gpt.EntriesLba() * sector, gpt.entries });
+    writes.push_back({ 1 * sector, gpt.header });
+    writes.push_back({ backupEntriesLba * sector, gpt.entries });
+    writes.push_back({ backupLba * sector, backup });
+}
+
+// 解析 FAT32 引导扇区并扫描第一份 FAT
+static bool ReadFat32Volume(DiskImage& image, ULONGLONG base, const vector<uint8_t>& boot, Fat32Volume& volume) {
+    volume.boot = boot;
+    volume.bytesPerSector = GetLE16(&boot[11]);
+    volume.sectorsPerCluster = boot[13];
+    const ULONGLONG reserved = GetLE16(&boot[14]);
+    const ULONGLONG fatCount = boot[16];
+    const ULONGLONG fatSectors = GetLE32(&boot[36]);
+
+    if (volume.bytesPerSector != boot.size() || volume.sectorsPerCluster == 0
+        || fatCount == 0 || fatSectors == 0) {
+        wcerr << L"❌ FAT32 引导扇区无效 (扇区大小须与磁盘一致)" << endl;
+        return false;
+    }
+
+    volume.dataStart = reserved + fatCount * fatSectors;
+    const ULONGLONG fatBytes = fatSectors * volume.bytesPerSector;
+    volume.fatCapacity = min(fatBytes / 4 - 2, FAT32_MAX_CLUSTERS);
+
+    // 按 1 MiB 分块扫描, 记录最后一个非空项与已用簇数
+    const size_t chunkBytes = 1024 * 1024;
+    vector<uint8_t> chunk;
+    for (ULONGLONG pos = 0; pos < fatBytes; pos += chunk.size()) {
+        chunk.resize((size_t)min<ULONGLONG>(chunkBytes, fatBytes - pos));
+        if (!image.Read(base + reserved * volume.bytesPerSector + pos, chunk.data(), chunk.size())) return false;
+
+        for (size_t i = 0; i + 4 <= chunk.size(); i += 4) {
+            ULONGLONG cluster = (pos + i) / 4;
+            if (cluster < 2 || cluster >= volume.fatCapacity + 2) continue;
+            if ((GetLE32(&chunk[i]) & 0x0FFFFFFF) != 0) {
+                volume.highestUsed = cluster;
+                volume.usedClusters++;
+            }
+        }
+    }
+    return true;
+}
+
+// 更新一份 FSInfo 的空闲簇数与下一个空闲簇提示; 签名不对时跳过
+static bool UpdateFsInfo(DiskImage& image, ULONGLONG offset, unsigned bytesPerSector,
+    ULONGLONG clusterCount, ULONGLONG usedClusters, vector<PendingWrite>& writes) {
+    vector<uint8_t> info(bytesPerSector);
+    if (!image.Read(offset, info.data(), info.size())) return false;
+    if (GetLE32(&info[0]) != FSINFO_LEAD_SIGNATURE || GetLE32(&info[484]) != FSINFO_STRUCT_SIGNATURE) {
+        return true;
+    }
+
+    PutLE32(&info[488], (uint32_t)(clusterCount - usedClusters));
+    if (GetLE32(&info[492]) != FSINFO_UNKNOWN && GetLE32(&info[492]) >= clusterCount + 2) {
+        PutLE32(&info[492], FSINFO_UNKNOWN);
+    }
+    writes.push_back({ offset, info });
+    return true;
+}
+
+// 新的总扇区数写入引导扇区、备份引导扇区与两份 FSInfo
+static bool BuildFat32Writes(DiskImage& image, ULONGLONG base, const Fat32Volume& volume,
+    ULONGLONG totalSectors, vector<PendingWrite>& writes) {
+    const unsigned bps = volume.bytesPerSector;
+    const ULONGLONG clusterCount = (totalSectors - volume.dataStart) / volume.sectorsPerCluster;
+    const ULONGLONG fsInfoSector = GetLE16(&volume.boot[48]);
+    const ULONGLONG backupSector = GetLE16(&volume.boot[50]);
+
+    vector<uint8_t> boot = volume.boot;
+    PutLE16(&boot[19], 0);
+    PutLE32(&boot[32], (uint32_t)totalSectors);
+    writes.push_back({ base, boot });
+
+    if (fsInfoSector != 0 && fsInfoSector != 0xFFFF
+        && !UpdateFsInfo(image, base + fsInfoSector * bps, bps, clusterCount, volume.usedClusters, writes)) {
+        return false;
+    }
+
+    if (backupSector != 0 && backupSector != 0xFFFF) {
+        vector<uint8_t> backup(bps);
+        if (!image.Read(base + backupSector * bps, backup.data(), backup.size())) return false;
+        if (memcmp(&backup[82], "FAT32   ", 8) == 0) {
+            PutLE16(&backup[19], 0);
+            PutLE32(&backup[32], (uint32_t)totalSectors);
+            writes.push_back({ base + backupSector * bps, backup });
+        }
+        if (fsInfoSector != 0 && fsInfoSector != 0xFFFF
+            && !UpdateFsInfo(image, base + (backupSector + fsInfoSector) * bps, bps, clusterCount, volume.usedClusters, writes)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int RunImageResizeMode(const CommandLineArgs& args) {
+    auto start = chrono::steady_clock::now();
+
+    error_code ec;
+    if (!fs::is_regular_file(fs::path(args.imagePath), ec)) {
+        wcerr << L"❌ 错误: --resize-part 需要已有的镜像文件: " << args.imagePath << endl;
+        return 1;
+    }
+
+    mt19937_64 rng = MakeImageRng(args, IMAGE_RNG_CONTAINER);
+    DiskImage image;
+    if (!image.Open(args.imagePath, rng)) {
+        return 1;
+    }
+
+    GptState gpt;
+    unsigned sectorSize = image.IsVhdx() ? image.VhdxSectorSize() : 0;
+    if (!ReadGpt(image, sectorSize, gpt)) {
+        return 1;
+    }
+    const ULONGLONG sector = gpt.sectorSize;
+
+    wostream& out = wcout;
+    out << L"\n📐 调整镜像分区: " << args.imagePath << endl;
+    out << L"==========================================" << endl;
+    out << L"  格式: " << (image.IsVhdx() ? L"VHDX" : L"RAW") << L", 虚拟大小 " << FormatBytes(image.Size())
+        << L", 逻辑扇区 " << sector << endl;
+
+    // 先计算全部修改, 全部通过检查后才写入; 扩展时先写 GPT, 收缩时先写文件系统,
+    // 中途失败也不会出现文件系统大于分区的情况
+    vector<PendingWrite> beforeGpt;
+    vector<PendingWrite> afterGpt;
+    bool changed = false;
+
+    for (const auto& resize : args.resizes) {
+        const int number = resize.partitionNumber;
+        if (number < 1 || (uint32_t)number > gpt.entryCount || !gpt.IsUsed(number)) {
+            wcerr << L"❌ 未找到分区 " << number << endl;
+            return 1;
+        }
+
+        uint8_t* entry = gpt.Entry(number);
+        const ULONGLONG firstLba = GetLE64(entry + 32);
+        const ULONGLONG lastLba = GetLE64(entry + 40);
+        const ULONGLONG base = firstLba * sector;
+        const ULONGLONG currentSize = (lastLba - firstLba + 1) * sector;
+
+        // 分区起点不变: 上限为下一个分区的起点或最后可用 LBA
+        ULONGLONG endLba = gpt.LastUsableLba() + 1;
+        for (uint32_t other = 1; other <= gpt.entryCount; other++) {
+            if ((int)other == number || !gpt.IsUsed(other)) continue;
+            ULONGLONG otherFirst = GetLE64(gpt.Entry(other) + 32);
+            if (otherFirst > firstLba) endLba = min(endLba, otherFirst);
+        }
+        ULONGLONG sizeMax = (endLba - firstLba) * sector;
+        ULONGLONG sizeMin = min(currentSize, PARTITION_ALIGNMENT);
+
+        vector<uint8_t> boot(gpt.sectorSize);
+        if (!image.Read(base, boot.data(), boot.size())) return 1;
+        wstring fileSystem = ProbeFileSystem(boot);
+
+        Fat32Volume fat;
+        if (fileSystem == L"FAT32") {
+            if (!ReadFat32Volume(image, base, boot, fat)) return 1;
+
+            // 扩展受 FAT 容量与 2^32 扇区限制, 收缩不能截掉已用簇且须保持 FAT32 的最小簇数
+            ULONGLONG maxSectors = min(fat.dataStart + fat.fatCapacity * fat.sectorsPerCluster, 0xFFFFFFFFULL);
+            ULONGLONG minClusters = max(fat.highestUsed >= 2 ? fat.highestUsed - 1 : 0, FAT32_MIN_CLUSTERS);
+            sizeMax = min(sizeMax, maxSectors * sector);
+            sizeMin = max(sizeMin, (fat.dataStart + minClusters * fat.sectorsPerCluster) * sector);
+        }
+        else if (fileSystem == L"NTFS") {
+            NtfsGeometry ntfs;
+            if (!ReadNtfsGeometry(boot, ntfs)) {
+                wcerr << L"❌ NTFS 引导扇区无效 (扇区大小须与磁盘一致)" << endl;
+                return 1;
+            }
+
+            // 只能扩展; 簇数不超过 2^32 - 1, 最后一个扇区留给备份引导扇区
+            sizeMax = min(sizeMax, (0xFFFFFFFFULL * ntfs.SectorsPerCluster() + 1) * sector);
+            sizeMin = max(sizeMin, currentSize);
+        }
+        else if (!fileSystem.empty()) {
+            wcerr << L"❌ 分区 " << number << L" 的文件系统 (" << fileSystem << L") 不支持原地调整" << endl;
+            return 1;
+        }
+
+        ULONGLONG size = resize.useMaximum ? sizeMax : resize.size;
+
+        out << L"  分区 " << number << L": " << (fileSystem.empty() ? wstring(L"空白") : fileSystem)
+            << L", 当前 " << FormatBytes(currentSize)
+            << L", 支持范围 " << FormatBytes(sizeMin) << L" - " << FormatBytes(sizeMax) << endl;
+
+        if (size % sector != 0) {
+            wcerr << L"❌ 目标大小必须是扇区 (" << sector << L" 字节) 的整数倍" << endl;
+            return 1;
+        }
+        if (size < sizeMin || size > sizeMax) {
+            wcerr << L"❌ 目标大小 " << FormatBytes(size) << L" 超出支持范围 ("
+                << FormatBytes(sizeMin) << L" - " << FormatBytes(sizeMax) << L")" << endl;
+            return 1;
+        }
+        if (size == currentSize) {
+            out << L"    ✓ 已是目标大小, 无需调整" << endl;
+            continue;
+        }
+
+        out << L"    " << (size > currentSize ? L"扩展" : L"收缩") << L"到 " << FormatBytes(size) << endl;
+
+        PutLE64(entry + 40, firstLba + size / sector - 1);
+        if (fileSystem == L"FAT32"
+            && !BuildFat32Writes(image, base, fat, size / sector, size > currentSize ? afterGpt : beforeGpt)) {
+            return 1;
+        }
+        if (fileSystem == L"NTFS") {
+            ExtentList ntfsWrites;
+            auto read = [&](ULONGLONG offset, uint8_t* data, size_t length) { return image.Read(offset, data, length); };
+            if (!GrowNtfs(read, base, boot, size, ntfsWrites)) return 1;
+            for (const auto& entry : ntfsWrites.Extents()) afterGpt.push_back({ entry.second.offset, entry.second.data });
+        }
+        changed = true;
+    }
+
+    if (changed) {
+        vector<PendingWrite> gptWrites;
+        BuildGptWrites(gpt, gptWrites);
+
+        for (const auto* writes : { &beforeGpt, &gptWrites, &afterGpt }) {
+            for (const auto& write : *writes) {
+                if (!image.Write(write.offset, write.data.data(), write.data.size())) return 1;
+            }
+        }
+    }
+
+    if (!image.Close()) {
+        wcerr << L"❌ 关闭镜像失败: " << args.imagePath << endl;
+        return 1;
+    }
+
+    double elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    out << L"  写入: " << FormatBytes(image.BytesWritten()) << endl;
+    out << L"  耗时: " << fixed << setprecision(1) << elapsedMs << L" ms" << endl;
+    out << L"\n✓ " << (changed ? L"分区大小已调整" : L"无需调整") << endl;
+    return 0;
+}
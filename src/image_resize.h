@@ -0,0 +1,20 @@
+﻿#pragma once
+
+/*
+ * 已有镜像中分区的原地调整 (--image=<已有镜像> --resize-part=...)
+ *
+ * 对应 MSFT_Partition.GetSupportedSize / Resize 的镜像实现, 只改元数据所在的几个扇区:
+ *   1. 读取并校验主 GPT; 分区起点不变, 上限为下一个分区的起点或最后可用 LBA,
+ *      文件系统再收紧范围, 目标大小超出范围时不做任何修改;
+ *   2. 修改分区表项的结束 LBA, 重算 CRC, 并按主 GPT 重写备份 GPT;
+ *   3. FAT32: 更新引导扇区 (及备份) 的总扇区数与 FSInfo 的空闲簇数。FAT 的大小在
+ *      格式化时已确定, 扩展上限为 FAT 能描述的簇数; 收缩下限为最后一个已用簇。
+ *      NTFS: 只能扩展, 更新引导扇区与新位置的备份、$Bitmap 及其 runlist、$BadClus:$Bad (见 ntfs.h)。
+ *      空白分区只修改 GPT, 其他文件系统不支持。
+ * raw 镜像直接读写, VHDX 经 BAT 映射读写。
+ */
+
+#include "cli.h"
+
+// --image=<已有镜像> --resize-part=... 模式入口, 返回进程退出码
+int RunImageResizeMode(const CommandLineArgs& args);
@@ -0,0 +1,157 @@
+﻿#include "layout.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+// 1601-01-01 到 1970-01-01 的 100 ns 数
+static const ULONGLONG NT_EPOCH_OFFSET = 116444736000000000ULL;
+
+ULONGLONG ImageFormatTime(const CommandLineArgs& args) {
+    if (args.hasImageSeed) {
+        ULONGLONG seconds = 0;
+#ifdef _WIN32
+        char* epoch = nullptr;
+        size_t length = 0;
+        if (_dupenv_s(&epoch, &length, "SOURCE_DATE_EPOCH") == 0 && epoch) {
+            seconds = strtoull(epoch, nullptr, 10);
+            free(epoch);
+        }
+#else
+        if (const char* epoch = getenv("SOURCE_DATE_EPOCH")) {
+            seconds = strtoull(epoch, nullptr, 10);
+        }
+#endif
+        return NT_EPOCH_OFFSET + seconds * 10000000ULL;
+    }
+
+    static const ULONGLONG now = NT_EPOCH_OFFSET + (ULONGLONG)chrono::duration_cast<chrono::nanoseconds>(
+        chrono::system_clock::now().time_since_epoch()).count() / 100;
+    return now;
+}
+
+bool PlanLayout(
+    const CommandLineArgs& args,
+    ULONGLONG diskSize,
+    unsigned sectorSize,
+    unsigned physicalSectorSize,
+    mt19937_64& rng,
+    DiskLayout& layout
+) {
+    layout = DiskLayout();
+    layout.diskSize = diskSize / sectorSize * sectorSize;
+    layout.sectorSize = sectorSize;
+    layout.physicalSectorSize = physicalSectorSize;
+    layout.formatTime = ImageFormatTime(args);
+
+    if (sectorSize != 512 && sectorSize != 4096) {
+        wcerr << L"❌ 不支持的扇区大小: " << sectorSize << endl;
+        return false;
+    }
+    if (layout.SectorCount() < layout.FirstUsableLba() * 2 + 1) {
+        wcerr << L"❌ 磁盘容量太小: " << FormatBytes(diskSize) << endl;
+        return false;
+    }
+    if (args.partitions.size() > GPT_ENTRY_COUNT) {
+        wcerr << L"❌ 分区数超过 GPT 上限 " << GPT_ENTRY_COUNT << endl;
+        return false;
+    }
+
+    layout.diskGuid = RandomGuid(rng);
+
+    const ULONGLONG firstUsable = layout.FirstUsableLba() * sectorSize;
+    const ULONGLONG lastUsable = (layout.LastUsableLba() + 1) * sectorSize;   // 不含
+
+    for (size_t i = 0; i < args.partitions.size(); i++) {
+        const auto& spec = args.partitions[i];
+
+        PlannedPartition part;
+        part.number = (int)i + 1;
+        part.name = spec.label;
+        part.size = spec.size;
+
+        if (!ParseGuid(PartitionTypeToGuid(spec.type), part.typeGuid)) {
+            wcerr << L"❌ 无法识别的分区类型: " << spec.type << endl;
+            return false;
+        }
+        if (part.name.size() > GPT_NAME_CHARS) {
+            wcerr << L"❌ GPT 分区名称超过 " << GPT_NAME_CHARS << L" 个字符: " << part.name << endl;
+            return false;
+        }
+        if (part.size % sectorSize != 0 || spec.offset % sectorSize != 0) {
+            wcerr << L"❌ 分区 " << part.number << L" 的大小/偏移必须是扇区大小的整数倍" << endl;
+            return false;
+        }
+
+        // 空闲区间 (已放置的分区按偏移排序)
+        vector<pair<ULONGLONG, ULONGLONG>> gaps;
+        ULONGLONG cursor = firstUsable;
+        for (const auto& existing : layout.partitions) {
+            if (existing.offset > cursor) gaps.push_back({ cursor, existing.offset });
+            cursor = max(cursor, existing.End());
+        }
+        if (lastUsable > cursor) gaps.push_back({ cursor, lastUsable });
+
+        bool placed = false;
+
+        if (spec.offset > 0) {
+            for (const auto& gap : gaps) {
+                if (spec.offset >= gap.first && spec.offset < gap.second) {
+                    part.offset = spec.offset;
+                    if (part.size == 0) part.size = gap.second - spec.offset;
+                    placed = spec.offset + part.size <= gap.second;
+                    break;
+                }
+            }
+        }
+        else if (part.size == 0) {
+            // 占用最大的空闲区间
+            for (const auto& gap : gaps) {
+                ULONGLONG start = (gap.first + PARTITION_ALIGNMENT - 1) / PARTITION_ALIGNMENT * PARTITION_ALIGNMENT;
+                if (start >= gap.second) continue;
+                ULONGLONG length = (gap.second - start) / sectorSize * sectorSize;
+                if (length > part.size) {
+                    part.offset = start;
+                    part.size = length;
+                    placed = true;
+                }
+            }
+        }
+        else {
+            for (const auto& gap : gaps) {
+                ULONGLONG start = (gap.first + PARTITION_ALIGNMENT - 1) / PARTITION_ALIGNMENT * PARTITION_ALIGNMENT;
+                if (start + part.size <= gap.second) {
+                    part.offset = start;
+                    placed = true;
+                    break;
+                }
+            }
+        }
+
+        if (!placed || part.size == 0) {
+            wcerr << L"❌ 磁盘空间不足, 无法放置分区 " << part.number
+                << L" (大小 " << FormatBytes(spec.size) << L")" << endl;
+            return false;
+        }
+
+        part.uniqueGuid = RandomGuid(rng);
+
+        if (i < args.formats.size()) {
+            part.format = true;
+            part.formatSpec = args.formats[i];
+        }
+
+        // 按偏移插入, 分区号保持为命令行中的顺序
+        auto pos = upper_bound(layout.partitions.begin(), layout.partitions.end(), part,
+            [](const PlannedPartition& a, const PlannedPartition& b) { return a.offset < b.offset; });
+        layout.partitions.insert(pos, part);
+    }
+
+    // 分区表按分区号排列
+    sort(layout.partitions.begin(), layout.partitions.end(),
+        [](const PlannedPartition& a, const PlannedPartition& b) { return a.number < b.number; });
+    return true;
+}
@@ -0,0 +1,67 @@
+﻿#pragma once
+
+/*
+ * 分区布局规划
+ *
+ * 按 --create-part / --format 给出的顺序在空白 GPT 磁盘上放置分区,
+ * 规则与 MSFT_Disk.CreatePartition 一致: 默认 1 MiB 对齐、首个可容纳的空闲区间;
+ * 指定 offset 时必须落在空闲区间内; size 省略时占用剩余的最大空闲区间。
+ */
+
+#include "cli.h"
+#include "guid.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+constexpr unsigned GPT_ENTRY_COUNT = 128;
+constexpr unsigned GPT_ENTRY_SIZE = 128;
+constexpr ULONGLONG GPT_ENTRY_ARRAY_BYTES = (ULONGLONG)GPT_ENTRY_COUNT * GPT_ENTRY_SIZE;
+constexpr unsigned GPT_NAME_CHARS = 36;
+constexpr ULONGLONG PARTITION_ALIGNMENT = 1024 * 1024;
+
+struct PlannedPartition {
+    int number = 0;                    // 从 1 开始, 即 GPT 分区表中的序号
+    ULONGLONG offset = 0;              // 字节
+    ULONGLONG size = 0;
+    Guid typeGuid;
+    Guid uniqueGuid;
+    std::wstring name;                 // GPT 分区名称
+    ULONGLONG attributes = 0;
+
+    bool format = false;               // 是否有对应的 --format
+    CommandLineArgs::FormatSpec formatSpec;
+
+    ULONGLONG End() const { return offset + size; }
+};
+
+struct DiskLayout {
+    ULONGLONG diskSize = 0;
+    unsigned sectorSize = 512;         // 逻辑扇区
+    unsigned physicalSectorSize = 4096;
+    Guid diskGuid;
+    std::vector<PlannedPartition> partitions;
+    ULONGLONG formatTime = 0;          // 文件系统时间戳 (NT 时间: 1601 年起的 100 ns 数)
+
+    ULONGLONG SectorCount() const { return diskSize / sectorSize; }
+    ULONGLONG EntryArraySectors() const { return (GPT_ENTRY_ARRAY_BYTES + sectorSize - 1) / sectorSize; }
+
+    // GPT 可用范围 (LBA, 含两端)
+    ULONGLONG FirstUsableLba() const { return 2 + EntryArraySectors(); }
+    ULONGLONG LastUsableLba() const { return SectorCount() - 2 - EntryArraySectors(); }
+};
+
+// 文件系统时间戳 (NT 时间): 指定 --seed 时取 SOURCE_DATE_EPOCH (未设置为 1970-01-01),
+// 使输出可复现; 否则为当前时间 (进程内只取一次, 同一次运行的各分区一致)
+ULONGLONG ImageFormatTime(const CommandLineArgs& args);
+
+// 规划布局; 失败时输出原因并返回 false
+bool PlanLayout(
+    const CommandLineArgs& args,
+    ULONGLONG diskSize,
+    unsigned sectorSize,
+    unsigned physicalSectorSize,
+    std::mt19937_64& rng,
+    DiskLayout& layout
+);
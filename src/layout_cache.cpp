@@ -0,0 +1,423 @@
+﻿#include "layout_cache.h"
+
+#include "byte_order.h"
+#include "checksum.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+// 生成器或条目格式变化时递增, 使旧条目失效
+static const char* const LAYOUT_SPEC_VERSION = "disk_part_fmt layout v3";
+
+static const char LAYOUT_ENTRY_MAGIC[8] = { 'D', 'P', 'F', 'L', 'A', 'Y', 'T', '3' };
+
+// 区段类型
+static const uint8_t ENTRY_EXTENT_DATA = 0;
+static const uint8_t ENTRY_EXTENT_ZERO = 1;
+static const uint8_t ENTRY_EXTENT_FILL = 2;      // 后跟 4 字节填充值
+
+// ================================
+// 键
+// ================================
+
+static wstring NormalizeTypeGuid(const wstring& type) {
+    Guid guid;
+    wstring text = PartitionTypeToGuid(type);
+    return ParseGuid(text, guid) ? FormatGuid(guid) : text;
+}
+
+string ImageSpecKey(const CommandLineArgs& args) {
+    wostringstream spec;
+    spec << LAYOUT_SPEC_VERSION << L"\n";
+    spec << L"size=" << args.imageSize << L"\n";
+    spec << L"sector=" << args.imageSectorSize << L"\n";
+    spec << L"seed=" << args.imageSeed << L"\n";
+    spec << L"time=" << ImageFormatTime(args) << L"\n";
+
+    for (size_t i = 0; i < args.partitions.size(); i++) {
+        const auto& part = args.partitions[i];
+        spec << L"part offset=" << part.offset << L" size=" << part.size
+            << L" type=" << NormalizeTypeGuid(part.type) << L" label=" << part.label << L"\n";
+
+        // --format 与 --create-part 按序号配对
+        if (i < args.formats.size()) {
+            const auto& format = args.formats[i];
+            spec << L"format fs=" << format.fileSystem << L" vol=" << format.volumeLabel
+                << L" quick=" << (format.quickFormat ? 1 : 0) << L" unit=" << format.allocationUnitSize << L"\n";
+        }
+    }
+
+    string text = ToUtf8(spec.str());
+    return DigestToHex(Sha256(text.data(), text.size()));
+}
+
+// ================================
+// 条目序列化
+// ================================
+
+class EntryWriter {
+public:
+    void Bytes(const void* data, size_t length) {
+        const uint8_t* p = (const uint8_t*)data;
+        buffer.insert(buffer.end(), p, p + length);
+    }
+
+    void U8(uint8_t v) { buffer.push_back(v); }
+    void U32(uint32_t v) { uint8_t b[4]; PutLE32(b, v); Bytes(b, 4); }
+    void U64(uint64_t v) { uint8_t b[8]; PutLE64(b, v); Bytes(b, 8); }
+    void Id(const Guid& guid) { Bytes(guid.bytes, 16); }
+
+    void Text(const wstring& text) {
+        string utf8 = ToUtf8(text);
+        U32((uint32_t)utf8.size());
+        Bytes(utf8.data(), utf8.size());
+    }
+
+    vector<uint8_t> buffer;
+};
+
+class EntryReader {
+public:
+    EntryReader(const vector<uint8_t>& buffer, size_t end) : buffer(buffer), end(end) {}
+
+    bool Bytes(void* data, size_t length) {
+        if (failed || end - pos < length) {
+            failed = true;
+            return false;
+        }
+        memcpy(data, buffer.data() + pos, length);
+        pos += length;
+        return true;
+    }
+
+    uint8_t U8() { uint8_t v = 0; Bytes(&v, 1); return v; }
+    uint32_t U32() { uint8_t b[4] = {}; Bytes(b, 4); return GetLE32(b); }
+    uint64_t U64() { uint8_t b[8] = {}; Bytes(b, 8); return GetLE64(b); }
+    void Id(Guid& guid) { Bytes(guid.bytes, 16); }
+
+    wstring Text() {
+        uint32_t length = U32();
+        if (failed || end - pos < length) {
+            failed = true;
+            return wstring();
+        }
+        string utf8((const char*)buffer.data() + pos, length);
+        pos += length;
+        return FromUtf8(utf8);
+    }
+
+    bool Failed() const { return failed; }
+    bool AtEnd() const { return pos == end; }
+
+private:
+    const vector<uint8_t>& buffer;
+    size_t end;
+    size_t pos = 0;
+    bool failed = false;
+};
+
+static vector<uint8_t> EncodeEntry(const DiskLayout& layout, const ExtentList& extents) {
+    EntryWriter w;
+    w.Bytes(LAYOUT_ENTRY_MAGIC, sizeof(LAYOUT_ENTRY_MAGIC));
+    w.U64(layout.diskSize);
+    w.U32(layout.sectorSize);
+    w.U32(layout.physicalSectorSize);
+    w.Id(layout.diskGuid);
+
+    w.U32((uint32_t)layout.partitions.size());
+    for (const auto& part : layout.partitions) {
+        w.U32((uint32_t)part.number);
+        w.U64(part.offset);
+        w.U64(part.size);
+        w.Id(part.typeGuid);
+        w.Id(part.uniqueGuid);
+        w.U64(part.attributes);
+        w.Text(part.name);
+        w.U8(part.format ? 1 : 0);
+        w.Text(part.formatSpec.fileSystem);
+        w.Text(part.formatSpec.volumeLabel);
+        w.U8(part.formatSpec.quickFormat ? 1 : 0);
+        w.U64(part.formatSpec.allocationUnitSize);
+    }
+
+    w.U32((uint32_t)extents.Count());
+    for (const auto& entry : extents.Extents()) {
+        const ImageExtent& ext = entry.second;
+        w.U64(ext.offset);
+        w.U64(ext.length);
+        if (ext.IsZero()) {
+            w.U8(ENTRY_EXTENT_ZERO);
+        }
+        else if (ext.IsFill()) {
+            w.U8(ENTRY_EXTENT_FILL);
+            w.U32(ext.fill);
+        }
+        else {
+            w.U8(ENTRY_EXTENT_DATA);
+            w.Bytes(ext.data.data(), ext.data.size());
+        }
+    }
+
+    w.U32(Crc32(w.buffer.data(), w.buffer.size()));
+    return w.buffer;
+}
+
+static bool DecodeEntry(const vector<uint8_t>& buffer, DiskLayout& layout, ExtentList& extents) {
+    if (buffer.size() < sizeof(LAYOUT_ENTRY_MAGIC) + 4) return false;
+
+    const size_t body = buffer.size() - 4;
+    if (Crc32(buffer.data(), body) != GetLE32(buffer.data() + body)) return false;
+
+    EntryReader r(buffer, body);
+    char magic[sizeof(LAYOUT_ENTRY_MAGIC)];
+    if (!r.Bytes(magic, sizeof(magic)) || memcmp(magic, LAYOUT_ENTRY_MAGIC, sizeof(magic)) != 0) return false;
+
+    layout = DiskLayout();
+    layout.diskSize = r.U64();
+    layout.sectorSize = r.U32();
+    layout.physicalSectorSize = r.U32();
+    r.Id(layout.diskGuid);
+
+    uint32_t partitionCount = r.U32();
+    for (uint32_t i = 0; i < partitionCount && !r.Failed(); i++) {
+        PlannedPartition part;
+        part.number = (int)r.U32();
+        part.offset = r.U64();
+        part.size = r.U64();
+        r.Id(part.typeGuid);
+        r.Id(part.uniqueGuid);
+        part.attributes = r.U64();
+        part.name = r.Text();
+        part.format = r.U8() != 0;
+        part.formatSpec.fileSystem = r.Text();
+        part.formatSpec.volumeLabel = r.Text();
+        part.formatSpec.quickFormat = r.U8() != 0;
+        part.formatSpec.allocationUnitSize = r.U64();
+        layout.partitions.push_back(part);
+    }
+
+    extents.Clear();
+    uint32_t extentCount = r.U32();
+    vector<uint8_t> data;
+    for (uint32_t i = 0; i < extentCount && !r.Failed(); i++) {
+        ULONGLONG offset = r.U64();
+        ULONGLONG length = r.U64();
+        uint8_t kind = r.U8();
+
+        if (kind == ENTRY_EXTENT_ZERO) {
+            extents.Zero(offset, length);
+            continue;
+        }
+        if (kind == ENTRY_EXTENT_FILL) {
+            extents.Fill(offset, length, r.U32());
+            continue;
+        }
+        if (kind != ENTRY_EXTENT_DATA) return false;
+        if (length > body) return false;
+        data.resize((size_t)length);
+        if (r.Bytes(data.data(), data.size())) extents.Write(offset, data);
+    }
+
+    return !r.Failed() && r.AtEnd();
+}
+
+// ================================
+// LayoutCache
+// ================================
+
+static bool ReadWholeFile(const fs::path& path, vector<uint8_t>& buffer) {
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in) return false;
+
+    // 一次读入整个条目
+    streamoff size = in.tellg();
+    if (size < 0) return false;
+    buffer.resize((size_t)size);
+    in.seekg(0);
+    return (bool)in.read((char*)buffer.data(), size);
+}
+
+// 新建文件并写入全部内容; 文件已存在时失败 (O_EXCL / CREATE_NEW), 不会与其他写者共用同一文件
+static bool CreateExclusive(const fs::path& path, const void* data, size_t length) {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    const uint8_t* p = (const uint8_t*)data;
+    bool ok = true;
+    while (ok && length > 0) {
+        DWORD chunk = (DWORD)min<size_t>(length, 64 * 1024 * 1024);
+        DWORD written = 0;
+        ok = WriteFile(file, p, chunk, &written, nullptr) && written > 0;
+        p += written;
+        length -= written;
+    }
+    CloseHandle(file);
+#else
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+
+    const uint8_t* p = (const uint8_t*)data;
+    bool ok = true;
+    while (ok && length > 0) {
+        ssize_t written = write(fd, p, length);
+        if (written < 0 && errno == EINTR) continue;
+        ok = written > 0;
+        if (ok) {
+            p += written;
+            length -= (size_t)written;
+        }
+    }
+    if (close(fd) != 0) ok = false;
+#endif
+
+    if (!ok) {
+        error_code ec;
+        fs::remove(path, ec);
+    }
+    return ok;
+}
+
+// 写入临时文件 (<名称>.<进程号>.<随机数>.tmp) 再原子改名:
+// 并发写同一条目的进程各自使用自己的临时文件, 读者只会看到完整的旧条目或新条目
+static bool WriteWholeFile(const fs::path& path, const void* data, size_t length) {
+#ifdef _WIN32
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = (unsigned long)getpid();
+#endif
+    static thread_local mt19937_64 rng(random_device{}());
+
+    for (int attempt = 0; attempt < 8; attempt++) {
+        ostringstream suffix;
+        suffix << "." << pid << "." << hex << setw(16) << setfill('0') << rng() << ".tmp";
+        fs::path temp = path;
+        temp += suffix.str();
+
+        if (!CreateExclusive(temp, data, length)) {
+            error_code ec;
+            if (fs::exists(temp, ec)) continue;     // 名称冲突, 换一个
+            return false;
+        }
+
+        // rename(2) / MoveFileEx(MOVEFILE_REPLACE_EXISTING) 原子替换已有条目
+        error_code ec;
+        fs::rename(temp, path, ec);
+        if (ec) fs::remove(temp, ec);
+        return !ec;
+    }
+    return false;
+}
+
+// 追加一行; 单次 O_APPEND / FILE_APPEND_DATA 写入不会与其他进程的追加交错
+static bool AppendLine(const fs::path& path, const string& line) {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+        OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    DWORD written = 0;
+    bool ok = WriteFile(file, line.data(), (DWORD)line.size(), &written, nullptr) && written == line.size();
+    CloseHandle(file);
+    return ok;
+#else
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    ssize_t written;
+    do {
+        written = write(fd, line.data(), line.size());
+    } while (written < 0 && errno == EINTR);
+    close(fd);
+    return written == (ssize_t)line.size();
+#endif
+}
+
+LayoutCache::LayoutCache(const wstring& directory) : directory(directory) {}
+
+bool LayoutCache::Load(const string& key, DiskLayout& layout, ExtentList& extents) const {
+    vector<uint8_t> buffer;
+    if (!ReadWholeFile(fs::path(directory) / (key + ".layout"), buffer)) return false;
+
+    if (!DecodeEntry(buffer, layout, extents)) {
+        wcerr << L"⚠️  缓存条目损坏, 重新生成: " << FromUtf8(key) << endl;
+        return false;
+    }
+    return true;
+}
+
+bool LayoutCache::Store(const string& key, const DiskLayout& layout, const ExtentList& extents) const {
+    error_code ec;
+    fs::create_directories(fs::path(directory), ec);
+
+    vector<uint8_t> entry = EncodeEntry(layout, extents);
+    if (!WriteWholeFile(fs::path(directory) / (key + ".layout"), entry.data(), entry.size())) {
+        wcerr << L"⚠️  写入缓存失败: " << directory << endl;
+        return false;
+    }
+    return true;
+}
+
+void LayoutCache::RecordLookup(bool hit) const {
+    // 每次查找追加一条记录, 并发的进程不会互相覆盖计数
+    error_code ec;
+    fs::create_directories(fs::path(directory), ec);
+    AppendLine(fs::path(directory) / "lookups", hit ? "hit\n" : "miss\n");
+}
+
+LayoutCacheStats LayoutCache::Stats() const {
+    LayoutCacheStats stats;
+
+    ifstream lookups(fs::path(directory) / "lookups");
+    string record;
+    while (lookups >> record) {
+        if (record == "hit") stats.hits++;
+        else if (record == "miss") stats.misses++;
+    }
+
+    error_code ec;
+    for (fs::directory_iterator it(fs::path(directory), ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() != ".layout") continue;
+
+        stats.entries++;
+        stats.cacheBytes += (ULONGLONG)it->file_size(ec);
+
+        // 虚拟磁盘大小紧随魔数
+        uint8_t header[sizeof(LAYOUT_ENTRY_MAGIC) + 8];
+        ifstream in(it->path(), ios::binary);
+        if (in.read((char*)header, sizeof(header))) {
+            stats.imageBytes += GetLE64(header + sizeof(LAYOUT_ENTRY_MAGIC));
+        }
+    }
+    return stats;
+}
+
+void PrintLayoutCacheStats(wostream& out, const LayoutCache& cache, bool hit, const string& key) {
+    LayoutCacheStats stats = cache.Stats();
+    unsigned long long lookups = stats.hits + stats.misses;
+
+    out << L"  缓存: " << (hit ? L"命中" : L"未命中") << L" " << FromUtf8(key.substr(0, 16))
+        << L" (" << cache.Directory() << L")" << endl;
+    out << L"    累计命中 " << stats.hits << L" / " << lookups << L" 次查找";
+    if (lookups > 0) {
+        out << L" (" << fixed << setprecision(1) << stats.hits * 100.0 / lookups << L"%)";
+    }
+    out << endl;
+    out << L"    " << stats.entries << L" 个条目占用 " << FormatBytes(stats.cacheBytes)
+        << L", 对应镜像 " << FormatBytes(stats.imageBytes)
+        << L", 节省 " << FormatBytes(stats.imageBytes > stats.cacheBytes ? stats.imageBytes - stats.cacheBytes : 0) << endl;
+}
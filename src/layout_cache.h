@@ -0,0 +1,53 @@
+﻿#pragma once
+
+/*
+ * 生成布局的内容寻址缓存 (--cache)
+ *
+ * 键为规范化参数文本的 SHA-256: 磁盘大小、扇区、种子、文件系统时间戳、各分区的偏移/大小/类型 GUID/名称
+ * 与格式化参数, 以及生成器版本。容器格式 (VHDX / raw) 不参与键, 同一布局的两种输出共享条目。
+ * 条目保存布局与磁盘区段列表 (<目录>/<键>.layout, 带 CRC32), 命中时跳过布局规划与格式化。
+ *
+ * 只有指定 --seed 时输出才可复现, 未指定种子时不使用缓存。
+ * 每次查找在 <目录>/lookups 中追加一行 hit / miss, 累计次数由记录数得出 (多个进程共用目录时不丢计数)。
+ */
+
+#include "cli.h"
+#include "extent.h"
+#include "layout.h"
+
+#include <string>
+
+struct LayoutCacheStats {
+    unsigned long long hits = 0;           // 累计
+    unsigned long long misses = 0;
+    unsigned long long entries = 0;
+    ULONGLONG cacheBytes = 0;              // 条目文件总大小
+    ULONGLONG imageBytes = 0;              // 条目对应的虚拟磁盘总大小
+};
+
+// 规范化参数的 SHA-256 (十六进制)
+std::string ImageSpecKey(const CommandLineArgs& args);
+
+class LayoutCache {
+public:
+    explicit LayoutCache(const std::wstring& directory);
+
+    // 读取条目; 不存在或校验失败时返回 false
+    bool Load(const std::string& key, DiskLayout& layout, ExtentList& extents) const;
+
+    // 写入条目 (先写进程独有的临时文件再原子改名)
+    bool Store(const std::string& key, const DiskLayout& layout, const ExtentList& extents) const;
+
+    // 累计一次查找结果
+    void RecordLookup(bool hit) const;
+
+    // 累计计数与目录中的条目统计
+    LayoutCacheStats Stats() const;
+
+    const std::wstring& Directory() const { return directory; }
+
+private:
+    std::wstring directory;
+};
+
+void PrintLayoutCacheStats(std::wostream& out, const LayoutCache& cache, bool hit, const std::string& key);
@@ -8,1035 +8,372 @@
  *   - 链接库: ole32.lib oleaut32.lib wbemuuid.lib
  *
  * 编译命令:
- *   cl /EHsc /std:c++17 DiskPartitionTool_ATL.cpp /link ole32.lib oleaut32.lib wbemuuid.lib
+ *   cmake -S . -B build && cmake --build build --config Release
+ *
+ * 非 Windows 平台只编译可移植部分 (模拟提供程序), 用于容量规划与 CI。
  *
  * 使用示例:
  *   DiskPartitionTool.exe --disk=1 --gpt --create-part size=10G,label=MyPart --format fs=ntfs,vol=Data,quick=1
  */
 
-#include <windows.h>
-#include <atlbase.h>      // ATL 基础类
-#include <atlcom.h>       // ATL COM 支持
-#include <comdef.h>
-#include <Wbemidl.h>
+#include "audit.h"
+#include "cli.h"
+#include "disk_manager.h"
+#include "image.h"
+#include "image_farm.h"
+#include "image_resize.h"
+#include "preflight.h"
+#include "provision.h"
+#include "replay_backend.h"
+#include "retrim.h"
+#include "sparse_stream.h"
+#include "stamp.h"
+#include "sim_backend.h"
+#include "wmi_manager.h"
+
+#include <algorithm>
 #include <iostream>
-#include <string>
-#include <vector>
-#include <map>
-#include <sstream>
-#include <iomanip>
 #include <memory>
-#include <thread>
-#include <chrono>
-#include <windows.h>
-#include <comdef.h>
-#include <Wbemidl.h>
-#include <atlbase.h>
-#include <atlcomcli.h>
-#include <functional>
 #include <string>
 #include <vector>
-#include <map>
 
+#ifdef _WIN32
 #include <io.h>
 #include <fcntl.h>
-
-#pragma comment(lib, "wbemuuid.lib")
-#pragma comment(lib, "ole32.lib")
-#pragma comment(lib, "oleaut32.lib")
+#else
+#include <clocale>
+#include <cstring>
+#include <langinfo.h>
+#endif
 
 using namespace std;
-using namespace ATL;
-
-// ================================
-// 常量定义
-// ================================
-
-// GPT 分区类型 GUID
-const wstring GUID_BASIC_DATA_PARTITION = L"{EBD0A0A2-B9E5-4433-87C0-68B6B72699C7}";
-const wstring GUID_EFI_SYSTEM_PARTITION = L"{C12A7328-F81F-11D2-BA4B-00A0C93EC93B}";
-const wstring GUID_MICROSOFT_RESERVED = L"{E3C9E316-0B5C-4DB8-817D-F92DF00215AE}";
-
-// 文件系统类型
-const map<wstring, int> FILE_SYSTEMS = {
-    {L"ntfs", 7},    // NTFS
-    {L"fat32", 5},   // FAT32
-    {L"exfat", 8},   // exFAT
-    {L"refs", 9}     // ReFS
-};
 
 // ================================
-// 工具函数
+// 主程序
 // ================================
 
-// 转换字节大小的字符串(如 "10G", "500M") 为字节数
-ULONGLONG ParseSizeString(const wstring& sizeStr) {
-    wstring str = sizeStr;
-    ULONGLONG multiplier = 1;
+#ifdef _WIN32
+static bool CheckAdministrator() {
+    BOOL isAdmin = FALSE;
+    PSID adminGroup = NULL;
+    SID_IDENTIFIER_AUTHORITY ntAuthority = SECURITY_NT_AUTHORITY;
 
-    if (!str.empty()) {
-        wchar_t unit = towupper(str.back());
-        if (unit == L'K' || unit == L'M' || unit == L'G' || unit == L'T') {
-            str.pop_back();
-            switch (unit) {
-            case L'K': multiplier = 1024ULL; break;
-            case L'M': multiplier = 1024ULL * 1024; break;
-            case L'G': multiplier = 1024ULL * 1024 * 1024; break;
-            case L'T': multiplier = 1024ULL * 1024 * 1024 * 1024; break;
-            }
-        }
+    if (AllocateAndInitializeSid(&ntAuthority, 2, SECURITY_BUILTIN_DOMAIN_RID,
+        DOMAIN_ALIAS_RID_ADMINS, 0, 0, 0, 0, 0, 0, &adminGroup)) {
+        CheckTokenMembership(NULL, adminGroup, &isAdmin);
+        FreeSid(adminGroup);
     }
 
-    return stoull(str) * multiplier;
+    return isAdmin != FALSE;
 }
+#endif
 
-// 解析参数字符串 (如 "size=10G,label=MyPart,type=basic")
-map<wstring, wstring> ParseParams(const wstring& paramStr) {
-    map<wstring, wstring> params;
-    wstringstream ss(paramStr);
-    wstring token;
+static int RunTool(int argc, wchar_t* argv[]) {
+    // --export=- / --audit=json=- 时标准输出只能包含数据
+    bool stdoutIsData = false;
+    for (int i = 1; i < argc; i++) {
+        wstring arg = argv[i];
+        if (arg == L"--export=-") stdoutIsData = true;
+        if (arg.find(L"--audit=") == 0 && ParseParams(arg.substr(8))[L"json"] == L"-") stdoutIsData = true;
+    }
+    wostream& banner = stdoutIsData ? wcerr : wcout;
 
-    while (getline(ss, token, L',')) {
-        size_t pos = token.find(L'=');
-        if (pos != wstring::npos) {
-            wstring key = token.substr(0, pos);
-            wstring value = token.substr(pos + 1);
-            params[key] = value;
-        }
+    banner << L"╔════════════════════════════════════════════════════════╗" << endl;
+    banner << L"║   Windows Storage Management API 磁盘工具 (ATL版)     ║" << endl;
+    banner << L"║   版本: 2.0 | 需要管理员权限                          ║" << endl;
+    banner << L"╚════════════════════════════════════════════════════════╝\n" << endl;
+
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
     }
 
-    return params;
-}
+    // 解析命令行
+    auto args = ParseCommandLine(argc, argv);
+    if (args.invalid) {
+        return 1;
+    }
 
-// GUID 字符串转换
-wstring PartitionTypeToGuid(const wstring& type) {
-    if (type == L"basic" || type == L"data") {
-        return GUID_BASIC_DATA_PARTITION;
+    // 镜像输出: 不经过 WMI, 也不触碰真实磁盘
+    if (args.farm.enabled) {
+        return RunFarmMode(args.farm, args.quiet);
     }
-    else if (type == L"efi") {
-        return GUID_EFI_SYSTEM_PARTITION;
+    if (args.stampCount > 0) {
+        return RunStampMode(args);
     }
-    else if (type == L"msr") {
-        return GUID_MICROSOFT_RESERVED;
+    if (!args.imagePath.empty() && args.audit.enabled) {
+        AuditDisk disk;
+        AuditImage(args.imagePath, args.audit, disk);
+        return FinishAudit({ disk }, args.audit, !args.quiet);
     }
-    return type; // 假设是完整 GUID
-}
-
-// ================================
-// WMI 管理类 (ATL 版本)
-// ================================
-
-class WMIManager {
-private:
-    CComPtr<IWbemLocator> pLoc;      // ATL 智能指针，自动管理引用计数
-    CComPtr<IWbemServices> pSvc;     // ATL 智能指针
-    bool initialized;
-
-public:
-    WMIManager() : initialized(false) {}
-
-    ~WMIManager() {
-        Cleanup();
+    if (!args.imagePath.empty() && !args.resizes.empty() && args.partitions.empty()) {
+        return RunImageResizeMode(args);
     }
-
-    bool Initialize() {
-        HRESULT hres;
-
-        // 初始化 COM
-        hres = CoInitializeEx(0, COINIT_MULTITHREADED);
-        if (FAILED(hres) && hres != RPC_E_CHANGED_MODE) {
-            wcerr << L"❌ COM 初始化失败. 错误代码: 0x" << hex << hres << endl;
-            return false;
-        }
-
-        // 设置 COM 安全级别
-        hres = CoInitializeSecurity(
-            NULL,
-            -1,
-            NULL,
-            NULL,
-            RPC_C_AUTHN_LEVEL_DEFAULT,
-            RPC_C_IMP_LEVEL_IMPERSONATE,
-            NULL,
-            EOAC_NONE,
-            NULL
-        );
-
-        if (FAILED(hres) && hres != RPC_E_TOO_LATE) {
-            wcerr << L"❌ COM 安全初始化失败. 错误代码: 0x" << hex << hres << endl;
-            CoUninitialize();
-            return false;
-        }
-
-        // 获取 WMI 定位器 - 使用 ATL 智能指针
-        hres = pLoc.CoCreateInstance(CLSID_WbemLocator);
-        if (FAILED(hres)) {
-            wcerr << L"❌ 创建 WbemLocator 失败. 错误代码: 0x" << hex << hres << endl;
-            CoUninitialize();
-            return false;
+    if (!args.imagePath.empty() || !args.exportPath.empty()) {
+        if (args.retrim.enabled) {
+            wcerr << L"⚠️  新生成的镜像中未写入的范围本身就是空洞, 忽略 --retrim" << endl;
         }
-
-        // 连接到 ROOT\Microsoft\Windows\Storage 命名空间
-        CComBSTR bstrNamespace(L"ROOT\\Microsoft\\Windows\\Storage");
-        hres = pLoc->ConnectServer(
-            bstrNamespace,
-            NULL,
-            NULL,
-            0,
-            NULL,
-            0,
-            0,
-            &pSvc
-        );
-
-        if (FAILED(hres)) {
-            wcerr << L"❌ 连接到 WMI Storage 命名空间失败. 错误代码: 0x" << hex << hres << endl;
-            pLoc.Release();  // ATL 智能指针会自动 Release，但可以显式调用
-            CoUninitialize();
-            return false;
-        }
-
-        // 设置代理安全级别
-        hres = CoSetProxyBlanket(
-            pSvc,
-            RPC_C_AUTHN_WINNT,
-            RPC_C_AUTHZ_NONE,
-            NULL,
-            RPC_C_AUTHN_LEVEL_CALL,
-            RPC_C_IMP_LEVEL_IMPERSONATE,
-            NULL,
-            EOAC_NONE
-        );
-
-        if (FAILED(hres)) {
-            wcerr << L"❌ 设置代理安全失败. 错误代码: 0x" << hex << hres << endl;
-            pSvc.Release();
-            pLoc.Release();
-            CoUninitialize();
-            return false;
-        }
-
-        initialized = true;
-        wcout << L"✓ WMI 连接成功" << endl;
-        return true;
+        return RunImageMode(args);
     }
 
-    void Cleanup() {
-        // ATL 智能指针会自动释放，但确保 COM 清理
-        pSvc.Release();
-        pLoc.Release();
-        if (initialized) {
-            CoUninitialize();
-            initialized = false;
-        }
+    // 稀疏流写入: 直接写目标文件/设备
+    if (!args.applyPath.empty()) {
+        return RunApplyMode(args);
     }
 
-    IWbemServices* GetServices() { return pSvc; }
-
-    // 执行 WMI 方法
-    bool ExecMethod(
-        const wstring& objectPath,
-        const wstring& methodName,
-        IWbemClassObject* pInParams,
-        CComPtr<IWbemClassObject>& pOutParams  // 使用 ATL 智能指针引用
-    ) {
-        CComBSTR bstrObjectPath(objectPath.c_str());
-        CComBSTR bstrMethodName(methodName.c_str());
-
-        HRESULT hres = pSvc->ExecMethod(
-            bstrObjectPath,
-            bstrMethodName,
-            0,
-            NULL,
-            pInParams,
-            &pOutParams,
-            NULL
-        );
-
-        if (FAILED(hres)) {
-            wcerr << L"❌ 执行方法 " << methodName << L" 失败. 错误代码: 0x" << hex << hres << endl;
-            return false;
-        }
-
-        // 检查返回值 - 使用 ATL CComVariant
-        if (pOutParams) {
-            CComVariant varReturnValue;
+    // 录制/回放要求调用顺序确定
+    if ((!args.recordPath.empty() || !args.replayPath.empty()) && args.concurrency > 1) {
+        wcerr << L"❌ 错误: --record/--replay 需要 --concurrency=1" << endl;
+        return 1;
+    }
 
-            hres = pOutParams->Get(CComBSTR(L"ReturnValue"), 0, &varReturnValue, 0, 0);
-            if (SUCCEEDED(hres)) {
-                LONG retVal = V_I4(&varReturnValue);
-                // CComVariant 析构时自动调用 VariantClear
+    // 选择存储提供程序
+    BackendFactory factory;
+    unique_ptr<SimulatedStorage> simStorage;
+    unique_ptr<CallReplayer> replayer;
 
-                if (retVal != 0) {
-                    wcerr << L"❌ 方法 " << methodName << L" 返回错误码: " << retVal << endl;
-                    return false;
-                }
-            }
+    if (!args.replayPath.empty()) {
+        replayer.reset(new CallReplayer());
+        if (!replayer->Load(args.replayPath)) {
+            return 1;
         }
-
-        return true;
+        factory = replayer->Factory();
+        banner << L"⏪ 回放调用日志: " << args.replayPath << endl;
     }
-
-    // 查询对象 - 返回 ATL 智能指针
-    CComPtr<IEnumWbemClassObject> Query(const wstring& query) {
-        CComPtr<IEnumWbemClassObject> pEnumerator;
-        CComBSTR bstrQuery(query.c_str());
-
-        HRESULT hres = pSvc->ExecQuery(
-            CComBSTR(L"WQL"),
-            bstrQuery,
-            WBEM_FLAG_FORWARD_ONLY | WBEM_FLAG_RETURN_IMMEDIATELY,
-            NULL,
-            &pEnumerator
-        );
-
-        if (FAILED(hres)) {
-            wcerr << L"❌ WMI 查询失败: " << query << endl;
-            return nullptr;
+    else if (args.simulate) {
+        simStorage.reset(new SimulatedStorage(args.simConfig));
+        factory = simStorage->Factory();
+        banner << L"🧪 使用模拟存储提供程序 (" << args.simConfig.diskCount << L" 块磁盘, "
+            << (args.simConfig.realTime ? L"真实时间" : L"虚拟时间") << L")" << endl;
+    }
+    else {
+#ifdef _WIN32
+        // 检查管理员权限
+        if (!CheckAdministrator()) {
+            wcerr << L"❌ 错误: 需要管理员权限运行此程序!" << endl;
+            wcerr << L"   请右键选择 '以管理员身份运行'" << endl;
+            return 1;
         }
 
-        return pEnumerator;
+        factory = []() { return CreateWmiBackend(); };
+#else
+        wcerr << L"❌ 错误: 当前平台不支持 WMI, 请使用 --sim 模拟提供程序" << endl;
+        return 1;
+#endif
     }
-};
-
-// ================================
-// 磁盘管理类 (ATL 版本)
-// ================================
 
-class DiskManager {
-private:
-    WMIManager& wmi;
-
-public:
-    DiskManager(WMIManager& wmiMgr) : wmi(wmiMgr) {}
-
-    // 枚举所有物理磁盘
-    void EnumerateDisks() {
-        wcout << L"\n📀 枚举系统磁盘..." << endl;
-        wcout << L"==========================================\n" << endl;
-
-        auto pEnumerator = wmi.Query(L"SELECT * FROM MSFT_Disk");
-        if (!pEnumerator) return;
-
-        CComPtr<IWbemClassObject> pclsObj;
-        ULONG uReturn = 0;
-
-        while (true) {
-            HRESULT hr = pEnumerator->Next(WBEM_INFINITE, 1, &pclsObj, &uReturn);
-            if (uReturn == 0) break;
-
-            CComVariant vtNumber, vtSize, vtModel, vtPartitionStyle, vtIsOffline;
-
-            pclsObj->Get(L"Number", 0, &vtNumber, 0, 0);
-            pclsObj->Get(L"Size", 0, &vtSize, 0, 0);
-            pclsObj->Get(L"Model", 0, &vtModel, 0, 0);
-            pclsObj->Get(L"PartitionStyle", 0, &vtPartitionStyle, 0, 0);
-            pclsObj->Get(L"IsOffline", 0, &vtIsOffline, 0, 0);
-
-            // ============================
-            // 修复：正确解析 Size 字段
-            // ============================
-            ULONGLONG sizeBytes = 0;
-
-            switch (vtSize.vt) {
-            case VT_UI8:
-                sizeBytes = vtSize.ullVal;
-                break;
-
-            case VT_I8:
-                sizeBytes = (ULONGLONG)vtSize.llVal;
-                break;
-
-            case VT_BSTR:
-                sizeBytes = _wcstoui64(vtSize.bstrVal, nullptr, 10);
-                break;
-
-            default:
-            {
-                // 强制转换为 UI8
-                CComVariant vtConverted;
-                if (SUCCEEDED(VariantChangeType(&vtConverted, &vtSize, 0, VT_UI8))) {
-                    sizeBytes = vtConverted.ullVal;
-                }
-                break;
-            }
-            }
-
-            // ============================
-            // 输出磁盘信息
-            // ============================
-            wcout << L"磁盘 " << V_I4(&vtNumber) << L": ";
-
-            if (vtModel.vt == VT_BSTR)
-                wcout << vtModel.bstrVal;
-
-            wcout << endl;
-
-            wcout << L"  大小: " << fixed << setprecision(2)
-                << (sizeBytes / (1024.0 * 1024.0 * 1024.0)) << L" GB" << endl;
-
-            wcout << L"  分区样式: ";
-            switch (V_I4(&vtPartitionStyle)) {
-            case 0: wcout << L"RAW (未初始化)"; break;
-            case 1: wcout << L"MBR"; break;
-            case 2: wcout << L"GPT"; break;
-            default: wcout << L"未知"; break;
-            }
-            wcout << endl;
-
-            wcout << L"  状态: " << (V_BOOL(&vtIsOffline) ? L"离线" : L"在线") << endl;
-            wcout << endl;
-
-            pclsObj.Release();
-        }
+    // 模拟提供程序与回放没有真实的卷可以测试
+    if (args.qualify.enabled && (args.simulate || replayer)) {
+        wcerr << L"⚠️  模拟/回放模式下没有真实卷, 跳过 --qualify" << endl;
+        args.qualify.enabled = false;
     }
 
-    bool InitializeAsGPT(int diskNumber) {
-        wcout << L"\n🔧 初始化磁盘 " << diskNumber << L" 为 GPT..." << endl;
-
-        wstringstream query;
-        query << L"SELECT * FROM MSFT_Disk WHERE Number = " << diskNumber;
-
-        auto pEnumerator = wmi.Query(query.str());
-        if (!pEnumerator) {
-            wcerr << L"❌ 查询磁盘失败" << endl;
-            return false;
-        }
-
-        CComPtr<IWbemClassObject> pDiskObj;
-        ULONG uReturn = 0;
-        HRESULT hr = pEnumerator->Next(WBEM_INFINITE, 1, &pDiskObj, &uReturn);
-
-        if (uReturn == 0) {
-            wcerr << L"❌ 未找到磁盘 " << diskNumber << endl;
-            return false;
-        }
+    CallRecorder recorder;
+    if (!args.recordPath.empty()) {
+        factory = recorder.Wrap(factory);
+    }
 
-        CComVariant vtPath;
-        pDiskObj->Get(L"__PATH", 0, &vtPath, 0, 0);
-        if (vtPath.vt != VT_BSTR) {
-            wcerr << L"❌ 无法获取磁盘对象路径 (__PATH)" << endl;
-            return false;
+    // 结束时保存录制日志, 并确认回放已完整匹配
+    auto finish = [&](int exitCode) {
+        if (!args.recordPath.empty()) {
+            if (!recorder.Save(args.recordPath)) return 1;
+            wcout << L"✓ 调用日志已写入 " << args.recordPath << endl;
         }
-        wstring diskPath = vtPath.bstrVal;
-
-        // Clear()
-        {
-            CComPtr<IWbemClassObject> pClass;
-            hr = wmi.GetServices()->GetObject(CComBSTR(L"MSFT_Disk"), 0, NULL, &pClass, NULL);
-
-            CComPtr<IWbemClassObject> pInParamsDef;
-            hr = pClass->GetMethod(L"Clear", 0, &pInParamsDef, NULL);
-
-            CComPtr<IWbemClassObject> pInParams;
-            pInParamsDef->SpawnInstance(0, &pInParams);
-
-            CComVariant varRemove(true);
-            pInParams->Put(L"RemoveData", 0, &varRemove, 0);
-
-            CComPtr<IWbemClassObject> pOutParams;
-            if (!wmi.ExecMethod(diskPath, L"Clear", pInParams, pOutParams)) {
-                wcerr << L"❌ Clear() 失败，无法继续初始化" << endl;
-                return false;
-            }
-
-            wcout << L"✓ Clear() 成功" << endl;
+        if (replayer && !replayer->Complete()) {
+            wcerr << L"❌ 回放与调用日志不一致 (不匹配 " << replayer->Mismatches()
+                << L" 处, 未回放调用 " << replayer->Remaining() << L" 次)" << endl;
+            return 1;
         }
+        return exitCode;
+    };
 
-        // Initialize()
-        {
-            CComPtr<IWbemClassObject> pClass;
-            hr = wmi.GetServices()->GetObject(CComBSTR(L"MSFT_Disk"), 0, NULL, &pClass, NULL);
-
-            CComPtr<IWbemClassObject> pInParamsDef;
-            hr = pClass->GetMethod(L"Initialize", 0, &pInParamsDef, NULL);
-
-            CComPtr<IWbemClassObject> pInParams;
-            pInParamsDef->SpawnInstance(0, &pInParams);
-
-            CComVariant varStyle(2L);
-            pInParams->Put(L"PartitionStyle", 0, &varStyle, 0);
-
-            CComPtr<IWbemClassObject> pOutParams;
-            if (!wmi.ExecMethod(diskPath, L"Initialize", pInParams, pOutParams)) {
-                wcerr << L"❌ Initialize() 失败" << endl;
-                return false;
-            }
-
-            wcout << L"✓ Initialize(GPT) 成功" << endl;
-        }
+    // 空间回收: 录制/回放要求调用顺序确定
+    auto retrim = [&](const vector<int>& diskNumbers) {
+        size_t workers = (!args.recordPath.empty() || replayer) ? 1 : (size_t)args.retrim.concurrency;
+        auto results = RunRetrim(factory, diskNumbers, workers);
+        return PrintRetrimReport(results, workers, !args.quiet);
+    };
 
-        return true;
+    // 对齐审计: 只读, 未指定 --disk 时审计全部磁盘
+    if (args.audit.enabled) {
+        size_t workers = (!args.recordPath.empty() || replayer) ? 1 : AUDIT_MAX_WORKERS;
+        auto disks = RunAudit(factory, args.diskNumbers, args.audit, workers);
+        return finish(FinishAudit(disks, args.audit, !args.quiet));
     }
 
-
-
-    // 创建 GPT 分区
-    bool CreatePartition(
-        int diskNumber,
-        ULONGLONG size,
-        const wstring& gptLabel,
-        const wstring& gptType,
-        ULONGLONG offset = 0
-    ) {
-        wcout << L"\n📝 在磁盘 " << diskNumber << L" 上创建分区..." << endl;
-        wcout << L"  大小: " << (size / (1024.0 * 1024.0 * 1024.0)) << L" GB" << endl;
-        wcout << L"  GPT 标签: " << gptLabel << endl;
-
-        wstring diskPath = L"\\\\.\\ROOT\\Microsoft\\Windows\\Storage:MSFT_Disk.Number=" + to_wstring(diskNumber);
-
-        // 获取 MSFT_Disk 类
-        CComPtr<IWbemClassObject> pClass;
-        HRESULT hres = wmi.GetServices()->GetObject(
-            CComBSTR(L"MSFT_Disk"),
-            0,
-            NULL,
-            &pClass,
-            NULL
-        );
-
-        if (FAILED(hres)) {
-            wcerr << L"❌ 获取 MSFT_Disk 类失败" << endl;
-            return false;
-        }
-
-        // 获取 CreatePartition 方法
-        CComPtr<IWbemClassObject> pInParamsDefinition;
-        hres = pClass->GetMethod(CComBSTR(L"CreatePartition"), 0, &pInParamsDefinition, NULL);
-        if (FAILED(hres)) {
-            wcerr << L"❌ 获取 CreatePartition 方法失败" << endl;
-            return false;
+    // 列出磁盘
+    if (args.listDisks) {
+        WMIManager wmi;
+        if (!wmi.Initialize(factory())) {
+            wcerr << L"❌ WMI 初始化失败" << endl;
+            return 1;
         }
 
-        // 创建方法参数实例
-        CComPtr<IWbemClassObject> pInParams;
-        pInParamsDefinition->SpawnInstance(0, &pInParams);
-
-        // 设置参数 - 使用 ATL CComVariant，简化 VARIANT 操作
-
-        // Size (UINT64)
-        CComVariant varSize((__int64)size);
-        varSize.vt = VT_UI8;  // 确保类型为 UINT64
-        varSize.ullVal = size;
-        pInParams->Put(CComBSTR(L"Size"), 0, &varSize, 0);
+        DiskManager diskMgr(wmi);
+        diskMgr.EnumerateDisks();
 
-        // Offset (如果指定)
-        if (offset > 0) {
-            CComVariant varOffset((__int64)offset);
-            varOffset.vt = VT_UI8;
-            varOffset.ullVal = offset;
-            pInParams->Put(CComBSTR(L"Offset"), 0, &varOffset, 0);
+        if (args.stats) {
+            PrintCallStats(wmi.Stats(), 0, 0);
         }
+        return finish(0);
+    }
 
-        // GptType (分区类型 GUID) - 使用 CComBSTR
-        wstring guid = PartitionTypeToGuid(gptType);
-        CComBSTR bstrGuid(guid.c_str());
-        CComVariant varGuid(bstrGuid);
-        pInParams->Put(CComBSTR(L"GptType"), 0, &varGuid, 0);
-
-        // UseMaximumSize = false
-        CComVariant varUseMaxSize(false);
-        pInParams->Put(CComBSTR(L"UseMaximumSize"), 0, &varUseMaxSize, 0);
-
-        // 执行方法
-        CComPtr<IWbemClassObject> pOutParams;
-        bool result = wmi.ExecMethod(diskPath, L"CreatePartition", pInParams, pOutParams);
-
-        // 获取创建的分区对象
-        wstring partitionPath;
-        if (result && pOutParams) {
-            CComVariant varPartition;
-            hres = pOutParams->Get(CComBSTR(L"CreatedPartition"), 0, &varPartition, 0, 0);
-
-            if (SUCCEEDED(hres) && varPartition.vt == VT_UNKNOWN) {
-                CComPtr<IWbemClassObject> pPartition;
-                varPartition.punkVal->QueryInterface(IID_IWbemClassObject, (void**)&pPartition);
-
-                if (pPartition) {
-                    CComVariant varPath;
-                    pPartition->Get(CComBSTR(L"__PATH"), 0, &varPath, 0, 0);
-                    if (varPath.vt == VT_BSTR) {
-                        partitionPath = V_BSTR(&varPath);
-                        wcout << L"✓ 分区创建成功" << endl;
+    // 验证磁盘编号
+    if (args.diskNumbers.empty()) {
+        wcerr << L"❌ 错误: 必须指定磁盘编号 (--disk=N)" << endl;
+        PrintUsage();
+        return 1;
+    }
 
-                        // 设置 GPT 分区标签
-                        if (!gptLabel.empty()) {
-                            SetGptPartitionName(partitionPath, gptLabel);
-                        }
-                    }
-                }
+    wcout << L"目标磁盘: ";
+    for (size_t i = 0; i < args.diskNumbers.size() && i < 16; i++) {
+        wcout << (i ? L"," : L"") << args.diskNumbers[i];
+    }
+    if (args.diskNumbers.size() > 16) {
+        wcout << L",... (共 " << args.diskNumbers.size() << L" 块)";
+    }
+    wcout << endl;
+
+    // 健康预检: 在任何 Clear / CreatePartition 之前排除不合格的磁盘
+    if (args.preflight.enabled) {
+        PreflightProbe probe;
+        if (simStorage) {
+            SimulatedStorage* storage = simStorage.get();
+            probe.read = [storage](int diskNumber, ULONGLONG, int samples, vector<double>& latenciesMs) {
+                return storage->ProbeRead(diskNumber, samples, latenciesMs);
+            };
+            probe.simulated = true;
+        }
+        else if (replayer) {
+            probe.skipReason = L"回放模式下不访问磁盘";
+        }
+        else {
+            probe.read = ProbePhysicalDrive;
+        }
+
+        // 录制/回放要求调用顺序确定
+        size_t workers = (!args.recordPath.empty() || replayer) ? 1 : PREFLIGHT_MAX_WORKERS;
+        auto preflight = RunPreflight(factory, args.diskNumbers, args.preflight, probe, workers);
+        PrintPreflightReport(preflight, args.preflight, !args.quiet);
+
+        if (args.preflight.exclude) {
+            args.diskNumbers.clear();
+            for (const auto& result : preflight) {
+                if (result.Passed()) args.diskNumbers.push_back(result.diskNumber);
+            }
+            if (args.diskNumbers.empty()) {
+                wcerr << L"❌ 没有通过预检的磁盘" << endl;
+                return finish(1);
+            }
+            if (args.diskNumbers.size() < preflight.size()) {
+                wcout << L"⚠️  已排除 " << (preflight.size() - args.diskNumbers.size()) << L" 块未通过预检的磁盘, 继续处理其余 "
+                    << args.diskNumbers.size() << L" 块" << endl;
             }
         }
-
-        return result;
+        wcout << endl;
     }
 
-    // 设置 GPT 分区名称
-    bool SetGptPartitionName(const wstring& partitionPath, const wstring& gptLabel) {
-        wcout << L"  设置 GPT 分区名称: " << gptLabel << endl;
-
-        // 获取分区对象
-        CComPtr<IWbemClassObject> pPartition;
-        CComBSTR bstrPartitionPath(partitionPath.c_str());
-
-        HRESULT hres = wmi.GetServices()->GetObject(
-            bstrPartitionPath,
-            0,
-            NULL,
-            &pPartition,
-            NULL
-        );
-
-        if (FAILED(hres)) {
-            wcerr << L"❌ 获取分区对象失败" << endl;
-            return false;
-        }
-
-        // 设置 GptPartitionName 属性 - 使用 CComBSTR 和 CComVariant
-        CComBSTR bstrLabel(gptLabel.c_str());
-        CComVariant varLabel(bstrLabel);
-
-        hres = pPartition->Put(CComBSTR(L"GptPartitionName"), 0, &varLabel, 0);
-
-        if (FAILED(hres)) {
-            wcerr << L"❌ 设置 GptPartitionName 属性失败" << endl;
-            return false;
-        }
-
-        // 提交更改
-        hres = wmi.GetServices()->PutInstance(pPartition, WBEM_FLAG_UPDATE_ONLY, NULL, NULL);
-
-        if (FAILED(hres)) {
-            wcerr << L"❌ 提交 GPT 分区名称失败. 错误代码: 0x" << hex << hres << endl;
-            return false;
-        }
-
-        wcout << L"  ✓ GPT 分区名称设置成功" << endl;
-        return true;
+    // 只回收已有的卷: 不修改分区, 无需确认
+    if (args.retrim.enabled && args.partitions.empty() && args.resizes.empty() && !args.pool.enabled) {
+        return finish(retrim(args.diskNumbers) ? 0 : 1);
     }
 
-    // 格式化分区
-    bool FormatPartition(
-        int diskNumber,
-        int partitionNumber,
-        const wstring& fileSystem,
-        const wstring& volumeLabel,
-        bool quickFormat
-    ) {
-        wcout << L"\n💾 格式化分区 (磁盘 " << diskNumber
-            << L", 分区 " << partitionNumber << L")..." << endl;
-        wcout << L"  文件系统: " << fileSystem << endl;
-        wcout << L"  卷标: " << volumeLabel << endl;
-        wcout << L"  快速格式化: " << (quickFormat ? L"是" : L"否") << endl;
-
-        // 构建查询获取分区
-        wstringstream query;
-        query << L"SELECT * FROM MSFT_Partition WHERE DiskNumber = " << diskNumber
-            << L" AND PartitionNumber = " << partitionNumber;
-
-        auto pEnumerator = wmi.Query(query.str());
-        if (!pEnumerator) return false;
-
-        CComPtr<IWbemClassObject> pPartition;
-        ULONG uReturn = 0;
-        HRESULT hr = pEnumerator->Next(WBEM_INFINITE, 1, &pPartition, &uReturn);
-
-        if (uReturn == 0) {
-            wcerr << L"❌ 未找到指定分区" << endl;
-            return false;
+    // 模拟提供程序与回放不会触碰真实磁盘, 无需确认
+    if (!args.simulate && !replayer) {
+        if (args.partitions.empty() && !args.resizes.empty()) {
+            wcout << L"⚠️  警告: 此操作将调整已有分区的大小 (收缩需确保卷内数据在新范围内)!" << endl;
         }
-
-        // 获取分区路径 - 使用 CComVariant
-        CComVariant varPath;
-        pPartition->Get(CComBSTR(L"__PATH"), 0, &varPath, 0, 0);
-        wstring partitionPath = V_BSTR(&varPath);
-
-        // 获取 MSFT_Partition 类
-        CComPtr<IWbemClassObject> pClass;
-        HRESULT hres = wmi.GetServices()->GetObject(
-            CComBSTR(L"MSFT_Partition"),
-            0,
-            NULL,
-            &pClass,
-            NULL
-        );
-
-        if (FAILED(hres)) {
-            wcerr << L"❌ 获取 MSFT_Partition 类失败" << endl;
-            return false;
-        }
-
-        // 获取 Format 方法 (Windows 10+)
-        CComPtr<IWbemClassObject> pInParamsDefinition;
-        hres = pClass->GetMethod(CComBSTR(L"Format"), 0, &pInParamsDefinition, NULL);
-
-        if (FAILED(hres)) {
-            wcerr << L"❌ 获取 Format 方法失败" << endl;
-            return false;
-        }
-
-        // 创建方法参数实例
-        CComPtr<IWbemClassObject> pInParams;
-        pInParamsDefinition->SpawnInstance(0, &pInParams);
-
-        // FileSystem (NTFS=7, FAT32=5, exFAT=8, ReFS=9)
-        auto fsIt = FILE_SYSTEMS.find(fileSystem);
-        if (fsIt != FILE_SYSTEMS.end()) {
-            CComVariant varFS(fsIt->second);
-            pInParams->Put(CComBSTR(L"FileSystem"), 0, &varFS, 0);
+        else {
+            wcout << L"⚠️  警告: 此操作将清除磁盘上的所有数据!" << endl;
         }
+        wcout << L"按 'Y' 继续, 其他键取消: ";
 
-        // FileSystemLabel - 使用 CComBSTR
-        if (!volumeLabel.empty()) {
-            CComBSTR bstrLabel(volumeLabel.c_str());
-            CComVariant varLabel(bstrLabel);
-            pInParams->Put(CComBSTR(L"FileSystemLabel"), 0, &varLabel, 0);
-        }
-
-        // Full (快速格式化 = false, 完全格式化 = true)
-        CComVariant varFull(!quickFormat);
-        pInParams->Put(CComBSTR(L"Full"), 0, &varFull, 0);
-
-        // 执行格式化
-        wcout << L"  正在格式化，请稍候..." << endl;
-
-        CComPtr<IWbemClassObject> pOutParams;
-        bool result = wmi.ExecMethod(partitionPath, L"Format", pInParams, pOutParams);
-
-        if (result) {
-            wcout << L"✓ 分区格式化成功" << endl;
+        wchar_t confirm;
+        wcin >> confirm;
 
-            // 等待格式化完成并分配盘符
-            this_thread::sleep_for(chrono::seconds(2));
-
-            // 查询新的盘符
-            GetPartitionDriveLetter(diskNumber, partitionNumber);
+        if (towupper(confirm) != L'Y') {
+            wcout << L"操作已取消" << endl;
+            return 0;
         }
-
-        return result;
     }
 
-    // 获取分区盘符
-    void GetPartitionDriveLetter(int diskNumber, int partitionNumber) {
-        wstringstream query;
-        query << L"SELECT * FROM MSFT_Partition WHERE DiskNumber = " << diskNumber
-            << L" AND PartitionNumber = " << partitionNumber;
-
-        auto pEnumerator = wmi.Query(query.str());
-        if (!pEnumerator) return;
-
-        CComPtr<IWbemClassObject> pPartition;
-        ULONG uReturn = 0;
-        HRESULT hr = pEnumerator->Next(WBEM_INFINITE, 1, &pPartition, &uReturn);
-
-        if (uReturn == 0) return;
-
-        // 使用 CComVariant
-        CComVariant varLetter;
-        pPartition->Get(CComBSTR(L"DriveLetter"), 0, &varLetter, 0, 0);
-
-        if (varLetter.vt == VT_I2 && V_I2(&varLetter) != 0) {
-            wcout << L"  分配盘符: " << (wchar_t)V_I2(&varLetter) << L":\\" << endl;
-        }
+    // 存储空间条带卷: 之后的分区与格式化作用于新建的虚拟磁盘
+    PooledDisk pooled;
+    if (args.pool.enabled && !ProvisionPool(factory, args, pooled)) {
+        return finish(1);
     }
-};
-
-// ================================
-// 命令行参数解析
-// ================================
-
-struct CommandLineArgs {
-    int diskNumber = -1;
-    bool initGpt = false;
-
-    struct PartitionSpec {
-        ULONGLONG size = 0;
-        ULONGLONG offset = 0;
-        wstring label;
-        wstring type = L"basic";
-    };
-    vector<PartitionSpec> partitions;
-
-    struct FormatSpec {
-        wstring fileSystem = L"ntfs";
-        wstring volumeLabel;
-        bool quickFormat = true;
-    };
-    vector<FormatSpec> formats;
-
-    bool listDisks = false;
-};
-
-CommandLineArgs ParseCommandLine(int argc, wchar_t* argv[]) {
-    CommandLineArgs args;
-
-    for (int i = 1; i < argc; i++) {
-        wstring arg = argv[i];
-
-        // -------------------------
-        // --disk=N
-        // -------------------------
-        if (arg.find(L"--disk=") == 0) {
-            args.diskNumber = stoi(arg.substr(7));
-        }
-
-        // -------------------------
-        // --gpt
-        // -------------------------
-        else if (arg == L"--gpt") {
-            args.initGpt = true;
-        }
-
-        // -------------------------
-        // --list
-        // -------------------------
-        else if (arg == L"--list") {
-            args.listDisks = true;
-        }
-
-        // -------------------------
-        // --create-part [=] params
-        // -------------------------
-        else if (arg == L"--create-part") {
-            // 形式：--create-part size=5G,label=Data
-            if (i + 1 < argc) {
-                wstring params = argv[++i];
-                auto paramMap = ParseParams(params);
-
-                CommandLineArgs::PartitionSpec spec;
-
-                if (paramMap.count(L"size"))
-                    spec.size = ParseSizeString(paramMap[L"size"]);
-
-                if (paramMap.count(L"offset"))
-                    spec.offset = ParseSizeString(paramMap[L"offset"]);
-
-                if (paramMap.count(L"label"))
-                    spec.label = paramMap[L"label"];
-
-                if (paramMap.count(L"type"))
-                    spec.type = paramMap[L"type"];
-
-                args.partitions.push_back(spec);
-            }
-        }
-        else if (arg.find(L"--create-part=") == 0) {
-            // 形式：--create-part=size=5G,label=Data
-            wstring params = arg.substr(14);
-            auto paramMap = ParseParams(params);
-
-            CommandLineArgs::PartitionSpec spec;
-
-            if (paramMap.count(L"size"))
-                spec.size = ParseSizeString(paramMap[L"size"]);
-
-            if (paramMap.count(L"offset"))
-                spec.offset = ParseSizeString(paramMap[L"offset"]);
-
-            if (paramMap.count(L"label"))
-                spec.label = paramMap[L"label"];
 
-            if (paramMap.count(L"type"))
-                spec.type = paramMap[L"type"];
+    auto results = ProvisionDisks(factory, args);
 
-            args.partitions.push_back(spec);
-        }
-
-        // -------------------------
-        // --format [=] params
-        // -------------------------
-        else if (arg == L"--format") {
-            if (i + 1 < argc) {
-                wstring params = argv[++i];
-                auto paramMap = ParseParams(params);
-
-                CommandLineArgs::FormatSpec spec;
-
-                if (paramMap.count(L"fs"))
-                    spec.fileSystem = paramMap[L"fs"];
-
-                if (paramMap.count(L"vol"))
-                    spec.volumeLabel = paramMap[L"vol"];
-
-                if (paramMap.count(L"quick"))
-                    spec.quickFormat = (paramMap[L"quick"] == L"1" || paramMap[L"quick"] == L"true");
+    if (results.size() > 1 || args.simulate) {
+        PrintProvisionSummary(results, args.concurrency, args.partitions.size());
+    }
 
-                args.formats.push_back(spec);
-            }
-        }
-        else if (arg.find(L"--format=") == 0) {
-            wstring params = arg.substr(9);
-            auto paramMap = ParseParams(params);
+    if (args.guidPaths) {
+        PrintProvisionVolumes(results);
+    }
 
-            CommandLineArgs::FormatSpec spec;
+    if (args.qualify.enabled) {
+        PrintProvisionQualify(results);
+    }
 
-            if (paramMap.count(L"fs"))
-                spec.fileSystem = paramMap[L"fs"];
+    if (args.stats) {
+        PrintProvisionCallStats(results, args.partitions.size());
+    }
 
-            if (paramMap.count(L"vol"))
-                spec.volumeLabel = paramMap[L"vol"];
+    bool allSucceeded = all_of(results.begin(), results.end(),
+        [](const ProvisionResult& r) { return r.success; });
 
-            if (paramMap.count(L"quick"))
-                spec.quickFormat = (paramMap[L"quick"] == L"1" || paramMap[L"quick"] == L"true");
+    // 虚拟磁盘配置失败时不留下半成品的池
+    if (args.pool.enabled && !allSucceeded) {
+        RollbackPool(factory, args, pooled);
+    }
 
-            args.formats.push_back(spec);
+    // 格式化后回收: 只处理配置成功的磁盘
+    if (args.retrim.enabled) {
+        vector<int> provisioned;
+        for (const auto& result : results) {
+            if (result.success) provisioned.push_back(result.diskNumber);
         }
+        if (!provisioned.empty() && !retrim(provisioned)) allSucceeded = false;
     }
 
-    return args;
-}
-
+    if (!allSucceeded) {
+        return finish(1);
+    }
 
-// ================================
-// 主程序
-// ================================
+    wcout << L"\n✓ 所有操作完成!" << endl;
 
-void PrintUsage() {
-    wcout << L"\n磁盘分区与格式化工具 - Windows Storage Management API (ATL 版本)\n" << endl;
-    wcout << L"用法:" << endl;
-    wcout << L"  DiskPartitionTool.exe [选项]\n" << endl;
-    wcout << L"选项:" << endl;
-    wcout << L"  --list                          列出所有磁盘" << endl;
-    wcout << L"  --disk=<N>                      指定磁盘编号" << endl;
-    wcout << L"  --gpt                           初始化为 GPT 分区表" << endl;
-    wcout << L"  --create-part <参数>            创建分区" << endl;
-    wcout << L"      参数: size=<大小>,label=<标签>,type=<类型>,offset=<偏移>" << endl;
-    wcout << L"      大小支持: 10G, 500M, 1T 等" << endl;
-    wcout << L"      类型: basic, efi, msr 或完整 GUID" << endl;
-    wcout << L"  --format <参数>                 格式化分区" << endl;
-    wcout << L"      参数: fs=<文件系统>,vol=<卷标>,quick=<0|1>" << endl;
-    wcout << L"      文件系统: ntfs, fat32, exfat, refs\n" << endl;
-    wcout << L"示例:" << endl;
-    wcout << L"  列出磁盘:" << endl;
-    wcout << L"    DiskPartitionTool.exe --list\n" << endl;
-    wcout << L"  完整操作示例:" << endl;
-    wcout << L"    DiskPartitionTool.exe --disk=1 --gpt \\" << endl;
-    wcout << L"      --create-part size=100M,label=EFI,type=efi \\" << endl;
-    wcout << L"      --format fs=fat32,quick=1 \\" << endl;
-    wcout << L"      --create-part size=50G,label=Windows,type=basic \\" << endl;
-    wcout << L"      --format fs=ntfs,vol=System,quick=1\n" << endl;
-    wcout << L"⚠️  警告: 此工具会清除磁盘数据，请谨慎使用!" << endl;
+    // WMIManager 析构函数会释放后端会话
+    return finish(0);
 }
 
+#ifdef _WIN32
 int wmain(int argc, wchar_t* argv[]) {
     // 设置控制台输出为 UTF-16
     _setmode(_fileno(stdout), _O_U16TEXT);
     _setmode(_fileno(stderr), _O_U16TEXT);
 
-    wcout << L"╔════════════════════════════════════════════════════════╗" << endl;
-    wcout << L"║   Windows Storage Management API 磁盘工具 (ATL版)     ║" << endl;
-    wcout << L"║   版本: 2.0 | 需要管理员权限                          ║" << endl;
-    wcout << L"╚════════════════════════════════════════════════════════╝\n" << endl;
-
-    if (argc < 2) {
-        PrintUsage();
-        return 1;
-    }
-
-    // 检查管理员权限
-    BOOL isAdmin = FALSE;
-    PSID adminGroup = NULL;
-    SID_IDENTIFIER_AUTHORITY ntAuthority = SECURITY_NT_AUTHORITY;
-
-    if (AllocateAndInitializeSid(&ntAuthority, 2, SECURITY_BUILTIN_DOMAIN_RID,
-        DOMAIN_ALIAS_RID_ADMINS, 0, 0, 0, 0, 0, 0, &adminGroup)) {
-        CheckTokenMembership(NULL, adminGroup, &isAdmin);
-        FreeSid(adminGroup);
-    }
-
-    if (!isAdmin) {
-        wcerr << L"❌ 错误: 需要管理员权限运行此程序!" << endl;
-        wcerr << L"   请右键选择 '以管理员身份运行'" << endl;
-        return 1;
-    }
-
-    // 解析命令行
-    auto args = ParseCommandLine(argc, argv);
-
-    // 初始化 WMI
-    WMIManager wmi;
-    if (!wmi.Initialize()) {
-        wcerr << L"❌ WMI 初始化失败" << endl;
-        return 1;
-    }
-
-    DiskManager diskMgr(wmi);
-
-    // 列出磁盘
-    if (args.listDisks) {
-        diskMgr.EnumerateDisks();
-        return 0;
-    }
-
-    // 验证磁盘编号
-    if (args.diskNumber < 0) {
-        wcerr << L"❌ 错误: 必须指定磁盘编号 (--disk=N)" << endl;
-        PrintUsage();
-        return 1;
-    }
-
-    wcout << L"目标磁盘: " << args.diskNumber << endl;
-    wcout << L"⚠️  警告: 此操作将清除磁盘上的所有数据!" << endl;
-    wcout << L"按 'Y' 继续, 其他键取消: ";
-
-    wchar_t confirm;
-    wcin >> confirm;
-
-    if (towupper(confirm) != L'Y') {
-        wcout << L"操作已取消" << endl;
-        return 0;
+    return RunTool(argc, argv);
+}
+#else
+int main(int argc, char* argv[]) {
+    // 宽字符输出需要 UTF-8 locale
+    setlocale(LC_ALL, "");
+    if (strcmp(nl_langinfo(CODESET), "UTF-8") != 0) {
+        setlocale(LC_ALL, "C.UTF-8");
     }
 
-    // 初始化为 GPT
-    if (args.initGpt) {
-        //if (!diskMgr.InitializeAsGPT(args.diskNumber)) {
-        //    wcerr << L"❌ GPT 初始化失败" << endl;
-        //    return 1;
-        //}
+    vector<wstring> wideArgs;
+    for (int i = 0; i < argc; i++) {
+        wideArgs.push_back(FromUtf8(argv[i]));
     }
 
-    // 创建分区并格式化
-    int partitionNumber = 1; // GPT 分区从 1 开始
-
-    for (size_t i = 0; i < args.partitions.size(); i++) {
-        auto& partSpec = args.partitions[i];
-
-        // 创建分区
-        if (!diskMgr.CreatePartition(
-            args.diskNumber,
-            partSpec.size,
-            partSpec.label,
-            partSpec.type,
-            partSpec.offset
-        )) {
-            wcerr << L"❌ 分区创建失败" << endl;
-            return 1;
-        }
-
-        // 如果有对应的格式化参数
-        if (i < args.formats.size()) {
-            auto& fmtSpec = args.formats[i];
-
-            // 等待分区就绪
-            this_thread::sleep_for(chrono::seconds(1));
-
-            if (!diskMgr.FormatPartition(
-                args.diskNumber,
-                partitionNumber,
-                fmtSpec.fileSystem,
-                fmtSpec.volumeLabel,
-                fmtSpec.quickFormat
-            )) {
-                wcerr << L"❌ 分区格式化失败" << endl;
-                return 1;
-            }
-        }
-
-        partitionNumber++;
+    vector<wchar_t*> wideArgv;
+    for (auto& arg : wideArgs) {
+        wideArgv.push_back(&arg[0]);
     }
 
-    wcout << L"\n✓ 所有操作完成!" << endl;
-
-    // ATL 智能指针会自动清理，WMIManager 析构函数会调用 Cleanup()
-    return 0;
-}
\ No newline at end of file
+    return RunTool(argc, wideArgv.data());
+}
+#endif
@@ -0,0 +1,1385 @@
+﻿#include "ntfs.h"
+
+#include "byte_order.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// ================================
+// 磁盘结构常量
+// ================================
+
+// 属性类型
+static const uint32_t AT_STANDARD_INFORMATION = 0x10;
+static const uint32_t AT_FILE_NAME = 0x30;
+static const uint32_t AT_VOLUME_NAME = 0x60;
+static const uint32_t AT_VOLUME_INFORMATION = 0x70;
+static const uint32_t AT_DATA = 0x80;
+static const uint32_t AT_INDEX_ROOT = 0x90;
+static const uint32_t AT_INDEX_ALLOCATION = 0xA0;
+static const uint32_t AT_BITMAP = 0xB0;
+static const uint32_t AT_END = 0xFFFFFFFF;
+
+// MFT 记录标志
+static const uint16_t MFT_RECORD_IN_USE = 0x0001;
+static const uint16_t MFT_RECORD_IS_DIRECTORY = 0x0002;
+static const uint16_t MFT_RECORD_IN_EXTEND = 0x0004;
+static const uint16_t MFT_RECORD_IS_VIEW_INDEX = 0x0008;
+
+// 文件属性
+static const uint32_t FILE_ATTR_HIDDEN = 0x00000002;
+static const uint32_t FILE_ATTR_SYSTEM = 0x00000004;
+static const uint32_t FILE_ATTR_ARCHIVE = 0x00000020;
+static const uint32_t FILE_ATTR_DIRECTORY = 0x10000000;        // 仅用于 $FILE_NAME: 有 $I30 索引
+static const uint32_t FILE_ATTR_VIEW_INDEX = 0x20000000;
+
+// 索引排序规则
+static const uint32_t COLLATION_FILE_NAME = 0x01;
+static const uint32_t COLLATION_NTOFS_ULONG = 0x10;
+static const uint32_t COLLATION_NTOFS_SID = 0x11;
+static const uint32_t COLLATION_NTOFS_SECURITY_HASH = 0x12;
+static const uint32_t COLLATION_NTOFS_ULONGS = 0x13;
+
+// 索引项标志
+static const uint16_t INDEX_ENTRY_NODE = 0x01;
+static const uint16_t INDEX_ENTRY_END = 0x02;
+static const uint8_t LARGE_INDEX = 0x01;
+
+static const uint8_t FILE_NAME_WIN32_AND_DOS = 3;
+
+// 系统文件的 MFT 记录号
+enum : uint32_t {
+    FILE_MFT = 0,
+    FILE_MFTMIRR = 1,
+    FILE_LOGFILE = 2,
+    FILE_VOLUME = 3,
+    FILE_ATTRDEF = 4,
+    FILE_ROOT = 5,
+    FILE_BITMAP = 6,
+    FILE_BOOT = 7,
+    FILE_BADCLUS = 8,
+    FILE_SECURE = 9,
+    FILE_UPCASE = 10,
+    FILE_EXTEND = 11,
+    FILE_FIRST_USER = 16,
+    FILE_QUOTA = 24,
+    FILE_OBJID = 25,
+    FILE_REPARSE = 26,
+    FILE_SYSTEM_COUNT = 27,
+};
+
+static const unsigned NTFS_BLOCK_SIZE = 512;                   // 更新序列 (fixup) 的步长
+static const unsigned INITIAL_MFT_RECORDS = 64;
+static const unsigned BOOT_FILE_BYTES = 8192;
+static const unsigned ATTRDEF_BYTES = 0xA00;
+static const unsigned UPCASE_CHARS = 65536;
+static const ULONGLONG SDS_MIRROR_OFFSET = 0x40000;            // $SDS 每 256 KiB 后紧跟一份镜像
+static const unsigned LOG_PAGE_BYTES = 4096;
+static const unsigned MAX_LABEL_CHARS = 32;
+static const ULONGLONG MAX_CLUSTER_BYTES = 2 * 1024 * 1024;
+static const uint16_t UPDATE_SEQUENCE_NUMBER = 1;
+
+static const uint32_t SECURITY_ID_SYSTEM = 0x100;              // 系统文件
+static const uint32_t SECURITY_ID_ROOT = 0x101;                // 根目录 (可继承的默认权限)
+static const uint32_t QUOTA_DEFAULTS_ID = 1;
+static const uint32_t QUOTA_ADMINS_ID = 0x100;
+
+static size_t Align8(size_t n) { return (n + 7) & ~(size_t)7; }
+
+static ULONGLONG CeilDiv(ULONGLONG n, ULONGLONG d) { return (n + d - 1) / d; }
+
+static unsigned Log2(ULONGLONG n) {
+    unsigned shift = 0;
+    while ((1ULL << shift) < n) shift++;
+    return shift;
+}
+
+static uint64_t FileReference(uint32_t recordNumber, uint16_t sequence) {
+    return recordNumber | ((uint64_t)sequence << 48);
+}
+
+// 系统文件记录的序列号: 0 号为 1, 1-23 等于记录号 (16-23 保留未用), $Extend 下的文件为 1
+static uint16_t SystemSequence(uint32_t recordNumber) {
+    if (recordNumber == FILE_MFT || recordNumber >= FILE_QUOTA) return 1;
+    return (uint16_t)recordNumber;
+}
+
+static bool SystemRecordInUse(uint32_t recordNumber) {
+    return recordNumber < FILE_FIRST_USER || (recordNumber >= FILE_QUOTA && recordNumber < FILE_SYSTEM_COUNT);
+}
+
+static uint16_t SystemRecordFlags(uint32_t recordNumber) {
+    if (!SystemRecordInUse(recordNumber)) return 0;
+    switch (recordNumber) {
+    case FILE_ROOT:
+    case FILE_EXTEND:
+        return MFT_RECORD_IN_USE | MFT_RECORD_IS_DIRECTORY;
+    case FILE_SECURE:
+        return MFT_RECORD_IN_USE | MFT_RECORD_IS_VIEW_INDEX;
+    case FILE_QUOTA:
+    case FILE_OBJID:
+    case FILE_REPARSE:
+        return MFT_RECORD_IN_USE | MFT_RECORD_IN_EXTEND | MFT_RECORD_IS_VIEW_INDEX;
+    default:
+        return MFT_RECORD_IN_USE;
+    }
+}
+
+static u16string ToUtf16(const wstring& text) {
+    u16string out;
+    for (wchar_t c : text) {
+        uint32_t cp = (uint32_t)c;
+        if (cp > 0xFFFF) {
+            cp -= 0x10000;
+            out.push_back((char16_t)(0xD800 + (cp >> 10)));
+            out.push_back((char16_t)(0xDC00 + (cp & 0x3FF)));
+        }
+        else {
+            out.push_back((char16_t)cp);
+        }
+    }
+    return out;
+}
+
+// ================================
+// $UpCase
+// ================================
+
+// 与 Windows 7 及之后格式化写入的表一致 (ntfs-3g 以相同规则生成)
+static vector<uint16_t> BuildUpcaseTable() {
+    // [first, last) 区间内的字符加 delta
+    static const struct { uint16_t first, last; int delta; } shifts[] = {
+        { 0x0061, 0x007b, -32 }, { 0x00e0, 0x00f7, -32 }, { 0x00f8, 0x00ff, -32 },
+        { 0x0256, 0x0258, -205 }, { 0x028a, 0x028c, -217 }, { 0x037b, 0x037e, 130 },
+        { 0x03ac, 0x03ad, -38 }, { 0x03ad, 0x03b0, -37 }, { 0x03b1, 0x03c2, -32 },
+        { 0x03c2, 0x03c3, -31 }, { 0x03c3, 0x03cc, -32 }, { 0x03cc, 0x03cd, -64 },
+        { 0x03cd, 0x03cf, -63 }, { 0x0430, 0x0450, -32 }, { 0x0450, 0x0460, -80 },
+        { 0x0561, 0x0587, -48 }, { 0x1f00, 0x1f08, 8 }, { 0x1f10, 0x1f16, 8 },
+        { 0x1f20, 0x1f28, 8 }, { 0x1f30, 0x1f38, 8 }, { 0x1f40, 0x1f46, 8 },
+        { 0x1f51, 0x1f52, 8 }, { 0x1f53, 0x1f54, 8 }, { 0x1f55, 0x1f56, 8 },
+        { 0x1f57, 0x1f58, 8 }, { 0x1f60, 0x1f68, 8 }, { 0x1f70, 0x1f72, 74 },
+        { 0x1f72, 0x1f76, 86 }, { 0x1f76, 0x1f78, 100 }, { 0x1f78, 0x1f7a, 128 },
+        { 0x1f7a, 0x1f7c, 112 }, { 0x1f7c, 0x1f7e, 126 }, { 0x1f80, 0x1f88, 8 },
+        { 0x1f90, 0x1f98, 8 }, { 0x1fa0, 0x1fa8, 8 }, { 0x1fb0, 0x1fb2, 8 },
+        { 0x1fb3, 0x1fb4, 9 }, { 0x1fd0, 0x1fd2, 8 }, { 0x1fe0, 0x1fe2, 8 },
+        { 0x1fe5, 0x1fe6, 7 }, { 0x2170, 0x2180, -16 }, { 0x24d0, 0x24ea, -26 },
+        { 0x2c30, 0x2c5f, -48 }, { 0x2d00, 0x2d26, -7264 }, { 0xff41, 0xff5b, -32 },
+    };
+    // [first, last) 区间内大小写成对交替排列: 偶数偏移为大写, 其后为小写
+    static const struct { uint16_t first, last; } pairs[] = {
+        { 0x0100, 0x012f }, { 0x0132, 0x0137 }, { 0x0139, 0x0149 }, { 0x014a, 0x0178 },
+        { 0x0179, 0x017e }, { 0x01a0, 0x01a6 }, { 0x01b3, 0x01b7 }, { 0x01cd, 0x01dd },
+        { 0x01de, 0x01ef }, { 0x01f4, 0x01f5 }, { 0x01f8, 0x01f9 }, { 0x01fa, 0x0220 },
+        { 0x0222, 0x0234 }, { 0x023b, 0x023c }, { 0x0241, 0x0242 }, { 0x0246, 0x024f },
+        { 0x03d8, 0x03ef }, { 0x03f7, 0x03f8 }, { 0x03fa, 0x03fb }, { 0x0460, 0x0481 },
+        { 0x048a, 0x04bf }, { 0x04c1, 0x04c4 }, { 0x04c5, 0x04c8 }, { 0x04c9, 0x04ce },
+        { 0x04ec, 0x04ed }, { 0x04d0, 0x04eb }, { 0x04ee, 0x04f5 }, { 0x04f6, 0x0513 },
+        { 0x1e00, 0x1e95 }, { 0x1ea0, 0x1ef9 }, { 0x2183, 0x2184 }, { 0x2c60, 0x2c61 },
+        { 0x2c67, 0x2c6c }, { 0x2c75, 0x2c76 }, { 0x2c80, 0x2ce3 },
+    };
+    // 单个字符: 小写 -> 大写
+    static const struct { uint16_t lower, upper; } singles[] = {
+        { 0x00ff, 0x0178 }, { 0x0180, 0x0243 }, { 0x0183, 0x0182 }, { 0x0185, 0x0184 },
+        { 0x0188, 0x0187 }, { 0x018c, 0x018b }, { 0x0192, 0x0191 }, { 0x0195, 0x01f6 },
+        { 0x0199, 0x0198 }, { 0x019a, 0x023d }, { 0x019e, 0x0220 }, { 0x01a8, 0x01a7 },
+        { 0x01ad, 0x01ac }, { 0x01b0, 0x01af }, { 0x01b9, 0x01b8 }, { 0x01bd, 0x01bc },
+        { 0x01bf, 0x01f7 }, { 0x01c6, 0x01c4 }, { 0x01c9, 0x01c7 }, { 0x01cc, 0x01ca },
+        { 0x01dd, 0x018e }, { 0x01f3, 0x01f1 }, { 0x2c65, 0x023a }, { 0x2c66, 0x023e },
+        { 0x0253, 0x0181 }, { 0x0254, 0x0186 }, { 0x0259, 0x018f }, { 0x025b, 0x0190 },
+        { 0x0260, 0x0193 }, { 0x0263, 0x0194 }, { 0x0268, 0x0197 }, { 0x0269, 0x0196 },
+        { 0x026b, 0x2c62 }, { 0x026f, 0x019c }, { 0x0272, 0x019d }, { 0x0275, 0x019f },
+        { 0x027d, 0x2c64 }, { 0x0280, 0x01a6 }, { 0x0283, 0x01a9 }, { 0x0288, 0x01ae },
+        { 0x0289, 0x0244 }, { 0x028c, 0x0245 }, { 0x0292, 0x01b7 }, { 0x03ac, 0x0386 },
+        { 0x03ad, 0x0388 }, { 0x03ae, 0x0389 }, { 0x03af, 0x038a }, { 0x03cc, 0x038c },
+        { 0x03cd, 0x038e }, { 0x03ce, 0x038f }, { 0x04cf, 0x04c0 }, { 0x1d7d, 0x2c63 },
+        { 0x1fb3, 0x1fbc }, { 0x1fc3, 0x1fcc }, { 0x1fe5, 0x1fec }, { 0x1ff3, 0x1ffc },
+        { 0x214e, 0x2132 }, { 0x2184, 0x2183 }, { 0x2c61, 0x2c60 }, { 0x2c68, 0x2c67 },
+        { 0x2c6a, 0x2c69 }, { 0x2c6c, 0x2c6b }, { 0x2c76, 0x2c75 }, { 0x2c81, 0x2c80 },
+    };
+
+    vector<uint16_t> table(UPCASE_CHARS);
+    for (unsigned c = 0; c < UPCASE_CHARS; c++) table[c] = (uint16_t)c;
+
+    for (const auto& s : shifts) {
+        for (unsigned c = s.first; c < s.last; c++) table[c] = (uint16_t)(c + s.delta);
+    }
+    for (const auto& p : pairs) {
+        for (unsigned c = p.first; c < p.last; c += 2) table[c + 1] = (uint16_t)c;
+    }
+    for (const auto& s : singles) {
+        table[s.lower] = s.upper;
+    }
+    return table;
+}
+
+static const vector<uint16_t>& UpcaseTable() {
+    static const vector<uint16_t> table = BuildUpcaseTable();
+    return table;
+}
+
+// $I30 的排序规则 (COLLATION_FILE_NAME): 先按大写比较, 相同时按原字符比较
+static bool FileNameLess(const u16string& a, const u16string& b) {
+    const auto& upcase = UpcaseTable();
+    size_t n = min(a.size(), b.size());
+    for (size_t i = 0; i < n; i++) {
+        uint16_t x = upcase[a[i]];
+        uint16_t y = upcase[b[i]];
+        if (x != y) return x < y;
+    }
+    if (a.size() != b.size()) return a.size() < b.size();
+    return a < b;
+}
+
+// ================================
+// 更新序列与 MFT 记录
+// ================================
+
+// 把每 512 字节的最后两个字节移入更新序列数组, 原位置写入更新序列号
+static void ApplyFixups(uint8_t* block, size_t length, size_t usaOffset, uint16_t usn = UPDATE_SEQUENCE_NUMBER) {
+    PutLE16(block + usaOffset, usn);
+    for (size_t i = 0; i < length / NTFS_BLOCK_SIZE; i++) {
+        uint8_t* tail = block + (i + 1) * NTFS_BLOCK_SIZE - 2;
+        memcpy(block + usaOffset + 2 + 2 * i, tail, 2);
+        PutLE16(tail, usn);
+    }
+}
+
+// ApplyFixups 的逆操作; 某个 512 字节块的末尾与更新序列号不符 (写入不完整) 时返回 false
+static bool RemoveFixups(uint8_t* block, size_t length) {
+    const size_t usaOffset = GetLE16(block + 0x04);
+    const size_t usaCount = GetLE16(block + 0x06);
+    if (usaCount != length / NTFS_BLOCK_SIZE + 1 || usaOffset + 2 * usaCount > length) return false;
+
+    const uint16_t usn = GetLE16(block + usaOffset);
+    for (size_t i = 0; i + 1 < usaCount; i++) {
+        uint8_t* tail = block + (i + 1) * NTFS_BLOCK_SIZE - 2;
+        if (GetLE16(tail) != usn) return false;
+        memcpy(tail, block + usaOffset + 2 + 2 * i, 2);
+    }
+    return true;
+}
+
+// 非常驻属性的单个连续区段; sparse 时为空洞 (没有对应的簇)
+struct ClusterRun {
+    ULONGLONG lcn = 0;
+    ULONGLONG clusters = 0;
+    bool sparse = false;
+};
+
+// 整数按补码所需的最少字节数
+static unsigned SignedBytes(long long v) {
+    unsigned n = 1;
+    while (n < 8) {
+        long long limit = 1LL << (8 * n - 1);
+        if (v >= -limit && v < limit) break;
+        n++;
+    }
+    return n;
+}
+
+// mapping pairs: 每个区段为头字节 (偏移字节数 << 4 | 长度字节数), 长度, 相对上一个区段的 LCN 偏移; 以 0 结束。
+// 稀疏区段没有偏移字段
+static vector<uint8_t> EncodeRuns(const vector<ClusterRun>& runs) {
+    vector<uint8_t> pairs;
+    ULONGLONG previous = 0;
+    for (const auto& run : runs) {
+        long long delta = (long long)(run.lcn - previous);
+        unsigned lengthBytes = SignedBytes((long long)run.clusters);
+        unsigned lcnBytes = run.sparse ? 0 : SignedBytes(delta);
+        pairs.push_back((uint8_t)(lcnBytes << 4 | lengthBytes));
+        for (unsigned i = 0; i < lengthBytes; i++) pairs.push_back((uint8_t)(run.clusters >> (8 * i)));
+        for (unsigned i = 0; i < lcnBytes; i++) pairs.push_back((uint8_t)((ULONGLONG)delta >> (8 * i)));
+        if (!run.sparse) previous = run.lcn;
+    }
+    pairs.push_back(0);
+    return pairs;
+}
+
+// EncodeRuns 的逆操作; 缺少结束字节或字段越界时返回 false
+static bool DecodeRuns(const uint8_t* pairs, size_t length, vector<ClusterRun>& runs) {
+    runs.clear();
+    long long lcn = 0;
+    size_t pos = 0;
+    while (pos < length && pairs[pos] != 0) {
+        const unsigned lengthBytes = pairs[pos] & 0x0F;
+        const unsigned lcnBytes = pairs[pos] >> 4;
+        if (lengthBytes == 0 || lengthBytes > 8 || lcnBytes > 8 || pos + 1 + lengthBytes + lcnBytes > length) return false;
+
+        ClusterRun run;
+        for (unsigned i = 0; i < lengthBytes; i++) run.clusters |= (ULONGLONG)pairs[pos + 1 + i] << (8 * i);
+        if (lcnBytes == 0) {
+            run.sparse = true;
+        }
+        else {
+            ULONGLONG delta = 0;
+            for (unsigned i = 0; i < lcnBytes; i++) delta |= (ULONGLONG)pairs[pos + 1 + lengthBytes + i] << (8 * i);
+            if (lcnBytes < 8 && (delta >> (8 * lcnBytes - 1)) != 0) delta |= ~0ULL << (8 * lcnBytes);
+            lcn += (long long)delta;
+            if (lcn < 0) return false;
+            run.lcn = (ULONGLONG)lcn;
+        }
+        if (run.clusters == 0) return false;
+
+        runs.push_back(run);
+        pos += 1 + lengthBytes + lcnBytes;
+    }
+    return pos < length;
+}
+
+class FileRecord {
+public:
+    FileRecord(unsigned recordBytes, uint32_t recordNumber, uint16_t sequence, uint16_t flags)
+        : data(recordBytes, 0)
+    {
+        const unsigned usaCount = recordBytes / NTFS_BLOCK_SIZE + 1;
+        memcpy(&data[0], "FILE", 4);
+        PutLE16(&data[0x04], 0x30);                            // 更新序列数组偏移
+        PutLE16(&data[0x06], (uint16_t)usaCount);
+        PutLE16(&data[0x10], sequence);
+        PutLE16(&data[0x16], flags);
+        PutLE32(&data[0x1C], recordBytes);
+        PutLE32(&data[0x2C], recordNumber);
+
+        used = Align8(0x30 + 2 * usaCount);
+        PutLE16(&data[0x14], (uint16_t)used);                  // 第一个属性
+    }
+
+    void SetLinkCount(uint16_t count) { PutLE16(&data[0x12], count); }
+
+    void AddResident(uint32_t type, const u16string& name, const vector<uint8_t>& value, bool indexed = false) {
+        size_t valueOffset = Align8(0x18 + 2 * name.size());
+        uint8_t* a = Append(type, name, 0x18, Align8(valueOffset + value.size()), false);
+        if (!a) return;
+
+        PutLE32(a + 0x10, (uint32_t)value.size());
+        PutLE16(a + 0x14, (uint16_t)valueOffset);
+        a[0x16] = indexed ? 1 : 0;
+        if (!value.empty()) memcpy(a + valueOffset, value.data(), value.size());
+    }
+
+    void AddNonResident(uint32_t type, const u16string& name, const ClusterRun& run,
+        ULONGLONG allocatedBytes, ULONGLONG dataBytes) {
+        vector<uint8_t> pairs = EncodeRuns({ run });
+        size_t pairsOffset = Align8(0x40 + 2 * name.size());
+        uint8_t* a = Append(type, name, 0x40, Align8(pairsOffset + pairs.size()), true);
+        if (!a) return;
+
+        PutLE64(a + 0x10, 0);                                  // 起始 VCN
+        PutLE64(a + 0x18, run.clusters - 1);                   // 结束 VCN
+        PutLE16(a + 0x20, (uint16_t)pairsOffset);
+        PutLE64(a + 0x28, allocatedBytes);
+        PutLE64(a + 0x30, dataBytes);
+        PutLE64(a + 0x38, dataBytes);                          // 已初始化大小
+        memcpy(a + pairsOffset, pairs.data(), pairs.size());
+    }
+
+    // 写入属性结束标记与更新序列; 属性超出记录大小时返回 false
+    bool Seal(vector<uint8_t>& out) {
+        if (overflow || used + 8 > data.size()) return false;
+
+        PutLE32(&data[used], AT_END);
+        used += 8;
+        PutLE32(&data[0x18], (uint32_t)used);
+        PutLE16(&data[0x28], nextAttributeId);
+        ApplyFixups(data.data(), data.size(), 0x30);
+        out = data;
+        return true;
+    }
+
+private:
+    uint8_t* Append(uint32_t type, const u16string& name, size_t nameOffset, size_t length, bool nonResident) {
+        if (used + length + 8 > data.size()) {
+            overflow = true;
+            return nullptr;
+        }
+
+        uint8_t* a = &data[used];
+        PutLE32(a + 0x00, type);
+        PutLE32(a + 0x04, (uint32_t)length);
+        a[0x08] = nonResident ? 1 : 0;
+        a[0x09] = (uint8_t)name.size();
+        PutLE16(a + 0x0A, (uint16_t)nameOffset);
+        PutLE16(a + 0x0E, nextAttributeId++);
+        for (size_t i = 0; i < name.size(); i++) PutLE16(a + nameOffset + 2 * i, name[i]);
+
+        used += length;
+        return a;
+    }
+
+    vector<uint8_t> data;
+    size_t used = 0;
+    uint16_t nextAttributeId = 0;
+    bool overflow = false;
+};
+
+// ================================
+// 属性值
+// ================================
+
+static vector<uint8_t> StandardInformation(ULONGLONG time, uint32_t fileAttributes, uint32_t securityId) {
+    vector<uint8_t> v(0x48, 0);
+    for (int i = 0; i < 4; i++) PutLE64(&v[8 * i], time);     // 创建/修改/MFT 修改/访问
+    PutLE32(&v[0x20], fileAttributes);
+    PutLE32(&v[0x34], securityId);
+    return v;
+}
+
+static vector<uint8_t> FileNameValue(uint64_t parent, const u16string& name, ULONGLONG time,
+    ULONGLONG allocatedBytes, ULONGLONG dataBytes, uint32_t fileAttributes) {
+    vector<uint8_t> v(0x42 + 2 * name.size(), 0);
+    PutLE64(&v[0x00], parent);
+    for (int i = 0; i < 4; i++) PutLE64(&v[0x08 + 8 * i], time);
+    PutLE64(&v[0x28], allocatedBytes);
+    PutLE64(&v[0x30], dataBytes);
+    PutLE32(&v[0x38], fileAttributes);
+    v[0x40] = (uint8_t)name.size();
+    v[0x41] = FILE_NAME_WIN32_AND_DOS;
+    for (size_t i = 0; i < name.size(); i++) PutLE16(&v[0x42 + 2 * i], name[i]);
+    return v;
+}
+
+// $I30 索引项: 文件引用 + $FILE_NAME 作为键
+static vector<uint8_t> FileNameIndexEntry(uint64_t fileReference, const vector<uint8_t>& fileName) {
+    size_t length = Align8(0x10 + fileName.size());
+    vector<uint8_t> e(length, 0);
+    PutLE64(&e[0x00], fileReference);
+    PutLE16(&e[0x08], (uint16_t)length);
+    PutLE16(&e[0x0A], (uint16_t)fileName.size());
+    memcpy(&e[0x10], fileName.data(), fileName.size());
+    return e;
+}
+
+// 视图索引项 ($SDH/$SII/$O/$Q): 键后紧跟数据
+static vector<uint8_t> ViewIndexEntry(const vector<uint8_t>& key, const vector<uint8_t>& value,
+    const vector<uint8_t>& padding = {}) {
+    size_t dataOffset = 0x10 + key.size();
+    size_t length = Align8(dataOffset + value.size() + padding.size());
+    vector<uint8_t> e(length, 0);
+    PutLE16(&e[0x00], (uint16_t)dataOffset);
+    PutLE16(&e[0x02], (uint16_t)value.size());
+    PutLE16(&e[0x08], (uint16_t)length);
+    PutLE16(&e[0x0A], (uint16_t)key.size());
+    memcpy(&e[0x10], key.data(), key.size());
+    memcpy(&e[dataOffset], value.data(), value.size());
+    if (!padding.empty()) memcpy(&e[dataOffset + value.size()], padding.data(), padding.size());
+    return e;
+}
+
+// 结束项; 有子节点时指向 VCN 0 的索引块
+static vector<uint8_t> EndIndexEntry(bool hasChild) {
+    vector<uint8_t> e(hasChild ? 0x18 : 0x10, 0);
+    PutLE16(&e[0x08], (uint16_t)e.size());
+    PutLE16(&e[0x0C], (uint16_t)(INDEX_ENTRY_END | (hasChild ? INDEX_ENTRY_NODE : 0)));
+    return e;
+}
+
+static vector<uint8_t> JoinEntries(const vector<vector<uint8_t>>& entries) {
+    vector<uint8_t> out;
+    for (const auto& e : entries) out.insert(out.end(), e.begin(), e.end());
+    return out;
+}
+
+// 索引块大小以簇计; 簇大于索引块时以 512 字节为单位
+static uint8_t IndexBlockUnits(const NtfsGeometry& geo) {
+    unsigned unit = geo.clusterBytes <= geo.indexBlockBytes ? geo.clusterBytes : NTFS_BLOCK_SIZE;
+    return (uint8_t)(geo.indexBlockBytes / unit);
+}
+
+static vector<uint8_t> IndexRootValue(const NtfsGeometry& geo, uint32_t indexedType, uint32_t collation,
+    const vector<uint8_t>& entries, bool large) {
+    vector<uint8_t> v(0x20 + entries.size(), 0);
+    PutLE32(&v[0x00], indexedType);
+    PutLE32(&v[0x04], collation);
+    PutLE32(&v[0x08], geo.indexBlockBytes);
+    v[0x0C] = IndexBlockUnits(geo);
+    PutLE32(&v[0x10], 0x10);                                   // 索引头: 项偏移 (相对索引头)
+    PutLE32(&v[0x14], (uint32_t)(0x10 + entries.size()));      // 已用
+    PutLE32(&v[0x18], (uint32_t)(0x10 + entries.size()));      // 已分配
+    v[0x1C] = large ? LARGE_INDEX : 0;
+    memcpy(&v[0x20], entries.data(), entries.size());
+    return v;
+}
+
+static vector<uint8_t> IndexBlock(const NtfsGeometry& geo, const vector<uint8_t>& entries) {
+    const unsigned usaCount = geo.indexBlockBytes / NTFS_BLOCK_SIZE + 1;
+    const size_t entriesOffset = Align8(0x28 + 2 * usaCount) - 0x18;
+
+    vector<uint8_t> block(geo.indexBlockBytes, 0);
+    memcpy(&block[0], "INDX", 4);
+    PutLE16(&block[0x04], 0x28);
+    PutLE16(&block[0x06], (uint16_t)usaCount);
+    PutLE32(&block[0x18], (uint32_t)entriesOffset);
+    PutLE32(&block[0x1C], (uint32_t)(entriesOffset + entries.size()));
+    PutLE32(&block[0x20], geo.indexBlockBytes - 0x18);
+    memcpy(&block[0x18 + entriesOffset], entries.data(), entries.size());
+    ApplyFixups(block.data(), block.size(), 0x28);
+    return block;
+}
+
+// ================================
+// 安全描述符与 $Secure
+// ================================
+
+static vector<uint8_t> MakeSid(uint8_t authority, initializer_list<uint32_t> subAuthorities) {
+    vector<uint8_t> sid(8 + 4 * subAuthorities.size(), 0);
+    sid[0] = 1;
+    sid[1] = (uint8_t)subAuthorities.size();
+    sid[7] = authority;
+    size_t offset = 8;
+    for (uint32_t sub : subAuthorities) {
+        PutLE32(&sid[offset], sub);
+        offset += 4;
+    }
+    return sid;
+}
+
+static const vector<uint8_t>& SidAdministrators() { static const auto sid = MakeSid(5, { 32, 544 }); return sid; }
+static const vector<uint8_t>& SidLocalSystem() { static const auto sid = MakeSid(5, { 18 }); return sid; }
+static const vector<uint8_t>& SidAuthenticatedUsers() { static const auto sid = MakeSid(5, { 11 }); return sid; }
+static const vector<uint8_t>& SidUsers() { static const auto sid = MakeSid(5, { 32, 545 }); return sid; }
+
+struct AccessAllowed {
+    uint8_t flags;
+    uint32_t mask;
+    const vector<uint8_t>& sid;
+};
+
+static const uint32_t FILE_ALL_ACCESS = 0x001F01FF;
+static const uint32_t FILE_MODIFY = 0x001301BF;
+static const uint32_t FILE_READ_EXECUTE = 0x001200A9;
+static const uint8_t OBJECT_AND_CONTAINER_INHERIT = 0x03;
+
+// 自相对格式: 头 (20 字节), DACL, 所有者, 组; 一次分配最终大小后按偏移填写
+static vector<uint8_t> MakeSecurityDescriptor(const vector<uint8_t>& owner, const vector<uint8_t>& group,
+    const vector<AccessAllowed>& aces) {
+    const size_t SD_HEADER_BYTES = 20;
+    const size_t ACL_HEADER_BYTES = 8;
+
+    size_t aclBytes = ACL_HEADER_BYTES;
+    for (const auto& ace : aces) aclBytes += 8 + ace.sid.size();
+
+    const size_t aclOffset = SD_HEADER_BYTES;
+    const size_t ownerOffset = aclOffset + aclBytes;
+    const size_t groupOffset = ownerOffset + owner.size();
+    vector<uint8_t> sd(groupOffset + group.size(), 0);
+
+    sd[0] = 1;
+    PutLE16(&sd[2], 0x8004);                                   // SE_SELF_RELATIVE | SE_DACL_PRESENT
+    PutLE32(&sd[4], (uint32_t)ownerOffset);
+    PutLE32(&sd[8], (uint32_t)groupOffset);
+    PutLE32(&sd[16], (uint32_t)aclOffset);
+
+    uint8_t* acl = &sd[aclOffset];
+    acl[0] = 2;
+    PutLE16(acl + 2, (uint16_t)aclBytes);
+    PutLE16(acl + 4, (uint16_t)aces.size());
+
+    size_t offset = ACL_HEADER_BYTES;
+    for (const auto& ace : aces) {
+        acl[offset + 1] = ace.flags;                           // 类型 0: ACCESS_ALLOWED
+        PutLE16(acl + offset + 2, (uint16_t)(8 + ace.sid.size()));
+        PutLE32(acl + offset + 4, ace.mask);
+        memcpy(acl + offset + 8, ace.sid.data(), ace.sid.size());
+        offset += 8 + ace.sid.size();
+    }
+
+    memcpy(&sd[ownerOffset], owner.data(), owner.size());
+    memcpy(&sd[groupOffset], group.data(), group.size());
+    return sd;
+}
+
+static uint32_t SecurityHash(const vector<uint8_t>& sd) {
+    uint32_t hash = 0;
+    for (size_t i = 0; i + 4 <= sd.size(); i += 4) {
+        hash = GetLE32(&sd[i]) + ((hash << 3) | (hash >> 29));
+    }
+    return hash;
+}
+
+struct SecurityEntry {
+    uint32_t id = 0;
+    uint32_t hash = 0;
+    ULONGLONG offset = 0;              // 在 $SDS 中的偏移
+    vector<uint8_t> header;            // $SDS 项头 (20 字节), 也是 $SII/$SDH 的数据
+};
+
+struct SecureStream {
+    vector<uint8_t> primary;           // $SDS 的第一段, 镜像位于 +256 KiB
+    vector<SecurityEntry> entries;
+
+    ULONGLONG DataBytes() const { return SDS_MIRROR_OFFSET + primary.size(); }
+};
+
+static SecureStream BuildSecureStream() {
+    const vector<vector<uint8_t>> descriptors = {
+        // 系统文件: O:BA G:BA D:(A;;FA;;;SY)(A;;FA;;;BA)
+        MakeSecurityDescriptor(SidAdministrators(), SidAdministrators(), {
+            { 0, FILE_ALL_ACCESS, SidLocalSystem() },
+            { 0, FILE_ALL_ACCESS, SidAdministrators() },
+        }),
+        // 根目录: 管理员与 SYSTEM 完全控制, 经过身份验证的用户修改, 用户读取与执行
+        MakeSecurityDescriptor(SidAdministrators(), SidLocalSystem(), {
+            { OBJECT_AND_CONTAINER_INHERIT, FILE_ALL_ACCESS, SidAdministrators() },
+            { OBJECT_AND_CONTAINER_INHERIT, FILE_ALL_ACCESS, SidLocalSystem() },
+            { OBJECT_AND_CONTAINER_INHERIT, FILE_MODIFY, SidAuthenticatedUsers() },
+            { OBJECT_AND_CONTAINER_INHERIT, FILE_READ_EXECUTE, SidUsers() },
+        }),
+    };
+
+    SecureStream stream;
+    uint32_t id = SECURITY_ID_SYSTEM;
+    for (const auto& sd : descriptors) {
+        SecurityEntry entry;
+        entry.id = id++;
+        entry.hash = SecurityHash(sd);
+        entry.offset = (stream.primary.size() + 15) & ~(size_t)15;
+        entry.header.resize(20);
+        PutLE32(&entry.header[0], entry.hash);
+        PutLE32(&entry.header[4], entry.id);
+        PutLE64(&entry.header[8], entry.offset);
+        PutLE32(&entry.header[16], (uint32_t)(20 + sd.size()));
+
+        stream.primary.resize((size_t)entry.offset, 0);
+        stream.primary.insert(stream.primary.end(), entry.header.begin(), entry.header.end());
+        stream.primary.insert(stream.primary.end(), sd.begin(), sd.end());
+        stream.entries.push_back(entry);
+    }
+    return stream;
+}
+
+// ================================
+// $AttrDef
+// ================================
+
+static vector<uint8_t> BuildAttrDef() {
+    static const uint32_t INDEXABLE = 0x02;
+    static const uint32_t ALWAYS_RESIDENT = 0x40;
+    static const uint32_t MAY_BE_NONRESIDENT = 0x80;
+    static const ULONGLONG UNLIMITED = ~0ULL;
+
+    static const struct {
+        const char* name;
+        uint32_t type;
+        uint32_t flags;
+        ULONGLONG minSize;
+        ULONGLONG maxSize;
+    } definitions[] = {
+        { "$STANDARD_INFORMATION", 0x10, ALWAYS_RESIDENT, 0x30, 0x48 },
+        { "$ATTRIBUTE_LIST", 0x20, MAY_BE_NONRESIDENT, 0, UNLIMITED },
+        { "$FILE_NAME", 0x30, ALWAYS_RESIDENT | INDEXABLE, 0x44, 0x242 },
+        { "$OBJECT_ID", 0x40, ALWAYS_RESIDENT, 0, 0x100 },
+        { "$SECURITY_DESCRIPTOR", 0x50, MAY_BE_NONRESIDENT, 0, UNLIMITED },
+        { "$VOLUME_NAME", 0x60, ALWAYS_RESIDENT, 2, 0x100 },
+        { "$VOLUME_INFORMATION", 0x70, ALWAYS_RESIDENT, 0xC, 0xC },
+        { "$DATA", 0x80, 0, 0, UNLIMITED },
+        { "$INDEX_ROOT", 0x90, ALWAYS_RESIDENT, 0, UNLIMITED },
+        { "$INDEX_ALLOCATION", 0xA0, MAY_BE_NONRESIDENT, 0, UNLIMITED },
+        { "$BITMAP", 0xB0, MAY_BE_NONRESIDENT, 0, UNLIMITED },
+        { "$REPARSE_POINT", 0xC0, MAY_BE_NONRESIDENT, 0, 0x4000 },
+        { "$EA_INFORMATION", 0xD0, ALWAYS_RESIDENT, 8, 8 },
+        { "$EA", 0xE0, 0, 0, 0x10000 },
+        { "$LOGGED_UTILITY_STREAM", 0x100, MAY_BE_NONRESIDENT, 0, 0x10000 },
+    };
+
+    vector<uint8_t> table(ATTRDEF_BYTES, 0);
+    size_t offset = 0;
+    for (const auto& def : definitions) {
+        uint8_t* e = &table[offset];
+        for (size_t i = 0; def.name[i]; i++) PutLE16(e + 2 * i, (uint16_t)def.name[i]);
+        PutLE32(e + 0x80, def.type);
+        PutLE32(e + 0x88, def.type == AT_FILE_NAME ? COLLATION_FILE_NAME : 0);
+        PutLE32(e + 0x8C, def.flags);
+        PutLE64(e + 0x90, def.minSize);
+        PutLE64(e + 0x98, def.maxSize);
+        offset += 0xA0;
+    }
+    return table;
+}
+
+// ================================
+// 几何参数
+// ================================
+
+// $LogFile 大小 (与 Windows/mkntfs 的容量表一致), 对齐到簇与日志页
+static ULONGLONG LogFileBytes(ULONGLONG volumeBytes, unsigned clusterBytes) {
+    const ULONGLONG MiB = 1024ULL * 1024;
+    ULONGLONG size;
+    if (volumeBytes < 2 * MiB) size = 256 * 1024;
+    else if (volumeBytes < 4 * 1000 * 1000) size = 512 * 1024;
+    else if (volumeBytes <= 200 * MiB) size = 2 * MiB;
+    else if (volumeBytes >= 12 * 1024 * MiB) size = 64 * MiB;
+    else size = volumeBytes / 200;
+
+    ULONGLONG align = max<ULONGLONG>(clusterBytes, LOG_PAGE_BYTES);
+    return CeilDiv(size, align) * align;
+}
+
+bool PlanNtfs(ULONGLONG partitionSize, unsigned sectorSize, ULONGLONG clusterBytes, NtfsGeometry& geometry) {
+    geometry = NtfsGeometry();
+    geometry.bytesPerSector = sectorSize;
+    geometry.mftRecordBytes = max(1024u, sectorSize);
+    geometry.indexBlockBytes = max(4096u, sectorSize);
+
+    // 最后一个扇区留给备份引导扇区
+    if (partitionSize / sectorSize < 2) {
+        wcerr << L"❌ 分区太小, 无法格式化为 NTFS" << endl;
+        return false;
+    }
+    geometry.totalSectors = partitionSize / sectorSize - 1;
+
+    if (clusterBytes == 0) {
+        // Windows 的容量表: 4 KiB 起, 簇数超过 2^32 时加倍
+        clusterBytes = max<ULONGLONG>(4096, sectorSize);
+        while (clusterBytes < MAX_CLUSTER_BYTES && geometry.totalSectors * sectorSize / clusterBytes > 0xFFFFFFFFULL) {
+            clusterBytes *= 2;
+        }
+    }
+    if (clusterBytes < sectorSize || clusterBytes > MAX_CLUSTER_BYTES || (clusterBytes & (clusterBytes - 1)) != 0) {
+        wcerr << L"❌ 无效的 NTFS 簇大小: " << clusterBytes << L" (需为 " << sectorSize << L" - 2M 之间的 2 的幂)" << endl;
+        return false;
+    }
+    geometry.clusterBytes = (unsigned)clusterBytes;
+
+    geometry.clusterCount = geometry.totalSectors / geometry.SectorsPerCluster();
+    if (geometry.clusterCount > 0xFFFFFFFFULL) {
+        wcerr << L"❌ NTFS 簇数 " << geometry.clusterCount << L" 超过 2^32, 请增大簇大小" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+// 引导扇区中的 "每记录簇数": 小于一簇时为 -log2(字节数)
+static uint8_t ClustersPerField(unsigned bytes, unsigned clusterBytes) {
+    if (bytes >= clusterBytes) return (uint8_t)(bytes / clusterBytes);
+    return (uint8_t)(256 - Log2(bytes));
+}
+
+// ================================
+// 格式化
+// ================================
+
+namespace {
+
+// 顺序分配的元数据区段
+struct NtfsAllocation {
+    ClusterRun boot, mftMirr, logFile, attrDef, rootIndex, bitmap, upcase, secure, mftBitmap, mft;
+    ULONGLONG nextLcn = 0;
+
+    ClusterRun Take(ULONGLONG bytes, unsigned clusterBytes) {
+        ClusterRun run;
+        run.lcn = nextLcn;
+        run.clusters = CeilDiv(bytes, clusterBytes);
+        nextLcn += run.clusters;
+        return run;
+    }
+};
+
+}
+
+bool FormatNtfs(
+    const DiskLayout& layout,
+    const PlannedPartition& partition,
+    uint64_t volumeSerial,
+    ExtentList& extents
+) {
+    NtfsGeometry geo;
+    if (!PlanNtfs(partition.size, layout.sectorSize, partition.formatSpec.allocationUnitSize, geo)) {
+        return false;
+    }
+
+    const ULONGLONG base = partition.offset;
+    const unsigned cs = geo.clusterBytes;
+    const unsigned rs = geo.mftRecordBytes;
+    const ULONGLONG T = layout.formatTime;
+
+    // ---------- 元数据大小 ----------
+    const unsigned mirrorRecords = max(4u, cs / rs);
+    const ULONGLONG mftRecords = CeilDiv(max<ULONGLONG>(INITIAL_MFT_RECORDS, mirrorRecords) * rs, cs) * cs / rs;
+    const ULONGLONG mftBitmapBytes = Align8((size_t)CeilDiv(mftRecords, 8));
+    const ULONGLONG bitmapBytes = Align8((size_t)CeilDiv(geo.clusterCount, 8));
+    const ULONGLONG logBytes = LogFileBytes(geo.totalSectors * geo.bytesPerSector, cs);
+    const SecureStream secure = BuildSecureStream();
+
+    NtfsAllocation alloc;
+    alloc.boot = alloc.Take(BOOT_FILE_BYTES, cs);
+    alloc.mftMirr = alloc.Take((ULONGLONG)mirrorRecords * rs, cs);
+    alloc.logFile = alloc.Take(logBytes, cs);
+    alloc.attrDef = alloc.Take(ATTRDEF_BYTES, cs);
+    alloc.rootIndex = alloc.Take(geo.indexBlockBytes, cs);
+    alloc.bitmap = alloc.Take(bitmapBytes, cs);
+    alloc.upcase = alloc.Take(UPCASE_CHARS * 2, cs);
+    alloc.secure = alloc.Take(secure.DataBytes(), cs);
+    alloc.mftBitmap = alloc.Take(mftBitmapBytes, cs);
+    alloc.mft = alloc.Take(mftRecords * rs, cs);              // 最后分配, 其后空闲以便原地增长
+
+    if (alloc.nextLcn >= geo.clusterCount) {
+        wcerr << L"❌ 分区太小, 无法格式化为 NTFS (元数据需要 " << FormatBytes(alloc.nextLcn * cs) << L")" << endl;
+        return false;
+    }
+
+    auto allocated = [&](const ClusterRun& run) { return run.clusters * cs; };
+
+    // ---------- 系统文件记录 ----------
+    const uint64_t rootRef = FileReference(FILE_ROOT, SystemSequence(FILE_ROOT));
+    const uint64_t extendRef = FileReference(FILE_EXTEND, SystemSequence(FILE_EXTEND));
+    const uint32_t systemAttributes = FILE_ATTR_HIDDEN | FILE_ATTR_SYSTEM;
+    const uint32_t extendViewAttributes = systemAttributes | FILE_ATTR_ARCHIVE | FILE_ATTR_VIEW_INDEX;
+
+    // 27 号之后是已格式化的空记录
+    vector<FileRecord> records;
+    for (uint32_t i = 0; i < mftRecords; i++) {
+        records.emplace_back(rs, i, i < FILE_SYSTEM_COUNT ? SystemSequence(i) : 0, SystemRecordFlags(i));
+    }
+
+    // 目录项: 名称与 $FILE_NAME (同一份值写入记录与父目录索引)
+    struct NamedFile {
+        uint32_t recordNumber;
+        u16string name;
+        vector<uint8_t> fileName;
+    };
+    vector<NamedFile> rootFiles;
+    vector<NamedFile> extendFiles;
+
+    auto addName = [&](uint32_t number, const u16string& name, uint64_t parent,
+        ULONGLONG allocatedBytes, ULONGLONG dataBytes, uint32_t attributes) {
+        FileRecord& r = records[number];
+        r.AddResident(AT_STANDARD_INFORMATION, u"", StandardInformation(T, attributes & ~FILE_ATTR_DIRECTORY,
+            number == FILE_ROOT ? SECURITY_ID_ROOT : SECURITY_ID_SYSTEM));
+        NamedFile file = { number, name, FileNameValue(parent, name, T, allocatedBytes, dataBytes, attributes) };
+        r.AddResident(AT_FILE_NAME, u"", file.fileName, true);
+        r.SetLinkCount(1);
+        (parent == extendRef ? extendFiles : rootFiles).push_back(file);
+    };
+
+    auto addDataFile = [&](uint32_t number, const u16string& name, const ClusterRun& run, ULONGLONG dataBytes) {
+        addName(number, name, rootRef, allocated(run), dataBytes, systemAttributes);
+        records[number].AddNonResident(AT_DATA, u"", run, allocated(run), dataBytes);
+    };
+
+    // $MFT: 数据与记录位图
+    addDataFile(FILE_MFT, u"$MFT", alloc.mft, mftRecords * rs);
+    records[FILE_MFT].AddNonResident(AT_BITMAP, u"", alloc.mftBitmap, allocated(alloc.mftBitmap), mftBitmapBytes);
+
+    addDataFile(FILE_MFTMIRR, u"$MFTMirr", alloc.mftMirr, (ULONGLONG)mirrorRecords * rs);
+    addDataFile(FILE_LOGFILE, u"$LogFile", alloc.logFile, logBytes);
+
+    // $Volume: 卷标与 NTFS 3.1 版本
+    {
+        u16string label = ToUtf16(partition.formatSpec.volumeLabel);
+        if (label.size() > MAX_LABEL_CHARS) label.resize(MAX_LABEL_CHARS);
+        vector<uint8_t> labelBytes(2 * label.size());
+        for (size_t i = 0; i < label.size(); i++) PutLE16(&labelBytes[2 * i], label[i]);
+
+        vector<uint8_t> information(12, 0);
+        information[8] = 3;
+        information[9] = 1;
+
+        addName(FILE_VOLUME, u"$Volume", rootRef, 0, 0, systemAttributes);
+        records[FILE_VOLUME].AddResident(AT_VOLUME_NAME, u"", labelBytes);
+        records[FILE_VOLUME].AddResident(AT_VOLUME_INFORMATION, u"", information);
+        records[FILE_VOLUME].AddResident(AT_DATA, u"", {});
+    }
+
+    addDataFile(FILE_ATTRDEF, u"$AttrDef", alloc.attrDef, ATTRDEF_BYTES);
+    addDataFile(FILE_BITMAP, u"$Bitmap", alloc.bitmap, bitmapBytes);
+    addDataFile(FILE_BOOT, u"$Boot", alloc.boot, BOOT_FILE_BYTES);
+
+    // $BadClus: 空的默认流与覆盖整个卷的稀疏 $Bad 流
+    {
+        ClusterRun bad;
+        bad.clusters = geo.clusterCount;
+        bad.sparse = true;
+        addName(FILE_BADCLUS, u"$BadClus", rootRef, 0, 0, systemAttributes);
+        records[FILE_BADCLUS].AddResident(AT_DATA, u"", {});
+        records[FILE_BADCLUS].AddNonResident(AT_DATA, u"$Bad", bad, geo.clusterCount * cs, geo.clusterCount * cs);
+    }
+
+    // $Secure: $SDS 流与 $SDH (按哈希) / $SII (按 ID) 视图索引
+    {
+        vector<SecurityEntry> byHash = secure.entries;
+        sort(byHash.begin(), byHash.end(), [](const SecurityEntry& a, const SecurityEntry& b) {
+            return a.hash != b.hash ? a.hash < b.hash : a.id < b.id;
+        });
+
+        vector<vector<uint8_t>> sdh;
+        for (const auto& entry : byHash) {
+            vector<uint8_t> key(8);
+            PutLE32(&key[0], entry.hash);
+            PutLE32(&key[4], entry.id);
+            sdh.push_back(ViewIndexEntry(key, entry.header, { 'I', 0, 'I', 0 }));
+        }
+        sdh.push_back(EndIndexEntry(false));
+
+        vector<vector<uint8_t>> sii;
+        for (const auto& entry : secure.entries) {
+            vector<uint8_t> key(4);
+            PutLE32(&key[0], entry.id);
+            sii.push_back(ViewIndexEntry(key, entry.header));
+        }
+        sii.push_back(EndIndexEntry(false));
+
+        FileRecord& r = records[FILE_SECURE];
+        addName(FILE_SECURE, u"$Secure", rootRef, 0, 0, systemAttributes | FILE_ATTR_VIEW_INDEX);
+        r.AddNonResident(AT_DATA, u"$SDS", alloc.secure, allocated(alloc.secure), secure.DataBytes());
+        r.AddResident(AT_INDEX_ROOT, u"$SDH", IndexRootValue(geo, 0, COLLATION_NTOFS_SECURITY_HASH, JoinEntries(sdh), false));
+        r.AddResident(AT_INDEX_ROOT, u"$SII", IndexRootValue(geo, 0, COLLATION_NTOFS_ULONG, JoinEntries(sii), false));
+    }
+
+    addDataFile(FILE_UPCASE, u"$UpCase", alloc.upcase, UPCASE_CHARS * 2);
+
+    // 记录 12-15: 保留给系统使用, 只有 $STANDARD_INFORMATION 与空数据流
+    for (uint32_t i = FILE_EXTEND + 1; i < FILE_FIRST_USER; i++) {
+        records[i].AddResident(AT_STANDARD_INFORMATION, u"", StandardInformation(T, systemAttributes, SECURITY_ID_SYSTEM));
+        records[i].AddResident(AT_DATA, u"", {});
+    }
+
+    // $Extend 下的视图索引: $Quota ($O 按 SID, $Q 按配额 ID)、$ObjId ($O)、$Reparse ($R)
+    {
+        vector<uint8_t> ownerId(4);
+        PutLE32(&ownerId[0], QUOTA_ADMINS_ID);
+        vector<uint8_t> o = JoinEntries({ ViewIndexEntry(SidAdministrators(), ownerId, vector<uint8_t>(4, 0)),
+            EndIndexEntry(false) });
+
+        auto quotaEntry = [&](uint32_t id, const vector<uint8_t>& sid) {
+            vector<uint8_t> key(4);
+            PutLE32(&key[0], id);
+            vector<uint8_t> value(0x30, 0);
+            PutLE32(&value[0x00], 2);                          // 版本
+            PutLE32(&value[0x04], 1);                          // QUOTA_FLAG_DEFAULT_LIMITS
+            PutLE64(&value[0x10], T);                          // 修改时间
+            PutLE64(&value[0x18], ~0ULL);                      // 警告阈值: 无
+            PutLE64(&value[0x20], ~0ULL);                      // 限制: 无
+            value.insert(value.end(), sid.begin(), sid.end());
+            return ViewIndexEntry(key, value);
+        };
+        vector<uint8_t> q = JoinEntries({ quotaEntry(QUOTA_DEFAULTS_ID, {}),
+            quotaEntry(QUOTA_ADMINS_ID, SidAdministrators()), EndIndexEntry(false) });
+
+        vector<uint8_t> empty = EndIndexEntry(false);
+
+        addName(FILE_QUOTA, u"$Quota", extendRef, 0, 0, extendViewAttributes);
+        records[FILE_QUOTA].AddResident(AT_INDEX_ROOT, u"$O", IndexRootValue(geo, 0, COLLATION_NTOFS_SID, o, false));
+        records[FILE_QUOTA].AddResident(AT_INDEX_ROOT, u"$Q", IndexRootValue(geo, 0, COLLATION_NTOFS_ULONG, q, false));
+
+        addName(FILE_OBJID, u"$ObjId", extendRef, 0, 0, extendViewAttributes);
+        records[FILE_OBJID].AddResident(AT_INDEX_ROOT, u"$O", IndexRootValue(geo, 0, COLLATION_NTOFS_ULONGS, empty, false));
+
+        addName(FILE_REPARSE, u"$Reparse", extendRef, 0, 0, extendViewAttributes);
+        records[FILE_REPARSE].AddResident(AT_INDEX_ROOT, u"$R", IndexRootValue(geo, 0, COLLATION_NTOFS_ULONGS, empty, false));
+    }
+
+    // $Extend: 常驻的 $I30 索引
+    addName(FILE_EXTEND, u"$Extend", rootRef, 0, 0, systemAttributes | FILE_ATTR_DIRECTORY);
+    auto byName = [](const NamedFile& a, const NamedFile& b) { return FileNameLess(a.name, b.name); };
+    {
+        sort(extendFiles.begin(), extendFiles.end(), byName);
+        vector<vector<uint8_t>> entries;
+        for (const auto& file : extendFiles) {
+            entries.push_back(FileNameIndexEntry(FileReference(file.recordNumber, SystemSequence(file.recordNumber)), file.fileName));
+        }
+        entries.push_back(EndIndexEntry(false));
+        records[FILE_EXTEND].AddResident(AT_INDEX_ROOT, u"$I30",
+            IndexRootValue(geo, AT_FILE_NAME, COLLATION_FILE_NAME, JoinEntries(entries), false));
+    }
+
+    // 根目录: 项放在一个索引块中, 索引根只有指向它的结束项
+    addName(FILE_ROOT, u".", rootRef, 0, 0, systemAttributes | FILE_ATTR_DIRECTORY);
+    vector<uint8_t> rootBlock;
+    {
+        sort(rootFiles.begin(), rootFiles.end(), byName);
+        vector<vector<uint8_t>> entries;
+        for (const auto& file : rootFiles) {
+            entries.push_back(FileNameIndexEntry(FileReference(file.recordNumber, SystemSequence(file.recordNumber)), file.fileName));
+        }
+        entries.push_back(EndIndexEntry(false));
+        vector<uint8_t> joined = JoinEntries(entries);
+        if (0x40 + joined.size() > geo.indexBlockBytes) {
+            wcerr << L"❌ NTFS 根目录索引超出索引块" << endl;
+            return false;
+        }
+        rootBlock = IndexBlock(geo, joined);
+
+        vector<uint8_t> indexBitmap(8, 0);
+        indexBitmap[0] = 0x01;
+
+        FileRecord& r = records[FILE_ROOT];
+        r.AddResident(AT_INDEX_ROOT, u"$I30",
+            IndexRootValue(geo, AT_FILE_NAME, COLLATION_FILE_NAME, EndIndexEntry(true), true));
+        r.AddNonResident(AT_INDEX_ALLOCATION, u"$I30", alloc.rootIndex, allocated(alloc.rootIndex), geo.indexBlockBytes);
+        r.AddResident(AT_BITMAP, u"$I30", indexBitmap);
+    }
+
+    vector<uint8_t> mft;
+    mft.reserve((size_t)(mftRecords * rs));
+    for (uint32_t i = 0; i < mftRecords; i++) {
+        vector<uint8_t> record;
+        if (!records[i].Seal(record)) {
+            wcerr << L"❌ NTFS 系统文件记录 " << i << L" 超出记录大小" << endl;
+            return false;
+        }
+        mft.insert(mft.end(), record.begin(), record.end());
+    }
+
+    // MFT 位图: 0-15 与 24-26 已用
+    vector<uint8_t> mftBitmap((size_t)mftBitmapBytes, 0);
+    for (uint32_t i = 0; i < FILE_SYSTEM_COUNT; i++) {
+        if (SystemRecordInUse(i)) mftBitmap[i / 8] |= (uint8_t)(1 << (i % 8));
+    }
+
+    // ---------- 引导扇区 ----------
+    const unsigned bps = geo.bytesPerSector;
+    const unsigned spc = geo.SectorsPerCluster();
+    vector<uint8_t> boot(bps, 0);
+    uint8_t* b = boot.data();
+
+    b[0] = 0xEB; b[1] = 0x52; b[2] = 0x90;
+    memcpy(b + 3, "NTFS    ", 8);
+    PutLE16(b + 0x0B, (uint16_t)bps);
+    b[0x0D] = spc <= 128 ? (uint8_t)spc : (uint8_t)(256 - Log2(spc));
+    b[0x15] = 0xF8;                                           // 固定磁盘
+    PutLE16(b + 0x18, 63);                                    // 每磁道扇区数
+    PutLE16(b + 0x1A, 255);                                   // 磁头数
+    PutLE32(b + 0x1C, (uint32_t)min<ULONGLONG>(base / bps, 0xFFFFFFFFULL));   // 隐藏扇区
+    PutLE32(b + 0x24, 0x00800080);                            // 驱动器号 0x80
+    PutLE64(b + 0x28, geo.totalSectors);
+    PutLE64(b + 0x30, alloc.mft.lcn);
+    PutLE64(b + 0x38, alloc.mftMirr.lcn);
+    b[0x40] = ClustersPerField(rs, cs);
+    b[0x44] = ClustersPerField(geo.indexBlockBytes, cs);
+    PutLE64(b + 0x48, volumeSerial);
+    b[0x1FE] = 0x55;
+    b[0x1FF] = 0xAA;
+
+    // ---------- 簇位图: 元数据已用, 卷末不足 8 字节的填充位置 1 ----------
+    const ULONGLONG usedClusters = alloc.nextLcn;
+    auto lcnOffset = [&](ULONGLONG lcn) { return base + lcn * cs; };
+    auto setBits = [](vector<uint8_t>& bits, ULONGLONG first, ULONGLONG last, ULONGLONG bitBase) {
+        for (ULONGLONG i = first; i < last; i++) bits[(size_t)((i - bitBase) / 8)] |= (uint8_t)(1 << (i % 8));
+    };
+
+    // 大卷的位图只写首部与尾部, 中间保持零
+    const ULONGLONG headBytes = Align8((size_t)CeilDiv(usedClusters, 8));
+    const ULONGLONG tailStart = geo.clusterCount / 64 * 8;
+    vector<uint8_t> bitmapHead;
+    vector<uint8_t> bitmapTail;
+    if (tailStart <= headBytes) {
+        bitmapHead.assign((size_t)bitmapBytes, 0);
+        setBits(bitmapHead, 0, usedClusters, 0);
+        setBits(bitmapHead, geo.clusterCount, bitmapBytes * 8, 0);
+    }
+    else {
+        bitmapHead.assign((size_t)headBytes, 0);
+        setBits(bitmapHead, 0, usedClusters, 0);
+        bitmapTail.assign((size_t)(bitmapBytes - tailStart), 0);
+        setBits(bitmapTail, geo.clusterCount, bitmapBytes * 8, tailStart * 8);
+    }
+
+    // 完全格式化: 整个分区清零; 快速格式化: 仅清零元数据区
+    if (!partition.formatSpec.quickFormat) {
+        extents.Zero(base, partition.size);
+    }
+    else {
+        extents.Zero(base, usedClusters * cs);
+    }
+
+    vector<uint8_t> attrDef = BuildAttrDef();
+    vector<uint8_t> upcase(UPCASE_CHARS * 2);
+    const auto& table = UpcaseTable();
+    for (unsigned c = 0; c < UPCASE_CHARS; c++) PutLE16(&upcase[2 * c], table[c]);
+
+    extents.Write(lcnOffset(alloc.boot.lcn), boot);
+    extents.Write(lcnOffset(alloc.mftMirr.lcn), mft.data(), (size_t)mirrorRecords * rs);
+    extents.Write(lcnOffset(alloc.attrDef.lcn), attrDef);
+    extents.Write(lcnOffset(alloc.rootIndex.lcn), rootBlock);
+    extents.Write(lcnOffset(alloc.bitmap.lcn), bitmapHead);
+    if (!bitmapTail.empty()) extents.Write(lcnOffset(alloc.bitmap.lcn) + tailStart, bitmapTail);
+    extents.Write(lcnOffset(alloc.upcase.lcn), upcase);
+    extents.Write(lcnOffset(alloc.secure.lcn), secure.primary);               // $SDS 与 256 KiB 处的镜像
+    extents.Write(lcnOffset(alloc.secure.lcn) + SDS_MIRROR_OFFSET, secure.primary);
+    extents.Write(lcnOffset(alloc.mftBitmap.lcn), mftBitmap);
+    extents.Write(lcnOffset(alloc.mft.lcn), mft);
+
+    // 空日志: 全部为 0xFF, Windows 首次挂载时写入重启区; 以填充区段记录, 写出镜像时才展开
+    extents.Fill(lcnOffset(alloc.logFile.lcn), logBytes, 0xFFFFFFFF);
+
+    // 备份引导扇区: 分区最后一个扇区 (卷之外)
+    extents.Write(base + geo.totalSectors * bps, boot);
+
+    return true;
+}
+
+// ================================
+// 原地扩展
+// ================================
+
+// 引导扇区中的 "每记录簇数" 还原为字节数 (ClustersPerField 的逆操作); 无效时为 0
+static unsigned FieldBytes(uint8_t field, unsigned clusterBytes) {
+    if (field <= 0x7F) return field * clusterBytes;
+    unsigned shift = 256 - field;
+    return shift >= 9 && shift <= 16 ? 1u << shift : 0;
+}
+
+bool ReadNtfsGeometry(const vector<uint8_t>& boot, NtfsGeometry& geometry) {
+    geometry = NtfsGeometry();
+    if (boot.size() < NTFS_BLOCK_SIZE || memcmp(&boot[3], "NTFS    ", 8) != 0) return false;
+
+    const uint8_t* b = boot.data();
+    const unsigned spcField = b[0x0D];
+    const unsigned spc = spcField <= 128 ? spcField : (256 - spcField <= 12 ? 1u << (256 - spcField) : 0);
+    geometry.bytesPerSector = GetLE16(b + 0x0B);
+    if (geometry.bytesPerSector != boot.size() || spc == 0 || (spc & (spc - 1)) != 0) return false;
+
+    geometry.clusterBytes = geometry.bytesPerSector * spc;
+    geometry.mftRecordBytes = FieldBytes(b[0x40], geometry.clusterBytes);
+    geometry.indexBlockBytes = FieldBytes(b[0x44], geometry.clusterBytes);
+    geometry.totalSectors = GetLE64(b + 0x28);
+    geometry.clusterCount = geometry.totalSectors / spc;
+
+    return geometry.clusterBytes <= MAX_CLUSTER_BYTES
+        && geometry.mftRecordBytes >= NTFS_BLOCK_SIZE && geometry.mftRecordBytes % NTFS_BLOCK_SIZE == 0
+        && geometry.mftRecordBytes <= 64 * 1024
+        && geometry.clusterCount > 0 && geometry.clusterCount <= 0xFFFFFFFFULL;
+}
+
+namespace {
+
+// 已读出并还原更新序列的 MFT 记录
+struct LoadedRecord {
+    ULONGLONG offset = 0;
+    ULONGLONG mirrorOffset = 0;        // $MFTMirr 中的副本, 没有时为 0
+    vector<uint8_t> data;
+};
+
+// 流内的一段映射到卷上的位置
+struct StreamPiece {
+    ULONGLONG volumeOffset = 0;        // 相对卷起点
+    ULONGLONG streamOffset = 0;
+    ULONGLONG length = 0;
+};
+
+}
+
+// 按类型与名称查找属性, 返回其在记录中的偏移; 没有时为 0
+static size_t FindAttribute(const vector<uint8_t>& record, uint32_t type, const u16string& name) {
+    size_t pos = GetLE16(&record[0x14]);
+    while (pos + 0x10 <= record.size() && GetLE32(&record[pos]) != AT_END) {
+        const size_t length = GetLE32(&record[pos + 0x04]);
+        if (length < 0x10 || pos + length > record.size()) break;
+
+        if (GetLE32(&record[pos]) == type && record[pos + 0x09] == name.size()) {
+            const size_t nameOffset = GetLE16(&record[pos + 0x0A]);
+            bool same = nameOffset + 2 * name.size() <= length;
+            for (size_t i = 0; same && i < name.size(); i++) {
+                same = GetLE16(&record[pos + nameOffset + 2 * i]) == name[i];
+            }
+            if (same) return pos;
+        }
+        pos += length;
+    }
+    return 0;
+}
+
+// 非常驻属性的全部区段; 属性不完整 (不从 VCN 0 开始或区段与结束 VCN 不符) 时返回 false
+static bool ReadRuns(const vector<uint8_t>& record, size_t pos, vector<ClusterRun>& runs) {
+    if (pos == 0 || record[pos + 0x08] != 1 || GetLE64(&record[pos + 0x10]) != 0) return false;
+
+    const size_t length = GetLE32(&record[pos + 0x04]);
+    const size_t pairsOffset = GetLE16(&record[pos + 0x20]);
+    if (pairsOffset >= length || !DecodeRuns(&record[pos + pairsOffset], length - pairsOffset, runs)) return false;
+
+    ULONGLONG clusters = 0;
+    for (const auto& run : runs) clusters += run.clusters;
+    return !runs.empty() && clusters == GetLE64(&record[pos + 0x18]) + 1;
+}
+
+// 用新的区段重写非常驻属性的 mapping pairs 与大小, 其后的属性随之移动; 记录放不下时返回 false
+static bool WriteRuns(vector<uint8_t>& record, size_t pos, const vector<ClusterRun>& runs,
+    ULONGLONG allocatedBytes, ULONGLONG dataBytes) {
+    const vector<uint8_t> pairs = EncodeRuns(runs);
+    const size_t pairsOffset = GetLE16(&record[pos + 0x20]);
+    const size_t oldLength = GetLE32(&record[pos + 0x04]);
+    const size_t newLength = Align8(pairsOffset + pairs.size());
+    const size_t used = GetLE32(&record[0x18]);
+    if (used - oldLength + newLength > record.size()) return false;
+
+    memmove(&record[pos + newLength], &record[pos + oldLength], used - pos - oldLength);
+    if (newLength < oldLength) memset(&record[used - (oldLength - newLength)], 0, oldLength - newLength);
+    memset(&record[pos + pairsOffset], 0, newLength - pairsOffset);
+    memcpy(&record[pos + pairsOffset], pairs.data(), pairs.size());
+
+    ULONGLONG clusters = 0;
+    for (const auto& run : runs) clusters += run.clusters;
+    uint8_t* a = &record[pos];
+    PutLE32(a + 0x04, (uint32_t)newLength);
+    PutLE64(a + 0x18, clusters - 1);
+    PutLE64(a + 0x28, allocatedBytes);
+    PutLE64(a + 0x30, dataBytes);
+    PutLE64(a + 0x38, dataBytes);
+    PutLE32(&record[0x18], (uint32_t)(used - oldLength + newLength));
+    return true;
+}
+
+// 流内 [offset, offset + length) 映射到卷上的片段 (稀疏区段跳过)
+static vector<StreamPiece> MapStream(const vector<ClusterRun>& runs, unsigned clusterBytes,
+    ULONGLONG offset, ULONGLONG length) {
+    vector<StreamPiece> pieces;
+    ULONGLONG runStart = 0;
+    for (const auto& run : runs) {
+        const ULONGLONG runEnd = runStart + run.clusters * clusterBytes;
+        const ULONGLONG first = max(offset, runStart);
+        const ULONGLONG last = min(offset + length, runEnd);
+        if (first < last && !run.sparse) {
+            pieces.push_back({ run.lcn * clusterBytes + (first - runStart), first, last - first });
+        }
+        runStart = runEnd;
+    }
+    return pieces;
+}
+
+bool GrowNtfs(
+    const NtfsReader& read,
+    ULONGLONG base,
+    const vector<uint8_t>& boot,
+    ULONGLONG partitionSize,
+    ExtentList& extents
+) {
+    NtfsGeometry geo;
+    if (!ReadNtfsGeometry(boot, geo)) {
+        wcerr << L"❌ NTFS 引导扇区无效 (扇区大小须与磁盘一致)" << endl;
+        return false;
+    }
+
+    const unsigned bps = geo.bytesPerSector;
+    const unsigned cs = geo.clusterBytes;
+    const ULONGLONG totalSectors = partitionSize / bps - 1;
+    const ULONGLONG clusterCount = totalSectors / geo.SectorsPerCluster();
+    if (totalSectors < geo.totalSectors) {
+        wcerr << L"❌ NTFS 卷不支持原地收缩" << endl;
+        return false;
+    }
+    if (clusterCount > 0xFFFFFFFFULL) {
+        wcerr << L"❌ NTFS 簇数 " << clusterCount << L" 超过 2^32" << endl;
+        return false;
+    }
+
+    // $Bitmap 与 $BadClus 位于 $MFT 开头连续的系统文件记录中; 簇大于 4 个记录时 $MFTMirr 的一簇也包含它们
+    const ULONGLONG mftOffset = base + GetLE64(&boot[0x30]) * cs;
+    const ULONGLONG mirrorOffset = base + GetLE64(&boot[0x38]) * cs;
+    const unsigned mirrorRecords = max(4u, cs / geo.mftRecordBytes);
+    LoadedRecord records[2];
+    const uint32_t numbers[2] = { FILE_BITMAP, FILE_BADCLUS };
+    for (int i = 0; i < 2; i++) {
+        LoadedRecord& record = records[i];
+        record.offset = mftOffset + (ULONGLONG)numbers[i] * geo.mftRecordBytes;
+        record.data.resize(geo.mftRecordBytes);
+        if (!read(record.offset, record.data.data(), record.data.size())) return false;
+
+        // 只在镜像中的副本与记录相同时一并更新
+        if (numbers[i] < mirrorRecords) {
+            vector<uint8_t> mirror(record.data.size());
+            ULONGLONG offset = mirrorOffset + (ULONGLONG)numbers[i] * geo.mftRecordBytes;
+            if (!read(offset, mirror.data(), mirror.size())) return false;
+            if (mirror == record.data) record.mirrorOffset = offset;
+        }
+        if (memcmp(record.data.data(), "FILE", 4) != 0 || !RemoveFixups(record.data.data(), record.data.size())
+            || GetLE32(&record.data[0x18]) > record.data.size()) {
+            wcerr << L"❌ NTFS 系统文件记录 " << numbers[i] << L" 无效" << endl;
+            return false;
+        }
+    }
+    vector<uint8_t>& bitmapRecord = records[0].data;
+    vector<uint8_t>& badRecord = records[1].data;
+
+    const size_t bitmapAttr = FindAttribute(bitmapRecord, AT_DATA, u"");
+    const size_t badAttr = FindAttribute(badRecord, AT_DATA, u"$Bad");
+    vector<ClusterRun> bitmapRuns;
+    vector<ClusterRun> badRuns;
+    if (!ReadRuns(bitmapRecord, bitmapAttr, bitmapRuns) || !ReadRuns(badRecord, badAttr, badRuns)) {
+        wcerr << L"❌ NTFS 的 $Bitmap 或 $BadClus:$Bad 不是完整的非常驻属性" << endl;
+        return false;
+    }
+
+    // ---------- $Bitmap: 簇不够时从扩展出的区域开头分配 (原有区域可能已被文件占用) ----------
+    const ULONGLONG oldBytes = GetLE64(&bitmapRecord[bitmapAttr + 0x30]);
+    const ULONGLONG newBytes = Align8((size_t)CeilDiv(clusterCount, 8));
+    ULONGLONG bitmapClusters = GetLE64(&bitmapRecord[bitmapAttr + 0x18]) + 1;
+    if (oldBytes < CeilDiv(geo.clusterCount, 8) || oldBytes > bitmapClusters * cs) {
+        wcerr << L"❌ NTFS 的 $Bitmap 大小与卷不符" << endl;
+        return false;
+    }
+
+    ClusterRun added;
+    added.lcn = geo.clusterCount;
+    if (CeilDiv(newBytes, cs) > bitmapClusters) {
+        added.clusters = CeilDiv(newBytes, cs) - bitmapClusters;
+        if (added.lcn + added.clusters > clusterCount) {
+            wcerr << L"❌ 扩展的空间不足以容纳新的 $Bitmap" << endl;
+            return false;
+        }
+
+        ClusterRun& last = bitmapRuns.back();
+        if (!last.sparse && last.lcn + last.clusters == added.lcn) last.clusters += added.clusters;
+        else bitmapRuns.push_back(added);
+        bitmapClusters += added.clusters;
+    }
+
+    // 从旧卷最后一簇所在的字节起重写: 清除旧的卷末填充位, 标记新分配的簇与新的卷末填充位
+    const ULONGLONG firstByte = geo.clusterCount / 8;
+    vector<uint8_t> bits((size_t)(newBytes - firstByte), 0);
+    if (!bits.empty() && firstByte < oldBytes) {
+        for (const auto& piece : MapStream(bitmapRuns, cs, firstByte, 1)) {
+            if (!read(base + piece.volumeOffset, bits.data(), 1)) return false;
+        }
+        bits[0] &= (uint8_t)((1 << (geo.clusterCount % 8)) - 1);
+    }
+    auto setBits = [&](ULONGLONG first, ULONGLONG last) {
+        for (ULONGLONG i = first; i < last; i++) bits[(size_t)(i / 8 - firstByte)] |= (uint8_t)(1 << (i % 8));
+    };
+    setBits(added.lcn, added.lcn + added.clusters);
+    setBits(clusterCount, newBytes * 8);
+
+    for (const auto& piece : MapStream(bitmapRuns, cs, firstByte, bits.size())) {
+        extents.Write(base + piece.volumeOffset, &bits[(size_t)(piece.streamOffset - firstByte)], (size_t)piece.length);
+    }
+
+    // 目录项中 $Bitmap 的 $FILE_NAME 大小不更新: 系统文件的目录项副本不随文件维护
+    if (!WriteRuns(bitmapRecord, bitmapAttr, bitmapRuns, bitmapClusters * cs, newBytes)) {
+        wcerr << L"❌ $Bitmap 的区段超出 MFT 记录大小" << endl;
+        return false;
+    }
+
+    // ---------- $BadClus:$Bad: 覆盖整个卷的稀疏流 ----------
+    if (clusterCount > geo.clusterCount) {
+        ClusterRun grown;
+        grown.clusters = clusterCount - geo.clusterCount;
+        grown.sparse = true;
+        if (badRuns.back().sparse) badRuns.back().clusters += grown.clusters;
+        else badRuns.push_back(grown);
+    }
+    if (!WriteRuns(badRecord, badAttr, badRuns, clusterCount * cs, clusterCount * cs)) {
+        wcerr << L"❌ $BadClus:$Bad 的区段超出 MFT 记录大小" << endl;
+        return false;
+    }
+
+    // 重新写入的记录使用新的更新序列号
+    for (auto& record : records) {
+        const size_t usaOffset = GetLE16(&record.data[0x04]);
+        uint16_t usn = (uint16_t)(GetLE16(&record.data[usaOffset]) + 1);
+        ApplyFixups(record.data.data(), record.data.size(), usaOffset, usn == 0 ? 1 : usn);
+        extents.Write(record.offset, record.data);
+        if (record.mirrorOffset != 0) extents.Write(record.mirrorOffset, record.data);
+    }
+
+    // ---------- 引导扇区与位于新的最后一个扇区的备份 ----------
+    vector<uint8_t> newBoot = boot;
+    PutLE64(&newBoot[0x28], totalSectors);
+    extents.Write(base, newBoot);
+    extents.Write(base + totalSectors * bps, newBoot);
+    return true;
+}
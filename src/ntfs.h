@@ -0,0 +1,62 @@
+﻿#pragma once
+
+/*
+ * NTFS 原生格式化 (镜像模式)
+ *
+ * 直接生成 NTFS 3.1 卷的元数据, 不经过 MSFT_Partition.Format:
+ *   - 引导扇区 ($Boot) 及位于分区最后一个扇区的备份;
+ *   - $MFT 中的系统文件记录 (0-15 与 $Extend 下的 24-26) 及 $MFTMirr;
+ *   - $LogFile (空日志, Windows 首次挂载时初始化)、$AttrDef、$UpCase、
+ *     $Bitmap、$BadClus、$Secure ($SDS/$SDH/$SII)、$Volume (卷标来自 vol=);
+ *   - 根目录与 $Extend 的 $I30 索引。
+ * 元数据连续放在卷首, $MFT 放在最后以便原地增长; 其余簇保持空洞。
+ * 簇大小默认按 Windows 格式化的容量表选择 (簇数不超过 2^32), 可由 unit= 指定。
+ *
+ * 已有卷的原地扩展 (--resize-part) 只修改: 引导扇区的总扇区数及新的最后一个扇区上的备份,
+ * $Bitmap (长度与 runlist, 需要的新簇从扩展出的区域开头分配), $BadClus:$Bad 的稀疏区段。
+ * 收缩需要移动簇, 不支持。
+ */
+
+#include "extent.h"
+#include "layout.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct NtfsGeometry {
+    unsigned bytesPerSector = 512;
+    unsigned clusterBytes = 4096;
+    unsigned mftRecordBytes = 1024;    // 512 字节扇区为 1 KiB, 4Kn 为 4 KiB
+    unsigned indexBlockBytes = 4096;
+    ULONGLONG totalSectors = 0;        // 卷扇区数, 不含末尾的备份引导扇区
+    ULONGLONG clusterCount = 0;
+
+    unsigned SectorsPerCluster() const { return clusterBytes / bytesPerSector; }
+};
+
+// 计算 NTFS 几何参数; clusterBytes 为 0 时按容量表选择
+bool PlanNtfs(ULONGLONG partitionSize, unsigned sectorSize, ULONGLONG clusterBytes, NtfsGeometry& geometry);
+
+// 在分区范围内生成 NTFS 元数据; 时间戳取自 layout.formatTime
+bool FormatNtfs(
+    const DiskLayout& layout,
+    const PlannedPartition& partition,
+    uint64_t volumeSerial,
+    ExtentList& extents
+);
+
+// 读取镜像中绝对偏移处的数据
+using NtfsReader = std::function<bool(ULONGLONG offset, uint8_t* data, size_t length)>;
+
+// 从引导扇区读取几何参数; 不是 NTFS 或扇区大小与 boot 的长度不符时返回 false
+bool ReadNtfsGeometry(const std::vector<uint8_t>& boot, NtfsGeometry& geometry);
+
+// 把 base 处的 NTFS 卷扩展到 partitionSize 字节的分区; 需要写入的扇区放入 extents (绝对偏移)
+bool GrowNtfs(
+    const NtfsReader& read,
+    ULONGLONG base,
+    const std::vector<uint8_t>& boot,
+    ULONGLONG partitionSize,
+    ExtentList& extents
+);
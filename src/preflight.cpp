@@ -0,0 +1,379 @@
+﻿#include "preflight.h"
+#include "wmi_manager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+// 探测读的块大小 (也满足 512e / 4Kn 的直接 I/O 对齐)
+static const ULONGLONG PROBE_BLOCK_BYTES = 4096;
+#endif
+
+bool ParsePreflightSpec(const wstring& params, PreflightSpec& spec) {
+    auto paramMap = ParseParams(params);
+
+    try {
+        if (paramMap.count(L"temp"))
+            spec.maxTemperature = stoi(paramMap[L"temp"]);
+
+        if (paramMap.count(L"wear"))
+            spec.maxWear = stoi(paramMap[L"wear"]);
+
+        if (paramMap.count(L"read-errors"))
+            spec.maxReadErrors = stoull(paramMap[L"read-errors"]);
+
+        if (paramMap.count(L"write-errors"))
+            spec.maxWriteErrors = stoull(paramMap[L"write-errors"]);
+
+        if (paramMap.count(L"latency"))
+            spec.maxLatencyMs = stod(paramMap[L"latency"]);
+
+        if (paramMap.count(L"probe"))
+            spec.probeSamples = stoi(paramMap[L"probe"]);
+
+        if (paramMap.count(L"probe-latency"))
+            spec.maxProbeMs = stod(paramMap[L"probe-latency"]);
+
+        if (paramMap.count(L"action")) {
+            const wstring& action = paramMap[L"action"];
+            if (action == L"exclude") spec.exclude = true;
+            else if (action == L"flag") spec.exclude = false;
+            else return false;
+        }
+    }
+    catch (...) {
+        return false;
+    }
+
+    return spec.probeSamples >= 0 && spec.probeSamples <= 4096 && spec.maxProbeMs > 0;
+}
+
+double PreflightResult::ProbeMaxMs() const {
+    return probeMs.empty() ? 0 : *max_element(probeMs.begin(), probeMs.end());
+}
+
+// ================================
+// 读延迟探测
+// ================================
+
+#ifdef _WIN32
+// 第 index 次探测的偏移: 首尾两块之间均匀分布
+static ULONGLONG ProbeOffset(ULONGLONG diskSize, int index, int samples) {
+    ULONGLONG blocks = diskSize / PROBE_BLOCK_BYTES;
+    if (blocks == 0 || samples <= 1) return 0;
+    return (blocks - 1) * (ULONGLONG)index / (ULONGLONG)(samples - 1) * PROBE_BLOCK_BYTES;
+}
+
+bool ProbePhysicalDrive(int diskNumber, ULONGLONG diskSize, int samples, vector<double>& latenciesMs) {
+    latenciesMs.clear();
+
+    wstring path = L"\\\\.\\PhysicalDrive" + to_wstring(diskNumber);
+    HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+        OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    void* buffer = _aligned_malloc((size_t)PROBE_BLOCK_BYTES, (size_t)PROBE_BLOCK_BYTES);
+    bool ok = buffer != nullptr;
+
+    for (int i = 0; ok && i < samples; i++) {
+        ULONGLONG offset = ProbeOffset(diskSize, i, samples);
+
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+        DWORD bytesRead = 0;
+        auto start = chrono::steady_clock::now();
+        ok = ReadFile(handle, buffer, (DWORD)PROBE_BLOCK_BYTES, &bytesRead, &overlapped) && bytesRead == PROBE_BLOCK_BYTES;
+        latenciesMs.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+
+    _aligned_free(buffer);
+    CloseHandle(handle);
+    return ok;
+}
+#else
+bool ProbePhysicalDrive(int, ULONGLONG, int, vector<double>& latenciesMs) {
+    // 磁盘编号是 Windows 的 PhysicalDrive 编号, 其他平台没有对应的设备
+    latenciesMs.clear();
+    return false;
+}
+#endif
+
+// ================================
+// 单盘检查
+// ================================
+
+static const wchar_t* HealthStatusName(int status) {
+    switch (status) {
+    case 0: return L"正常";
+    case 1: return L"警告";
+    case 2: return L"不正常";
+    default: return L"未知";
+    }
+}
+
+// 判为不合格的 OperationalStatus 取值
+static const map<int, const wchar_t*>& BadOperationalStatus() {
+    static const map<int, const wchar_t*> names = {
+        { 3, L"Degraded" },
+        { 5, L"Predictive Failure" },
+        { 6, L"Error" },
+        { 7, L"Non-Recoverable Error" },
+        { 12, L"No Contact" },
+        { 13, L"Lost Communication" },
+        { 14, L"Aborted" },
+        { 16, L"Supporting Entity in Error" },
+    };
+    return names;
+}
+
+// 属性为空 (驱动未提供) 时返回 -1
+static long long OptionalInt(const StorageObjectPtr& obj, const wchar_t* name) {
+    PropValue value = obj->Prop(name);
+    return value.IsEmpty() ? -1 : value.AsInt();
+}
+
+// 取查询结果的第一个对象; 查询失败返回 false, 没有结果时 obj 为空
+static bool QueryFirst(WMIManager& wmi, const wstring& query, StorageObjectPtr& obj) {
+    obj.reset();
+    auto enumerator = wmi.Query(query);
+    if (!enumerator) return false;
+
+    StorageObjectPtr next;
+    while (wmi.Next(*enumerator, next)) {
+        if (!obj) obj = next;
+    }
+    return true;
+}
+
+static void CheckPhysicalDisk(WMIManager& wmi, PreflightResult& result) {
+    StorageObjectPtr disk;
+    if (!QueryFirst(wmi, L"SELECT * FROM MSFT_PhysicalDisk WHERE DeviceId = '" + to_wstring(result.diskNumber) + L"'", disk)) {
+        result.failures.push_back(L"无法查询 MSFT_PhysicalDisk");
+        return;
+    }
+    if (!disk) {
+        // 存储池中的虚拟磁盘没有同编号的物理磁盘
+        result.notes.push_back(L"未找到对应的物理磁盘, 跳过健康检查");
+        return;
+    }
+
+    result.foundPhysicalDisk = true;
+    result.friendlyName = disk->GetString(L"FriendlyName");
+    result.size = disk->GetUInt64(L"Size");
+    result.healthStatus = (int)OptionalInt(disk, L"HealthStatus");
+
+    PropValue status = disk->Prop(L"OperationalStatus");
+    if (status.GetKind() == PropValue::Kind::StringArray) result.operationalStatus = status.AsStringArray();
+    else if (!status.IsEmpty()) result.operationalStatus.push_back(status.AsString());
+
+    if (result.healthStatus == 1 || result.healthStatus == 2) {
+        result.failures.push_back(wstring(L"健康状态: ") + HealthStatusName(result.healthStatus));
+    }
+    for (const auto& code : result.operationalStatus) {
+        auto it = BadOperationalStatus().find((int)wcstol(code.c_str(), nullptr, 10));
+        if (it != BadOperationalStatus().end()) {
+            result.failures.push_back(wstring(L"运行状态: ") + it->second);
+        }
+    }
+
+    // 计数器通过关联获取 (与 Get-StorageReliabilityCounter 相同)
+    StorageObjectPtr counters;
+    if (!QueryFirst(wmi, L"ASSOCIATORS OF {" + disk->Path() + L"} WHERE ResultClass = MSFT_StorageReliabilityCounter", counters)
+        || !counters) {
+        result.notes.push_back(L"驱动未提供可靠性计数器");
+        return;
+    }
+
+    result.hasCounters = true;
+    result.temperature = (int)OptionalInt(counters, L"Temperature");
+    result.wear = (int)OptionalInt(counters, L"Wear");
+    result.readErrors = OptionalInt(counters, L"ReadErrorsUncorrected");
+    result.writeErrors = OptionalInt(counters, L"WriteErrorsUncorrected");
+    result.readLatencyMax = OptionalInt(counters, L"ReadLatencyMax");
+    result.writeLatencyMax = OptionalInt(counters, L"WriteLatencyMax");
+}
+
+static void CheckThresholds(const PreflightSpec& spec, PreflightResult& result) {
+    if (!result.hasCounters) return;
+
+    auto check = [&](long long value, double limit, const wchar_t* name, const wchar_t* unit) {
+        if (value < 0) {
+            result.notes.push_back(wstring(name) + L"未提供");
+        }
+        else if ((double)value > limit) {
+            wstringstream ss;
+            ss << name << L" " << value << unit << L" > " << limit << unit;
+            result.failures.push_back(ss.str());
+        }
+    };
+
+    check(result.temperature, spec.maxTemperature, L"温度", L"°C");
+    check(result.wear, spec.maxWear, L"磨损", L"%");
+    check(result.readErrors, (double)spec.maxReadErrors, L"未纠正读错误", L"");
+    check(result.writeErrors, (double)spec.maxWriteErrors, L"未纠正写错误", L"");
+    if (spec.maxLatencyMs > 0) {
+        check(result.readLatencyMax, spec.maxLatencyMs, L"读延迟最大值", L" ms");
+        check(result.writeLatencyMax, spec.maxLatencyMs, L"写延迟最大值", L" ms");
+    }
+}
+
+static void RunProbe(WMIManager& wmi, const PreflightSpec& spec, const PreflightProbe& probe, PreflightResult& result) {
+    if (spec.probeSamples == 0) return;
+
+    if (!probe.read) {
+        result.probeSkipReason = probe.skipReason;
+        return;
+    }
+    if (result.size == 0) {
+        result.probeSkipReason = L"磁盘大小未知";
+        return;
+    }
+
+    if (!probe.read(result.diskNumber, result.size, spec.probeSamples, result.probeMs)) {
+        result.failures.push_back(L"探测读失败");
+        return;
+    }
+
+    // 模拟的探测读没有真实耗时, 推进会话的虚拟时钟
+    if (probe.simulated) {
+        double totalMs = 0;
+        for (double ms : result.probeMs) totalMs += ms;
+        wmi.Sleep(chrono::nanoseconds((long long)(totalMs * 1e6)));
+    }
+
+    double maxMs = result.ProbeMaxMs();
+    if (maxMs > spec.maxProbeMs) {
+        wstringstream ss;
+        ss << fixed << setprecision(1) << L"探测读延迟 " << maxMs << L" ms > " << spec.maxProbeMs << L" ms";
+        result.failures.push_back(ss.str());
+    }
+}
+
+vector<PreflightResult> RunPreflight(
+    const BackendFactory& factory,
+    const vector<int>& diskNumbers,
+    const PreflightSpec& spec,
+    const PreflightProbe& probe,
+    size_t maxWorkers
+) {
+    vector<PreflightResult> results(diskNumbers.size());
+    atomic<size_t> nextIndex(0);
+
+    auto worker = [&]() {
+        WMIManager wmi;
+        if (!wmi.Initialize(factory())) {
+            wcerr << L"❌ 预检线程无法连接存储提供程序" << endl;
+            return;
+        }
+
+        for (size_t i = nextIndex++; i < results.size(); i = nextIndex++) {
+            PreflightResult& result = results[i];
+            result.diskNumber = diskNumbers[i];
+            result.started = wmi.Now();
+            CheckPhysicalDisk(wmi, result);
+            CheckThresholds(spec, result);
+            RunProbe(wmi, spec, probe, result);
+            result.finished = wmi.Now();
+        }
+    };
+
+    size_t workerCount = min(maxWorkers, results.size());
+    if (workerCount <= 1) {
+        worker();
+    }
+    else {
+        vector<thread> workers;
+        for (size_t i = 0; i < workerCount; i++) {
+            workers.emplace_back(worker);
+        }
+        for (auto& t : workers) {
+            t.join();
+        }
+    }
+
+    // 未执行的磁盘 (工作线程初始化失败) 视为不合格
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i].diskNumber < 0) {
+            results[i].diskNumber = diskNumbers[i];
+            results[i].failures.push_back(L"未执行预检");
+        }
+    }
+
+    return results;
+}
+
+// ================================
+// 报告
+// ================================
+
+void PrintPreflightReport(const vector<PreflightResult>& results, const PreflightSpec& spec, bool verbose) {
+    size_t passed = 0;
+    vector<double> probeMs;
+    auto first = chrono::nanoseconds::max();
+    auto last = chrono::nanoseconds::min();
+
+    wcout << L"\n🩺 磁盘健康预检" << endl;
+    wcout << L"==========================================" << endl;
+    wcout << fixed << setprecision(2);
+
+    for (const auto& result : results) {
+        if (result.Passed()) passed++;
+        probeMs.insert(probeMs.end(), result.probeMs.begin(), result.probeMs.end());
+        first = min(first, result.started);
+        last = max(last, result.finished);
+
+        if (!result.Passed()) {
+            wcout << L"  ❌ 磁盘 " << result.diskNumber << L": ";
+            for (size_t i = 0; i < result.failures.size(); i++) {
+                wcout << (i ? L"; " : L"") << result.failures[i];
+            }
+            wcout << (spec.exclude ? L"  (已排除)" : L"  (已标记)") << endl;
+            continue;
+        }
+        if (!verbose) continue;
+
+        wcout << L"  ✓ 磁盘 " << result.diskNumber << L":";
+        if (result.foundPhysicalDisk) wcout << L" " << HealthStatusName(result.healthStatus);
+        if (result.temperature >= 0) wcout << L", " << result.temperature << L"°C";
+        if (result.wear >= 0) wcout << L", 磨损 " << result.wear << L"%";
+        if (!result.probeMs.empty()) wcout << L", 探测读最大 " << result.ProbeMaxMs() << L" ms";
+        for (const auto& note : result.notes) wcout << L"; " << note;
+        wcout << endl;
+    }
+
+    wcout << L"  磁盘: " << results.size() << L" (合格 " << passed << L", 不合格 " << (results.size() - passed) << L")";
+    if (!results.empty() && last >= first) {
+        wcout << L", 耗时 " << chrono::duration<double>(last - first).count() << L" s";
+    }
+    wcout << endl;
+
+    if (!probeMs.empty()) {
+        sort(probeMs.begin(), probeMs.end());
+        auto percentile = [&](double p) { return probeMs[(size_t)(p * (probeMs.size() - 1) + 0.5)]; };
+        wcout << L"  探测读延迟: p50 " << percentile(0.50) << L" ms, p99 " << percentile(0.99)
+            << L" ms, 最大 " << probeMs.back() << L" ms (" << probeMs.size() << L" 次)" << endl;
+    }
+    else if (spec.probeSamples > 0) {
+        for (const auto& result : results) {
+            if (!result.probeSkipReason.empty()) {
+                wcout << L"  ⚠️  跳过探测读: " << result.probeSkipReason << endl;
+                break;
+            }
+        }
+    }
+}
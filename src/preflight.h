@@ -0,0 +1,97 @@
+﻿#pragma once
+
+/*
+ * 配置前的磁盘健康预检 (--preflight)
+ *
+ * 在任何 Clear / CreatePartition 之前并发检查全部目标磁盘 (只读):
+ *   1. MSFT_PhysicalDisk: HealthStatus 与 OperationalStatus;
+ *   2. MSFT_StorageReliabilityCounter: 温度、磨损、未纠正读写错误、读写延迟最大值;
+ *   3. 读延迟探测: 在整个 LBA 范围内均匀选取 probe= 个 4K 位置各读一次 (绕过缓存)。
+ * 每个工作线程持有自己的后端会话, 线程数与 --concurrency 无关 (最多 64)。
+ * 超过阈值的磁盘按 action= 从本次运行中排除 (exclude) 或只在报告中标记 (flag)。
+ * 驱动不提供的计数器 (类不存在或属性为空) 只报告, 不判为不合格。
+ */
+
+#include "storage_backend.h"
+#include "utils.h"
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct PreflightSpec {
+    bool enabled = false;
+
+    // 阈值, 超过即不合格
+    int maxTemperature = 60;           // °C
+    int maxWear = 90;                  // %
+    ULONGLONG maxReadErrors = 0;       // 未纠正的读错误
+    ULONGLONG maxWriteErrors = 0;      // 未纠正的写错误
+    double maxLatencyMs = 0;           // ReadLatencyMax / WriteLatencyMax, 0 表示不检查
+
+    int probeSamples = 16;             // 探测读次数, 0 表示不探测
+    double maxProbeMs = 100;           // 单次探测读的最大延迟
+
+    bool exclude = true;               // action=exclude: 排除不合格的磁盘; action=flag: 只标记
+};
+
+// 形式: temp=60,wear=90,read-errors=0,write-errors=0,latency=500,probe=16,probe-latency=100,action=exclude|flag
+bool ParsePreflightSpec(const std::wstring& params, PreflightSpec& spec);
+
+struct PreflightResult {
+    int diskNumber = -1;
+    std::wstring friendlyName;
+    ULONGLONG size = 0;
+
+    bool foundPhysicalDisk = false;
+    int healthStatus = -1;             // 0 Healthy / 1 Warning / 2 Unhealthy / 5 Unknown
+    std::vector<std::wstring> operationalStatus;
+
+    bool hasCounters = false;
+    int temperature = -1;              // -1 表示驱动未提供
+    int wear = -1;
+    long long readErrors = -1;
+    long long writeErrors = -1;
+    long long readLatencyMax = -1;     // ms
+    long long writeLatencyMax = -1;
+
+    std::vector<double> probeMs;       // 每次探测读的延迟
+    std::wstring probeSkipReason;
+
+    std::vector<std::wstring> failures;   // 不合格项
+    std::vector<std::wstring> notes;      // 未检查的项 (不算不合格)
+
+    std::chrono::nanoseconds started{ 0 };    // 后端时钟 (模拟时为虚拟时间)
+    std::chrono::nanoseconds finished{ 0 };
+
+    bool Passed() const { return failures.empty(); }
+    double ProbeMaxMs() const;
+};
+
+// 读延迟探测: 依次读取 samples 个位置, 输出每次读的毫秒数; 读失败返回 false
+using ReadProbe = std::function<bool(int diskNumber, ULONGLONG diskSize, int samples, std::vector<double>& latenciesMs)>;
+
+struct PreflightProbe {
+    ReadProbe read;                    // 为空时跳过探测 (回放)
+    std::wstring skipReason;
+    bool simulated = false;            // 延迟未真实经过, 由后端时钟推进 (模拟提供程序)
+};
+
+// 探测本机物理磁盘 \\.\PhysicalDrive<N> (只读, FILE_FLAG_NO_BUFFERING); 非 Windows 平台返回 false
+bool ProbePhysicalDrive(int diskNumber, ULONGLONG diskSize, int samples, std::vector<double>& latenciesMs);
+
+// 预检工作线程数上限 (只读查询, 不占用宿主机全局存储服务)
+const size_t PREFLIGHT_MAX_WORKERS = 64;
+
+// 并发预检, 结果与 diskNumbers 一一对应
+std::vector<PreflightResult> RunPreflight(
+    const BackendFactory& factory,
+    const std::vector<int>& diskNumbers,
+    const PreflightSpec& spec,
+    const PreflightProbe& probe,
+    size_t maxWorkers
+);
+
+// 预检报告; verbose 时每块盘一行, 否则只列出不合格的磁盘
+void PrintPreflightReport(const std::vector<PreflightResult>& results, const PreflightSpec& spec, bool verbose);
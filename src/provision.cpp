@@ -0,0 +1,349 @@
+﻿#include "provision.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+// 新卷在 --access-path 下的挂载目录: <根>\Disk<N>\Part<P>\ (AddAccessPath 要求以 \ 结尾)
+static wstring AccessPathFor(const wstring& root, int diskNumber, int partitionNumber) {
+    wstring path = root;
+    if (!path.empty() && path.back() != L'\\' && path.back() != L'/') path += L'\\';
+    return path + L"Disk" + to_wstring(diskNumber) + L"\\Part" + to_wstring(partitionNumber) + L"\\";
+}
+
+// 在新卷的根目录下运行 I/O 验收 (依次使用盘符、挂载目录、卷 GUID 路径)
+static bool QualifyNewVolume(
+    int diskNumber,
+    const ProvisionedVolume& volume,
+    const CommandLineArgs& args,
+    vector<QualifyResult>* qualify
+) {
+    wstring root = volume.driveLetter ? wstring(1, volume.driveLetter) + L":\\"
+        : !volume.accessPath.empty() ? volume.accessPath
+        : volume.guidPath;
+
+    QualifyResult result;
+    if (root.empty()) {
+        result.target = L"磁盘 " + to_wstring(diskNumber) + L" 分区 " + to_wstring(volume.partitionNumber);
+        result.skipReason = L"未分配盘符";
+    }
+    else {
+        QualifyVolume(root, args.qualify, result);
+    }
+
+    if (!args.quiet || !result.Passed()) {
+        PrintQualifyResult(wcout, result);
+    }
+    if (qualify) {
+        qualify->push_back(result);
+    }
+    return result.Passed();
+}
+
+bool ProvisionDisk(
+    DiskManager& diskMgr,
+    int diskNumber,
+    const CommandLineArgs& args,
+    vector<QualifyResult>* qualify,
+    vector<ProvisionedVolume>* volumes
+) {
+    diskMgr.SetBulk(args.bulk);
+
+    // 初始化为 GPT
+    if (args.initGpt) {
+        //if (!diskMgr.InitializeAsGPT(diskNumber)) {
+        //    wcerr << L"❌ GPT 初始化失败" << endl;
+        //    return false;
+        //}
+    }
+
+    // 创建分区并格式化
+    int partitionNumber = 1; // GPT 分区从 1 开始
+
+    for (size_t i = 0; i < args.partitions.size(); i++) {
+        auto& partSpec = args.partitions[i];
+
+        // 创建分区
+        if (!diskMgr.CreatePartition(
+            diskNumber,
+            partSpec.size,
+            partSpec.label,
+            partSpec.type,
+            partSpec.offset
+        )) {
+            wcerr << L"❌ 分区创建失败 (磁盘 " << diskNumber << L")" << endl;
+            return false;
+        }
+
+        // 如果有对应的格式化参数
+        if (i < args.formats.size()) {
+            auto& fmtSpec = args.formats[i];
+
+            // 等待分区就绪 (批量模式不分配盘符, 没有要等待的挂载)
+            if (!args.bulk) {
+                diskMgr.Wmi().Sleep(chrono::seconds(1));
+            }
+
+            ProvisionedVolume volume;
+            volume.partitionNumber = partitionNumber;
+            if (!diskMgr.FormatPartition(
+                diskNumber,
+                partitionNumber,
+                fmtSpec.fileSystem,
+                fmtSpec.volumeLabel,
+                fmtSpec.quickFormat,
+                fmtSpec.allocationUnitSize,
+                &volume.driveLetter,
+                &volume.guidPath
+            )) {
+                wcerr << L"❌ 分区格式化失败 (磁盘 " << diskNumber << L")" << endl;
+                return false;
+            }
+
+            // 挂载到文件夹; 模拟与回放时不在本机创建目录
+            if (!args.accessPathRoot.empty()) {
+                volume.accessPath = AccessPathFor(args.accessPathRoot, diskNumber, partitionNumber);
+                if (!args.simulate && args.replayPath.empty()) {
+                    error_code ec;
+                    filesystem::create_directories(filesystem::path(volume.accessPath), ec);
+                    if (ec) {
+                        wcerr << L"❌ 无法创建挂载目录: " << volume.accessPath << endl;
+                        return false;
+                    }
+                }
+                if (!diskMgr.AddAccessPath(diskNumber, partitionNumber, volume.accessPath)) {
+                    return false;
+                }
+            }
+
+            if (volumes) {
+                volumes->push_back(volume);
+            }
+
+            if (args.qualify.enabled
+                && !QualifyNewVolume(diskNumber, volume, args, qualify)) {
+                wcerr << L"❌ I/O 验收不合格 (磁盘 " << diskNumber << L", 分区 " << partitionNumber << L")" << endl;
+                return false;
+            }
+        }
+
+        partitionNumber++;
+    }
+
+    // 批量模式: 整个布局提交后只刷新一次宿主机存储缓存
+    if (args.bulk && !diskMgr.UpdateHostStorageCache()) {
+        return false;
+    }
+
+    // 原地调整已有分区 (在创建/格式化之后, 以便同一次运行中调整新分区)
+    for (const auto& resize : args.resizes) {
+        if (!diskMgr.ResizePartition(diskNumber, resize.partitionNumber, resize.size, resize.useMaximum)) {
+            wcerr << L"❌ 分区大小调整失败 (磁盘 " << diskNumber << L", 分区 " << resize.partitionNumber << L")" << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ProvisionPool(const BackendFactory& factory, CommandLineArgs& args, PooledDisk& pooled) {
+    // 条带按第一个格式化的分区规划; 其余同文件系统且未指定簇大小的分区沿用同一簇大小
+    wstring fileSystem = args.formats.empty() ? L"ntfs" : args.formats[0].fileSystem;
+    ULONGLONG clusterBytes = args.formats.empty() ? 0 : args.formats[0].allocationUnitSize;
+    StripeLayout stripe = PlanStripe(args.pool, (int)args.diskNumbers.size(), fileSystem, clusterBytes);
+
+    if (stripe.columns * stripe.copies > (int)args.diskNumbers.size()) {
+        wcerr << L"❌ " << stripe.columns << L" 列 × " << stripe.copies << L" 副本需要至少 "
+            << stripe.columns * stripe.copies << L" 块磁盘, 只选中了 " << args.diskNumbers.size() << L" 块" << endl;
+        return false;
+    }
+
+    if (stripe.clusterBytes) {
+        for (auto& format : args.formats) {
+            if (format.fileSystem == fileSystem && format.allocationUnitSize == 0) {
+                format.allocationUnitSize = stripe.clusterBytes;
+            }
+        }
+    }
+
+    wcout << L"🧱 存储池 " << args.pool.name << L": " << args.diskNumbers.size() << L" 块磁盘, "
+        << (args.pool.mirror ? L"Mirror ×" + to_wstring(stripe.copies) : wstring(L"Simple")) << L", "
+        << stripe.columns << L" 列 × " << FormatBytes(stripe.interleave) << L" 交错 = "
+        << FormatBytes(stripe.StripeWidth()) << L" 条带, 簇 "
+        << (stripe.clusterBytes ? FormatBytes(stripe.clusterBytes) : wstring(L"默认")) << endl;
+    if (!stripe.aligned) {
+        wcout << L"⚠️  条带宽度与簇大小不一致, 每次簇写入会跨列或只落在部分列上" << endl;
+    }
+
+    WMIManager wmi;
+    if (!wmi.Initialize(factory())) {
+        wcerr << L"❌ WMI 初始化失败" << endl;
+        return false;
+    }
+
+    if (!CreatePooledDisk(wmi, args.pool, args.diskNumbers, stripe, pooled, !args.quiet)) {
+        return false;
+    }
+
+    args.diskNumbers = { pooled.diskNumber };
+    wcout << endl;
+    return true;
+}
+
+bool RollbackPool(const BackendFactory& factory, const CommandLineArgs& args, PooledDisk& pooled) {
+    wcout << L"\n⚠️  虚拟磁盘 " << pooled.diskNumber << L" 配置失败, 删除存储池 " << args.pool.name << endl;
+
+    WMIManager wmi;
+    if (!wmi.Initialize(factory())) {
+        wcerr << L"❌ WMI 初始化失败" << endl;
+        PrintPooledDiskLeftovers(args.pool, pooled);
+        return false;
+    }
+
+    return RemovePooledDisk(wmi, args.pool, pooled, !args.quiet);
+}
+
+vector<ProvisionResult> ProvisionDisks(const BackendFactory& factory, const CommandLineArgs& args) {
+    vector<ProvisionResult> results(args.diskNumbers.size());
+    atomic<size_t> nextIndex(0);
+
+    auto worker = [&]() {
+        WMIManager wmi;
+        if (!wmi.Initialize(factory())) {
+            wcerr << L"❌ 工作线程无法连接存储提供程序" << endl;
+            return;
+        }
+
+        DiskManager diskMgr(wmi);
+        diskMgr.SetVerbose(!args.quiet);
+
+        for (size_t i = nextIndex++; i < results.size(); i = nextIndex++) {
+            ProvisionResult& result = results[i];
+            result.diskNumber = args.diskNumbers[i];
+            wmi.ResetStats();
+            result.started = wmi.Now();
+            result.success = ProvisionDisk(diskMgr, result.diskNumber, args, &result.qualify, &result.volumes);
+            result.finished = wmi.Now();
+            result.calls = wmi.Stats();
+        }
+    };
+
+    size_t workerCount = min((size_t)args.concurrency, results.size());
+    if (workerCount <= 1) {
+        worker();
+        return results;
+    }
+
+    vector<thread> workers;
+    for (size_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(worker);
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    return results;
+}
+
+void PrintProvisionSummary(const vector<ProvisionResult>& results, int concurrency, size_t partitionsPerDisk) {
+    size_t succeeded = 0;
+    vector<double> perDisk;
+    auto first = chrono::nanoseconds::max();
+    auto last = chrono::nanoseconds::min();
+
+    for (const auto& result : results) {
+        if (result.diskNumber < 0) continue;   // 未执行 (工作线程初始化失败)
+
+        if (result.success) succeeded++;
+        perDisk.push_back(chrono::duration<double>(result.finished - result.started).count());
+        first = min(first, result.started);
+        last = max(last, result.finished);
+    }
+
+    if (perDisk.empty()) return;
+
+    sort(perDisk.begin(), perDisk.end());
+    auto percentile = [&](double p) {
+        size_t index = (size_t)(p * (perDisk.size() - 1) + 0.5);
+        return perDisk[index];
+    };
+
+    double makespan = chrono::duration<double>(last - first).count();
+
+    wcout << L"\n📊 执行汇总" << endl;
+    wcout << L"==========================================" << endl;
+    wcout << L"  磁盘: " << results.size() << L" (成功 " << succeeded
+        << L", 失败 " << (results.size() - succeeded) << L")" << endl;
+    wcout << L"  并发: " << concurrency << endl;
+    wcout << fixed << setprecision(2);
+    wcout << L"  总耗时: " << makespan << L" s" << endl;
+    if (makespan > 0) {
+        wcout << L"  吞吐: " << (succeeded * 3600.0 / makespan) << L" 盘/小时" << endl;
+    }
+    wcout << L"  单盘耗时: p50 " << percentile(0.50) << L" s, p95 " << percentile(0.95)
+        << L" s, 最大 " << perDisk.back() << L" s" << endl;
+    if (partitionsPerDisk > 0) {
+        wcout << L"  每分区耗时: p50 " << setprecision(3) << (percentile(0.50) / partitionsPerDisk) << L" s" << endl;
+    }
+}
+
+void PrintProvisionVolumes(const vector<ProvisionResult>& results) {
+    wcout << L"\n📂 卷访问路径" << endl;
+    wcout << L"==========================================" << endl;
+    for (const auto& result : results) {
+        for (const auto& volume : result.volumes) {
+            wcout << L"  磁盘 " << result.diskNumber << L" 分区 " << volume.partitionNumber << L": ";
+            if (volume.driveLetter) wcout << volume.driveLetter << L":  ";
+            wcout << (volume.guidPath.empty() ? L"(无卷路径)" : volume.guidPath);
+            if (!volume.accessPath.empty()) wcout << L"  -> " << volume.accessPath;
+            wcout << endl;
+        }
+    }
+}
+
+void PrintProvisionQualify(const vector<ProvisionResult>& results) {
+    size_t passed = 0;
+    size_t failed = 0;
+    size_t skipped = 0;
+    vector<wstring> failures;
+
+    for (const auto& result : results) {
+        for (const auto& volume : result.qualify) {
+            if (volume.Skipped()) skipped++;
+            else if (volume.Passed()) passed++;
+            else {
+                failed++;
+                wstring reason = volume.completed ? L"" : L"测试失败";
+                for (const auto& failure : volume.failures) {
+                    reason += (reason.empty() ? L"" : L"; ") + failure;
+                }
+                failures.push_back(L"磁盘 " + to_wstring(result.diskNumber) + L" " + volume.target + L": " + reason);
+            }
+        }
+    }
+
+    wcout << L"\n🚦 I/O 验收" << endl;
+    wcout << L"==========================================" << endl;
+    wcout << L"  卷: 合格 " << passed << L", 不合格 " << failed << L", 跳过 " << skipped << endl;
+    for (const auto& failure : failures) {
+        wcout << L"  ❌ " << failure << endl;
+    }
+}
+
+void PrintProvisionCallStats(const vector<ProvisionResult>& results, size_t partitionsPerDisk) {
+    CallStats total;
+    size_t disks = 0;
+
+    for (const auto& result : results) {
+        if (result.diskNumber < 0) continue;
+        total += result.calls;
+        disks++;
+    }
+
+    PrintCallStats(total, disks, disks * partitionsPerDisk);
+}
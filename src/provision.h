@@ -0,0 +1,69 @@
+﻿#pragma once
+
+/*
+ * 分区与格式化执行器
+ *
+ * 对单块磁盘按命令行给出的布局依次创建分区并格式化;
+ * 多块磁盘时按 --concurrency 启动工作线程, 每个线程持有自己的后端会话。
+ * --bulk 时不分配盘符、不逐个等待挂载, 整盘完成后只刷新一次宿主机存储缓存,
+ * 每个分区的 WMI 往返次数恒定 (创建+格式化 10 次, 不等待盘符也不挂载), 每盘另加一次
+ * UpdateHostStorageCache, 单盘耗时随分区数近似线性增长; 预算见 bench.cpp 的 --check-budgets。
+ */
+
+#include "cli.h"
+#include "disk_manager.h"
+#include "qualify.h"
+#include "storage_pool.h"
+
+#include <chrono>
+#include <vector>
+
+// 新卷的访问方式 (盘符 / 卷 GUID 路径 / 文件夹挂载点)
+struct ProvisionedVolume {
+    int partitionNumber = 0;
+    wchar_t driveLetter = 0;
+    std::wstring guidPath;      // 卷 GUID 路径 (\\?\Volume{GUID}\ 形式)
+    std::wstring accessPath;    // --access-path 下的挂载目录
+};
+
+struct ProvisionResult {
+    int diskNumber = -1;
+    bool success = false;
+    std::chrono::nanoseconds started{ 0 };    // 后端时钟 (模拟时为虚拟时间)
+    std::chrono::nanoseconds finished{ 0 };
+    CallStats calls;                          // 本盘的 WMI 往返统计
+    std::vector<QualifyResult> qualify;       // 各新卷的 I/O 验收结果 (--qualify)
+    std::vector<ProvisionedVolume> volumes;   // 各新卷的访问路径
+};
+
+// 在单块磁盘上执行布局; 指定 --qualify 时每个格式化的卷在 qualify 中追加一项验收结果,
+// 不合格视为本盘失败; volumes 非空时追加每个格式化的卷的访问路径
+bool ProvisionDisk(
+    DiskManager& diskMgr,
+    int diskNumber,
+    const CommandLineArgs& args,
+    std::vector<QualifyResult>* qualify = nullptr,
+    std::vector<ProvisionedVolume>* volumes = nullptr
+);
+
+// --pool: 规划条带 (补全格式化的簇大小), 把 args.diskNumbers 组成存储池与虚拟磁盘,
+// 成功后 args.diskNumbers 替换为虚拟磁盘的编号
+bool ProvisionPool(const BackendFactory& factory, CommandLineArgs& args, PooledDisk& pooled);
+
+// 虚拟磁盘上的分区/格式化失败时删除 ProvisionPool 建立的虚拟磁盘与存储池
+bool RollbackPool(const BackendFactory& factory, const CommandLineArgs& args, PooledDisk& pooled);
+
+// 并发执行多块磁盘
+std::vector<ProvisionResult> ProvisionDisks(const BackendFactory& factory, const CommandLineArgs& args);
+
+// 输出汇总: 成功/失败数、总耗时、每小时磁盘数、单盘耗时分位数 (及每分区耗时)
+void PrintProvisionSummary(const std::vector<ProvisionResult>& results, int concurrency, size_t partitionsPerDisk = 0);
+
+// 输出各新卷的盘符 / 卷 GUID 路径 / 挂载目录 (--guid-paths)
+void PrintProvisionVolumes(const std::vector<ProvisionResult>& results);
+
+// 输出 I/O 验收汇总: 合格/不合格/跳过的卷数与不合格项
+void PrintProvisionQualify(const std::vector<ProvisionResult>& results);
+
+// 汇总各盘的往返统计并输出
+void PrintProvisionCallStats(const std::vector<ProvisionResult>& results, size_t partitionsPerDisk);
@@ -0,0 +1,622 @@
+﻿#include "qualify.h"
+
+#include "uring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// 测试范围的对齐 (也满足直接 I/O 的扇区对齐)
+static const ULONGLONG QUALIFY_ALIGNMENT = 1024 * 1024;
+
+// 小于此大小的范围不测试
+static const ULONGLONG QUALIFY_MIN_BYTES = 16ULL * 1024 * 1024;
+
+static const size_t SEQ_BLOCK_BYTES = 1024 * 1024;
+static const int SEQ_QUEUE_DEPTH = 4;
+static const size_t RANDOM_BLOCK_BYTES = 4096;
+
+static const wchar_t* const QUALIFY_TEMP_NAME = L"disk_part_fmt_qualify.tmp";
+
+bool ParseQualifySpec(const wstring& params, QualifySpec& spec) {
+    auto paramMap = ParseParams(params);
+
+    try {
+        if (paramMap.count(L"size"))
+            spec.size = ParseSizeString(paramMap[L"size"]);
+
+        if (paramMap.count(L"time"))
+            spec.seconds = stod(paramMap[L"time"]);
+
+        if (paramMap.count(L"qd")) {
+            // 形式: 1/4/32
+            spec.queueDepths.clear();
+            for (const auto& depth : SplitString(paramMap[L"qd"], L'/')) {
+                int value = stoi(depth);
+                if (value < 1 || value > 256) return false;
+                spec.queueDepths.push_back(value);
+            }
+        }
+
+        if (paramMap.count(L"seq-read"))
+            spec.minSeqReadMBps = stod(paramMap[L"seq-read"]);
+
+        if (paramMap.count(L"seq-write"))
+            spec.minSeqWriteMBps = stod(paramMap[L"seq-write"]);
+
+        if (paramMap.count(L"iops"))
+            spec.minRandReadIops = stod(paramMap[L"iops"]);
+    }
+    catch (...) {
+        return false;
+    }
+
+    return spec.size >= QUALIFY_MIN_BYTES && spec.seconds > 0 && !spec.queueDepths.empty();
+}
+
+// ================================
+// 测试任务
+// ================================
+
+struct IoJob {
+    bool write = false;
+    bool random = false;
+    size_t blockSize = 0;
+    int queueDepth = 1;
+    ULONGLONG offset = 0;      // 文件内的测试范围
+    ULONGLONG length = 0;
+    double seconds = 1;
+};
+
+struct IoJobResult {
+    ULONGLONG ops = 0;
+    ULONGLONG bytes = 0;
+    double seconds = 0;
+};
+
+// 请求偏移: 顺序测试依次覆盖范围, 随机测试在范围内均匀选取块
+class IoCursor {
+public:
+    explicit IoCursor(const IoJob& job)
+        : job(job), blocks(job.length / job.blockSize), pick(0, blocks > 0 ? blocks - 1 : 0) {}
+
+    // 顺序测试覆盖完范围后返回 false
+    bool Next(ULONGLONG& offset) {
+        if (blocks == 0) return false;
+        if (job.random) {
+            offset = job.offset + pick(rng) * job.blockSize;
+            return true;
+        }
+        if (next >= blocks) return false;
+        offset = job.offset + next++ * job.blockSize;
+        return true;
+    }
+
+private:
+    const IoJob& job;
+    ULONGLONG blocks;
+    ULONGLONG next = 0;
+    mt19937_64 rng{ 1 };
+    uniform_int_distribution<ULONGLONG> pick;
+};
+
+// 直接 I/O 要求缓冲区按扇区对齐, 按页对齐即可满足
+class AlignedBuffer {
+public:
+    explicit AlignedBuffer(size_t size) : size(size) {
+#ifdef _WIN32
+        data = _aligned_malloc(size, 4096);
+#else
+        if (posix_memalign(&data, 4096, size) != 0) data = nullptr;
+#endif
+        // 非零且不重复的内容, 避免存储端压缩或去重
+        if (data) {
+            mt19937_64 fill(size);
+            uint64_t* words = (uint64_t*)data;
+            for (size_t i = 0; i < size / sizeof(uint64_t); i++) words[i] = fill();
+        }
+    }
+
+    ~AlignedBuffer() {
+#ifdef _WIN32
+        _aligned_free(data);
+#else
+        free(data);
+#endif
+    }
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    void* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    void* data = nullptr;
+    size_t size = 0;
+};
+
+// 完成驱动的队列: 保持 queueDepth 个请求在途, 每完成一个补交一个, 直到超时或覆盖完范围。
+// submit(slot, offset) 提交请求; wait(slot, bytes) 等待任一请求完成
+template <typename Submit, typename Wait>
+static bool RunQueue(const IoJob& job, IoJobResult& result, Submit submit, Wait wait) {
+    IoCursor cursor(job);
+    auto start = chrono::steady_clock::now();
+    auto deadline = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(job.seconds));
+
+    int inflight = 0;
+    bool failed = false;
+    ULONGLONG offset = 0;
+
+    for (int slot = 0; slot < job.queueDepth && cursor.Next(offset); slot++) {
+        if (!submit(slot, offset)) {
+            failed = true;
+            break;
+        }
+        inflight++;
+    }
+
+    while (inflight > 0) {
+        int slot = -1;
+        size_t bytes = 0;
+        if (!wait(slot, bytes)) return false;
+        inflight--;
+
+        if (bytes != job.blockSize) {
+            failed = true;
+            continue;
+        }
+        result.ops++;
+        result.bytes += bytes;
+
+        // 出错后只回收在途请求
+        if (!failed && chrono::steady_clock::now() < deadline && cursor.Next(offset)) {
+            if (!submit(slot, offset)) {
+                failed = true;
+                continue;
+            }
+            inflight++;
+        }
+    }
+
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return !failed;
+}
+
+// ================================
+// 平台相关: 测试文件与 I/O 引擎
+// ================================
+
+#ifdef _WIN32
+
+class QualifyFile {
+public:
+    ~QualifyFile() { Close(); }
+
+    // temporary 为 true 时新建文件并设置长度, 关闭时删除
+    bool Open(const wstring& path, bool temporary, ULONGLONG size) {
+        DWORD flags = FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH;
+        if (temporary) flags |= FILE_FLAG_DELETE_ON_CLOSE;
+
+        handle = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+            temporary ? CREATE_ALWAYS : OPEN_EXISTING, flags, NULL);
+        if (handle == INVALID_HANDLE_VALUE) {
+            wcerr << L"❌ 无法打开测试文件: " << path << L" (错误 " << GetLastError() << L")" << endl;
+            return false;
+        }
+
+        if (temporary) {
+            FILE_END_OF_FILE_INFO eof = {};
+            eof.EndOfFile.QuadPart = (LONGLONG)size;
+            if (!SetFileInformationByHandle(handle, FileEndOfFileInfo, &eof, sizeof(eof))) {
+                wcerr << L"❌ 无法设置测试文件大小: " << path << endl;
+                return false;
+            }
+        }
+
+        port = CreateIoCompletionPort(handle, NULL, 0, 1);
+        return port != NULL;
+    }
+
+    void Close() {
+        if (port) CloseHandle(port);
+        if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+        port = NULL;
+        handle = INVALID_HANDLE_VALUE;
+    }
+
+    bool Flush() { return FlushFileBuffers(handle) != FALSE; }
+    bool Direct() const { return true; }
+
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    HANDLE port = NULL;
+};
+
+class IoEngine {
+public:
+    IoEngine(QualifyFile& file, int) : file(file) {}
+
+    const wchar_t* Name() const { return L"overlapped"; }
+
+    // 重叠 I/O, 完成通知经完成端口返回
+    bool Run(const IoJob& job, IoJobResult& result) {
+        struct Slot {
+            OVERLAPPED overlapped;
+            unique_ptr<AlignedBuffer> buffer;
+        };
+
+        vector<Slot> slots(job.queueDepth);
+        for (auto& slot : slots) {
+            slot.buffer.reset(new AlignedBuffer(job.blockSize));
+            if (!slot.buffer->Data()) return false;
+        }
+
+        auto submit = [&](int index, ULONGLONG offset) {
+            Slot& slot = slots[index];
+            memset(&slot.overlapped, 0, sizeof(slot.overlapped));
+            slot.overlapped.Offset = (DWORD)offset;
+            slot.overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+            BOOL ok = job.write
+                ? WriteFile(file.handle, slot.buffer->Data(), (DWORD)job.blockSize, NULL, &slot.overlapped)
+                : ReadFile(file.handle, slot.buffer->Data(), (DWORD)job.blockSize, NULL, &slot.overlapped);
+            return ok || GetLastError() == ERROR_IO_PENDING;
+        };
+
+        auto wait = [&](int& index, size_t& bytes) {
+            DWORD transferred = 0;
+            ULONG_PTR key = 0;
+            LPOVERLAPPED overlapped = NULL;
+            BOOL ok = GetQueuedCompletionStatus(file.port, &transferred, &key, &overlapped, INFINITE);
+            if (!overlapped) return false;
+
+            // 请求失败时 transferred 不等于块大小, 由 RunQueue 记为出错
+            index = (int)(CONTAINING_RECORD(overlapped, Slot, overlapped) - slots.data());
+            bytes = ok ? transferred : 0;
+            return true;
+        };
+
+        return RunQueue(job, result, submit, wait);
+    }
+
+private:
+    QualifyFile& file;
+};
+
+#else
+
+class QualifyFile {
+public:
+    ~QualifyFile() { Close(); }
+
+    // temporary 为 true 时新建文件并设置长度, 打开后立即删除目录项
+    bool Open(const wstring& path, bool temporary, ULONGLONG size) {
+        string utf8 = ToUtf8(path);
+        int flags = O_RDWR | O_CLOEXEC | (temporary ? O_CREAT | O_EXCL : 0);
+
+#ifdef O_DIRECT
+        fd = open(utf8.c_str(), flags | O_DIRECT, 0600);
+        if (fd < 0 && errno == EINVAL) {
+            // tmpfs 等不支持直接 I/O, 结果会包含页缓存
+            direct = false;
+            fd = open(utf8.c_str(), flags, 0600);
+        }
+#else
+        fd = open(utf8.c_str(), flags, 0600);
+#ifdef F_NOCACHE
+        if (fd >= 0) fcntl(fd, F_NOCACHE, 1);
+#else
+        direct = false;
+#endif
+#endif
+        if (fd < 0) {
+            wcerr << L"❌ 无法打开测试文件: " << path << L" (" << FromUtf8(strerror(errno)) << L")" << endl;
+            return false;
+        }
+
+        if (temporary) {
+            unlink(utf8.c_str());
+            if (ftruncate(fd, (off_t)size) != 0) {
+                wcerr << L"❌ 无法设置测试文件大小: " << path << endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void Close() {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+
+    bool Flush() { return fdatasync(fd) == 0; }
+    bool Direct() const { return direct; }
+
+    int fd = -1;
+    bool direct = true;
+};
+
+class IoEngine {
+public:
+    IoEngine(QualifyFile& file, int maxQueueDepth) : file(file) {
+#ifdef HAVE_IO_URING
+        useRing = ring.Setup((unsigned)maxQueueDepth);
+#else
+        (void)maxQueueDepth;
+#endif
+    }
+
+    const wchar_t* Name() const {
+#ifdef HAVE_IO_URING
+        if (useRing) return L"io_uring";
+#endif
+        return L"threads";
+    }
+
+    bool Run(const IoJob& job, IoJobResult& result) {
+#ifdef HAVE_IO_URING
+        // 回收在途请求失败时环已关闭, 其余测试改用线程
+        if (useRing && !ring.Ready()) useRing = false;
+        if (useRing) return RunRing(job, result);
+#endif
+        return RunThreads(job, result);
+    }
+
+private:
+#ifdef HAVE_IO_URING
+    bool RunRing(const IoJob& job, IoJobResult& result) {
+        vector<unique_ptr<AlignedBuffer>> buffers;
+        vector<iovec> iovs(job.queueDepth);
+        for (int i = 0; i < job.queueDepth; i++) {
+            buffers.emplace_back(new AlignedBuffer(job.blockSize));
+            if (!buffers.back()->Data()) return false;
+            iovs[i].iov_base = buffers.back()->Data();
+            iovs[i].iov_len = job.blockSize;
+        }
+
+        auto submit = [&](int slot, ULONGLONG offset) {
+            return ring.Queue(file.fd, job.write, &iovs[slot], offset, (uint64_t)slot);
+        };
+
+        // 等待失败时 RunQueue 直接返回, 先回收在途请求再释放 buffers
+        auto wait = [&](int& slot, size_t& bytes) {
+            uint64_t tag = 0;
+            int res = 0;
+            if (!ring.Wait(tag, res)) {
+                ring.Drain();
+                return false;
+            }
+            slot = (int)tag;
+            bytes = res > 0 ? (size_t)res : 0;
+            return true;
+        };
+
+        return RunQueue(job, result, submit, wait);
+    }
+#endif
+
+    // 每个队列槽一个线程, 同步 pread/pwrite
+    bool RunThreads(const IoJob& job, IoJobResult& result) {
+        IoCursor cursor(job);
+        mutex cursorLock;
+        atomic<bool> failed(false);
+        atomic<ULONGLONG> ops(0);
+
+        auto start = chrono::steady_clock::now();
+        auto deadline = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(job.seconds));
+
+        auto worker = [&]() {
+            AlignedBuffer buffer(job.blockSize);
+            if (!buffer.Data()) {
+                failed = true;
+                return;
+            }
+
+            while (!failed) {
+                ULONGLONG offset = 0;
+                {
+                    lock_guard<mutex> guard(cursorLock);
+                    if (chrono::steady_clock::now() >= deadline || !cursor.Next(offset)) break;
+                }
+
+                ssize_t n = job.write
+                    ? pwrite(file.fd, buffer.Data(), job.blockSize, (off_t)offset)
+                    : pread(file.fd, buffer.Data(), job.blockSize, (off_t)offset);
+                if (n != (ssize_t)job.blockSize) {
+                    failed = true;
+                    break;
+                }
+                ops++;
+            }
+        };
+
+        vector<thread> workers;
+        for (int i = 0; i < job.queueDepth; i++) {
+            workers.emplace_back(worker);
+        }
+        for (auto& t : workers) {
+            t.join();
+        }
+
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        result.ops = ops;
+        result.bytes = ops * job.blockSize;
+        return !failed;
+    }
+
+    QualifyFile& file;
+#ifdef HAVE_IO_URING
+    Uring ring;
+    bool useRing = false;
+#endif
+};
+
+#endif
+
+// ================================
+// 测试流程
+// ================================
+
+static double MBps(const IoJobResult& r) {
+    return r.seconds > 0 ? r.bytes / 1e6 / r.seconds : 0;
+}
+
+static double Iops(const IoJobResult& r) {
+    return r.seconds > 0 ? r.ops / r.seconds : 0;
+}
+
+static void CheckThreshold(
+    QualifyResult& result,
+    const wchar_t* name,
+    double value,
+    double minimum,
+    const wchar_t* unit,
+    int precision
+) {
+    if (minimum <= 0 || value >= minimum) return;
+
+    wostringstream text;
+    text << name << L" " << fixed << setprecision(precision) << value << L" " << unit
+        << L" 低于 " << setprecision(0) << minimum << L" " << unit;
+    result.failures.push_back(text.str());
+}
+
+static bool RunQualify(QualifyFile& file, ULONGLONG offset, ULONGLONG length, const QualifySpec& spec, QualifyResult& result) {
+    int maxDepth = max(SEQ_QUEUE_DEPTH, *max_element(spec.queueDepths.begin(), spec.queueDepths.end()));
+    IoEngine engine(file, maxDepth);
+    result.engine = engine.Name();
+    result.direct = file.Direct();
+
+    // 1. 顺序写 (计入刷新时间); 之后的读只访问写过的部分, 避免读到空洞
+    IoJob job;
+    job.write = true;
+    job.blockSize = SEQ_BLOCK_BYTES;
+    job.queueDepth = SEQ_QUEUE_DEPTH;
+    job.offset = offset;
+    job.length = length;
+    job.seconds = spec.seconds;
+
+    IoJobResult written;
+    auto start = chrono::steady_clock::now();
+    if (!engine.Run(job, written) || !file.Flush()) {
+        wcerr << L"❌ 顺序写测试失败: " << result.target << endl;
+        return false;
+    }
+    written.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.seqWriteMBps = MBps(written);
+    result.testedBytes = written.bytes;
+
+    // 2. 顺序读
+    job.write = false;
+    job.length = written.bytes;
+
+    IoJobResult read;
+    if (!engine.Run(job, read)) {
+        wcerr << L"❌ 顺序读测试失败: " << result.target << endl;
+        return false;
+    }
+    result.seqReadMBps = MBps(read);
+
+    // 3. 4K 随机读
+    job.random = true;
+    job.blockSize = RANDOM_BLOCK_BYTES;
+    for (int depth : spec.queueDepths) {
+        job.queueDepth = depth;
+
+        IoJobResult random;
+        if (!engine.Run(job, random)) {
+            wcerr << L"❌ 随机读测试失败 (QD" << depth << L"): " << result.target << endl;
+            return false;
+        }
+        result.randReadIops.push_back({ depth, Iops(random) });
+    }
+
+    result.completed = true;
+
+    // 随机读阈值按最大队列深度的结果判断
+    auto best = max_element(result.randReadIops.begin(), result.randReadIops.end());
+    CheckThreshold(result, L"顺序写", result.seqWriteMBps, spec.minSeqWriteMBps, L"MB/s", 1);
+    CheckThreshold(result, L"顺序读", result.seqReadMBps, spec.minSeqReadMBps, L"MB/s", 1);
+    CheckThreshold(result, L"4K 随机读", best->second, spec.minRandReadIops, L"IOPS", 0);
+    return true;
+}
+
+bool QualifyRange(const wstring& path, ULONGLONG offset, ULONGLONG length, const QualifySpec& spec, QualifyResult& result) {
+    result = QualifyResult();
+    result.target = path + L" @ " + FormatBytes(offset);
+
+    length = min(length, spec.size) / QUALIFY_ALIGNMENT * QUALIFY_ALIGNMENT;
+    if (offset % QUALIFY_ALIGNMENT != 0 || length < QUALIFY_MIN_BYTES) {
+        result.skipReason = L"空闲范围不足 " + FormatBytes(QUALIFY_MIN_BYTES);
+        return false;
+    }
+
+    QualifyFile file;
+    return file.Open(path, false, 0) && RunQualify(file, offset, length, spec, result);
+}
+
+bool QualifyVolume(const wstring& root, const QualifySpec& spec, QualifyResult& result) {
+    result = QualifyResult();
+    result.target = root;
+
+    error_code ec;
+    auto space = filesystem::space(filesystem::path(root), ec);
+    if (ec) {
+        wcerr << L"❌ 无法查询可用空间: " << root << endl;
+        return false;
+    }
+
+    ULONGLONG length = min<ULONGLONG>(spec.size, space.available / 2) / QUALIFY_ALIGNMENT * QUALIFY_ALIGNMENT;
+    if (length < QUALIFY_MIN_BYTES) {
+        result.skipReason = L"可用空间不足 " + FormatBytes(QUALIFY_MIN_BYTES * 2);
+        return false;
+    }
+
+    QualifyFile file;
+    return file.Open((filesystem::path(root) / QUALIFY_TEMP_NAME).wstring(), true, length)
+        && RunQualify(file, 0, length, spec, result);
+}
+
+void PrintQualifyResult(wostream& out, const QualifyResult& result) {
+    out << L"  🚦 " << result.target;
+
+    if (!result.skipReason.empty()) {
+        out << L": 跳过 (" << result.skipReason << L")" << endl;
+        return;
+    }
+    if (!result.completed) {
+        out << L": ❌ 测试失败" << endl;
+        return;
+    }
+
+    out << L" [" << result.engine << (result.direct ? L"" : L", 含缓存") << L", " << FormatBytes(result.testedBytes) << L"]"
+        << fixed << setprecision(1)
+        << L" 写 " << result.seqWriteMBps << L" MB/s, 读 " << result.seqReadMBps << L" MB/s, 4K 随机读";
+    for (const auto& entry : result.randReadIops) {
+        out << L" QD" << entry.first << L" " << setprecision(0) << entry.second;
+    }
+    out << L" IOPS  " << (result.Passed() ? L"✓" : L"❌") << endl;
+
+    for (const auto& failure : result.failures) {
+        out << L"      ❌ " << failure << endl;
+    }
+}
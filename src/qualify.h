@@ -0,0 +1,70 @@
+﻿#pragma once
+
+/*
+ * 格式化后的 I/O 验收测试 (--qualify)
+ *
+ * 在刚格式化的卷 (卷根目录下的临时文件) 或 raw 镜像中分区的空闲范围上运行一组有时限的基准:
+ *   1. 顺序写: 1 MiB 块, 队列深度 4
+ *   2. 顺序读: 重读第 1 步写过的范围
+ *   3. 4K 随机读: 依次使用各个队列深度 (默认 1, 4, 32)
+ * 每项在 time= 秒后或覆盖整个测试范围后结束; 读写绕过缓存 (FILE_FLAG_NO_BUFFERING / O_DIRECT)。
+ *
+ * 异步引擎: Windows 为重叠 I/O + 完成端口; Linux 为 io_uring, 内核不支持或被禁止时
+ * 退回每个队列槽一个线程的 pread/pwrite。
+ * 低于阈值 (seq-read= / seq-write= MB/s, iops= 随机读 IOPS, 取最大队列深度) 的卷判为不合格。
+ */
+
+#include "utils.h"
+
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct QualifySpec {
+    bool enabled = false;
+    ULONGLONG size = 256ULL * 1024 * 1024;     // 测试范围
+    double seconds = 1.0;                      // 每项测试的时间上限
+    std::vector<int> queueDepths = { 1, 4, 32 };
+
+    // 阈值, 0 表示只报告不检查
+    double minSeqReadMBps = 0;
+    double minSeqWriteMBps = 0;
+    double minRandReadIops = 0;
+};
+
+// 形式: size=256M,time=1,qd=1/4/32,seq-read=200,seq-write=150,iops=5000
+bool ParseQualifySpec(const std::wstring& params, QualifySpec& spec);
+
+struct QualifyResult {
+    std::wstring target;               // 卷根目录或 "镜像文件 @ 偏移"
+    const wchar_t* engine = L"";       // overlapped / io_uring / threads
+    bool direct = true;                // 是否绕过缓存
+    ULONGLONG testedBytes = 0;         // 顺序写覆盖的范围, 读测试只访问这部分
+    double seqWriteMBps = 0;
+    double seqReadMBps = 0;
+    std::vector<std::pair<int, double>> randReadIops;   // (队列深度, IOPS)
+
+    bool completed = false;            // I/O 出错时为 false
+    std::vector<std::wstring> failures;                 // 低于阈值的项
+    std::wstring skipReason;           // 范围或可用空间太小而未测试 (不算不合格)
+
+    bool Skipped() const { return !skipReason.empty(); }
+    bool Passed() const { return Skipped() || (completed && failures.empty()); }
+};
+
+// 测试 path 中的 [offset, offset + length) (长度按 1 MiB 截断, 最多 spec.size);
+// 范围内的原有内容会被覆盖, 由调用方负责选择空闲范围并在之后恢复
+bool QualifyRange(
+    const std::wstring& path,
+    ULONGLONG offset,
+    ULONGLONG length,
+    const QualifySpec& spec,
+    QualifyResult& result
+);
+
+// 在卷根目录 (如 E:\) 下创建临时文件测试, 结束后删除; 大小不超过可用空间的一半
+bool QualifyVolume(const std::wstring& root, const QualifySpec& spec, QualifyResult& result);
+
+// 单行结果 (含不合格项)
+void PrintQualifyResult(std::wostream& out, const QualifyResult& result);
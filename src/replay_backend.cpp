@@ -0,0 +1,596 @@
+﻿#include "replay_backend.h"
+
+#include <cwchar>
+#include <cwctype>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+// 回放不匹配时返回的错误码 (E_FAIL)
+static const HRESULT REPLAY_MISMATCH = (HRESULT)0x80004005L;
+
+static const char* const LOG_HEADER = "# disk_part_fmt call log v1";
+
+// ================================
+// 对象编码
+// ================================
+
+static void AppendQuoted(wstring& out, const wstring& str) {
+    out += L'"';
+    for (wchar_t c : str) {
+        switch (c) {
+        case L'"': out += L"\\\""; break;
+        case L'\\': out += L"\\\\"; break;
+        case L'\n': out += L"\\n"; break;
+        case L'\r': out += L"\\r"; break;
+        case L'\t': out += L"\\t"; break;
+        default: out += c; break;
+        }
+    }
+    out += L'"';
+}
+
+static void AppendObject(wstring& out, const StorageObjectPtr& obj);
+
+static void AppendValue(wstring& out, const PropValue& value) {
+    switch (value.GetKind()) {
+    case PropValue::Kind::Bool:
+        out += value.AsBool() ? L"b1" : L"b0";
+        break;
+    case PropValue::Kind::Int:
+        out += L'i' + to_wstring(value.AsInt());
+        break;
+    case PropValue::Kind::UInt64:
+        out += L'u' + to_wstring(value.AsUInt64());
+        break;
+    case PropValue::Kind::String:
+        out += L's';
+        AppendQuoted(out, value.AsString());
+        break;
+    case PropValue::Kind::Object:
+        out += L'o';
+        AppendObject(out, value.AsObject());
+        break;
+    case PropValue::Kind::StringArray:
+        out += L"S[";
+        for (size_t i = 0; i < value.AsStringArray().size(); i++) {
+            if (i) out += L',';
+            AppendQuoted(out, value.AsStringArray()[i]);
+        }
+        out += L']';
+        break;
+    case PropValue::Kind::ObjectArray:
+        out += L"O[";
+        for (size_t i = 0; i < value.AsObjectArray().size(); i++) {
+            if (i) out += L',';
+            AppendObject(out, value.AsObjectArray()[i]);
+        }
+        out += L']';
+        break;
+    default:
+        out += L'e';
+        break;
+    }
+}
+
+static void AppendObject(wstring& out, const StorageObjectPtr& obj) {
+    if (!obj) {
+        out += L'-';
+        return;
+    }
+
+    out += L'{';
+    bool first = true;
+    for (const auto& name : obj->GetNames()) {
+        if (!first) out += L',';
+        first = false;
+        AppendQuoted(out, name);
+        out += L'=';
+        AppendValue(out, obj->Prop(name));
+    }
+    out += L'}';
+}
+
+wstring EncodeObject(const StorageObjectPtr& obj) {
+    wstring out;
+    AppendObject(out, obj);
+    return out;
+}
+
+// 简单的递归下降解析
+class LogReader {
+public:
+    explicit LogReader(const wstring& text) : text(text), pos(0) {}
+
+    bool AtEnd() {
+        SkipSpaces();
+        return pos >= text.size();
+    }
+
+    bool Token(wstring& token) {
+        SkipSpaces();
+        size_t start = pos;
+        while (pos < text.size() && text[pos] != L' ') pos++;
+        token = text.substr(start, pos - start);
+        return !token.empty();
+    }
+
+    bool Quoted(wstring& str) {
+        SkipSpaces();
+        if (!Consume(L'"')) return false;
+
+        str.clear();
+        while (pos < text.size() && text[pos] != L'"') {
+            wchar_t c = text[pos++];
+            if (c == L'\\' && pos < text.size()) {
+                c = text[pos++];
+                if (c == L'n') c = L'\n';
+                else if (c == L'r') c = L'\r';
+                else if (c == L't') c = L'\t';
+            }
+            str += c;
+        }
+        return Consume(L'"');
+    }
+
+    bool Object(StorageObjectPtr& obj) {
+        SkipSpaces();
+        if (Consume(L'-')) {
+            obj = nullptr;
+            return true;
+        }
+        if (!Consume(L'{')) return false;
+
+        auto bag = make_shared<PropertyBag>();
+        if (!Consume(L'}')) {
+            do {
+                wstring name;
+                PropValue value;
+                if (!Quoted(name) || !Consume(L'=') || !Value(value)) return false;
+                bag->Put(name, value);
+            } while (Consume(L','));
+
+            if (!Consume(L'}')) return false;
+        }
+
+        obj = bag;
+        return true;
+    }
+
+private:
+    bool Value(PropValue& value) {
+        if (pos >= text.size()) return false;
+
+        switch (text[pos++]) {
+        case L'e':
+            value = PropValue();
+            return true;
+        case L'b':
+            if (pos >= text.size()) return false;
+            value = PropValue(text[pos++] == L'1');
+            return true;
+        case L'i':
+            value = PropValue(wcstoll(Number().c_str(), nullptr, 10));
+            return true;
+        case L'u':
+            value = PropValue(wcstoull(Number().c_str(), nullptr, 10));
+            return true;
+        case L's':
+        {
+            wstring str;
+            if (!Quoted(str)) return false;
+            value = PropValue(str);
+            return true;
+        }
+        case L'o':
+        {
+            StorageObjectPtr obj;
+            if (!Object(obj)) return false;
+            value = PropValue(obj);
+            return true;
+        }
+        case L'S':
+        {
+            vector<wstring> items;
+            if (!Consume(L'[')) return false;
+            if (!Consume(L']')) {
+                do {
+                    wstring item;
+                    if (!Quoted(item)) return false;
+                    items.push_back(item);
+                } while (Consume(L','));
+                if (!Consume(L']')) return false;
+            }
+            value = PropValue(items);
+            return true;
+        }
+        case L'O':
+        {
+            vector<StorageObjectPtr> items;
+            if (!Consume(L'[')) return false;
+            if (!Consume(L']')) {
+                do {
+                    StorageObjectPtr item;
+                    if (!Object(item)) return false;
+                    items.push_back(item);
+                } while (Consume(L','));
+                if (!Consume(L']')) return false;
+            }
+            value = PropValue(items);
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    wstring Number() {
+        size_t start = pos;
+        if (pos < text.size() && text[pos] == L'-') pos++;
+        while (pos < text.size() && iswdigit(text[pos])) pos++;
+        return text.substr(start, pos - start);
+    }
+
+    bool Consume(wchar_t c) {
+        if (pos < text.size() && text[pos] == c) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    void SkipSpaces() {
+        while (pos < text.size() && text[pos] == L' ') pos++;
+    }
+
+    const wstring& text;
+    size_t pos;
+};
+
+bool DecodeObject(const wstring& text, StorageObjectPtr& obj) {
+    LogReader reader(text);
+    return reader.Object(obj) && reader.AtEnd();
+}
+
+// ================================
+// 录制
+// ================================
+
+class RecordingEnumerator : public ObjectEnumerator {
+public:
+    RecordingEnumerator(unique_ptr<ObjectEnumerator> inner, size_t id)
+        : inner(move(inner)), id(id) {}
+
+    bool Next(StorageObjectPtr& obj) override {
+        return inner->Next(obj);
+    }
+
+    unique_ptr<ObjectEnumerator> inner;
+    size_t id;
+};
+
+class RecordingBackend : public StorageBackend {
+public:
+    RecordingBackend(unique_ptr<StorageBackend> inner, shared_ptr<CallSession> log)
+        : inner(move(inner)), log(move(log)), queries(0) {}
+
+    wstring Name() const override { return L"record:" + inner->Name(); }
+
+    bool ExecQuery(const wstring& query, unique_ptr<ObjectEnumerator>& result) override {
+        size_t id = queries++;
+        unique_ptr<ObjectEnumerator> innerResult;
+        bool ok = Record(CallKind::ExecQuery, query, nullptr,
+            [&]() { return inner->ExecQuery(query, innerResult); });
+        if (ok) {
+            result.reset(new RecordingEnumerator(move(innerResult), id));
+        }
+        return ok;
+    }
+
+    bool Next(ObjectEnumerator& enumerator, StorageObjectPtr& obj) override {
+        auto& recording = static_cast<RecordingEnumerator&>(enumerator);
+        return Record(CallKind::Next, to_wstring(recording.id), &obj,
+            [&]() { return inner->Next(*recording.inner, obj); });
+    }
+
+    bool GetObjectByPath(const wstring& path, StorageObjectPtr& result) override {
+        return Record(CallKind::GetObject, path, &result,
+            [&]() { return inner->GetObjectByPath(path, result); });
+    }
+
+    bool GetMethod(const StorageObjectPtr& classObj, const wstring& methodName,
+        StorageObjectPtr& inParamsDefinition) override {
+        return Record(CallKind::GetMethod, classObj->ClassName() + L"." + methodName, &inParamsDefinition,
+            [&]() { return inner->GetMethod(classObj, methodName, inParamsDefinition); });
+    }
+
+    bool SpawnInstance(const StorageObjectPtr& definition, StorageObjectPtr& instance) override {
+        return Record(CallKind::SpawnInstance, definition->ClassName(), &instance,
+            [&]() { return inner->SpawnInstance(definition, instance); });
+    }
+
+    bool ExecMethod(const wstring& objectPath, const wstring& methodName,
+        const StorageObjectPtr& inParams, StorageObjectPtr& outParams) override {
+        return Record(CallKind::ExecMethod, methodName + L" " + objectPath, &outParams,
+            [&]() { return inner->ExecMethod(objectPath, methodName, inParams, outParams); });
+    }
+
+    bool PutInstance(const StorageObjectPtr& obj) override {
+        return Record(CallKind::PutInstance, obj->Path(), nullptr,
+            [&]() { return inner->PutInstance(obj); });
+    }
+
+    chrono::nanoseconds Now() const override { return inner->Now(); }
+    void Sleep(chrono::nanoseconds duration) override { inner->Sleep(duration); }
+
+private:
+    template <typename Call>
+    bool Record(CallKind kind, const wstring& key, const StorageObjectPtr* result, Call&& call) {
+        auto start = inner->Now();
+        bool ok = call();
+
+        CallRecord record;
+        record.kind = kind;
+        record.key = key;
+        record.ok = ok;
+        record.error = ok ? 0 : inner->LastError();
+        record.elapsed = inner->Now() - start;
+        if (ok && result) {
+            record.result = CopyObject(*result);
+        }
+
+        lastError = record.error;
+        log->push_back(move(record));
+        return ok;
+    }
+
+    unique_ptr<StorageBackend> inner;
+    shared_ptr<CallSession> log;     // 会话只在所属工作线程中追加
+    size_t queries;
+};
+
+BackendFactory CallRecorder::Wrap(BackendFactory inner) {
+    return [this, inner]() -> unique_ptr<StorageBackend> {
+        auto backend = inner();
+        if (!backend) return nullptr;
+
+        auto log = make_shared<CallSession>();
+        {
+            lock_guard<mutex> guard(lock);
+            sessions.push_back(log);
+        }
+        return unique_ptr<StorageBackend>(new RecordingBackend(move(backend), log));
+    };
+}
+
+vector<CallSession> CallRecorder::Sessions() const {
+    lock_guard<mutex> guard(lock);
+
+    vector<CallSession> result;
+    for (const auto& session : sessions) {
+        result.push_back(*session);
+    }
+    return result;
+}
+
+bool CallRecorder::Save(const wstring& path) const {
+#ifdef _WIN32
+    ofstream out(path.c_str(), ios::binary);
+#else
+    ofstream out(ToUtf8(path), ios::binary);
+#endif
+    if (!out) {
+        wcerr << L"❌ 无法写入调用日志: " << path << endl;
+        return false;
+    }
+
+    out << LOG_HEADER << "\n";
+    for (const auto& session : Sessions()) {
+        out << "session\n";
+        for (const auto& record : session) {
+            wstring line = CallKindName(record.kind);
+            line += record.ok ? L" 1 " : L" 0 ";
+
+            wchar_t error[16];
+            swprintf(error, 16, L"0x%08lX", (unsigned long)record.error & 0xFFFFFFFFUL);
+            line += error;
+            line += L' ' + to_wstring(record.elapsed.count()) + L' ';
+
+            AppendQuoted(line, record.key);
+            line += L' ';
+            AppendObject(line, record.result);
+
+            out << ToUtf8(line) << "\n";
+        }
+    }
+
+    return (bool)out;
+}
+
+// ================================
+// 回放
+// ================================
+
+class ReplayEnumerator : public ObjectEnumerator {
+public:
+    explicit ReplayEnumerator(size_t id) : id(id) {}
+
+    // 回放时结果来自日志, 只能经由 ReplayBackend::Next 读取
+    bool Next(StorageObjectPtr&) override { return false; }
+
+    size_t id;
+};
+
+class ReplayBackend : public StorageBackend {
+public:
+    ReplayBackend(CallReplayer& replayer, size_t sessionIndex)
+        : replayer(replayer), sessionIndex(sessionIndex), position(0), queries(0), clock(0), broken(false) {}
+
+    wstring Name() const override { return L"replay"; }
+
+    bool ExecQuery(const wstring& query, unique_ptr<ObjectEnumerator>& result) override {
+        size_t id = queries++;
+        if (!Play(CallKind::ExecQuery, query, nullptr)) return false;
+        result.reset(new ReplayEnumerator(id));
+        return true;
+    }
+
+    bool Next(ObjectEnumerator& enumerator, StorageObjectPtr& obj) override {
+        auto& replay = static_cast<ReplayEnumerator&>(enumerator);
+        return Play(CallKind::Next, to_wstring(replay.id), &obj);
+    }
+
+    bool GetObjectByPath(const wstring& path, StorageObjectPtr& result) override {
+        return Play(CallKind::GetObject, path, &result);
+    }
+
+    bool GetMethod(const StorageObjectPtr& classObj, const wstring& methodName,
+        StorageObjectPtr& inParamsDefinition) override {
+        return Play(CallKind::GetMethod, classObj->ClassName() + L"." + methodName, &inParamsDefinition);
+    }
+
+    bool SpawnInstance(const StorageObjectPtr& definition, StorageObjectPtr& instance) override {
+        return Play(CallKind::SpawnInstance, definition->ClassName(), &instance);
+    }
+
+    bool ExecMethod(const wstring& objectPath, const wstring& methodName,
+        const StorageObjectPtr&, StorageObjectPtr& outParams) override {
+        return Play(CallKind::ExecMethod, methodName + L" " + objectPath, &outParams);
+    }
+
+    bool PutInstance(const StorageObjectPtr& obj) override {
+        return Play(CallKind::PutInstance, obj->Path(), nullptr);
+    }
+
+    // 虚拟时钟: 每次调用推进录制时的耗时
+    chrono::nanoseconds Now() const override { return clock; }
+    void Sleep(chrono::nanoseconds duration) override { clock += duration; }
+
+private:
+    bool Play(CallKind kind, const wstring& key, StorageObjectPtr* result) {
+        const CallSession& session = replayer.sessions[sessionIndex];
+
+        if (broken) {
+            lastError = REPLAY_MISMATCH;
+            return false;
+        }
+
+        if (position >= session.size() || session[position].kind != kind || session[position].key != key) {
+            broken = true;
+            replayer.mismatches++;
+
+            wcerr << L"❌ 回放不匹配 (会话 " << sessionIndex << L", 第 " << (position + 1) << L" 次调用)" << endl;
+            if (position < session.size()) {
+                wcerr << L"   期望: " << CallKindName(session[position].kind) << L" " << session[position].key << endl;
+            }
+            else {
+                wcerr << L"   期望: (会话已结束)" << endl;
+            }
+            wcerr << L"   实际: " << CallKindName(kind) << L" " << key << endl;
+
+            lastError = REPLAY_MISMATCH;
+            return false;
+        }
+
+        const CallRecord& record = session[position++];
+        {
+            lock_guard<mutex> guard(replayer.lock);
+            replayer.consumed[sessionIndex] = position;
+        }
+
+        clock += record.elapsed;
+        lastError = record.error;
+
+        // 调用方可能修改结果 (Put), 交出副本以保持日志不变
+        if (result) {
+            *result = record.ok ? CopyObject(record.result) : nullptr;
+        }
+        return record.ok;
+    }
+
+    CallReplayer& replayer;
+    size_t sessionIndex;
+    size_t position;
+    size_t queries;
+    chrono::nanoseconds clock;
+    bool broken;
+};
+
+bool CallReplayer::Load(const wstring& path) {
+#ifdef _WIN32
+    ifstream in(path.c_str(), ios::binary);
+#else
+    ifstream in(ToUtf8(path), ios::binary);
+#endif
+    if (!in) {
+        wcerr << L"❌ 无法读取调用日志: " << path << endl;
+        return false;
+    }
+
+    sessions.clear();
+
+    string rawLine;
+    size_t lineNumber = 0;
+    while (getline(in, rawLine)) {
+        lineNumber++;
+        if (!rawLine.empty() && rawLine.back() == '\r') rawLine.pop_back();
+        if (rawLine.empty() || rawLine[0] == '#') continue;
+
+        if (rawLine == "session") {
+            sessions.emplace_back();
+            continue;
+        }
+
+        wstring line = FromUtf8(rawLine);
+        LogReader reader(line);
+        CallRecord record;
+        wstring kind, ok, error, elapsed;
+
+        bool parsed = !sessions.empty()
+            && reader.Token(kind) && ParseCallKind(kind.c_str(), record.kind)
+            && reader.Token(ok) && reader.Token(error) && reader.Token(elapsed)
+            && reader.Quoted(record.key) && reader.Object(record.result) && reader.AtEnd();
+
+        if (!parsed) {
+            wcerr << L"❌ 调用日志格式错误 (第 " << lineNumber << L" 行): " << path << endl;
+            return false;
+        }
+
+        record.ok = ok == L"1";
+        record.error = (HRESULT)(int)wcstoul(error.c_str(), nullptr, 16);
+        record.elapsed = chrono::nanoseconds(wcstoll(elapsed.c_str(), nullptr, 10));
+        sessions.back().push_back(move(record));
+    }
+
+    consumed.assign(sessions.size(), 0);
+    nextSession = 0;
+    mismatches = 0;
+    return true;
+}
+
+BackendFactory CallReplayer::Factory() {
+    return [this]() -> unique_ptr<StorageBackend> {
+        size_t index = nextSession++;
+        if (index >= sessions.size()) {
+            wcerr << L"❌ 调用日志中的会话已用尽" << endl;
+            return nullptr;
+        }
+        return unique_ptr<StorageBackend>(new ReplayBackend(*this, index));
+    };
+}
+
+bool CallReplayer::Complete() const {
+    return mismatches == 0 && Remaining() == 0;
+}
+
+size_t CallReplayer::Remaining() const {
+    lock_guard<mutex> guard(lock);
+
+    size_t remaining = 0;
+    for (size_t i = 0; i < sessions.size(); i++) {
+        remaining += sessions[i].size() - consumed[i];
+    }
+    return remaining;
+}
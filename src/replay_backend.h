@@ -0,0 +1,89 @@
+﻿#pragma once
+
+/*
+ * 调用录制与回放
+ *
+ * CallRecorder 包装任意后端 (真实 WMI 或模拟提供程序), 按顺序记录每次
+ * 往返调用的类型、参数键、结果对象与耗时; 日志可保存为 UTF-8 文本。
+ * CallReplayer 按录制顺序回放: 调用类型与参数键必须一致, 结果对象为
+ * 录制时的深拷贝, 耗时推进虚拟时钟。这样在没有 Windows 的环境下也能
+ * 复现一次真实会话的调用序列, 并检查往返次数预算。
+ *
+ * 日志格式 (每行一条, 字符串使用 "..." 并转义):
+ *   session
+ *   <调用> <1|0> <HRESULT> <耗时 ns> "<参数键>" <结果对象 | ->
+ *
+ * 对象编码: {"名称"=值,...}, 值为 e | b0/b1 | i<整数> | u<整数> | s"..." |
+ *           o{...} | S["...",...] | O[{...},...]
+ */
+
+#include "call_stats.h"
+#include "storage_backend.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct CallRecord {
+    CallKind kind = CallKind::ExecQuery;
+    std::wstring key;                 // 查询语句 / 对象路径 / 方法名等
+    bool ok = false;
+    HRESULT error = 0;
+    std::chrono::nanoseconds elapsed{ 0 };
+    StorageObjectPtr result;          // 属性包深拷贝, 没有结果时为空
+};
+
+// 一个后端会话的调用序列
+using CallSession = std::vector<CallRecord>;
+
+class CallRecorder {
+public:
+    // 包装后端工厂: 每个新会话对应日志中的一个 session
+    BackendFactory Wrap(BackendFactory inner);
+
+    std::vector<CallSession> Sessions() const;
+
+    bool Save(const std::wstring& path) const;
+
+private:
+    friend class RecordingBackend;
+
+    mutable std::mutex lock;
+    std::vector<std::shared_ptr<CallSession>> sessions;
+};
+
+class CallReplayer {
+public:
+    CallReplayer() = default;
+    explicit CallReplayer(std::vector<CallSession> recorded)
+        : sessions(std::move(recorded)), consumed(sessions.size(), 0) {}
+
+    bool Load(const std::wstring& path);
+
+    // 按录制顺序逐个交出会话, 会话用尽时返回 nullptr
+    BackendFactory Factory();
+
+    // 所有会话的调用都已按序回放且没有出现不匹配
+    bool Complete() const;
+
+    size_t Mismatches() const { return mismatches; }
+
+    // 尚未回放的调用数 (含未被取用的会话)
+    size_t Remaining() const;
+
+private:
+    friend class ReplayBackend;
+
+    std::vector<CallSession> sessions;
+    std::vector<size_t> consumed;     // 每个会话已回放的调用数
+    std::atomic<size_t> nextSession{ 0 };
+    std::atomic<size_t> mismatches{ 0 };
+    mutable std::mutex lock;
+};
+
+// 对象编码 (日志与调试输出)
+std::wstring EncodeObject(const StorageObjectPtr& obj);
+bool DecodeObject(const std::wstring& text, StorageObjectPtr& obj);
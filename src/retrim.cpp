@@ -0,0 +1,222 @@
+﻿#include "retrim.h"
+
+#include "wmi_manager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+bool ParseRetrimSpec(const wstring& params, RetrimSpec& spec) {
+    auto paramMap = ParseParams(params);
+
+    try {
+        if (paramMap.count(L"concurrency"))
+            spec.concurrency = stoi(paramMap[L"concurrency"]);
+    }
+    catch (...) {
+        return false;
+    }
+
+    return spec.concurrency >= 1 && spec.concurrency <= RETRIM_MAX_CONCURRENCY;
+}
+
+bool RetrimResult::Succeeded() const {
+    if (!error.empty()) return false;
+    return all_of(volumes.begin(), volumes.end(), [](const RetrimVolume& v) { return v.success; });
+}
+
+ULONGLONG RetrimResult::TrimmedBytes() const {
+    ULONGLONG bytes = 0;
+    for (const auto& volume : volumes) {
+        if (volume.success) bytes += volume.freeBytes;
+    }
+    return bytes;
+}
+
+// ================================
+// 单块磁盘
+// ================================
+
+static StorageObjectPtr QueryFirst(WMIManager& wmi, const wstring& query) {
+    auto enumerator = wmi.Query(query);
+    if (!enumerator) return nullptr;
+
+    StorageObjectPtr first, next;
+    while (wmi.Next(*enumerator, next)) {
+        if (!first) first = next;
+    }
+    return first;
+}
+
+static void RetrimDisk(WMIManager& wmi, int diskNumber, RetrimResult& result) {
+    result.diskNumber = diskNumber;
+    const wstring diskQuery = L"SELECT * FROM MSFT_Disk WHERE Number = " + to_wstring(diskNumber);
+
+    auto disk = QueryFirst(wmi, diskQuery);
+    if (!disk) {
+        result.error = L"未找到磁盘";
+        return;
+    }
+    result.provisioningType = (int)disk->GetInt(L"ProvisioningType");
+    result.allocatedBefore = disk->GetUInt64(L"AllocatedSize");
+    result.allocatedAfter = result.allocatedBefore;
+
+    vector<StorageObjectPtr> partitions;
+    {
+        auto enumerator = wmi.Query(L"SELECT * FROM MSFT_Partition WHERE DiskNumber = " + to_wstring(diskNumber));
+        if (!enumerator) {
+            result.error = L"查询分区失败";
+            return;
+        }
+
+        StorageObjectPtr partition;
+        while (wmi.Next(*enumerator, partition)) {
+            partitions.push_back(partition);
+        }
+    }
+
+    for (const auto& partition : partitions) {
+        // 分区上的卷 (MSFT_PartitionToVolume); 未格式化的分区没有可回收的文件系统
+        auto volume = QueryFirst(wmi, L"ASSOCIATORS OF {" + partition->Path() + L"} WHERE ResultClass = MSFT_Volume");
+        if (!volume || volume->GetString(L"FileSystem").empty()) continue;
+
+        RetrimVolume entry;
+        entry.partitionNumber = (int)partition->GetInt(L"PartitionNumber");
+        entry.fileSystem = volume->GetString(L"FileSystem");
+        entry.size = volume->GetUInt64(L"Size");
+        entry.freeBytes = volume->GetUInt64(L"SizeRemaining");
+
+        auto start = wmi.Now();
+        auto inParams = wmi.PrepareMethod(L"MSFT_Volume", L"Optimize");
+        if (inParams) {
+            inParams->Put(L"ReTrim", true);
+
+            StorageObjectPtr outParams;
+            entry.success = wmi.ExecMethod(volume->Path(), L"Optimize", inParams, outParams);
+        }
+        entry.elapsed = wmi.Now() - start;
+        result.volumes.push_back(entry);
+    }
+
+    sort(result.volumes.begin(), result.volumes.end(),
+        [](const RetrimVolume& a, const RetrimVolume& b) { return a.partitionNumber < b.partitionNumber; });
+
+    // 阵列在 UNMAP 完成后更新分配量
+    disk = QueryFirst(wmi, diskQuery);
+    if (disk) result.allocatedAfter = disk->GetUInt64(L"AllocatedSize");
+}
+
+vector<RetrimResult> RunRetrim(
+    const BackendFactory& factory,
+    const vector<int>& diskNumbers,
+    size_t maxWorkers
+) {
+    vector<RetrimResult> results(diskNumbers.size());
+    atomic<size_t> nextIndex(0);
+
+    auto worker = [&]() {
+        WMIManager wmi;
+        if (!wmi.Initialize(factory())) {
+            wcerr << L"❌ 回收线程无法连接存储提供程序" << endl;
+            return;
+        }
+
+        for (size_t i = nextIndex++; i < results.size(); i = nextIndex++) {
+            RetrimResult& result = results[i];
+            result.started = wmi.Now();
+            RetrimDisk(wmi, diskNumbers[i], result);
+            result.finished = wmi.Now();
+        }
+    };
+
+    size_t workerCount = min(maxWorkers, results.size());
+    if (workerCount <= 1) {
+        worker();
+    }
+    else {
+        vector<thread> workers;
+        for (size_t i = 0; i < workerCount; i++) {
+            workers.emplace_back(worker);
+        }
+        for (auto& t : workers) {
+            t.join();
+        }
+    }
+
+    // 未执行的磁盘 (工作线程初始化失败)
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i].diskNumber < 0) {
+            results[i].diskNumber = diskNumbers[i];
+            results[i].error = L"未执行回收";
+        }
+    }
+
+    return results;
+}
+
+// ================================
+// 报告
+// ================================
+
+bool PrintRetrimReport(const vector<RetrimResult>& results, size_t workers, bool verbose) {
+    size_t succeeded = 0;
+    size_t volumeCount = 0;
+    ULONGLONG trimmed = 0;
+    ULONGLONG returned = 0;
+    auto first = chrono::nanoseconds::max();
+    auto last = chrono::nanoseconds::min();
+
+    wcout << L"\n♻️  回收空间 (ReTrim)" << endl;
+    wcout << L"==========================================" << endl;
+    wcout << fixed << setprecision(2);
+
+    for (const auto& result : results) {
+        first = min(first, result.started);
+        last = max(last, result.finished);
+        volumeCount += result.volumes.size();
+        trimmed += result.TrimmedBytes();
+        returned += result.ReturnedBytes();
+
+        if (!result.error.empty()) {
+            wcout << L"  ❌ 磁盘 " << result.diskNumber << L": " << result.error << endl;
+            continue;
+        }
+
+        bool ok = result.Succeeded();
+        if (ok) succeeded++;
+        if (ok && !verbose) continue;
+
+        double seconds = chrono::duration<double>(result.finished - result.started).count();
+        wcout << (ok ? L"  ✓ 磁盘 " : L"  ❌ 磁盘 ") << result.diskNumber << L": "
+            << result.volumes.size() << L" 个卷, 回收范围 " << FormatBytes(result.TrimmedBytes());
+        if (result.IsThin()) {
+            wcout << L", 已分配 " << FormatBytes(result.allocatedBefore) << L" → " << FormatBytes(result.allocatedAfter)
+                << L" (归还 " << FormatBytes(result.ReturnedBytes()) << L")";
+        }
+        else {
+            wcout << (result.provisioningType == 2 ? L", 固定置备" : L", 置备类型未知");
+        }
+        wcout << L", 耗时 " << seconds << L" s" << endl;
+
+        for (const auto& volume : result.volumes) {
+            if (volume.success && !verbose) continue;
+            wcout << L"      分区 " << volume.partitionNumber << L" (" << volume.fileSystem << L"): "
+                << (volume.success ? L"空闲 " + FormatBytes(volume.freeBytes) : wstring(L"Optimize 失败"))
+                << L", " << chrono::duration<double>(volume.elapsed).count() << L" s" << endl;
+        }
+    }
+
+    wcout << L"📊 " << results.size() << L" 块磁盘 (成功 " << succeeded << L"), " << volumeCount
+        << L" 个卷, 回收范围 " << FormatBytes(trimmed) << L", 归还 " << FormatBytes(returned);
+    if (!results.empty() && last >= first) {
+        wcout << L", 耗时 " << chrono::duration<double>(last - first).count() << L" s (并发 "
+            << min(workers, results.size()) << L")";
+    }
+    wcout << endl;
+
+    return succeeded == results.size();
+}
@@ -0,0 +1,68 @@
+﻿#pragma once
+
+/*
+ * 格式化后的空间回收 (--retrim)
+ *
+ * 精简置备的 SAN / 虚拟化 LUN 上, 完全格式化或之前的数据会让阵列为整个范围分配存储。
+ * 对目标磁盘上每个已格式化的卷调用 MSFT_Volume.Optimize(ReTrim = true), 由文件系统对全部
+ * 空闲簇发送 TRIM / UNMAP, 阵列据此回收空间。
+ * 回收量取 MSFT_Disk.AllocatedSize 前后之差 (精简置备磁盘由阵列报告), 固定置备的磁盘只报告回收范围。
+ * 多块磁盘时并发, 线程数上限由 concurrency= 给出 (避免同时向阵列发送大量 UNMAP)。
+ * 稀疏流写入 (--apply) 时改为释放目标上未触碰的范围 (文件打洞 / 块设备 TRIM)。
+ */
+
+#include "storage_backend.h"
+#include "utils.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct RetrimSpec {
+    bool enabled = false;
+    int concurrency = 4;               // 同时回收的磁盘数上限
+};
+
+// 形式: concurrency=4
+bool ParseRetrimSpec(const std::wstring& params, RetrimSpec& spec);
+
+struct RetrimVolume {
+    int partitionNumber = 0;
+    std::wstring fileSystem;
+    ULONGLONG size = 0;
+    ULONGLONG freeBytes = 0;           // SizeRemaining, 即发送 TRIM 的范围
+    std::chrono::nanoseconds elapsed{ 0 };
+    bool success = false;
+};
+
+struct RetrimResult {
+    int diskNumber = -1;
+    int provisioningType = 0;          // MSFT_Disk.ProvisioningType: 0 未知 / 1 精简 / 2 固定
+    ULONGLONG allocatedBefore = 0;     // MSFT_Disk.AllocatedSize
+    ULONGLONG allocatedAfter = 0;
+    std::vector<RetrimVolume> volumes;
+    std::wstring error;                // 非空表示未能完成
+
+    std::chrono::nanoseconds started{ 0 };    // 后端时钟 (模拟时为虚拟时间)
+    std::chrono::nanoseconds finished{ 0 };
+
+    bool IsThin() const { return provisioningType == 1; }
+    bool Succeeded() const;
+    ULONGLONG TrimmedBytes() const;    // 成功的卷的空闲范围之和
+    ULONGLONG ReturnedBytes() const {  // 阵列归还的空间
+        return allocatedBefore > allocatedAfter ? allocatedBefore - allocatedAfter : 0;
+    }
+};
+
+// 并发线程数上限 (concurrency= 的最大值)
+const int RETRIM_MAX_CONCURRENCY = 64;
+
+// 对每块磁盘上的全部已格式化卷执行 ReTrim, 最多 maxWorkers 个工作线程
+std::vector<RetrimResult> RunRetrim(
+    const BackendFactory& factory,
+    const std::vector<int>& diskNumbers,
+    size_t maxWorkers
+);
+
+// 回收报告 (verbose 时列出每个卷); 返回是否全部成功
+bool PrintRetrimReport(const std::vector<RetrimResult>& results, size_t workers, bool verbose);
@@ -0,0 +1,1697 @@
+﻿#include "sim_backend.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cwctype>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+// ================================
+// 常量定义
+// ================================
+
+static const wstring STORAGE_NAMESPACE_PREFIX = L"\\\\.\\ROOT\\Microsoft\\Windows\\Storage:";
+
+// 模拟返回码 (参照 MSFT_StorageExtendedStatus 的取值)
+enum SimReturnCode : long {
+    RET_SUCCESS = 0,
+    RET_NOT_SUPPORTED = 1,
+    RET_FAILED = 4,
+    RET_INVALID_PARAMETER = 5,
+    RET_NOT_ENOUGH_RESOURCES = 40002,
+    RET_DISK_NOT_INITIALIZED = 41000,
+    RET_DISK_ALREADY_INITIALIZED = 41001,
+    RET_DISK_OFFLINE = 41003,
+    RET_DISK_HAS_DATA = 41004,
+    RET_NOT_ENOUGH_SPACE = 42002,
+    RET_INVALID_OFFSET = 42007,
+};
+
+// 存储空间: 每块成员盘保留给池元数据的容量, 以及虚拟磁盘的分配单位 (slab)
+static const ULONGLONG POOL_RESERVED_BYTES = 256ULL * 1024 * 1024;
+static const ULONGLONG POOL_SLAB_BYTES = 256ULL * 1024 * 1024;
+static const ULONGLONG POOL_MIN_DISK_BYTES = 4ULL * 1024 * 1024 * 1024;
+static const ULONGLONG VD_DEFAULT_INTERLEAVE = 256 * 1024;
+static const ULONGLONG VD_MIN_INTERLEAVE = 16 * 1024;
+static const ULONGLONG VD_MAX_INTERLEAVE = 16ULL * 1024 * 1024;
+
+// 已格式化的卷占用的空间 (文件系统元数据, 模拟为最多 32 MiB, 位于分区开头)
+static const ULONGLONG VOLUME_USED_BYTES = 32ULL * 1024 * 1024;
+
+// WMI HRESULT (Linux 下没有 wbemcli.h)
+static const HRESULT SIM_WBEM_E_FAILED = (HRESULT)0x80041001L;
+static const HRESULT SIM_WBEM_E_NOT_FOUND = (HRESULT)0x80041002L;
+static const HRESULT SIM_WBEM_E_INVALID_CLASS = (HRESULT)0x80041010L;
+static const HRESULT SIM_WBEM_E_INVALID_QUERY = (HRESULT)0x80041017L;
+static const HRESULT SIM_WBEM_E_INVALID_METHOD = (HRESULT)0x8004102EL;
+
+static const ULONGLONG MiB = 1024ULL * 1024;
+static const ULONGLONG GiB = 1024ULL * 1024 * 1024;
+static const int GPT_MAX_PARTITIONS = 128;
+static const ULONGLONG GPT_ENTRY_ARRAY_BYTES = 128 * 128;
+
+// ================================
+// 延迟模型
+// ================================
+
+chrono::nanoseconds LatencyModel::Sample(mt19937_64& rng) const {
+    double ns = 0;
+
+    switch (dist) {
+    case Dist::Fixed:
+        ns = a;
+        break;
+    case Dist::Uniform:
+        ns = uniform_real_distribution<double>(a, max(a, b))(rng);
+        break;
+    case Dist::Normal:
+        ns = b > 0 ? normal_distribution<double>(a, b)(rng) : a;
+        break;
+    case Dist::LogNormal:
+    {
+        // 以目标均值/标准差换算对数正态参数
+        if (a <= 0 || b <= 0) {
+            ns = a;
+            break;
+        }
+        double sigma2 = log(1.0 + (b * b) / (a * a));
+        double mu = log(a) - sigma2 / 2.0;
+        ns = lognormal_distribution<double>(mu, sqrt(sigma2))(rng);
+        break;
+    }
+    case Dist::Exponential:
+        ns = a > 0 ? exponential_distribution<double>(1.0 / a)(rng) : 0;
+        break;
+    }
+
+    return chrono::nanoseconds((long long)max(0.0, ns));
+}
+
+static LatencyModel MakeModel(LatencyModel::Dist dist, double aMs, double bMs, bool serial = false) {
+    LatencyModel model;
+    model.dist = dist;
+    model.a = aMs * 1e6;
+    model.b = bMs * 1e6;
+    model.serial = serial;
+    return model;
+}
+
+SimConfig SimConfig::Default() {
+    using Dist = LatencyModel::Dist;
+
+    SimConfig config;
+    config.latency[L"ExecQuery"] = MakeModel(Dist::LogNormal, 4, 2);
+    config.latency[L"Next"] = MakeModel(Dist::LogNormal, 1.5, 0.8);
+    config.latency[L"GetObject"] = MakeModel(Dist::LogNormal, 2, 1);
+    config.latency[L"GetMethod"] = MakeModel(Dist::Fixed, 0.05, 0);
+    config.latency[L"SpawnInstance"] = MakeModel(Dist::Fixed, 0.02, 0);
+    config.latency[L"PutInstance"] = MakeModel(Dist::LogNormal, 40, 15);
+    config.latency[L"ExecMethod"] = MakeModel(Dist::LogNormal, 100, 50);
+    config.latency[L"Clear"] = MakeModel(Dist::LogNormal, 900, 300);
+    config.latency[L"Initialize"] = MakeModel(Dist::LogNormal, 350, 100);
+    config.latency[L"CreatePartition"] = MakeModel(Dist::LogNormal, 300, 120);
+    config.latency[L"Format"] = MakeModel(Dist::LogNormal, 1800, 600);
+    config.latency[L"GetSupportedSize"] = MakeModel(Dist::LogNormal, 120, 40);
+    config.latency[L"Resize"] = MakeModel(Dist::LogNormal, 700, 250);
+    config.latency[L"AddAccessPath"] = MakeModel(Dist::LogNormal, 80, 30);
+    config.latency[L"UpdateHostStorageCache"] = MakeModel(Dist::LogNormal, 1500, 500, true);
+    config.latency[L"FormatFull"] = MakeModel(Dist::Fixed, 2700, 0);         // 每 GiB
+    config.latency[L"MountLetter"] = MakeModel(Dist::LogNormal, 450, 200, true);
+    config.latency[L"CreateStoragePool"] = MakeModel(Dist::LogNormal, 3000, 1000, true);
+    config.latency[L"CreateVirtualDisk"] = MakeModel(Dist::LogNormal, 2500, 800, true);
+    config.latency[L"ProbeRead"] = MakeModel(Dist::LogNormal, 0.5, 0.2);
+    config.latency[L"Optimize"] = MakeModel(Dist::LogNormal, 250, 80);
+    config.latency[L"ReTrim"] = MakeModel(Dist::Fixed, 40, 0);              // 每 GiB
+    return config;
+}
+
+bool ParseSimConfig(const wstring& params, SimConfig& config) {
+    auto paramMap = ParseParams(params);
+
+    try {
+        if (paramMap.count(L"disks"))
+            config.diskCount = stoi(paramMap[L"disks"]);
+
+        if (paramMap.count(L"first"))
+            config.firstDiskNumber = stoi(paramMap[L"first"]);
+
+        if (paramMap.count(L"size"))
+            config.diskSize = ParseSizeString(paramMap[L"size"]);
+
+        if (paramMap.count(L"style")) {
+            const wstring& style = paramMap[L"style"];
+            if (style == L"raw") config.partitionStyle = 0;
+            else if (style == L"mbr") config.partitionStyle = 1;
+            else if (style == L"gpt") config.partitionStyle = 2;
+            else return false;
+        }
+
+        if (paramMap.count(L"sector")) {
+            // 形式: 512/4096 (逻辑/物理)
+            auto parts = SplitString(paramMap[L"sector"], L'/');
+            config.logicalSectorSize = stoi(parts[0]);
+            config.physicalSectorSize = parts.size() > 1 ? stoi(parts[1]) : config.logicalSectorSize;
+        }
+
+        if (paramMap.count(L"seed"))
+            config.seed = stoull(paramMap[L"seed"]);
+
+        if (paramMap.count(L"realtime"))
+            config.realTime = (paramMap[L"realtime"] == L"1" || paramMap[L"realtime"] == L"true");
+
+        if (paramMap.count(L"scale"))
+            config.timeScale = stod(paramMap[L"scale"]);
+
+        if (paramMap.count(L"thin"))
+            config.thin = (paramMap[L"thin"] == L"1" || paramMap[L"thin"] == L"true");
+
+        if (paramMap.count(L"slab"))
+            config.thinSlab = ParseSizeString(paramMap[L"slab"]);
+
+        if (paramMap.count(L"written")) {
+            config.thinWritten = paramMap[L"written"] == L"all" ? ~0ULL : ParseSizeString(paramMap[L"written"]);
+        }
+    }
+    catch (const exception&) {
+        return false;
+    }
+
+    return config.diskCount >= 0 && config.diskSize > 0 && config.logicalSectorSize > 0 && config.thinSlab > 0;
+}
+
+// 可注入延迟与失败的操作名, 与 SimConfig::Default 及 --help 中的列表一致; 拼错的名字会被拒绝而不是被静默忽略
+static bool IsSimOperation(const wstring& name) {
+    static const set<wstring> operations = {
+        L"ExecQuery", L"Next", L"GetObject", L"GetMethod", L"SpawnInstance", L"PutInstance", L"ExecMethod",
+        L"Clear", L"Initialize", L"CreatePartition", L"Format", L"FormatFull", L"MountLetter",
+        L"GetSupportedSize", L"Resize", L"AddAccessPath", L"UpdateHostStorageCache", L"ProbeRead",
+        L"CreateStoragePool", L"CreateVirtualDisk", L"Optimize", L"ReTrim",
+    };
+    return operations.count(name) > 0;
+}
+
+bool ParseLatencySpec(const wstring& spec, SimConfig& config) {
+    auto parts = SplitString(spec, L':');
+    if (parts.size() < 3 || !IsSimOperation(parts[0])) return false;
+
+    LatencyModel model = config.latency[parts[0]];
+    const wstring& dist = parts[1];
+    size_t next = 3;
+
+    try {
+        if (dist == L"fixed") {
+            model.dist = LatencyModel::Dist::Fixed;
+            model.a = (double)ParseDuration(parts[2]).count();
+            model.b = 0;
+        }
+        else if (dist == L"uniform" || dist == L"normal" || dist == L"lognormal") {
+            if (parts.size() < 4) return false;
+            model.dist = dist == L"uniform" ? LatencyModel::Dist::Uniform
+                : dist == L"normal" ? LatencyModel::Dist::Normal
+                : LatencyModel::Dist::LogNormal;
+            model.a = (double)ParseDuration(parts[2]).count();
+            model.b = (double)ParseDuration(parts[3]).count();
+            next = 4;
+        }
+        else if (dist == L"exp") {
+            model.dist = LatencyModel::Dist::Exponential;
+            model.a = (double)ParseDuration(parts[2]).count();
+            model.b = 0;
+        }
+        else {
+            return false;
+        }
+    }
+    catch (const exception&) {
+        return false;
+    }
+
+    model.serial = next < parts.size() && parts[next] == L"serial";
+    config.latency[parts[0]] = model;
+    return true;
+}
+
+bool ParseFailureSpec(const wstring& spec, SimConfig& config) {
+    auto parts = SplitString(spec, L':');
+    if (parts.size() != 2 || !IsSimOperation(parts[0])) return false;
+
+    try {
+        double rate = stod(parts[1]);
+        if (rate < 0 || rate > 1) return false;
+        config.latency[parts[0]].failureRate = rate;
+    }
+    catch (const exception&) {
+        return false;
+    }
+
+    return true;
+}
+
+bool ParseHealthSpec(const wstring& spec, SimConfig& config) {
+    size_t colon = spec.find(L':');
+    if (colon == wstring::npos) return false;
+
+    try {
+        vector<int> diskNumbers = ParseNumberList(spec.substr(0, colon));
+        if (diskNumbers.empty()) return false;
+
+        auto paramMap = ParseParams(spec.substr(colon + 1));
+        for (int diskNumber : diskNumbers) {
+            SimHealth& health = config.health[diskNumber];
+
+            if (paramMap.count(L"health")) {
+                const wstring& status = paramMap[L"health"];
+                if (status == L"healthy") health.healthStatus = 0;
+                else if (status == L"warning") health.healthStatus = 1;
+                else if (status == L"unhealthy") health.healthStatus = 2;
+                else return false;
+            }
+
+            if (paramMap.count(L"status")) {
+                // 形式: 2/5 (OperationalStatus 数组)
+                health.operationalStatus.clear();
+                for (const auto& code : SplitString(paramMap[L"status"], L'/')) {
+                    health.operationalStatus.push_back(to_wstring(stoi(code)));
+                }
+            }
+
+            if (paramMap.count(L"temp"))
+                health.temperature = stoi(paramMap[L"temp"]);
+
+            if (paramMap.count(L"wear"))
+                health.wear = stoi(paramMap[L"wear"]);
+
+            if (paramMap.count(L"read-errors"))
+                health.readErrors = stoull(paramMap[L"read-errors"]);
+
+            if (paramMap.count(L"write-errors"))
+                health.writeErrors = stoull(paramMap[L"write-errors"]);
+
+            if (paramMap.count(L"read-latency"))
+                health.readLatencyMax = stoull(paramMap[L"read-latency"]);
+
+            if (paramMap.count(L"write-latency"))
+                health.writeLatencyMax = stoull(paramMap[L"write-latency"]);
+
+            if (paramMap.count(L"counters"))
+                health.hasCounters = (paramMap[L"counters"] == L"1" || paramMap[L"counters"] == L"true");
+
+            if (paramMap.count(L"probe"))
+                health.probeMs = ParseDuration(paramMap[L"probe"]).count() / 1e6;
+        }
+    }
+    catch (const exception&) {
+        return false;
+    }
+
+    return true;
+}
+
+bool ParsePartitionsSpec(const wstring& spec, SimConfig& config) {
+    size_t colon = spec.find(L':');
+    if (colon == wstring::npos) return false;
+
+    try {
+        vector<int> diskNumbers = ParseNumberList(spec.substr(0, colon));
+        if (diskNumbers.empty()) return false;
+
+        vector<pair<ULONGLONG, ULONGLONG>> partitions;
+        for (const auto& item : SplitString(spec.substr(colon + 1), L'/')) {
+            size_t plus = item.find(L'+');
+            if (plus == wstring::npos) return false;
+
+            ULONGLONG offset = ParseSizeString(item.substr(0, plus));
+            ULONGLONG size = ParseSizeString(item.substr(plus + 1));
+            if (offset == 0 || size == 0) return false;
+            partitions.push_back({ offset, size });
+        }
+
+        for (int diskNumber : diskNumbers) {
+            config.partitions[diskNumber] = partitions;
+        }
+    }
+    catch (const exception&) {
+        return false;
+    }
+
+    return true;
+}
+
+// ================================
+// 路径与查询解析
+// ================================
+
+namespace {
+
+struct ObjectPath {
+    wstring className;
+    map<wstring, wstring> keys;
+
+    bool IsClass() const { return keys.empty(); }
+
+    int KeyInt(const wstring& name) const {
+        auto it = keys.find(name);
+        return it == keys.end() ? -1 : (int)wcstol(it->second.c_str(), nullptr, 10);
+    }
+};
+
+wstring StripQuotes(const wstring& value) {
+    if (value.size() >= 2 && (value.front() == L'"' || value.front() == L'\'') && value.back() == value.front()) {
+        return value.substr(1, value.size() - 2);
+    }
+    return value;
+}
+
+bool EqualsNoCase(const wstring& a, const wstring& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (towupper(a[i]) != towupper(b[i])) return false;
+    }
+    return true;
+}
+
+// 解析 "\\.\ROOT\...:MSFT_Partition.DiskNumber=1,PartitionNumber=2" 或 "MSFT_Disk"
+ObjectPath ParseObjectPath(const wstring& path) {
+    ObjectPath result;
+    wstring rel = path;
+
+    size_t colon = rel.find(L':');
+    if (colon != wstring::npos) rel = rel.substr(colon + 1);
+
+    size_t dot = rel.find(L'.');
+    result.className = rel.substr(0, dot);
+    if (dot == wstring::npos) return result;
+
+    for (const auto& pair : SplitString(rel.substr(dot + 1), L',')) {
+        size_t eq = pair.find(L'=');
+        if (eq == wstring::npos) continue;
+        result.keys[pair.substr(0, eq)] = StripQuotes(pair.substr(eq + 1));
+    }
+
+    return result;
+}
+
+struct WqlQuery {
+    wstring className;
+    vector<pair<wstring, wstring>> conditions;   // 属性 = 值 (AND 连接)
+    wstring sourcePath;                          // ASSOCIATORS OF 的源对象路径
+};
+
+vector<wstring> TokenizeWql(const wstring& query) {
+    vector<wstring> tokens;
+    wstring current;
+    wchar_t quote = 0;
+
+    auto flush = [&]() {
+        if (!current.empty()) tokens.push_back(current);
+        current.clear();
+    };
+
+    for (wchar_t c : query) {
+        if (quote) {
+            current += c;
+            if (c == quote) {
+                quote = 0;
+                flush();
+            }
+        }
+        else if (c == L'\'' || c == L'"') {
+            flush();
+            quote = c;
+            current += c;
+        }
+        else if (iswspace(c)) {
+            flush();
+        }
+        else if (c == L'=') {
+            flush();
+            tokens.push_back(L"=");
+        }
+        else {
+            current += c;
+        }
+    }
+    flush();
+
+    return tokens;
+}
+
+// 支持: SELECT * FROM <类> [WHERE <属性> = <值> [AND <属性> = <值>]...]
+//       ASSOCIATORS OF {<对象路径>} WHERE ResultClass = <类> [AssocClass = <类>]
+bool ParseWql(const wstring& query, WqlQuery& result) {
+    auto tokens = TokenizeWql(query);
+
+    if (!tokens.empty() && EqualsNoCase(tokens[0], L"ASSOCIATORS")) {
+        size_t open = query.find(L'{');
+        size_t close = query.rfind(L'}');
+        if (open == wstring::npos || close == wstring::npos || close < open) return false;
+        result.sourcePath = query.substr(open + 1, close - open - 1);
+
+        auto rest = TokenizeWql(query.substr(close + 1));
+        if (rest.empty() || !EqualsNoCase(rest[0], L"WHERE")) return false;
+        for (size_t j = 1; j < rest.size(); j += 3) {
+            if (j + 3 > rest.size() || rest[j + 1] != L"=") return false;
+            if (EqualsNoCase(rest[j], L"ResultClass")) result.className = rest[j + 2];
+        }
+        return !result.className.empty();
+    }
+
+    size_t i = 0;
+    if (tokens.size() < 4 || !EqualsNoCase(tokens[i++], L"SELECT")) return false;
+
+    while (i < tokens.size() && !EqualsNoCase(tokens[i], L"FROM")) i++;
+    if (++i >= tokens.size()) return false;
+    result.className = tokens[i++];
+
+    if (i == tokens.size()) return true;
+    if (!EqualsNoCase(tokens[i++], L"WHERE")) return false;
+
+    for (;;) {
+        if (i + 3 > tokens.size() || tokens[i + 1] != L"=") return false;
+        result.conditions.push_back({ tokens[i], StripQuotes(tokens[i + 2]) });
+        i += 3;
+
+        if (i == tokens.size()) return true;
+        if (!EqualsNoCase(tokens[i++], L"AND")) return false;
+    }
+}
+
+bool MatchesConditions(const StorageObjectPtr& obj, const vector<pair<wstring, wstring>>& conditions) {
+    for (const auto& cond : conditions) {
+        PropValue value;
+        if (!obj->Get(cond.first, value)) return false;
+        if (!EqualsNoCase(value.AsString(), cond.second)) return false;
+    }
+    return true;
+}
+
+class SimEnumerator : public ObjectEnumerator {
+public:
+    explicit SimEnumerator(vector<StorageObjectPtr> objs) : objects(move(objs)) {}
+
+    bool Next(StorageObjectPtr& obj) override {
+        if (index >= objects.size()) return false;
+        obj = objects[index++];
+        return true;
+    }
+
+private:
+    vector<StorageObjectPtr> objects;
+    size_t index = 0;
+};
+
+wstring FileSystemName(const PropValue& value) {
+    static const map<int, wstring> names = {
+        {7, L"NTFS"}, {5, L"FAT32"}, {8, L"exFAT"}, {9, L"ReFS"}
+    };
+
+    if (value.GetKind() == PropValue::Kind::String) {
+        return value.AsString();
+    }
+    auto it = names.find((int)value.AsInt());
+    return it == names.end() ? L"Unknown" : it->second;
+}
+
+// 精简置备: 分配 [offset, offset + length) (向外扩展到 slab 边界), 与相邻范围合并
+void BackRange(map<ULONGLONG, ULONGLONG>& backed, ULONGLONG slab, ULONGLONG offset, ULONGLONG length) {
+    if (length == 0) return;
+
+    ULONGLONG start = offset / slab * slab;
+    ULONGLONG end = (offset + length + slab - 1) / slab * slab;
+
+    auto it = backed.upper_bound(start);
+    if (it != backed.begin() && prev(it)->second >= start) {
+        --it;
+        start = it->first;
+    }
+    while (it != backed.end() && it->first <= end) {
+        end = max(end, it->second);
+        it = backed.erase(it);
+    }
+    backed[start] = end;
+}
+
+// 释放 [offset, offset + length) 内完整的 slab, 返回释放的字节数
+ULONGLONG UnmapRange(map<ULONGLONG, ULONGLONG>& backed, ULONGLONG slab, ULONGLONG offset, ULONGLONG length) {
+    ULONGLONG start = (offset + slab - 1) / slab * slab;
+    ULONGLONG end = (offset + length) / slab * slab;
+    if (start >= end) return 0;
+
+    ULONGLONG freed = 0;
+    auto it = backed.upper_bound(start);
+    if (it != backed.begin()) --it;
+
+    while (it != backed.end() && it->first < end) {
+        ULONGLONG first = it->first;
+        ULONGLONG last = it->second;
+        if (last <= start) {
+            ++it;
+            continue;
+        }
+
+        it = backed.erase(it);
+        if (first < start) backed[first] = start;
+        if (last > end) backed[end] = last;
+        freed += min(last, end) - max(first, start);
+    }
+    return freed;
+}
+
+ULONGLONG BackedBytes(const map<ULONGLONG, ULONGLONG>& backed) {
+    ULONGLONG bytes = 0;
+    for (const auto& range : backed) bytes += range.second - range.first;
+    return bytes;
+}
+
+} // namespace
+
+// ================================
+// 模拟会话
+// ================================
+
+class SimulatedBackend : public StorageBackend {
+public:
+    SimulatedBackend(SimulatedStorage& storage, unsigned sessionId)
+        : storage(storage),
+          rng(storage.config.seed * 0x9E3779B97F4A7C15ULL + sessionId),
+          clock(0) {}
+
+    wstring Name() const override { return L"sim"; }
+
+    chrono::nanoseconds Now() const override {
+        if (storage.config.realTime) {
+            return StorageBackend::Now();
+        }
+        return clock;
+    }
+
+    void Sleep(chrono::nanoseconds duration) override {
+        if (storage.config.realTime) {
+            this_thread::sleep_for(chrono::nanoseconds((long long)(duration.count() * storage.config.timeScale)));
+            return;
+        }
+        clock += duration;
+    }
+
+    bool ExecQuery(const wstring& query, unique_ptr<ObjectEnumerator>& result) override {
+        if (!Charge(L"ExecQuery")) return Fail(SIM_WBEM_E_FAILED);
+
+        WqlQuery wql;
+        if (!ParseWql(query, wql)) return Fail(SIM_WBEM_E_INVALID_QUERY);
+
+        vector<StorageObjectPtr> objects;
+        {
+            lock_guard<mutex> guard(storage.lock);
+
+            if (!CollectObjects(wql, objects)) return Fail(SIM_WBEM_E_INVALID_CLASS);
+        }
+
+        result.reset(new SimEnumerator(move(objects)));
+        return Succeed();
+    }
+
+    bool Next(ObjectEnumerator& enumerator, StorageObjectPtr& obj) override {
+        // 每次 Next 都是一次往返, 包括最后一次返回空结果
+        Charge(L"Next");
+        return enumerator.Next(obj);
+    }
+
+    bool GetObjectByPath(const wstring& path, StorageObjectPtr& result) override {
+        if (!Charge(L"GetObject")) return Fail(SIM_WBEM_E_FAILED);
+
+        ObjectPath objPath = ParseObjectPath(path);
+        if (objPath.IsClass()) {
+            if (!IsKnownClass(objPath.className)) return Fail(SIM_WBEM_E_INVALID_CLASS);
+
+            auto classObj = MakeObject(objPath.className);
+            classObj->Put(L"__PATH", STORAGE_NAMESPACE_PREFIX + objPath.className);
+            result = classObj;
+            return Succeed();
+        }
+
+        lock_guard<mutex> guard(storage.lock);
+
+        result = LookupInstance(objPath);
+        if (!result) return Fail(SIM_WBEM_E_NOT_FOUND);
+        return Succeed();
+    }
+
+    bool GetMethod(const StorageObjectPtr& classObj, const wstring& methodName,
+        StorageObjectPtr& inParamsDefinition) override {
+        if (!Charge(L"GetMethod")) return Fail(SIM_WBEM_E_FAILED);
+
+        if (!classObj || !IsKnownMethod(classObj->ClassName(), methodName)) {
+            return Fail(SIM_WBEM_E_INVALID_METHOD);
+        }
+
+        auto definition = MakeObject(L"__PARAMETERS");
+        definition->Put(L"__METHOD", methodName);
+        inParamsDefinition = definition;
+        return Succeed();
+    }
+
+    bool SpawnInstance(const StorageObjectPtr& definition, StorageObjectPtr& instance) override {
+        if (!Charge(L"SpawnInstance")) return Fail(SIM_WBEM_E_FAILED);
+
+        auto bag = dynamic_cast<PropertyBag*>(definition.get());
+        if (!bag) return Fail(SIM_WBEM_E_FAILED);
+
+        instance = make_shared<PropertyBag>(*bag);
+        return Succeed();
+    }
+
+    bool ExecMethod(const wstring& objectPath, const wstring& methodName,
+        const StorageObjectPtr& inParams, StorageObjectPtr& outParams) override {
+        const wstring op = storage.config.latency.count(methodName) ? methodName : L"ExecMethod";
+        bool ok = Charge(op);
+
+        ObjectPath target = ParseObjectPath(objectPath);
+        if (!IsKnownMethod(target.className, methodName)) return Fail(SIM_WBEM_E_INVALID_METHOD);
+
+        auto out = MakeObject(L"__PARAMETERS");
+        outParams = out;
+
+        // 注入的失败以方法返回值体现
+        if (!ok) {
+            out->Put(L"ReturnValue", (long)RET_FAILED);
+            return Succeed();
+        }
+
+        StorageObjectPtr in = inParams ? inParams : MakeObject(L"__PARAMETERS");
+        long ret = RET_NOT_SUPPORTED;
+
+        if (target.className == L"MSFT_Disk") {
+            int diskNumber = target.KeyInt(L"Number");
+            if (methodName == L"Clear") ret = DiskClear(diskNumber, *in);
+            else if (methodName == L"Initialize") ret = DiskInitialize(diskNumber, *in);
+            else if (methodName == L"CreatePartition") ret = DiskCreatePartition(diskNumber, *in, *out);
+        }
+        else if (target.className == L"MSFT_Partition" || target.className == L"MSFT_Volume") {
+            int diskNumber = target.KeyInt(L"DiskNumber");
+            int partitionNumber = target.KeyInt(L"PartitionNumber");
+            if (methodName == L"Format") ret = PartitionFormat(diskNumber, partitionNumber, *in, *out);
+            else if (methodName == L"Optimize") ret = VolumeOptimize(diskNumber, partitionNumber, *in);
+            else if (methodName == L"GetSupportedSize") ret = PartitionGetSupportedSize(diskNumber, partitionNumber, *out);
+            else if (methodName == L"Resize") ret = PartitionResize(diskNumber, partitionNumber, *in);
+            else if (methodName == L"AddAccessPath") ret = PartitionAddAccessPath(diskNumber, partitionNumber, *in);
+        }
+        else if (target.className == L"MSFT_StorageSetting") {
+            // 重新枚举宿主机存储 (耗时由 UpdateHostStorageCache 延迟模型体现)
+            if (methodName == L"UpdateHostStorageCache") ret = RET_SUCCESS;
+        }
+        else if (target.className == L"MSFT_StorageSubSystem") {
+            if (methodName == L"CreateStoragePool") ret = SubSystemCreateStoragePool(*in, *out);
+        }
+        else if (target.className == L"MSFT_StoragePool") {
+            if (methodName == L"CreateVirtualDisk") ret = PoolCreateVirtualDisk(ObjectNumber(target, L"SIM-POOL-"), *in, *out);
+            else if (methodName == L"DeleteObject") ret = PoolDelete(ObjectNumber(target, L"SIM-POOL-"));
+        }
+        else if (target.className == L"MSFT_VirtualDisk") {
+            if (methodName == L"DeleteObject") ret = VirtualDiskDelete(ObjectNumber(target, L"SIM-VD-"));
+        }
+
+        out->Put(L"ReturnValue", ret);
+        return Succeed();
+    }
+
+    bool PutInstance(const StorageObjectPtr& obj) override {
+        if (!Charge(L"PutInstance")) return Fail(SIM_WBEM_E_FAILED);
+
+        ObjectPath objPath = ParseObjectPath(obj ? obj->Path() : L"");
+
+        lock_guard<mutex> guard(storage.lock);
+
+        if (objPath.className != L"MSFT_Partition") return Fail(SIM_WBEM_E_INVALID_CLASS);
+
+        SimPartition* part = FindPartition(objPath.KeyInt(L"DiskNumber"), objPath.KeyInt(L"PartitionNumber"));
+        if (!part) return Fail(SIM_WBEM_E_NOT_FOUND);
+
+        PropValue name;
+        if (obj->Get(L"GptPartitionName", name) && !name.IsEmpty()) {
+            part->name = name.AsString();
+        }
+        return Succeed();
+    }
+
+private:
+    bool Succeed() {
+        lastError = 0;
+        return true;
+    }
+
+    bool Fail(HRESULT hres) {
+        lastError = hres;
+        return false;
+    }
+
+    // 按操作模型计入延迟, 返回 false 表示注入失败
+    bool Charge(const wstring& op, double scale = 1.0) {
+        auto it = storage.config.latency.find(op);
+        if (it == storage.config.latency.end()) return true;
+
+        const LatencyModel& model = it->second;
+        auto latency = chrono::nanoseconds((long long)(model.Sample(rng).count() * scale));
+
+        if (storage.config.realTime) {
+            auto scaled = chrono::nanoseconds((long long)(latency.count() * storage.config.timeScale));
+            if (model.serial) {
+                lock_guard<mutex> guard(storage.serialLock);
+                this_thread::sleep_for(scaled);
+            }
+            else {
+                this_thread::sleep_for(scaled);
+            }
+        }
+        else {
+            auto start = model.serial ? storage.ReserveSerial(clock, latency) : clock;
+            clock = start + latency;
+        }
+
+        if (model.failureRate > 0) {
+            return uniform_real_distribution<double>(0.0, 1.0)(rng) >= model.failureRate;
+        }
+        return true;
+    }
+
+    static bool IsKnownClass(const wstring& className) {
+        return className == L"MSFT_Disk" || className == L"MSFT_Partition" || className == L"MSFT_Volume"
+            || className == L"MSFT_StorageSetting" || className == L"MSFT_PhysicalDisk"
+            || className == L"MSFT_StorageReliabilityCounter" || className == L"MSFT_StorageSubSystem"
+            || className == L"MSFT_StoragePool" || className == L"MSFT_VirtualDisk";
+    }
+
+    static bool IsKnownMethod(const wstring& className, const wstring& methodName) {
+        if (className == L"MSFT_Disk") {
+            return methodName == L"Clear" || methodName == L"Initialize" || methodName == L"CreatePartition";
+        }
+        if (className == L"MSFT_Partition") {
+            return methodName == L"Format" || methodName == L"GetSupportedSize" || methodName == L"Resize"
+                || methodName == L"AddAccessPath";
+        }
+        if (className == L"MSFT_StorageSetting") {
+            return methodName == L"UpdateHostStorageCache";
+        }
+        if (className == L"MSFT_Volume") {
+            return methodName == L"Format" || methodName == L"Optimize";
+        }
+        if (className == L"MSFT_StorageSubSystem") {
+            return methodName == L"CreateStoragePool";
+        }
+        if (className == L"MSFT_StoragePool") {
+            return methodName == L"CreateVirtualDisk" || methodName == L"DeleteObject";
+        }
+        if (className == L"MSFT_VirtualDisk") {
+            return methodName == L"DeleteObject";
+        }
+        return false;
+    }
+
+    // ---------- 状态访问 (调用方持有 storage.lock) ----------
+
+    SimDisk* FindDisk(int diskNumber) {
+        auto it = storage.disks.find(diskNumber);
+        return it == storage.disks.end() ? nullptr : &it->second;
+    }
+
+    // 以 MSFT_Disk 出现的磁盘 (存储池成员不再作为 MSFT_Disk 出现)
+    SimDisk* FindBasicDisk(int diskNumber) {
+        SimDisk* disk = FindDisk(diskNumber);
+        return disk && disk->poolId == 0 ? disk : nullptr;
+    }
+
+    SimPool* FindPool(int poolId) {
+        auto it = storage.pools.find(poolId);
+        return it == storage.pools.end() ? nullptr : &it->second;
+    }
+
+    SimPartition* FindPartition(int diskNumber, int partitionNumber) {
+        SimDisk* disk = FindDisk(diskNumber);
+        if (!disk) return nullptr;
+        for (auto& part : disk->partitions) {
+            if (part.number == partitionNumber) return &part;
+        }
+        return nullptr;
+    }
+
+    static wstring DiskPath(int number) {
+        return STORAGE_NAMESPACE_PREFIX + L"MSFT_Disk.Number=" + to_wstring(number);
+    }
+
+    static wstring PartitionPath(const wstring& className, int diskNumber, int partitionNumber) {
+        return STORAGE_NAMESPACE_PREFIX + className + L".DiskNumber=" + to_wstring(diskNumber)
+            + L",PartitionNumber=" + to_wstring(partitionNumber);
+    }
+
+    StorageObjectPtr DiskObject(const SimDisk& disk) {
+        ULONGLONG allocated = 0;
+        for (const auto& part : disk.partitions) allocated += part.size;
+
+        auto obj = MakeObject(L"MSFT_Disk");
+        obj->Put(L"__PATH", DiskPath(disk.number));
+        obj->Put(L"Number", disk.number);
+        obj->Put(L"FriendlyName", L"Simulated Disk " + to_wstring(disk.number));
+        obj->Put(L"Model", L"Simulated Disk");
+        obj->Put(L"SerialNumber", disk.serialNumber);
+        obj->Put(L"Guid", disk.guid);
+        obj->Put(L"UniqueId", disk.serialNumber);
+        obj->Put(L"Size", disk.size);
+        obj->Put(L"AllocatedSize", storage.config.thin ? BackedBytes(disk.backed) : allocated);
+        obj->Put(L"ProvisioningType", storage.config.thin ? 1 : 2);     // Thin / Fixed
+        obj->Put(L"PartitionStyle", disk.partitionStyle);
+        obj->Put(L"IsOffline", disk.isOffline);
+        obj->Put(L"IsReadOnly", disk.isReadOnly);
+        obj->Put(L"LogicalSectorSize", disk.logicalSectorSize);
+        obj->Put(L"PhysicalSectorSize", disk.physicalSectorSize);
+        obj->Put(L"NumberOfPartitions", (int)disk.partitions.size());
+        return obj;
+    }
+
+    StorageObjectPtr PartitionObject(const SimDisk& disk, const SimPartition& part) {
+        auto obj = MakeObject(L"MSFT_Partition");
+        obj->Put(L"__PATH", PartitionPath(L"MSFT_Partition", disk.number, part.number));
+        obj->Put(L"DiskNumber", disk.number);
+        obj->Put(L"PartitionNumber", part.number);
+        obj->Put(L"Offset", part.offset);
+        obj->Put(L"Size", part.size);
+        obj->Put(L"GptType", part.gptType);
+        obj->Put(L"Guid", part.guid);
+        obj->Put(L"DriveLetter", (int)part.driveLetter);
+        obj->Put(L"AccessPaths", part.accessPaths);
+        return obj;
+    }
+
+    StorageObjectPtr VolumeObject(const SimDisk& disk, const SimPartition& part) {
+        auto obj = MakeObject(L"MSFT_Volume");
+        obj->Put(L"__PATH", PartitionPath(L"MSFT_Volume", disk.number, part.number));
+        obj->Put(L"DiskNumber", disk.number);
+        obj->Put(L"PartitionNumber", part.number);
+        obj->Put(L"Path", L"\\\\?\\Volume" + part.volume.guid + L"\\");
+        obj->Put(L"DriveLetter", (int)part.driveLetter);
+        obj->Put(L"FileSystem", part.volume.fileSystem);
+        obj->Put(L"FileSystemLabel", part.volume.label);
+        obj->Put(L"AllocationUnitSize", part.volume.allocationUnitSize);
+        obj->Put(L"Size", part.size);
+        obj->Put(L"SizeRemaining", part.size - min(part.size, VOLUME_USED_BYTES));
+        return obj;
+    }
+
+    // 非池化磁盘的 MSFT_PhysicalDisk.DeviceId 与 MSFT_Disk.Number 相同
+    StorageObjectPtr PhysicalDiskObject(const SimDisk& disk) {
+        auto obj = MakeObject(L"MSFT_PhysicalDisk");
+        obj->Put(L"__PATH", STORAGE_NAMESPACE_PREFIX + L"MSFT_PhysicalDisk.ObjectId=\"SIM-PD-" + to_wstring(disk.number) + L"\"");
+        obj->Put(L"DeviceId", to_wstring(disk.number));
+        obj->Put(L"FriendlyName", L"Simulated Disk " + to_wstring(disk.number));
+        obj->Put(L"SerialNumber", disk.serialNumber);
+        obj->Put(L"Size", disk.size);
+        obj->Put(L"MediaType", 4);             // SSD
+        obj->Put(L"HealthStatus", disk.health.healthStatus);
+        obj->Put(L"OperationalStatus", disk.health.operationalStatus);
+
+        vector<wstring> cannotPoolReason = CannotPoolReason(disk);
+        obj->Put(L"CanPool", cannotPoolReason.empty());
+        obj->Put(L"CannotPoolReason", cannotPoolReason);
+        return obj;
+    }
+
+    // MSFT_PhysicalDisk.CannotPoolReason: 2 已在池中, 3 不正常, 6 脱机, 7 容量不足 (含已有分区)
+    static vector<wstring> CannotPoolReason(const SimDisk& disk) {
+        vector<wstring> reasons;
+        if (disk.poolId != 0) reasons.push_back(L"2");
+        if (disk.health.healthStatus != 0) reasons.push_back(L"3");
+        if (disk.isOffline) reasons.push_back(L"6");
+        if (!disk.partitions.empty() || disk.size < POOL_MIN_DISK_BYTES) reasons.push_back(L"7");
+        return reasons;
+    }
+
+    StorageObjectPtr SubSystemObject() {
+        auto obj = MakeObject(L"MSFT_StorageSubSystem");
+        obj->Put(L"__PATH", STORAGE_NAMESPACE_PREFIX + L"MSFT_StorageSubSystem.ObjectId=\"SIM-SS\"");
+        obj->Put(L"ObjectId", L"SIM-SS");
+        obj->Put(L"FriendlyName", L"Windows Storage on SIM");
+        obj->Put(L"Model", L"Windows Storage");
+        return obj;
+    }
+
+    // 池的可用原始容量: 每块成员盘扣除元数据保留后按 slab 取整
+    ULONGLONG PoolCapacity(const SimPool& pool) {
+        ULONGLONG capacity = 0;
+        for (int member : pool.members) {
+            const SimDisk* disk = FindDisk(member);
+            if (disk && disk->size > POOL_RESERVED_BYTES) {
+                capacity += (disk->size - POOL_RESERVED_BYTES) / POOL_SLAB_BYTES * POOL_SLAB_BYTES;
+            }
+        }
+        return capacity;
+    }
+
+    StorageObjectPtr PoolObject(const SimPool& pool) {
+        auto obj = MakeObject(L"MSFT_StoragePool");
+        wstring objectId = L"SIM-POOL-" + to_wstring(pool.id);
+        obj->Put(L"__PATH", STORAGE_NAMESPACE_PREFIX + L"MSFT_StoragePool.ObjectId=\"" + objectId + L"\"");
+        obj->Put(L"ObjectId", objectId);
+        obj->Put(L"FriendlyName", pool.friendlyName);
+        obj->Put(L"IsPrimordial", false);
+        obj->Put(L"HealthStatus", 0);
+        obj->Put(L"Size", PoolCapacity(pool));
+        obj->Put(L"AllocatedSize", pool.allocated);
+        return obj;
+    }
+
+    StorageObjectPtr VirtualDiskObject(const SimVirtualDisk& vd) {
+        auto obj = MakeObject(L"MSFT_VirtualDisk");
+        wstring objectId = L"SIM-VD-" + to_wstring(vd.diskNumber);
+        obj->Put(L"__PATH", STORAGE_NAMESPACE_PREFIX + L"MSFT_VirtualDisk.ObjectId=\"" + objectId + L"\"");
+        obj->Put(L"ObjectId", objectId);
+        obj->Put(L"FriendlyName", vd.friendlyName);
+        obj->Put(L"Size", vd.size);
+        obj->Put(L"FootprintOnPool", vd.size * (ULONGLONG)vd.copies);
+        obj->Put(L"ResiliencySettingName", vd.resiliency);
+        obj->Put(L"NumberOfColumns", vd.columns);
+        obj->Put(L"NumberOfDataCopies", vd.copies);
+        obj->Put(L"Interleave", vd.interleave);
+        obj->Put(L"ProvisioningType", 2);       // Fixed
+        obj->Put(L"HealthStatus", 0);
+        return obj;
+    }
+
+    StorageObjectPtr ReliabilityCounterObject(const SimDisk& disk) {
+        const SimHealth& health = disk.health;
+
+        auto obj = MakeObject(L"MSFT_StorageReliabilityCounter");
+        obj->Put(L"__PATH", STORAGE_NAMESPACE_PREFIX + L"MSFT_StorageReliabilityCounter.ObjectId=\"SIM-SRC-"
+            + to_wstring(disk.number) + L"\"");
+        obj->Put(L"DeviceId", to_wstring(disk.number));
+        obj->Put(L"Temperature", health.temperature);
+        obj->Put(L"Wear", health.wear);
+        obj->Put(L"ReadErrorsUncorrected", health.readErrors);
+        obj->Put(L"WriteErrorsUncorrected", health.writeErrors);
+        obj->Put(L"ReadLatencyMax", health.readLatencyMax);
+        obj->Put(L"WriteLatencyMax", health.writeLatencyMax);
+        return obj;
+    }
+
+    // 模拟对象 ObjectId ("<前缀><编号>") 中的编号, 无法识别时为 -1
+    static int ObjectNumber(const ObjectPath& objPath, const wstring& prefix) {
+        auto it = objPath.keys.find(L"ObjectId");
+        if (it == objPath.keys.end() || it->second.compare(0, prefix.size(), prefix) != 0) return -1;
+        return (int)wcstol(it->second.c_str() + prefix.size(), nullptr, 10);
+    }
+
+    // 对象路径所属的磁盘编号, 无法识别时为 -1
+    static int SourceDiskNumber(const ObjectPath& objPath) {
+        if (objPath.className == L"MSFT_Disk") return objPath.KeyInt(L"Number");
+        if (objPath.className == L"MSFT_PhysicalDisk") return ObjectNumber(objPath, L"SIM-PD-");
+        if (objPath.className == L"MSFT_VirtualDisk") return ObjectNumber(objPath, L"SIM-VD-");
+        return objPath.KeyInt(L"DiskNumber");
+    }
+
+    StorageObjectPtr LookupInstance(const ObjectPath& objPath) {
+        if (objPath.className == L"MSFT_Disk") {
+            SimDisk* disk = FindBasicDisk(objPath.KeyInt(L"Number"));
+            return disk ? DiskObject(*disk) : nullptr;
+        }
+
+        int diskNumber = objPath.KeyInt(L"DiskNumber");
+        SimPartition* part = FindPartition(diskNumber, objPath.KeyInt(L"PartitionNumber"));
+        if (!part) return nullptr;
+
+        if (objPath.className == L"MSFT_Partition") {
+            return PartitionObject(*FindDisk(diskNumber), *part);
+        }
+        if (objPath.className == L"MSFT_Volume" && part->hasVolume) {
+            return VolumeObject(*FindDisk(diskNumber), *part);
+        }
+        return nullptr;
+    }
+
+    bool CollectObjects(const WqlQuery& wql, vector<StorageObjectPtr>& objects) {
+        if (!IsKnownClass(wql.className)) return false;
+
+        // 存储空间对象不属于某块磁盘
+        if (wql.className == L"MSFT_StorageSubSystem" || wql.className == L"MSFT_StoragePool"
+            || wql.className == L"MSFT_VirtualDisk") {
+            vector<StorageObjectPtr> candidates;
+            if (wql.className == L"MSFT_StorageSubSystem") candidates.push_back(SubSystemObject());
+            for (const auto& entry : storage.pools) {
+                if (wql.className == L"MSFT_StoragePool") candidates.push_back(PoolObject(entry.second));
+                if (wql.className == L"MSFT_VirtualDisk") {
+                    for (const auto& vd : entry.second.virtualDisks) candidates.push_back(VirtualDiskObject(vd));
+                }
+            }
+            for (const auto& obj : candidates) {
+                if (wql.sourcePath.empty() && MatchesConditions(obj, wql.conditions)) objects.push_back(obj);
+            }
+            return true;
+        }
+
+        // 按磁盘编号过滤的查询直接定位, 避免遍历上千块磁盘
+        bool perDisk = wql.className == L"MSFT_Disk" || wql.className == L"MSFT_PhysicalDisk"
+            || wql.className == L"MSFT_StorageReliabilityCounter";
+        const wchar_t* diskKey = wql.className == L"MSFT_Disk" ? L"Number"
+            : perDisk ? L"DeviceId"
+            : L"DiskNumber";
+
+        int onlyDisk = -1;
+        for (const auto& cond : wql.conditions) {
+            if (cond.first == diskKey) {
+                onlyDisk = (int)wcstol(cond.second.c_str(), nullptr, 10);
+            }
+        }
+
+        // ASSOCIATORS OF: 源对象所在磁盘上的 ResultClass 实例 (源为分区时只取该分区的)
+        int onlyPartition = -1;
+        if (!wql.sourcePath.empty()) {
+            ObjectPath source = ParseObjectPath(wql.sourcePath);
+            onlyDisk = SourceDiskNumber(source);
+            if (onlyDisk < 0) return true;
+            if (source.className == L"MSFT_Partition") onlyPartition = source.KeyInt(L"PartitionNumber");
+        }
+
+        auto visit = [&](const SimDisk& disk) {
+            if (perDisk) {
+                if (wql.className == L"MSFT_Disk" && disk.poolId != 0) return;
+                if (wql.className != L"MSFT_Disk" && disk.isVirtual) return;
+                if (wql.className == L"MSFT_StorageReliabilityCounter" && !disk.health.hasCounters) return;
+
+                auto obj = wql.className == L"MSFT_Disk" ? DiskObject(disk)
+                    : wql.className == L"MSFT_PhysicalDisk" ? PhysicalDiskObject(disk)
+                    : ReliabilityCounterObject(disk);
+                if (MatchesConditions(obj, wql.conditions)) objects.push_back(obj);
+                return;
+            }
+
+            for (const auto& part : disk.partitions) {
+                if (wql.className == L"MSFT_Volume" && !part.hasVolume) continue;
+                if (onlyPartition >= 0 && part.number != onlyPartition) continue;
+
+                auto obj = wql.className == L"MSFT_Partition" ? PartitionObject(disk, part) : VolumeObject(disk, part);
+                if (MatchesConditions(obj, wql.conditions)) objects.push_back(obj);
+            }
+        };
+
+        if (onlyDisk >= 0) {
+            SimDisk* disk = FindDisk(onlyDisk);
+            if (disk) visit(*disk);
+        }
+        else {
+            for (const auto& entry : storage.disks) visit(entry.second);
+        }
+
+        return true;
+    }
+
+    // ---------- 方法实现 ----------
+
+    long DiskClear(int diskNumber, const StorageObject& in) {
+        lock_guard<mutex> guard(storage.lock);
+
+        SimDisk* disk = FindBasicDisk(diskNumber);
+        if (!disk) return RET_INVALID_PARAMETER;
+        if (disk->isOffline) return RET_DISK_OFFLINE;
+
+        if (!disk->partitions.empty() && !in.GetBool(L"RemoveData")) {
+            return RET_DISK_HAS_DATA;
+        }
+
+        for (const auto& part : disk->partitions) {
+            storage.ReleaseDriveLetter(part.driveLetter);
+            for (const auto& path : part.accessPaths) storage.accessPathsInUse.erase(path);
+        }
+        disk->partitions.clear();
+        disk->partitionStyle = 0;
+        return RET_SUCCESS;
+    }
+
+    long DiskInitialize(int diskNumber, const StorageObject& in) {
+        lock_guard<mutex> guard(storage.lock);
+
+        SimDisk* disk = FindBasicDisk(diskNumber);
+        if (!disk) return RET_INVALID_PARAMETER;
+        if (disk->isOffline) return RET_DISK_OFFLINE;
+        if (disk->partitionStyle != 0) return RET_DISK_ALREADY_INITIALIZED;
+
+        long long style = in.GetInt(L"PartitionStyle");
+        if (style != 1 && style != 2) return RET_INVALID_PARAMETER;
+
+        disk->partitionStyle = (int)style;
+        disk->guid = storage.NewGuid();
+        return RET_SUCCESS;
+    }
+
+    long DiskCreatePartition(int diskNumber, const StorageObject& in, StorageObject& out) {
+        bool assignLetter = false;
+        long ret = RET_SUCCESS;
+
+        {
+            lock_guard<mutex> guard(storage.lock);
+
+            SimDisk* disk = FindBasicDisk(diskNumber);
+            if (!disk) return RET_INVALID_PARAMETER;
+            if (disk->isOffline) return RET_DISK_OFFLINE;
+            if (disk->partitionStyle == 0) return RET_DISK_NOT_INITIALIZED;
+            if ((int)disk->partitions.size() >= GPT_MAX_PARTITIONS) return RET_NOT_ENOUGH_RESOURCES;
+
+            const ULONGLONG sector = (ULONGLONG)disk->logicalSectorSize;
+            const ULONGLONG firstUsable = (2 + GPT_ENTRY_ARRAY_BYTES / sector) * sector;
+            const ULONGLONG lastUsable = disk->size - (1 + GPT_ENTRY_ARRAY_BYTES / sector) * sector;
+
+            PropValue alignmentValue = in.Prop(L"Alignment");
+            ULONGLONG alignment = alignmentValue.IsEmpty() ? MiB : alignmentValue.AsUInt64();
+            if (alignment == 0 || alignment % sector != 0) return RET_INVALID_PARAMETER;
+
+            ULONGLONG size = in.GetUInt64(L"Size");
+            bool useMaximumSize = in.GetBool(L"UseMaximumSize");
+            PropValue offsetValue = in.Prop(L"Offset");
+            bool hasOffset = !offsetValue.IsEmpty() && offsetValue.AsUInt64() > 0;
+
+            if (!useMaximumSize && (size == 0 || size % sector != 0)) return RET_INVALID_PARAMETER;
+
+            // 空闲区间 (已按 Offset 排序)
+            vector<pair<ULONGLONG, ULONGLONG>> gaps;
+            ULONGLONG cursor = firstUsable;
+            for (const auto& part : disk->partitions) {
+                if (part.offset > cursor) gaps.push_back({ cursor, part.offset });
+                cursor = max(cursor, part.offset + part.size);
+            }
+            if (lastUsable > cursor) gaps.push_back({ cursor, lastUsable });
+
+            ULONGLONG offset = 0;
+            bool placed = false;
+
+            if (hasOffset) {
+                offset = offsetValue.AsUInt64();
+                if (offset % sector != 0) return RET_INVALID_OFFSET;
+
+                for (const auto& gap : gaps) {
+                    if (offset >= gap.first && offset < gap.second) {
+                        if (useMaximumSize) size = (gap.second - offset) / sector * sector;
+                        placed = size > 0 && offset + size <= gap.second;
+                        break;
+                    }
+                }
+                if (!placed) return RET_INVALID_OFFSET;
+            }
+            else if (useMaximumSize) {
+                for (const auto& gap : gaps) {
+                    ULONGLONG start = (gap.first + alignment - 1) / alignment * alignment;
+                    if (start >= gap.second) continue;
+                    ULONGLONG length = (gap.second - start) / sector * sector;
+                    if (length > size) {
+                        offset = start;
+                        size = length;
+                        placed = true;
+                    }
+                }
+            }
+            else {
+                for (const auto& gap : gaps) {
+                    ULONGLONG start = (gap.first + alignment - 1) / alignment * alignment;
+                    if (start + size <= gap.second) {
+                        offset = start;
+                        placed = true;
+                        break;
+                    }
+                }
+            }
+
+            if (!placed) return RET_NOT_ENOUGH_SPACE;
+
+            SimPartition part;
+            part.offset = offset;
+            part.size = size;
+            part.gptType = in.GetString(L"GptType");
+            if (part.gptType.empty()) part.gptType = GUID_BASIC_DATA_PARTITION;
+            part.guid = storage.NewGuid();
+
+            // 最小未使用的分区号
+            part.number = 1;
+            for (bool used = true; used; ) {
+                used = false;
+                for (const auto& existing : disk->partitions) {
+                    if (existing.number == part.number) {
+                        part.number++;
+                        used = true;
+                    }
+                }
+            }
+
+            // 未显式指定 AssignDriveLetter 时, 基础数据分区会被挂载并分配盘符
+            PropValue assignValue = in.Prop(L"AssignDriveLetter");
+            bool wantsLetter = assignValue.IsEmpty() ? true : assignValue.AsBool();
+            if (wantsLetter && EqualsNoCase(part.gptType, GUID_BASIC_DATA_PARTITION)) {
+                part.driveLetter = storage.AllocateDriveLetter();
+                assignLetter = part.driveLetter != 0;
+            }
+
+            auto pos = upper_bound(disk->partitions.begin(), disk->partitions.end(), part,
+                [](const SimPartition& a, const SimPartition& b) { return a.offset < b.offset; });
+            pos = disk->partitions.insert(pos, part);
+
+            out.Put(L"CreatedPartition", PartitionObject(*disk, *pos));
+        }
+
+        // 挂载与盘符分配 (mount manager / shell 通知)
+        if (assignLetter) {
+            Charge(L"MountLetter");
+        }
+
+        return ret;
+    }
+
+    long PartitionFormat(int diskNumber, int partitionNumber, const StorageObject& in, StorageObject& out) {
+        ULONGLONG size = 0;
+        {
+            lock_guard<mutex> guard(storage.lock);
+
+            SimPartition* part = FindPartition(diskNumber, partitionNumber);
+            if (!part) return RET_INVALID_PARAMETER;
+            size = part->size;
+        }
+
+        // 完全格式化需要写满整个分区
+        if (in.GetBool(L"Full")) {
+            Charge(L"FormatFull", (double)size / GiB);
+        }
+
+        lock_guard<mutex> guard(storage.lock);
+
+        SimDisk* disk = FindDisk(diskNumber);
+        SimPartition* part = FindPartition(diskNumber, partitionNumber);
+        if (!disk || !part) return RET_INVALID_PARAMETER;
+
+        part->hasVolume = true;
+        part->volume.fileSystem = FileSystemName(in.Prop(L"FileSystem"));
+        part->volume.label = in.GetString(L"FileSystemLabel");
+        part->volume.allocationUnitSize = in.GetUInt64(L"AllocationUnitSize");
+        if (part->volume.allocationUnitSize == 0) part->volume.allocationUnitSize = 4096;
+        if (part->volume.guid.empty()) part->volume.guid = storage.NewGuid();
+
+        // 完全格式化写满分区, 快速格式化只写卷元数据
+        BackRange(disk->backed, storage.config.thinSlab, part->offset,
+            in.GetBool(L"Full") ? part->size : min(part->size, VOLUME_USED_BYTES));
+
+        out.Put(L"FormattedVolume", VolumeObject(*disk, *part));
+        return RET_SUCCESS;
+    }
+
+    // 只模拟 ReTrim: 释放卷的空闲范围 (卷元数据之后) 上的完整 slab, 耗时随空闲空间增长
+    long VolumeOptimize(int diskNumber, int partitionNumber, const StorageObject& in) {
+        if (!in.GetBool(L"ReTrim")) return RET_NOT_SUPPORTED;
+
+        ULONGLONG freeBytes = 0;
+        {
+            lock_guard<mutex> guard(storage.lock);
+
+            SimDisk* disk = FindDisk(diskNumber);
+            SimPartition* part = FindPartition(diskNumber, partitionNumber);
+            if (!disk || !part || !part->hasVolume) return RET_INVALID_PARAMETER;
+            if (disk->isOffline) return RET_DISK_OFFLINE;
+            freeBytes = part->size - min(part->size, VOLUME_USED_BYTES);
+        }
+
+        Charge(L"ReTrim", (double)freeBytes / GiB);
+
+        lock_guard<mutex> guard(storage.lock);
+
+        SimDisk* disk = FindDisk(diskNumber);
+        SimPartition* part = FindPartition(diskNumber, partitionNumber);
+        if (!disk || !part) return RET_INVALID_PARAMETER;
+
+        ULONGLONG used = min(part->size, VOLUME_USED_BYTES);
+        UnmapRange(disk->backed, storage.config.thinSlab, part->offset + used, part->size - used);
+        return RET_SUCCESS;
+    }
+
+    // 分区可调整的范围 (调用方持有 storage.lock)
+    //   上限: 原地扩展到下一个分区或最后可用扇区, 不移动分区起点;
+    //         FAT32 / exFAT 卷不支持联机扩展, 上限为当前大小
+    //   下限: 已格式化的卷保留已用空间 (VOLUME_USED_BYTES), 空白分区 1 MiB
+    static bool SupportedRange(const SimDisk& disk, const SimPartition& part, ULONGLONG& sizeMin, ULONGLONG& sizeMax) {
+        const ULONGLONG sector = (ULONGLONG)disk.logicalSectorSize;
+        const ULONGLONG lastUsable = disk.size - (1 + GPT_ENTRY_ARRAY_BYTES / sector) * sector;
+
+        ULONGLONG end = lastUsable;
+        for (const auto& other : disk.partitions) {
+            if (other.offset > part.offset) end = min(end, other.offset);
+        }
+        if (end < part.offset + part.size) return false;
+
+        bool fixedSize = part.hasVolume
+            && (EqualsNoCase(part.volume.fileSystem, L"FAT32") || EqualsNoCase(part.volume.fileSystem, L"exFAT"));
+
+        sizeMax = fixedSize ? part.size : (end - part.offset) / sector * sector;
+        sizeMin = part.hasVolume ? min(part.size, VOLUME_USED_BYTES) : min(part.size, MiB);
+        return true;
+    }
+
+    long PartitionGetSupportedSize(int diskNumber, int partitionNumber, StorageObject& out) {
+        lock_guard<mutex> guard(storage.lock);
+
+        SimDisk* disk = FindDisk(diskNumber);
+        SimPartition* part = FindPartition(diskNumber, partitionNumber);
+        if (!disk || !part) return RET_INVALID_PARAMETER;
+        if (disk->isOffline) return RET_DISK_OFFLINE;
+
+        ULONGLONG sizeMin = 0, sizeMax = 0;
+        if (!SupportedRange(*disk, *part, sizeMin, sizeMax)) return RET_FAILED;
+
+        out.Put(L"SizeMin", sizeMin);
+        out.Put(L"SizeMax", sizeMax);
+        return RET_SUCCESS;
+    }
+
+    long PartitionResize(int diskNumber, int partitionNumber, const StorageObject& in) {
+        lock_guard<mutex> guard(storage.lock);
+
+        SimDisk* disk = FindDisk(diskNumber);
+        SimPartition* part = FindPartition(diskNumber, partitionNumber);
+        if (!disk || !part) return RET_INVALID_PARAMETER;
+        if (disk->isOffline) return RET_DISK_OFFLINE;
+
+        ULONGLONG size = in.GetUInt64(L"Size");
+        if (size == 0 || size % (ULONGLONG)disk->logicalSectorSize != 0) return RET_INVALID_PARAMETER;
+
+        ULONGLONG sizeMin = 0, sizeMax = 0;
+        if (!SupportedRange(*disk, *part, sizeMin, sizeMax)) return RET_FAILED;
+        if (size > sizeMax) return RET_NOT_ENOUGH_SPACE;
+        if (size < sizeMin) return RET_INVALID_PARAMETER;
+
+        part->size = size;
+        return RET_SUCCESS;
+    }
+
+    // 文件夹挂载点 (以 \ 结尾) 或盘符 ("E:" / "E:\")
+    long PartitionAddAccessPath(int diskNumber, int partitionNumber, const StorageObject& in) {
+        lock_guard<mutex> guard(storage.lock);
+
+        SimPartition* part = FindPartition(diskNumber, partitionNumber);
+        if (!part) return RET_INVALID_PARAMETER;
+
+        wstring path = in.GetString(L"AccessPath");
+        if (path.empty()) return RET_INVALID_PARAMETER;
+        if (path.back() != L'\\') path += L'\\';
+
+        if (!storage.accessPathsInUse.insert(path).second) return RET_INVALID_PARAMETER;
+        part->accessPaths.push_back(path);
+        return RET_SUCCESS;
+    }
+
+    // 把 PhysicalDisks 中的空白磁盘组成新池
+    long SubSystemCreateStoragePool(const StorageObject& in, StorageObject& out) {
+        lock_guard<mutex> guard(storage.lock);
+
+        wstring name = in.GetString(L"FriendlyName");
+        if (name.empty()) return RET_INVALID_PARAMETER;
+        for (const auto& entry : storage.pools) {
+            if (EqualsNoCase(entry.second.friendlyName, name)) return RET_INVALID_PARAMETER;
+        }
+
+        SimPool pool;
+        pool.id = storage.pools.empty() ? 1 : storage.pools.rbegin()->first + 1;
+        pool.friendlyName = name;
+
+        PropValue physicalDisks = in.Prop(L"PhysicalDisks");
+        for (const auto& physicalDisk : physicalDisks.AsObjectArray()) {
+            int number = physicalDisk ? (int)wcstol(physicalDisk->GetString(L"DeviceId").c_str(), nullptr, 10) : -1;
+            SimDisk* disk = FindDisk(number);
+            if (!disk || disk->isVirtual || !CannotPoolReason(*disk).empty()) return RET_INVALID_PARAMETER;
+            if (find(pool.members.begin(), pool.members.end(), number) != pool.members.end()) return RET_INVALID_PARAMETER;
+            pool.members.push_back(number);
+        }
+        if (pool.members.empty()) return RET_INVALID_PARAMETER;
+
+        for (int member : pool.members) {
+            FindDisk(member)->poolId = pool.id;
+        }
+        storage.pools[pool.id] = pool;
+
+        out.Put(L"CreatedStoragePool", PoolObject(pool));
+        return RET_SUCCESS;
+    }
+
+    // 在池中创建固定配置的 Simple / Mirror 虚拟磁盘, 以新编号的 RAW 磁盘出现
+    long PoolCreateVirtualDisk(int poolId, const StorageObject& in, StorageObject& out) {
+        lock_guard<mutex> guard(storage.lock);
+
+        SimPool* pool = FindPool(poolId);
+        if (!pool) return RET_INVALID_PARAMETER;
+
+        SimVirtualDisk vd;
+        vd.friendlyName = in.GetString(L"FriendlyName");
+        vd.resiliency = in.GetString(L"ResiliencySettingName");
+        if (vd.resiliency.empty()) vd.resiliency = L"Simple";
+
+        bool mirror = EqualsNoCase(vd.resiliency, L"Mirror");
+        if (!mirror && !EqualsNoCase(vd.resiliency, L"Simple")) return RET_NOT_SUPPORTED;
+
+        PropValue copies = in.Prop(L"NumberOfDataCopies");
+        vd.copies = copies.IsEmpty() ? (mirror ? 2 : 1) : (int)copies.AsInt();
+        if (mirror ? (vd.copies < 2 || vd.copies > 3) : vd.copies != 1) return RET_INVALID_PARAMETER;
+
+        int members = (int)pool->members.size();
+        PropValue columns = in.Prop(L"NumberOfColumns");
+        vd.columns = columns.IsEmpty() ? max(1, min(members / vd.copies, 8)) : (int)columns.AsInt();
+        if (vd.columns < 1 || vd.columns * vd.copies > members) return RET_NOT_ENOUGH_RESOURCES;
+
+        PropValue interleave = in.Prop(L"Interleave");
+        vd.interleave = interleave.IsEmpty() ? VD_DEFAULT_INTERLEAVE : interleave.AsUInt64();
+        if (vd.interleave < VD_MIN_INTERLEAVE || vd.interleave > VD_MAX_INTERLEAVE
+            || (vd.interleave & (vd.interleave - 1)) != 0) {
+            return RET_INVALID_PARAMETER;
+        }
+
+        // 每次在每列上各分配一个 slab
+        const ULONGLONG unit = POOL_SLAB_BYTES * (ULONGLONG)vd.columns;
+        ULONGLONG capacity = PoolCapacity(*pool);
+        ULONGLONG available = capacity > pool->allocated ? capacity - pool->allocated : 0;
+        ULONGLONG maxSize = available / (ULONGLONG)vd.copies / unit * unit;
+
+        vd.size = in.GetBool(L"UseMaximumSize") ? maxSize : (in.GetUInt64(L"Size") + unit - 1) / unit * unit;
+        if (vd.size == 0 || vd.size > maxSize) return RET_NOT_ENOUGH_SPACE;
+
+        const SimDisk& first = *FindDisk(pool->members.front());
+        SimDisk disk;
+        disk.number = storage.disks.rbegin()->first + 1;
+        disk.size = vd.size;
+        disk.partitionStyle = 0;
+        disk.logicalSectorSize = first.logicalSectorSize;
+        disk.physicalSectorSize = first.physicalSectorSize;
+        disk.serialNumber = L"SIMVD" + to_wstring(disk.number);
+        disk.isVirtual = true;
+        storage.disks[disk.number] = disk;
+
+        vd.diskNumber = disk.number;
+        pool->allocated += vd.size * (ULONGLONG)vd.copies;
+        pool->virtualDisks.push_back(vd);
+
+        out.Put(L"CreatedVirtualDisk", VirtualDiskObject(vd));
+        return RET_SUCCESS;
+    }
+
+    // 删除虚拟磁盘: 其 MSFT_Disk 连同分区一起消失, 容量归还给池
+    long VirtualDiskDelete(int diskNumber) {
+        lock_guard<mutex> guard(storage.lock);
+
+        for (auto& entry : storage.pools) {
+            auto& virtualDisks = entry.second.virtualDisks;
+            auto vd = find_if(virtualDisks.begin(), virtualDisks.end(),
+                [&](const SimVirtualDisk& candidate) { return candidate.diskNumber == diskNumber; });
+            if (vd == virtualDisks.end()) continue;
+
+            SimDisk* disk = FindDisk(diskNumber);
+            if (disk) {
+                for (const auto& part : disk->partitions) {
+                    storage.ReleaseDriveLetter(part.driveLetter);
+                    for (const auto& path : part.accessPaths) storage.accessPathsInUse.erase(path);
+                }
+                storage.disks.erase(diskNumber);
+            }
+
+            entry.second.allocated -= vd->size * (ULONGLONG)vd->copies;
+            virtualDisks.erase(vd);
+            return RET_SUCCESS;
+        }
+        return RET_INVALID_PARAMETER;
+    }
+
+    // 删除存储池: 池中仍有虚拟磁盘时拒绝; 成员盘恢复为可加入池
+    long PoolDelete(int poolId) {
+        lock_guard<mutex> guard(storage.lock);
+
+        SimPool* pool = FindPool(poolId);
+        if (!pool) return RET_INVALID_PARAMETER;
+        if (!pool->virtualDisks.empty()) return RET_DISK_HAS_DATA;
+
+        for (int member : pool->members) {
+            SimDisk* disk = FindDisk(member);
+            if (disk) disk->poolId = 0;
+        }
+        storage.pools.erase(poolId);
+        return RET_SUCCESS;
+    }
+
+    SimulatedStorage& storage;
+    mt19937_64 rng;
+    chrono::nanoseconds clock;
+};
+
+// ================================
+// SimulatedStorage
+// ================================
+
+SimulatedStorage::SimulatedStorage(const SimConfig& config)
+    : config(config), lettersInUse(26, false), guidRng(config.seed), sessionCounter(0) {
+    // A: B: C: 保留给系统
+    lettersInUse[0] = lettersInUse[1] = lettersInUse[2] = true;
+
+    for (int i = 0; i < config.diskCount; i++) {
+        SimDisk disk;
+        disk.number = config.firstDiskNumber + i;
+        disk.size = config.diskSize;
+        disk.partitionStyle = config.partitionStyle;
+        disk.logicalSectorSize = config.logicalSectorSize;
+        disk.physicalSectorSize = config.physicalSectorSize;
+
+        wstringstream serial;
+        serial << L"SIM" << setw(6) << setfill(L'0') << disk.number;
+        disk.serialNumber = serial.str();
+        disk.guid = config.partitionStyle == 2 ? NewGuid() : L"";
+
+        auto health = config.health.find(disk.number);
+        if (health != config.health.end()) disk.health = health->second;
+
+        // 之前写入的数据 (written=)
+        BackRange(disk.backed, config.thinSlab, 0, min(config.thinWritten, disk.size));
+
+        // 预置的旧分区: 超出磁盘或与前一个分区重叠的项忽略
+        auto preset = config.partitions.find(disk.number);
+        if (preset != config.partitions.end()) {
+            ULONGLONG cursor = 0;
+            for (const auto& range : preset->second) {
+                if (range.first < cursor || range.first % disk.logicalSectorSize != 0
+                    || range.first + range.second > disk.size) continue;
+
+                SimPartition part;
+                part.number = (int)disk.partitions.size() + 1;
+                part.offset = range.first;
+                part.size = range.second / disk.logicalSectorSize * disk.logicalSectorSize;
+                part.gptType = GUID_BASIC_DATA_PARTITION;
+                part.guid = NewGuid();
+                part.hasVolume = true;
+                part.volume.fileSystem = L"NTFS";
+                part.volume.allocationUnitSize = 4096;
+                part.volume.guid = NewGuid();
+                disk.partitions.push_back(part);
+                BackRange(disk.backed, config.thinSlab, part.offset, part.size);
+                cursor = part.offset + part.size;
+            }
+        }
+
+        disks[disk.number] = disk;
+    }
+}
+
+unique_ptr<StorageBackend> SimulatedStorage::CreateSession() {
+    return unique_ptr<StorageBackend>(new SimulatedBackend(*this, sessionCounter++));
+}
+
+BackendFactory SimulatedStorage::Factory() {
+    return [this]() { return CreateSession(); };
+}
+
+vector<SimDisk> SimulatedStorage::Snapshot() const {
+    lock_guard<mutex> guard(lock);
+
+    vector<SimDisk> result;
+    for (const auto& entry : disks) result.push_back(entry.second);
+    return result;
+}
+
+vector<SimPool> SimulatedStorage::PoolSnapshot() const {
+    lock_guard<mutex> guard(lock);
+
+    vector<SimPool> result;
+    for (const auto& entry : pools) result.push_back(entry.second);
+    return result;
+}
+
+bool SimulatedStorage::ProbeRead(int diskNumber, int samples, vector<double>& latenciesMs) const {
+    SimHealth health;
+    {
+        lock_guard<mutex> guard(lock);
+
+        auto it = disks.find(diskNumber);
+        if (it == disks.end()) return false;
+        health = it->second.health;
+    }
+
+    // 每块盘独立的随机序列, 与会话调度顺序无关
+    mt19937_64 rng(config.seed * 0x9E3779B97F4A7C15ULL + 0x5052 + (unsigned long long)diskNumber);
+    LatencyModel model;
+    auto it = config.latency.find(L"ProbeRead");
+    if (it != config.latency.end()) model = it->second;
+
+    latenciesMs.clear();
+    for (int i = 0; i < samples; i++) {
+        double ms = health.probeMs > 0 ? health.probeMs : model.Sample(rng).count() / 1e6;
+        if (model.failureRate > 0 && uniform_real_distribution<double>(0.0, 1.0)(rng) < model.failureRate) {
+            return false;
+        }
+        latenciesMs.push_back(ms);
+    }
+    return true;
+}
+
+chrono::nanoseconds SimulatedStorage::ReserveSerial(chrono::nanoseconds earliest, chrono::nanoseconds duration) {
+    lock_guard<mutex> guard(serialLock);
+
+    // 会话按真实线程调度先后到达, 因此在区间表中寻找 earliest 之后第一个足够大的空档
+    long long start = earliest.count();
+    long long length = duration.count();
+
+    auto it = serialBusy.upper_bound(start);
+    if (it != serialBusy.begin()) {
+        auto prev = std::prev(it);
+        if (prev->second > start) start = prev->second;
+    }
+    while (it != serialBusy.end() && it->first < start + length) {
+        start = max(start, it->second);
+        ++it;
+    }
+
+    serialBusy[start] = start + length;
+    return chrono::nanoseconds(start);
+}
+
+wstring SimulatedStorage::NewGuid() {
+    unsigned long long hi = guidRng();
+    unsigned long long lo = guidRng();
+
+    wstringstream ss;
+    ss << hex << uppercase << setfill(L'0') << L"{"
+        << setw(8) << (hi >> 32) << L"-"
+        << setw(4) << ((hi >> 16) & 0xFFFF) << L"-"
+        << setw(4) << ((hi & 0x0FFF) | 0x4000) << L"-"
+        << setw(4) << (((lo >> 48) & 0x3FFF) | 0x8000) << L"-"
+        << setw(12) << (lo & 0xFFFFFFFFFFFFULL) << L"}";
+    return ss.str();
+}
+
+wchar_t SimulatedStorage::AllocateDriveLetter() {
+    for (size_t i = 0; i < lettersInUse.size(); i++) {
+        if (!lettersInUse[i]) {
+            lettersInUse[i] = true;
+            return (wchar_t)(L'A' + i);
+        }
+    }
+    return 0;
+}
+
+void SimulatedStorage::ReleaseDriveLetter(wchar_t letter) {
+    if (letter >= L'A' && letter <= L'Z') {
+        lettersInUse[letter - L'A'] = false;
+    }
+}
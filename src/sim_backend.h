@@ -0,0 +1,224 @@
+﻿#pragma once
+
+/*
+ * 进程内模拟存储提供程序
+ *
+ * 在内存中模拟 ROOT\Microsoft\Windows\Storage 的 MSFT_Disk / MSFT_Partition /
+ * MSFT_Volume 状态, 实现工具用到的 WQL 查询与 Clear / Initialize /
+ * CreatePartition / Format / GetSupportedSize / Resize / AddAccessPath 方法
+ * 以及 MSFT_StorageSetting.UpdateHostStorageCache。
+ * 每块磁盘另有只读的 MSFT_PhysicalDisk / MSFT_StorageReliabilityCounter 对象,
+ * 健康状态与计数器取自固定的健康值 (可由 --sim-health 按磁盘覆盖), 供预检使用。
+ * 磁盘默认为空, --sim-partitions 可预置其他工具留下的分区 (供 --audit 使用)。
+ * 存储空间: MSFT_StorageSubSystem.CreateStoragePool 把空白磁盘加入池 (成员从 MSFT_Disk 中消失),
+ * MSFT_StoragePool.CreateVirtualDisk 按列数/交错/副本数创建 Simple 或 Mirror 虚拟磁盘,
+ * 虚拟磁盘以新编号的 RAW MSFT_Disk 出现, 之后与普通磁盘一样分区、格式化。
+ * 精简置备 (thin=1): 每块磁盘按 slab 记录阵列上已分配的范围, 格式化 (完全格式化为整个分区,
+ * 快速格式化为卷元数据) 与预置分区会分配, MSFT_Volume.Optimize(ReTrim) 释放卷的空闲范围,
+ * MSFT_Disk.AllocatedSize 报告已分配量; Clear 不释放 (与多数阵列一致)。
+ * 每类操作的延迟与失败率可配置。
+ *
+ * 时间模型:
+ *   - 虚拟时间 (默认): 每个会话维护自己的虚拟时钟, 操作延迟只推进时钟,
+ *     不真正阻塞, 可在一个进程内快速模拟成千上万块磁盘;
+ *   - 真实时间 (realtime=1): 按 scale 缩放后真正 sleep。
+ * 标记为 serial 的操作占用宿主机全局存储服务, 不同会话之间互斥排队。
+ */
+
+#include "storage_backend.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+// ================================
+// 延迟与失败模型
+// ================================
+
+struct LatencyModel {
+    enum class Dist { Fixed, Uniform, Normal, LogNormal, Exponential };
+
+    Dist dist = Dist::Fixed;
+    double a = 0;            // 纳秒: fixed 值 / uniform 下限 / 均值
+    double b = 0;            // 纳秒: uniform 上限 / 标准差
+    double failureRate = 0;  // 0..1
+    bool serial = false;     // 占用宿主机全局存储服务
+
+    std::chrono::nanoseconds Sample(std::mt19937_64& rng) const;
+};
+
+// 模拟的磁盘健康状态与可靠性计数器 (默认值为一块健康的 SSD)
+struct SimHealth {
+    int healthStatus = 0;                    // 0 Healthy / 1 Warning / 2 Unhealthy
+    std::vector<std::wstring> operationalStatus = { L"2" };   // 2 OK, 3 Degraded, 5 Predictive Failure ...
+    int temperature = 35;                    // °C
+    int wear = 3;                            // %
+    ULONGLONG readErrors = 0;                // 未纠正的读/写错误
+    ULONGLONG writeErrors = 0;
+    ULONGLONG readLatencyMax = 8;            // ms
+    ULONGLONG writeLatencyMax = 12;
+    bool hasCounters = true;                 // false: 驱动不提供 MSFT_StorageReliabilityCounter
+    double probeMs = 0;                      // 探测读的固定延迟, 0 使用 ProbeRead 延迟模型
+};
+
+struct SimConfig {
+    int diskCount = 4;
+    int firstDiskNumber = 1;
+    ULONGLONG diskSize = 1024ULL * 1024 * 1024 * 1024;
+    int partitionStyle = 2;              // 0 RAW / 1 MBR / 2 GPT
+    int logicalSectorSize = 512;
+    int physicalSectorSize = 4096;
+    unsigned long long seed = 1;
+    bool realTime = false;
+    double timeScale = 1.0;              // 真实时间模式下的延迟缩放
+
+    // 精简置备: 阵列的分配单位, 以及初始时已分配的范围 (从磁盘起点算起, 模拟之前写入的数据)
+    bool thin = false;
+    ULONGLONG thinSlab = 1024 * 1024;
+    ULONGLONG thinWritten = 0;
+
+    // 操作名 -> 延迟模型
+    //   WMI 调用: ExecQuery / Next / GetObject / GetMethod / SpawnInstance / PutInstance
+    //   方法:     Clear / Initialize / CreatePartition / Format / GetSupportedSize / Resize /
+    //             AddAccessPath / UpdateHostStorageCache / CreateStoragePool / CreateVirtualDisk / Optimize
+    //   附加开销: FormatFull (每 GiB) / MountLetter (分配盘符) / ReTrim (每 GiB 空闲空间)
+    //   预检:     ProbeRead (每次 4K 探测读)
+    std::map<std::wstring, LatencyModel> latency;
+
+    // 磁盘编号 -> 健康状态 (未列出的磁盘使用 SimHealth 默认值)
+    std::map<int, SimHealth> health;
+
+    // 磁盘编号 -> 已有分区 (偏移, 大小), 模拟其他工具创建的旧布局; 每个分区带 4K 簇的 NTFS 卷
+    std::map<int, std::vector<std::pair<ULONGLONG, ULONGLONG>>> partitions;
+
+    // 带默认延迟模型的配置 (经验值, 可被 --sim-latency 覆盖)
+    static SimConfig Default();
+};
+
+// 解析 --sim=disks=N,size=1T,style=gpt,sector=512/4096,seed=S,realtime=0,scale=1,thin=0,slab=1M,written=0|all
+bool ParseSimConfig(const std::wstring& params, SimConfig& config);
+
+// 解析 --sim-latency=<操作>:<分布>:<参数1>[:<参数2>][:serial]
+//   分布: fixed:<值> | uniform:<下限>:<上限> | normal:<均值>:<标准差>
+//         lognormal:<均值>:<标准差> | exp:<均值>
+bool ParseLatencySpec(const std::wstring& spec, SimConfig& config);
+
+// 解析 --sim-fail=<操作>:<概率>
+bool ParseFailureSpec(const std::wstring& spec, SimConfig& config);
+
+// 解析 --sim-health=<磁盘列表>:health=warning,status=2/5,temp=71,wear=95,read-errors=3,
+//   write-errors=0,read-latency=800,write-latency=900,counters=0,probe=40  (延迟单位 ms)
+bool ParseHealthSpec(const std::wstring& spec, SimConfig& config);
+
+// 解析 --sim-partitions=<磁盘列表>:<偏移>+<大小>[/<偏移>+<大小>...]  (如 1-8:32256+100G/107374215168+50G)
+bool ParsePartitionsSpec(const std::wstring& spec, SimConfig& config);
+
+// ================================
+// 模拟状态
+// ================================
+
+struct SimVolume {
+    std::wstring fileSystem;
+    std::wstring label;
+    ULONGLONG allocationUnitSize = 0;
+    std::wstring guid;
+};
+
+struct SimPartition {
+    int number = 0;
+    ULONGLONG offset = 0;
+    ULONGLONG size = 0;
+    std::wstring gptType;
+    std::wstring name;
+    std::wstring guid;
+    wchar_t driveLetter = 0;
+    std::vector<std::wstring> accessPaths;
+    bool hasVolume = false;
+    SimVolume volume;
+};
+
+// 存储空间虚拟磁盘 (其 MSFT_Disk 为 diskNumber)
+struct SimVirtualDisk {
+    int diskNumber = 0;
+    std::wstring friendlyName;
+    std::wstring resiliency;                // Simple / Mirror
+    int columns = 1;
+    int copies = 1;
+    ULONGLONG interleave = 0;
+    ULONGLONG size = 0;
+};
+
+struct SimPool {
+    int id = 0;
+    std::wstring friendlyName;
+    std::vector<int> members;               // 成员磁盘编号
+    ULONGLONG allocated = 0;                // 已分配的原始容量 (含全部副本)
+    std::vector<SimVirtualDisk> virtualDisks;
+};
+
+struct SimDisk {
+    int number = 0;
+    ULONGLONG size = 0;
+    int partitionStyle = 0;
+    bool isOffline = false;
+    bool isReadOnly = false;
+    int logicalSectorSize = 512;
+    int physicalSectorSize = 4096;
+    std::wstring serialNumber;
+    std::wstring guid;
+    std::vector<SimPartition> partitions;   // 按 Offset 排序
+    SimHealth health;
+    int poolId = 0;                         // 已加入的存储池 (0 为未加入)
+    bool isVirtual = false;                 // 存储空间虚拟磁盘
+    std::map<ULONGLONG, ULONGLONG> backed;  // 阵列上已分配的范围 (起点 -> 终点, 按 slab 对齐)
+};
+
+class SimulatedBackend;
+
+class SimulatedStorage {
+public:
+    explicit SimulatedStorage(const SimConfig& config);
+
+    const SimConfig& Config() const { return config; }
+
+    // 创建一个会话 (每个工作线程一个)
+    std::unique_ptr<StorageBackend> CreateSession();
+    BackendFactory Factory();
+
+    // 状态快照 (报告与校验用)
+    std::vector<SimDisk> Snapshot() const;
+    std::vector<SimPool> PoolSnapshot() const;
+
+    // 模拟预检的读延迟探测: 按磁盘的 probe= 或 ProbeRead 延迟模型给出 samples 次读的毫秒数,
+    // 不推进任何会话的时钟; 磁盘不存在或注入失败时返回 false
+    bool ProbeRead(int diskNumber, int samples, std::vector<double>& latenciesMs) const;
+
+private:
+    friend class SimulatedBackend;
+
+    // 在虚拟时间轴上为串行操作预留区间, 返回实际开始时间
+    std::chrono::nanoseconds ReserveSerial(std::chrono::nanoseconds earliest, std::chrono::nanoseconds duration);
+
+    std::wstring NewGuid();
+    wchar_t AllocateDriveLetter();
+    void ReleaseDriveLetter(wchar_t letter);
+
+    SimConfig config;
+    mutable std::mutex lock;
+    std::map<int, SimDisk> disks;
+    std::map<int, SimPool> pools;
+    std::vector<bool> lettersInUse;        // 'A'..'Z'
+    std::set<std::wstring> accessPathsInUse;   // 文件夹挂载点
+    std::mt19937_64 guidRng;
+
+    std::mutex serialLock;                  // 串行操作: 虚拟时间区间表 / 真实时间互斥
+    std::map<long long, long long> serialBusy;
+
+    std::atomic<unsigned> sessionCounter;
+};
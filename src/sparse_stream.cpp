@@ -0,0 +1,445 @@
+﻿#include "sparse_stream.h"
+
+#include "byte_order.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+
+static const unsigned SPARSE_HEADER_BYTES = 28;
+static const unsigned SPARSE_CHUNK_HEADER_BYTES = 12;
+
+// 单个 RAW 块组的上限, 限制导出时的内存占用
+static const ULONGLONG SPARSE_MAX_RAW_BLOCKS = 16384;
+
+// --apply 合并相邻 RAW 数据后单次写入的上限
+static const size_t APPLY_WRITE_BYTES = 8 * 1024 * 1024;
+
+// ================================
+// 块组规划
+// ================================
+
+typedef pair<ULONGLONG, ULONGLONG> BlockRange;   // [first, end)
+
+// 追加并与前一个重叠/相邻的范围合并 (输入按起点有序)
+static void AddRange(vector<BlockRange>& ranges, ULONGLONG first, ULONGLONG end) {
+    if (first >= end) return;
+    if (!ranges.empty() && first <= ranges.back().second) {
+        ranges.back().second = max(ranges.back().second, end);
+        return;
+    }
+    ranges.push_back({ first, end });
+}
+
+// 按填充值区分的块范围 (输入按起点有序, 同值的重叠/相邻范围合并)
+struct FillRange {
+    ULONGLONG first = 0;
+    ULONGLONG end = 0;
+    uint32_t fill = 0;
+};
+
+static void AddFillRange(vector<FillRange>& ranges, ULONGLONG first, ULONGLONG end, uint32_t fill) {
+    if (first >= end) return;
+    if (!ranges.empty() && ranges.back().fill == fill && first <= ranges.back().end) {
+        ranges.back().end = max(ranges.back().end, end);
+        return;
+    }
+    ranges.push_back({ first, end, fill });
+}
+
+static void AddChunk(vector<SparseChunk>& chunks, SparseChunkType type, ULONGLONG first, ULONGLONG end, uint32_t fill = 0) {
+    if (first >= end) return;
+
+    if (type == SparseChunkType::Raw) {
+        for (ULONGLONG block = first; block < end; block += SPARSE_MAX_RAW_BLOCKS) {
+            SparseChunk chunk;
+            chunk.type = type;
+            chunk.firstBlock = block;
+            chunk.blockCount = min(SPARSE_MAX_RAW_BLOCKS, end - block);
+            chunks.push_back(chunk);
+        }
+        return;
+    }
+
+    if (!chunks.empty() && chunks.back().type == type && chunks.back().fill == fill
+        && chunks.back().firstBlock + chunks.back().blockCount == first) {
+        chunks.back().blockCount += end - first;
+        return;
+    }
+
+    SparseChunk chunk;
+    chunk.type = type;
+    chunk.firstBlock = first;
+    chunk.blockCount = end - first;
+    chunk.fill = fill;
+    chunks.push_back(chunk);
+}
+
+vector<SparseChunk> PlanSparseChunks(const ExtentList& extents, ULONGLONG diskSize, unsigned blockSize) {
+    const ULONGLONG totalBlocks = diskSize / blockSize;
+
+    // 区段边界不一定按块对齐: 与数据区段相交的块整体作为 RAW (其余部分从区段列表读出);
+    // 零区段向外扩展到整块 (空洞写零无妨), 非零填充区段只取完整覆盖的块, 首尾不完整的块作为 RAW
+    vector<BlockRange> data;
+    vector<FillRange> fills;
+    for (const auto& entry : extents.Extents()) {
+        const ImageExtent& ext = entry.second;
+        ULONGLONG first = ext.offset / blockSize;
+        ULONGLONG end = min(totalBlocks, (ext.End() + blockSize - 1) / blockSize);
+
+        if (ext.IsZero()) {
+            AddFillRange(fills, first, end, 0);
+        }
+        else if (ext.IsFill()) {
+            ULONGLONG innerFirst = min(end, (ext.offset + blockSize - 1) / blockSize);
+            ULONGLONG innerEnd = max(innerFirst, min(end, ext.End() / blockSize));
+            AddRange(data, first, innerFirst);
+            AddFillRange(fills, innerFirst, innerEnd, ext.fill);
+            AddRange(data, innerEnd, end);
+        }
+        else {
+            AddRange(data, first, end);
+        }
+    }
+
+    vector<SparseChunk> chunks;
+    ULONGLONG cursor = 0;
+    size_t d = 0;
+    size_t f = 0;
+
+    while (cursor < totalBlocks) {
+        if (d < data.size() && data[d].first <= cursor) {
+            AddChunk(chunks, SparseChunkType::Raw, cursor, data[d].second);
+            cursor = data[d].second;
+            d++;
+            continue;
+        }
+
+        const ULONGLONG nextData = d < data.size() ? data[d].first : totalBlocks;
+
+        while (f < fills.size() && fills[f].end <= cursor) f++;
+        if (f < fills.size() && fills[f].first <= cursor) {
+            ULONGLONG end = min(fills[f].end, nextData);
+            AddChunk(chunks, SparseChunkType::Fill, cursor, end, fills[f].fill);
+            cursor = end;
+            continue;
+        }
+
+        const ULONGLONG nextFill = f < fills.size() ? fills[f].first : totalBlocks;
+        ULONGLONG end = min(nextData, nextFill);
+        AddChunk(chunks, SparseChunkType::DontCare, cursor, end);
+        cursor = end;
+    }
+
+    return chunks;
+}
+
+// ================================
+// 导出
+// ================================
+
+bool ExportSparse(const ExtentList& extents, ULONGLONG diskSize, OutputStream& out, SparseStats& stats) {
+    stats = SparseStats();
+    stats.diskSize = diskSize;
+
+    const unsigned blockSize = SPARSE_BLOCK_SIZE;
+    if (diskSize % blockSize != 0) {
+        wcerr << L"❌ 稀疏流要求磁盘大小是 " << blockSize << L" 字节的整数倍" << endl;
+        return false;
+    }
+    if (diskSize / blockSize > 0xFFFFFFFFULL) {
+        wcerr << L"❌ 磁盘过大, 稀疏流最多支持 " << FormatBytes(0xFFFFFFFFULL * blockSize) << endl;
+        return false;
+    }
+
+    vector<SparseChunk> chunks = PlanSparseChunks(extents, diskSize, blockSize);
+
+    uint8_t header[SPARSE_HEADER_BYTES] = {};
+    PutLE32(header + 0, SPARSE_MAGIC);
+    PutLE16(header + 4, 1);                              // 主版本
+    PutLE16(header + 6, 0);                              // 次版本
+    PutLE16(header + 8, SPARSE_HEADER_BYTES);
+    PutLE16(header + 10, SPARSE_CHUNK_HEADER_BYTES);
+    PutLE32(header + 12, blockSize);
+    PutLE32(header + 16, (uint32_t)(diskSize / blockSize));
+    PutLE32(header + 20, (uint32_t)chunks.size());
+    PutLE32(header + 24, 0);                             // 不携带整盘校验和
+    if (!out.Write(header, sizeof(header))) return false;
+
+    vector<uint8_t> data;
+    for (const auto& chunk : chunks) {
+        const ULONGLONG bytes = chunk.blockCount * blockSize;
+
+        uint32_t payload = 0;
+        if (chunk.type == SparseChunkType::Raw) payload = (uint32_t)bytes;
+        else if (chunk.type == SparseChunkType::Fill) payload = 4;
+
+        uint8_t chunkHeader[SPARSE_CHUNK_HEADER_BYTES] = {};
+        PutLE16(chunkHeader + 0, (uint16_t)chunk.type);
+        PutLE32(chunkHeader + 4, (uint32_t)chunk.blockCount);
+        PutLE32(chunkHeader + 8, SPARSE_CHUNK_HEADER_BYTES + payload);
+        if (!out.Write(chunkHeader, sizeof(chunkHeader))) return false;
+
+        switch (chunk.type) {
+        case SparseChunkType::Raw:
+            data.resize((size_t)bytes);
+            extents.Read(chunk.firstBlock * blockSize, data.data(), data.size());
+            if (!out.Write(data.data(), data.size())) return false;
+            stats.rawChunks++;
+            stats.rawBytes += bytes;
+            break;
+
+        case SparseChunkType::Fill: {
+            uint8_t fillValue[4];
+            PutLE32(fillValue, chunk.fill);
+            if (!out.Write(fillValue, sizeof(fillValue))) return false;
+            stats.fillChunks++;
+            stats.fillBytes += bytes;
+            break;
+        }
+
+        default:
+            stats.skipChunks++;
+            stats.skipBytes += bytes;
+            break;
+        }
+    }
+
+    stats.chunks = chunks.size();
+    stats.streamBytes = out.BytesWritten();
+    return true;
+}
+
+// ================================
+// 写入目标 (--apply)
+// ================================
+
+// 待写出的连续 RAW 数据
+struct PendingWrite {
+    ULONGLONG offset = 0;
+    vector<uint8_t> data;
+
+    ULONGLONG End() const { return offset + data.size(); }
+};
+
+static bool FlushPending(OutputFile& target, PendingWrite& pending) {
+    if (pending.data.empty()) return true;
+    bool ok = target.WriteAt(pending.offset, pending.data.data(), pending.data.size());
+    pending.offset = pending.End();
+    pending.data.clear();
+    return ok;
+}
+
+bool ApplySparse(InputStream& in, OutputFile& target, SparseStats& stats, bool discard) {
+    stats = SparseStats();
+
+    uint8_t header[SPARSE_HEADER_BYTES];
+    if (!in.Read(header, sizeof(header))) return false;
+
+    const unsigned headerBytes = GetLE16(header + 8);
+    const unsigned chunkHeaderBytes = GetLE16(header + 10);
+    const unsigned blockSize = GetLE32(header + 12);
+    const ULONGLONG totalBlocks = GetLE32(header + 16);
+    const ULONGLONG totalChunks = GetLE32(header + 20);
+
+    if (GetLE32(header) != SPARSE_MAGIC || GetLE16(header + 4) != 1
+        || headerBytes < SPARSE_HEADER_BYTES || chunkHeaderBytes < SPARSE_CHUNK_HEADER_BYTES
+        || blockSize == 0 || blockSize % 512 != 0) {
+        wcerr << L"❌ 不是有效的稀疏流 (文件头不匹配)" << endl;
+        return false;
+    }
+    if (!in.Skip(headerBytes - SPARSE_HEADER_BYTES)) return false;
+
+    stats.diskSize = totalBlocks * blockSize;
+
+    // 文件目标不足时扩展; 设备容量不足时拒绝写入
+    ULONGLONG targetSize = 0;
+    if (!target.QuerySize(targetSize)) return false;
+    if (targetSize < stats.diskSize) {
+        if (target.IsDevice()) {
+            wcerr << L"❌ 目标容量 " << FormatBytes(targetSize) << L" 小于镜像 " << FormatBytes(stats.diskSize) << endl;
+            return false;
+        }
+        if (!target.SetSize(stats.diskSize)) return false;
+    }
+    else if (target.IsDevice() && targetSize > stats.diskSize) {
+        wcerr << L"⚠️  目标 (" << FormatBytes(targetSize) << L") 大于镜像 (" << FormatBytes(stats.diskSize)
+            << L"), 备份 GPT 不在磁盘末尾" << endl;
+    }
+
+    PendingWrite pending;
+    ULONGLONG block = 0;
+
+    for (ULONGLONG i = 0; i < totalChunks; i++) {
+        uint8_t chunkHeader[SPARSE_CHUNK_HEADER_BYTES];
+        if (!in.Read(chunkHeader, sizeof(chunkHeader))) return false;
+        if (!in.Skip(chunkHeaderBytes - SPARSE_CHUNK_HEADER_BYTES)) return false;
+
+        const uint16_t type = GetLE16(chunkHeader);
+        const ULONGLONG blocks = GetLE32(chunkHeader + 4);
+        const ULONGLONG totalBytes = GetLE32(chunkHeader + 8);
+        const ULONGLONG offset = block * blockSize;
+        const ULONGLONG bytes = blocks * blockSize;
+
+        if (totalBytes < chunkHeaderBytes || block + blocks > totalBlocks) {
+            wcerr << L"❌ 稀疏流第 " << i << L" 个块组越界" << endl;
+            return false;
+        }
+        const ULONGLONG payload = totalBytes - chunkHeaderBytes;
+
+        switch ((SparseChunkType)type) {
+        case SparseChunkType::Raw: {
+            if (payload != bytes) {
+                wcerr << L"❌ 稀疏流第 " << i << L" 个块组长度不一致" << endl;
+                return false;
+            }
+            if (pending.End() != offset) {
+                if (!FlushPending(target, pending)) return false;
+                pending.offset = offset;
+            }
+
+            // 逐段读入待写缓冲, 满 APPLY_WRITE_BYTES 时写出一次
+            ULONGLONG remaining = bytes;
+            while (remaining > 0) {
+                if (pending.data.size() == APPLY_WRITE_BYTES) {
+                    if (!FlushPending(target, pending)) return false;
+                }
+                size_t take = (size_t)min<ULONGLONG>(remaining, APPLY_WRITE_BYTES - pending.data.size());
+                size_t used = pending.data.size();
+                pending.data.resize(used + take);
+                if (!in.Read(pending.data.data() + used, take)) return false;
+                remaining -= take;
+            }
+
+            stats.rawChunks++;
+            stats.rawBytes += bytes;
+            break;
+        }
+
+        case SparseChunkType::Fill: {
+            uint8_t fillValue[4];
+            if (payload != 4 || !in.Read(fillValue, sizeof(fillValue))) {
+                wcerr << L"❌ 稀疏流第 " << i << L" 个块组 (FILL) 无效" << endl;
+                return false;
+            }
+            if (!FlushPending(target, pending)) return false;
+
+            if (GetLE32(fillValue) == 0) {
+                if (!target.ZeroRange(offset, bytes)) return false;
+            }
+            else {
+                // 非零填充 (如 NTFS 空日志): 按填充值展开后写入
+                vector<uint8_t> pattern(min<ULONGLONG>(bytes, APPLY_WRITE_BYTES));
+                for (size_t k = 0; k < pattern.size(); k++) pattern[k] = fillValue[k % 4];
+                for (ULONGLONG done = 0; done < bytes; done += pattern.size()) {
+                    size_t take = (size_t)min<ULONGLONG>(bytes - done, pattern.size());
+                    if (!target.WriteAt(offset + done, pattern.data(), take)) return false;
+                }
+            }
+
+            stats.fillChunks++;
+            stats.fillBytes += bytes;
+            break;
+        }
+
+        case SparseChunkType::DontCare:
+            if (!in.Skip(payload)) return false;
+            stats.skipChunks++;
+            stats.skipBytes += bytes;
+
+            if (discard && !stats.discardUnsupported) {
+                auto discardStart = chrono::steady_clock::now();
+                if (target.Discard(offset, bytes)) {
+                    stats.discardBytes += bytes;
+                }
+                else {
+                    stats.discardUnsupported = true;
+                }
+                stats.discardMs += chrono::duration<double, milli>(chrono::steady_clock::now() - discardStart).count();
+            }
+            break;
+
+        case SparseChunkType::Crc32:
+            // 校验和块组不占用块
+            if (!in.Skip(payload)) return false;
+            break;
+
+        default:
+            wcerr << L"❌ 稀疏流第 " << i << L" 个块组类型未知: 0x" << hex << type << dec << endl;
+            return false;
+        }
+
+        block += blocks;
+    }
+
+    if (!FlushPending(target, pending)) return false;
+
+    if (block != totalBlocks) {
+        wcerr << L"❌ 稀疏流块数不一致: " << block << L" / " << totalBlocks << endl;
+        return false;
+    }
+
+    stats.chunks = totalChunks;
+    stats.streamBytes = in.BytesRead();
+    stats.writeCount = target.WriteCount();
+    return target.Flush();
+}
+
+int RunApplyMode(const CommandLineArgs& args) {
+    if (args.applyTarget.empty()) {
+        wcerr << L"❌ 错误: --apply 需要 --apply-to=<镜像文件|设备>" << endl;
+        return 1;
+    }
+
+    auto start = chrono::steady_clock::now();
+
+    InputStream in;
+    if (!in.Open(args.applyPath)) return 1;
+
+    OutputFile target;
+    if (!target.Open(args.applyTarget)) return 1;
+
+    // 回收前后的占用 (只有文件目标可查询)
+    ULONGLONG allocatedBefore = 0, allocatedAfter = 0;
+    bool hasAllocated = args.retrim.enabled && target.QueryAllocated(allocatedBefore);
+
+    SparseStats stats;
+    if (!ApplySparse(in, target, stats, args.retrim.enabled)) {
+        wcerr << L"❌ 写入 " << args.applyTarget << L" 失败" << endl;
+        return 1;
+    }
+
+    hasAllocated = hasAllocated && target.QueryAllocated(allocatedAfter);
+
+    if (!target.Close()) {
+        wcerr << L"❌ 关闭目标失败: " << args.applyTarget << endl;
+        return 1;
+    }
+
+    double elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    wcout << L"\n📥 写入稀疏流: " << (args.applyPath == L"-" ? L"<stdin>" : args.applyPath)
+        << L" -> " << args.applyTarget << endl;
+    wcout << L"==========================================" << endl;
+    wcout << L"  磁盘大小: " << FormatBytes(stats.diskSize) << L", 流 " << FormatBytes(stats.streamBytes)
+        << L" (" << stats.chunks << L" 个块组)" << endl;
+    wcout << L"  数据: " << FormatBytes(stats.rawBytes) << L" (" << stats.writeCount << L" 次写入)" << endl;
+    wcout << L"  清零: " << FormatBytes(stats.fillBytes) << L", 跳过: " << FormatBytes(stats.skipBytes) << endl;
+    if (args.retrim.enabled) {
+        wcout << L"  回收: 释放 " << FormatBytes(stats.discardBytes) << L" (" << fixed << setprecision(1)
+            << stats.discardMs << L" ms)";
+        if (hasAllocated) {
+            wcout << L", 目标占用 " << FormatBytes(allocatedBefore) << L" → " << FormatBytes(allocatedAfter);
+        }
+        wcout << endl;
+        if (stats.discardUnsupported) {
+            wcout << L"  ⚠️  目标不支持打洞 / TRIM, 其余未触碰的范围保持原样" << endl;
+        }
+    }
+    wcout << L"  耗时: " << fixed << setprecision(1) << elapsedMs << L" ms" << endl;
+    wcout << L"\n✓ 写入完成" << endl;
+    return 0;
+}
@@ -0,0 +1,70 @@
+﻿#pragma once
+
+/*
+ * 稀疏流导出与写入
+ *
+ * 流格式与 Android sparse image 相同 (可用 simg2img 等工具查看):
+ *   文件头 28 字节: 魔数 0xED26FF3A, 版本 1.0, 块大小, 总块数, 块组数
+ *   块组头 12 字节: 类型, 块数, 含头的总字节数
+ *     RAW       后跟块数 * 块大小的数据
+ *     FILL      后跟 4 字节填充值 (镜像中的零区段与填充区段, 如 NTFS 空日志的 0xFFFFFFFF)
+ *     DONT_CARE 无数据 (镜像中未触碰的范围, 写入时跳过)
+ *
+ * 导出按区段列表顺序生成, 不需要先落地完整大小的镜像, 可直接写到标准输出或管道;
+ * 写入端 (--apply) 只写 RAW 数据, 相邻块组合并为大块对齐写入, FILL 0 通过打洞/设备清零完成,
+ * 其他填充值按块展开后写入;
+ * --retrim 时 DONT_CARE 范围也被释放 (文件打洞 / 块设备 TRIM), 目标上之前的数据不再占用存储。
+ */
+
+#include "cli.h"
+#include "extent.h"
+#include "file_io.h"
+
+#include <cstdint>
+#include <vector>
+
+constexpr uint32_t SPARSE_MAGIC = 0xED26FF3A;
+constexpr unsigned SPARSE_BLOCK_SIZE = 4096;
+
+enum class SparseChunkType : uint16_t {
+    Raw = 0xCAC1,
+    Fill = 0xCAC2,
+    DontCare = 0xCAC3,
+    Crc32 = 0xCAC4,
+};
+
+struct SparseChunk {
+    SparseChunkType type = SparseChunkType::DontCare;
+    ULONGLONG firstBlock = 0;
+    ULONGLONG blockCount = 0;
+    uint32_t fill = 0;                 // FILL 的填充值
+};
+
+struct SparseStats {
+    ULONGLONG diskSize = 0;
+    ULONGLONG chunks = 0;
+    ULONGLONG rawChunks = 0;
+    ULONGLONG fillChunks = 0;
+    ULONGLONG skipChunks = 0;
+    ULONGLONG rawBytes = 0;            // RAW 数据
+    ULONGLONG fillBytes = 0;           // FILL 覆盖的范围
+    ULONGLONG skipBytes = 0;           // DONT_CARE 覆盖的范围
+    ULONGLONG streamBytes = 0;         // 流本身的字节数
+    ULONGLONG writeCount = 0;          // --apply: 对目标的写入次数
+    ULONGLONG discardBytes = 0;        // --apply --retrim: 已释放的 DONT_CARE 范围
+    bool discardUnsupported = false;   // 目标不支持释放 (之后的范围不再尝试)
+    double discardMs = 0;              // 释放耗时
+};
+
+// 按块划分区段列表: 含数据的块为 RAW, 只含零区段或同一填充区段的块为 FILL, 其余为 DONT_CARE;
+// 填充区段未按块对齐的首尾块作为 RAW
+std::vector<SparseChunk> PlanSparseChunks(const ExtentList& extents, ULONGLONG diskSize, unsigned blockSize);
+
+// 将区段列表以稀疏流写出
+bool ExportSparse(const ExtentList& extents, ULONGLONG diskSize, OutputStream& out, SparseStats& stats);
+
+// 读取稀疏流并写入目标; discard 时释放 DONT_CARE 范围
+bool ApplySparse(InputStream& in, OutputFile& target, SparseStats& stats, bool discard = false);
+
+// --apply 模式入口, 返回进程退出码
+int RunApplyMode(const CommandLineArgs& args);
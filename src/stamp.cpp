@@ -0,0 +1,176 @@
+﻿#include "stamp.h"
+
+#include "image.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+using namespace std;
+
+// 比较与补丁的粒度 (扇区)
+static const unsigned STAMP_PATCH_GRANULARITY = 512;
+
+wstring ExpandStampTemplate(const wstring& text, int n) {
+    static const wstring placeholder = L"{n}";
+
+    wstring result = text;
+    for (size_t pos = result.find(placeholder); pos != wstring::npos; pos = result.find(placeholder, pos)) {
+        wstring number = to_wstring(n);
+        result.replace(pos, placeholder.size(), number);
+        pos += number.size();
+    }
+    return result;
+}
+
+CommandLineArgs StampArgs(const CommandLineArgs& args, int n) {
+    CommandLineArgs target = args;
+    target.imagePath = ExpandStampTemplate(args.imagePath, n);
+    for (auto& part : target.partitions) {
+        part.label = ExpandStampTemplate(part.label, n);
+    }
+    for (auto& format : target.formats) {
+        format.volumeLabel = ExpandStampTemplate(format.volumeLabel, n);
+    }
+    return target;
+}
+
+bool StampImage(
+    const wstring& goldenPath,
+    const ExtentList& golden,
+    ULONGLONG goldenSize,
+    const CommandLineArgs& target,
+    mt19937_64& rng,
+    StampResult& result
+) {
+    result = StampResult();
+
+    DiskLayout layout;
+    ExtentList extents;
+    ExtentList content;
+    ImageWriteStats stats;
+    if (!BuildImage(target, rng, layout, extents)
+        || !BuildImageFile(target, layout, extents, rng, content, stats)) {
+        return false;
+    }
+
+    if (stats.fileSize != goldenSize) {
+        wcerr << L"❌ " << target.imagePath << L" 的文件大小与黄金镜像不同, 布局不一致" << endl;
+        return false;
+    }
+
+    OutputFile file;
+    if (!file.Create(target.imagePath) || !file.CloneFrom(goldenPath, result.method)) {
+        return false;
+    }
+    result.copiedBytes = file.CopiedBytes();
+
+    // 只写入与黄金镜像不同的扇区
+    vector<uint8_t> buffer;
+    for (const auto& range : DiffExtents(golden, content, STAMP_PATCH_GRANULARITY)) {
+        buffer.resize((size_t)(range.second - range.first));
+        content.Read(range.first, buffer.data(), buffer.size());
+        if (!file.WriteAt(range.first, buffer.data(), buffer.size())) return false;
+    }
+
+    result.patchBytes = file.BytesWritten();
+    result.patchWrites = file.WriteCount();
+
+    if (!file.Close()) {
+        wcerr << L"❌ 关闭镜像文件失败: " << target.imagePath << endl;
+        return false;
+    }
+    return true;
+}
+
+int RunStampMode(const CommandLineArgs& args) {
+    if (args.imageSize == 0) {
+        wcerr << L"❌ 错误: 盖印模式需要 --image-size=<大小>" << endl;
+        return 1;
+    }
+    if (args.imagePath.find(L"{n}") == wstring::npos) {
+        wcerr << L"❌ 错误: --stamp 需要 --image 路径中包含 {n} (如 --image=out/disk{n}.vhdx)" << endl;
+        return 1;
+    }
+    if (!args.exportPath.empty()) {
+        wcerr << L"❌ 错误: --stamp 不能与 --export 同时使用" << endl;
+        return 1;
+    }
+
+    auto start = chrono::steady_clock::now();
+    mt19937_64 rng = MakeImageRng(args, IMAGE_RNG_LAYOUT);
+
+    wstring goldenPath;
+    ExtentList golden;
+    ImageWriteStats goldenStats;
+
+    map<CloneMethod, int> methods;
+    ULONGLONG copiedBytes = 0;
+    ULONGLONG patchBytes = 0;
+    ULONGLONG patchWrites = 0;
+
+    // 第一个目标为黄金镜像
+    {
+        CommandLineArgs target = StampArgs(args, 1);
+        DiskLayout layout;
+        ExtentList extents;
+        if (!BuildImage(target, rng, layout, extents)
+            || !BuildImageFile(target, layout, extents, rng, golden, goldenStats)
+            || !WriteImageContent(target.imagePath, golden, goldenStats)) {
+            return 1;
+        }
+        goldenPath = target.imagePath;
+
+        if (!args.quiet) {
+            wcout << L"  ✓ " << goldenPath << L" (黄金镜像, 写入 " << FormatBytes(goldenStats.bytesWritten) << L")" << endl;
+        }
+    }
+
+    for (int n = 2; n <= args.stampCount; n++) {
+        CommandLineArgs target = StampArgs(args, n);
+
+        StampResult result;
+        if (!StampImage(goldenPath, golden, goldenStats.fileSize, target, rng, result)) {
+            wcerr << L"❌ 目标 " << n << L" 生成失败" << endl;
+            return 1;
+        }
+
+        methods[result.method]++;
+        copiedBytes += result.copiedBytes;
+        patchBytes += result.patchBytes;
+        patchWrites += result.patchWrites;
+
+        if (!args.quiet) {
+            wcout << L"  ✓ " << target.imagePath << L" (" << CloneMethodName(result.method) << L", 补丁 "
+                << FormatBytes(result.patchBytes) << L" / " << result.patchWrites << L" 次)" << endl;
+        }
+    }
+
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    const int copies = args.stampCount - 1;
+
+    wcout << L"\n🖨  盖印镜像: " << args.imagePath << L" × " << args.stampCount << endl;
+    wcout << L"==========================================" << endl;
+    wcout << L"  黄金镜像: " << goldenPath << L", 写入 " << FormatBytes(goldenStats.bytesWritten)
+        << L" (" << goldenStats.writeCount << L" 次)" << endl;
+
+    if (copies > 0) {
+        wcout << L"  克隆:";
+        for (const auto& entry : methods) {
+            wcout << L" " << CloneMethodName(entry.first) << L" × " << entry.second;
+        }
+        wcout << L", 复制数据 " << FormatBytes(copiedBytes) << endl;
+        wcout << L"  补丁: " << FormatBytes(patchBytes) << L" (" << patchWrites << L" 次写入), 平均每个目标 "
+            << FormatBytes(patchBytes / copies) << L" / " << fixed << setprecision(1)
+            << (double)patchWrites / copies << L" 次" << endl;
+    }
+
+    wcout << L"  耗时: " << fixed << setprecision(1) << elapsed * 1000 << L" ms";
+    if (elapsed > 0) {
+        wcout << L" (" << setprecision(0) << args.stampCount / elapsed << L" 个/秒)";
+    }
+    wcout << endl;
+    wcout << L"\n✓ 已生成 " << args.stampCount << L" 个镜像" << endl;
+    return 0;
+}
@@ -0,0 +1,47 @@
+﻿#pragma once
+
+/*
+ * 黄金布局盖印 (--stamp)
+ *
+ * 同一布局的大量镜像只在磁盘/分区 GUID、卷序列号与卷标上不同:
+ *   1. 第一个目标按常规方式生成, 作为黄金镜像;
+ *   2. 其余目标先从黄金镜像克隆 (reflink 共享区段, 否则 copy_file_range 只复制已分配范围),
+ *   3. 再在内存中按目标自己的 GUID/卷标重新生成镜像内容, 与黄金镜像逐扇区比较,
+ *      只写入不同的扇区 (GPT 头/分区表及其 CRC、引导扇区、VHDX 头等)。
+ *
+ * --image 路径与 label= / vol= 中的 {n} 替换为目标序号 (从 1 开始)。
+ */
+
+#include "cli.h"
+#include "extent.h"
+#include "file_io.h"
+
+#include <random>
+#include <string>
+
+struct StampResult {
+    CloneMethod method = CloneMethod::Copy;
+    ULONGLONG copiedBytes = 0;         // 克隆时实际复制的字节 (reflink 为 0)
+    ULONGLONG patchBytes = 0;
+    ULONGLONG patchWrites = 0;
+};
+
+// 将 text 中的 {n} 替换为 n
+std::wstring ExpandStampTemplate(const std::wstring& text, int n);
+
+// 目标 n 的参数: 路径、GPT 分区名称与卷标中的 {n} 已替换
+CommandLineArgs StampArgs(const CommandLineArgs& args, int n);
+
+// 从黄金镜像 (goldenPath, 内容为 golden, 长度 goldenSize) 克隆出 target.imagePath,
+// 再写入与目标自身内容不同的扇区
+bool StampImage(
+    const std::wstring& goldenPath,
+    const ExtentList& golden,
+    ULONGLONG goldenSize,
+    const CommandLineArgs& target,
+    std::mt19937_64& rng,
+    StampResult& result
+);
+
+// --stamp 模式入口, 返回进程退出码
+int RunStampMode(const CommandLineArgs& args);
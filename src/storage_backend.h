@@ -0,0 +1,85 @@
+﻿#pragma once
+
+/*
+ * 存储提供程序后端接口
+ *
+ * 每个方法对应一次 WMI 跨进程调用 (IWbemServices / IEnumWbemClassObject /
+ * IWbemClassObject), WMIManager 在其上做统一的错误输出。
+ *
+ * 实现:
+ *   - WmiBackend        真实的 ROOT\Microsoft\Windows\Storage (仅 Windows)
+ *   - SimulatedBackend  进程内模拟提供程序 (任意平台)
+ */
+
+#include "storage_object.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+// 查询结果枚举器 (IEnumWbemClassObject 的抽象)
+class ObjectEnumerator {
+public:
+    virtual ~ObjectEnumerator() = default;
+
+    // 取下一个对象, 没有更多对象时返回 false
+    virtual bool Next(StorageObjectPtr& obj) = 0;
+};
+
+class StorageBackend {
+public:
+    virtual ~StorageBackend() = default;
+
+    virtual std::wstring Name() const = 0;
+
+    // IWbemServices::ExecQuery (WQL)
+    virtual bool ExecQuery(const std::wstring& query, std::unique_ptr<ObjectEnumerator>& result) = 0;
+
+    // IEnumWbemClassObject::Next
+    virtual bool Next(ObjectEnumerator& enumerator, StorageObjectPtr& obj) {
+        return enumerator.Next(obj);
+    }
+
+    // IWbemServices::GetObject (类名或实例路径)
+    virtual bool GetObjectByPath(const std::wstring& path, StorageObjectPtr& result) = 0;
+
+    // IWbemClassObject::GetMethod
+    virtual bool GetMethod(const StorageObjectPtr& classObj, const std::wstring& methodName,
+        StorageObjectPtr& inParamsDefinition) = 0;
+
+    // IWbemClassObject::SpawnInstance
+    virtual bool SpawnInstance(const StorageObjectPtr& definition, StorageObjectPtr& instance) = 0;
+
+    // IWbemServices::ExecMethod
+    virtual bool ExecMethod(const std::wstring& objectPath, const std::wstring& methodName,
+        const StorageObjectPtr& inParams, StorageObjectPtr& outParams) = 0;
+
+    // IWbemServices::PutInstance
+    virtual bool PutInstance(const StorageObjectPtr& obj) = 0;
+
+    // 最近一次失败的 HRESULT
+    virtual HRESULT LastError() const { return lastError; }
+
+    // 时钟: 真实后端使用墙钟, 模拟后端使用虚拟时钟 (等待不会真正阻塞)
+    virtual std::chrono::nanoseconds Now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch());
+    }
+
+    virtual void Sleep(std::chrono::nanoseconds duration) {
+        std::this_thread::sleep_for(duration);
+    }
+
+protected:
+    HRESULT lastError = 0;
+};
+
+// 后端工厂: 每个工作线程各自创建会话 (COM 需要按线程初始化)
+using BackendFactory = std::function<std::unique_ptr<StorageBackend>()>;
+
+#ifdef _WIN32
+// 连接 ROOT\Microsoft\Windows\Storage, 失败时返回 nullptr
+std::unique_ptr<StorageBackend> CreateWmiBackend();
+#endif
@@ -0,0 +1,123 @@
+﻿#include "storage_object.h"
+
+#include <cwchar>
+
+using namespace std;
+
+// ================================
+// PropValue
+// ================================
+
+bool PropValue::AsBool() const {
+    switch (kind) {
+    case Kind::Bool:
+    case Kind::Int:
+        return intVal != 0;
+    case Kind::UInt64:
+        return uintVal != 0;
+    case Kind::String:
+        return strVal == L"1" || strVal == L"true" || strVal == L"TRUE" || strVal == L"True";
+    default:
+        return false;
+    }
+}
+
+long long PropValue::AsInt() const {
+    switch (kind) {
+    case Kind::Bool:
+    case Kind::Int:
+        return intVal;
+    case Kind::UInt64:
+        return (long long)uintVal;
+    case Kind::String:
+        return wcstoll(strVal.c_str(), nullptr, 10);
+    default:
+        return 0;
+    }
+}
+
+ULONGLONG PropValue::AsUInt64() const {
+    switch (kind) {
+    case Kind::Bool:
+    case Kind::Int:
+        return (ULONGLONG)intVal;
+    case Kind::UInt64:
+        return uintVal;
+    case Kind::String:
+        // WMI 的 uint64 属性以 BSTR 形式返回
+        return wcstoull(strVal.c_str(), nullptr, 10);
+    default:
+        return 0;
+    }
+}
+
+wstring PropValue::AsString() const {
+    switch (kind) {
+    case Kind::Bool:
+        return intVal ? L"TRUE" : L"FALSE";
+    case Kind::Int:
+        return to_wstring(intVal);
+    case Kind::UInt64:
+        return to_wstring(uintVal);
+    case Kind::String:
+        return strVal;
+    default:
+        return L"";
+    }
+}
+
+// ================================
+// StorageObject / PropertyBag
+// ================================
+
+PropValue StorageObject::Prop(const wstring& name) const {
+    PropValue value;
+    Get(name, value);
+    return value;
+}
+
+bool PropertyBag::Get(const wstring& name, PropValue& value) const {
+    auto it = props.find(name);
+    if (it == props.end()) {
+        value = PropValue();
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+bool PropertyBag::Put(const wstring& name, const PropValue& value) {
+    props[name] = value;
+    return true;
+}
+
+vector<wstring> PropertyBag::GetNames() const {
+    vector<wstring> names;
+    for (const auto& prop : props) {
+        names.push_back(prop.first);
+    }
+    return names;
+}
+
+StorageObjectPtr CopyObject(const StorageObjectPtr& obj) {
+    if (!obj) return nullptr;
+
+    auto copy = make_shared<PropertyBag>();
+    for (const auto& name : obj->GetNames()) {
+        PropValue value = obj->Prop(name);
+
+        if (value.GetKind() == PropValue::Kind::Object) {
+            value = PropValue(CopyObject(value.AsObject()));
+        }
+        else if (value.GetKind() == PropValue::Kind::ObjectArray) {
+            vector<StorageObjectPtr> items;
+            for (const auto& item : value.AsObjectArray()) {
+                items.push_back(CopyObject(item));
+            }
+            value = PropValue(items);
+        }
+
+        copy->Put(name, value);
+    }
+    return copy;
+}
@@ -0,0 +1,113 @@
+﻿#pragma once
+
+/*
+ * 存储对象模型
+ *
+ * 对 WMI 实例 (IWbemClassObject) 与属性值 (VARIANT) 的可移植抽象:
+ *   - Windows 下由 WMI 后端包装真实的 COM 对象
+ *   - 模拟提供程序/回放后端使用内存中的属性包 (PropertyBag)
+ */
+
+#include "utils.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class StorageObject;
+using StorageObjectPtr = std::shared_ptr<StorageObject>;
+
+// ================================
+// 属性值 (VARIANT 的可移植子集)
+// ================================
+
+class PropValue {
+public:
+    enum class Kind { Empty, Bool, Int, UInt64, String, Object, StringArray, ObjectArray };
+
+    PropValue() = default;
+    PropValue(bool v) : kind(Kind::Bool), intVal(v ? 1 : 0) {}
+    PropValue(int v) : kind(Kind::Int), intVal(v) {}
+    PropValue(long v) : kind(Kind::Int), intVal(v) {}
+    PropValue(long long v) : kind(Kind::Int), intVal(v) {}
+    PropValue(unsigned int v) : kind(Kind::Int), intVal(v) {}
+    PropValue(unsigned long v) : kind(Kind::UInt64), uintVal(v) {}
+    PropValue(unsigned long long v) : kind(Kind::UInt64), uintVal(v) {}
+    PropValue(const wchar_t* v) : kind(Kind::String), strVal(v) {}
+    PropValue(const std::wstring& v) : kind(Kind::String), strVal(v) {}
+    PropValue(const StorageObjectPtr& v) : kind(Kind::Object), objVal(v) {}
+    PropValue(const std::vector<std::wstring>& v) : kind(Kind::StringArray), strArray(v) {}
+    PropValue(const std::vector<StorageObjectPtr>& v) : kind(Kind::ObjectArray), objArray(v) {}
+
+    Kind GetKind() const { return kind; }
+    bool IsEmpty() const { return kind == Kind::Empty; }
+
+    // 取值时按 WMI 的习惯做宽松转换 (如 uint64 常以字符串形式返回)
+    bool AsBool() const;
+    long long AsInt() const;
+    ULONGLONG AsUInt64() const;
+    std::wstring AsString() const;
+    StorageObjectPtr AsObject() const { return objVal; }
+    const std::vector<std::wstring>& AsStringArray() const { return strArray; }
+    const std::vector<StorageObjectPtr>& AsObjectArray() const { return objArray; }
+
+private:
+    Kind kind = Kind::Empty;
+    long long intVal = 0;
+    ULONGLONG uintVal = 0;
+    std::wstring strVal;
+    StorageObjectPtr objVal;
+    std::vector<std::wstring> strArray;
+    std::vector<StorageObjectPtr> objArray;
+};
+
+// ================================
+// 存储对象 (IWbemClassObject 的抽象)
+// ================================
+
+class StorageObject {
+public:
+    virtual ~StorageObject() = default;
+
+    virtual bool Get(const std::wstring& name, PropValue& value) const = 0;
+    virtual bool Put(const std::wstring& name, const PropValue& value) = 0;
+
+    // 全部属性名 (含 __PATH 等系统属性), 录制调用时用于复制对象
+    virtual std::vector<std::wstring> GetNames() const = 0;
+
+    // 便捷读取, 属性不存在时返回默认值
+    PropValue Prop(const std::wstring& name) const;
+    std::wstring GetString(const std::wstring& name) const { return Prop(name).AsString(); }
+    long long GetInt(const std::wstring& name) const { return Prop(name).AsInt(); }
+    ULONGLONG GetUInt64(const std::wstring& name) const { return Prop(name).AsUInt64(); }
+    bool GetBool(const std::wstring& name) const { return Prop(name).AsBool(); }
+
+    std::wstring Path() const { return GetString(L"__PATH"); }
+    std::wstring ClassName() const { return GetString(L"__CLASS"); }
+};
+
+// 内存属性包: 模拟提供程序与回放后端使用
+class PropertyBag : public StorageObject {
+public:
+    PropertyBag() = default;
+    explicit PropertyBag(const std::wstring& className) {
+        props[L"__CLASS"] = className;
+    }
+
+    bool Get(const std::wstring& name, PropValue& value) const override;
+    bool Put(const std::wstring& name, const PropValue& value) override;
+    std::vector<std::wstring> GetNames() const override;
+
+    const std::map<std::wstring, PropValue>& Properties() const { return props; }
+
+private:
+    std::map<std::wstring, PropValue> props;
+};
+
+inline StorageObjectPtr MakeObject(const std::wstring& className) {
+    return std::make_shared<PropertyBag>(className);
+}
+
+// 深拷贝为属性包 (嵌套对象一并复制), 使结果脱离原后端
+StorageObjectPtr CopyObject(const StorageObjectPtr& obj);
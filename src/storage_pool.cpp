@@ -0,0 +1,331 @@
+﻿#include "storage_pool.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+// Storage Spaces 允许的最小交错大小; 自动选择时的首选交错
+static const ULONGLONG MIN_INTERLEAVE = 16 * 1024;
+static const ULONGLONG PREFERRED_INTERLEAVE = 64 * 1024;
+static const int MAX_COLUMNS = 64;
+
+bool ParsePoolSpec(const wstring& params, PoolSpec& spec) {
+    auto paramMap = ParseParams(params);
+
+    try {
+        if (paramMap.count(L"name"))
+            spec.name = paramMap[L"name"];
+
+        if (paramMap.count(L"resiliency")) {
+            const wstring& resiliency = paramMap[L"resiliency"];
+            if (resiliency == L"simple") spec.mirror = false;
+            else if (resiliency == L"mirror") spec.mirror = true;
+            else return false;
+        }
+
+        if (paramMap.count(L"copies"))
+            spec.copies = stoi(paramMap[L"copies"]);
+
+        if (paramMap.count(L"columns") && paramMap[L"columns"] != L"auto")
+            spec.columns = stoi(paramMap[L"columns"]);
+
+        if (paramMap.count(L"interleave") && paramMap[L"interleave"] != L"auto")
+            spec.interleave = ParseSizeString(paramMap[L"interleave"]);
+
+        if (paramMap.count(L"size") && paramMap[L"size"] != L"max")
+            spec.size = ParseSizeString(paramMap[L"size"]);
+    }
+    catch (...) {
+        return false;
+    }
+
+    bool interleaveValid = spec.interleave == 0
+        || (spec.interleave >= MIN_INTERLEAVE && (spec.interleave & (spec.interleave - 1)) == 0);
+    return !spec.name.empty() && spec.copies >= 2 && spec.copies <= 3
+        && spec.columns >= 0 && spec.columns <= MAX_COLUMNS && interleaveValid;
+}
+
+// ================================
+// 条带规划
+// ================================
+
+static ULONGLONG FloorPowerOfTwo(ULONGLONG value) {
+    ULONGLONG result = 1;
+    while (result * 2 <= value) result *= 2;
+    return result;
+}
+
+// 各文件系统允许的最大簇
+static ULONGLONG MaxClusterBytes(const wstring& fileSystem) {
+    if (fileSystem == L"refs" || fileSystem == L"fat32") return 64 * 1024;
+    if (fileSystem == L"exfat") return 32ULL * 1024 * 1024;
+    return 2ULL * 1024 * 1024;   // NTFS
+}
+
+StripeLayout PlanStripe(const PoolSpec& spec, int diskCount, const wstring& fileSystem, ULONGLONG clusterBytes) {
+    StripeLayout layout;
+    layout.copies = spec.mirror ? spec.copies : 1;
+
+    bool autoColumns = spec.columns == 0;
+    layout.columns = autoColumns
+        ? (int)FloorPowerOfTwo((ULONGLONG)max(1, min(diskCount / layout.copies, MAX_COLUMNS)))
+        : spec.columns;
+
+    // 目标条带宽度: 给定的簇大小, 否则为不超过最大簇的 2 的幂
+    ULONGLONG target = clusterBytes;
+    if (target == 0) {
+        ULONGLONG interleave = spec.interleave ? spec.interleave : PREFERRED_INTERLEAVE;
+        target = FloorPowerOfTwo(min(MaxClusterBytes(fileSystem), interleave * (ULONGLONG)layout.columns));
+    }
+
+    if (spec.interleave) {
+        layout.interleave = spec.interleave;
+    }
+    else if (target < MIN_INTERLEAVE) {
+        // 簇小于最小交错, 无论几列都无法对齐, 保留全部列数
+        layout.interleave = PREFERRED_INTERLEAVE;
+    }
+    else {
+        while (autoColumns && layout.columns > 1 && target / (ULONGLONG)layout.columns < MIN_INTERLEAVE) {
+            layout.columns /= 2;
+        }
+        layout.interleave = max(MIN_INTERLEAVE, FloorPowerOfTwo(target / (ULONGLONG)layout.columns));
+    }
+
+    layout.aligned = layout.StripeWidth() == target;
+
+    // 未指定簇大小且条带宽度无法对齐 (如显式的非 2 的幂列数) 时使用文件系统默认簇
+    layout.clusterBytes = clusterBytes ? clusterBytes : (layout.aligned ? target : 0);
+    return layout;
+}
+
+// ================================
+// 池与虚拟磁盘
+// ================================
+
+// 取查询结果的第一个对象, 没有结果时返回 nullptr
+static StorageObjectPtr QueryFirst(WMIManager& wmi, const wstring& query) {
+    auto enumerator = wmi.Query(query);
+    if (!enumerator) return nullptr;
+
+    StorageObjectPtr first, next;
+    while (wmi.Next(*enumerator, next)) {
+        if (!first) first = next;
+    }
+    return first;
+}
+
+// 清除已有分区并取得可加入池的 MSFT_PhysicalDisk
+static StorageObjectPtr PreparePoolMember(WMIManager& wmi, int diskNumber, bool verbose) {
+    auto disk = QueryFirst(wmi, L"SELECT * FROM MSFT_Disk WHERE Number = " + to_wstring(diskNumber));
+    if (!disk) {
+        wcerr << L"❌ 未找到磁盘 " << diskNumber << endl;
+        return nullptr;
+    }
+
+    if (disk->GetInt(L"NumberOfPartitions") > 0) {
+        auto inParams = wmi.PrepareMethod(L"MSFT_Disk", L"Clear");
+        if (!inParams) return nullptr;
+
+        inParams->Put(L"RemoveData", true);
+        inParams->Put(L"RemoveOEM", true);
+
+        StorageObjectPtr outParams;
+        if (!wmi.ExecMethod(disk->Path(), L"Clear", inParams, outParams)) {
+            wcerr << L"❌ 清除磁盘 " << diskNumber << L" 失败" << endl;
+            return nullptr;
+        }
+        if (verbose) wcout << L"✓ 已清除磁盘 " << diskNumber << endl;
+    }
+
+    auto physicalDisk = QueryFirst(wmi, L"SELECT * FROM MSFT_PhysicalDisk WHERE DeviceId = '" + to_wstring(diskNumber) + L"'");
+    if (!physicalDisk) {
+        wcerr << L"❌ 磁盘 " << diskNumber << L" 没有对应的物理磁盘 (不能加入存储池)" << endl;
+        return nullptr;
+    }
+
+    if (!physicalDisk->GetBool(L"CanPool")) {
+        // CannotPoolReason: 2 已在池中, 3 不正常, 6 脱机, 7 容量不足 (含已有分区) ...
+        wcerr << L"❌ 磁盘 " << diskNumber << L" 不能加入存储池, CannotPoolReason:";
+        PropValue reasons = physicalDisk->Prop(L"CannotPoolReason");
+        for (const auto& reason : reasons.AsStringArray()) {
+            wcerr << L" " << reason;
+        }
+        wcerr << endl;
+        return nullptr;
+    }
+
+    return physicalDisk;
+}
+
+bool CreatePooledDisk(
+    WMIManager& wmi,
+    const PoolSpec& spec,
+    const vector<int>& diskNumbers,
+    const StripeLayout& stripe,
+    PooledDisk& pooled,
+    bool verbose
+) {
+    pooled = PooledDisk();
+
+    vector<StorageObjectPtr> physicalDisks;
+    for (int number : diskNumbers) {
+        auto physicalDisk = PreparePoolMember(wmi, number, verbose);
+        if (!physicalDisk) return false;
+        physicalDisks.push_back(physicalDisk);
+    }
+
+    // 本机存储子系统 (Model 为 "Windows Storage")
+    StorageObjectPtr subsystem;
+    {
+        auto enumerator = wmi.Query(L"SELECT * FROM MSFT_StorageSubSystem");
+        if (!enumerator) return false;
+
+        StorageObjectPtr next;
+        while (wmi.Next(*enumerator, next)) {
+            if (!subsystem || next->GetString(L"Model") == L"Windows Storage") subsystem = next;
+        }
+        if (!subsystem) {
+            wcerr << L"❌ 未找到存储子系统" << endl;
+            return false;
+        }
+    }
+
+    const wchar_t* resiliency = spec.mirror ? L"Mirror" : L"Simple";
+
+    // CreateStoragePool()
+    {
+        auto inParams = wmi.PrepareMethod(L"MSFT_StorageSubSystem", L"CreateStoragePool");
+        if (!inParams) return false;
+
+        inParams->Put(L"FriendlyName", spec.name);
+        inParams->Put(L"PhysicalDisks", physicalDisks);
+        inParams->Put(L"ResiliencySettingNameDefault", resiliency);
+        inParams->Put(L"ProvisioningTypeDefault", 2L);    // Fixed
+
+        StorageObjectPtr outParams;
+        if (!wmi.ExecMethod(subsystem->Path(), L"CreateStoragePool", inParams, outParams)) {
+            wcerr << L"❌ 创建存储池失败" << endl;
+            return false;
+        }
+
+        auto pool = outParams ? outParams->Prop(L"CreatedStoragePool").AsObject() : nullptr;
+        pooled.poolPath = pool ? pool->Path() : L"";
+        if (pooled.poolPath.empty()) {
+            wcerr << L"❌ 无法获取存储池对象路径, 存储池 " << spec.name << L" 可能已经建立" << endl;
+            wcerr << L"   清理: Remove-StoragePool -FriendlyName '" << spec.name << L"'" << endl;
+            return false;
+        }
+        if (verbose) wcout << L"✓ 已创建存储池 " << spec.name << L" (" << diskNumbers.size() << L" 块磁盘)" << endl;
+    }
+
+    // 之后的失败: 删除已建立的虚拟磁盘与池, 成员盘回到可加入池的状态
+    auto rollback = [&]() {
+        RemovePooledDisk(wmi, spec, pooled, verbose);
+        return false;
+    };
+
+    // CreateVirtualDisk()
+    {
+        auto inParams = wmi.PrepareMethod(L"MSFT_StoragePool", L"CreateVirtualDisk");
+        if (!inParams) return rollback();
+
+        inParams->Put(L"FriendlyName", spec.name);
+        inParams->Put(L"ResiliencySettingName", resiliency);
+        inParams->Put(L"NumberOfColumns", stripe.columns);
+        inParams->Put(L"Interleave", stripe.interleave);
+        if (spec.mirror) {
+            inParams->Put(L"NumberOfDataCopies", stripe.copies);
+        }
+        inParams->Put(L"ProvisioningType", 2L);           // Fixed
+        if (spec.size > 0) {
+            inParams->Put(L"Size", spec.size);
+        }
+        else {
+            inParams->Put(L"UseMaximumSize", true);
+        }
+
+        StorageObjectPtr outParams;
+        if (!wmi.ExecMethod(pooled.poolPath, L"CreateVirtualDisk", inParams, outParams)) {
+            wcerr << L"❌ 创建虚拟磁盘失败" << endl;
+            return rollback();
+        }
+
+        auto virtualDisk = outParams ? outParams->Prop(L"CreatedVirtualDisk").AsObject() : nullptr;
+        pooled.virtualDiskPath = virtualDisk ? virtualDisk->Path() : L"";
+        if (pooled.virtualDiskPath.empty()) {
+            wcerr << L"❌ 无法获取虚拟磁盘对象路径, 虚拟磁盘 " << spec.name << L" 可能已经建立" << endl;
+            wcerr << L"   清理: Remove-VirtualDisk -FriendlyName '" << spec.name << L"'" << endl;
+            return rollback();
+        }
+        if (verbose) {
+            wcout << L"✓ 已创建虚拟磁盘 " << spec.name << L": " << resiliency << L", "
+                << virtualDisk->GetInt(L"NumberOfColumns") << L" 列, 交错 " << FormatBytes(virtualDisk->GetUInt64(L"Interleave"))
+                << L", 容量 " << FormatBytes(virtualDisk->GetUInt64(L"Size")) << endl;
+        }
+    }
+
+    // 虚拟磁盘对应的 MSFT_Disk (MSFT_VirtualDiskToDisk)
+    auto disk = QueryFirst(wmi, L"ASSOCIATORS OF {" + pooled.virtualDiskPath + L"} WHERE ResultClass = MSFT_Disk");
+    if (!disk) {
+        wcerr << L"❌ 未找到虚拟磁盘对应的磁盘" << endl;
+        return rollback();
+    }
+    pooled.diskNumber = (int)disk->GetInt(L"Number");
+
+    // Initialize() (新虚拟磁盘为 RAW)
+    if (disk->GetInt(L"PartitionStyle") == 0) {
+        auto inParams = wmi.PrepareMethod(L"MSFT_Disk", L"Initialize");
+        if (!inParams) return rollback();
+
+        inParams->Put(L"PartitionStyle", 2L);
+
+        StorageObjectPtr outParams;
+        if (!wmi.ExecMethod(disk->Path(), L"Initialize", inParams, outParams)) {
+            wcerr << L"❌ 虚拟磁盘初始化失败" << endl;
+            return rollback();
+        }
+    }
+
+    if (verbose) wcout << L"✓ 虚拟磁盘为磁盘 " << pooled.diskNumber << L" (GPT)" << endl;
+    return true;
+}
+
+bool RemovePooledDisk(WMIManager& wmi, const PoolSpec& spec, PooledDisk& pooled, bool verbose) {
+    // DeleteObject(): 先删虚拟磁盘 (连同其上的分区), 池中没有虚拟磁盘后才能删除池
+    auto deleteObject = [&](wstring& path, const wchar_t* className, const wchar_t* what) {
+        if (path.empty()) return true;
+
+        auto inParams = wmi.PrepareMethod(className, L"DeleteObject");
+        StorageObjectPtr outParams;
+        if (!inParams || !wmi.ExecMethod(path, L"DeleteObject", inParams, outParams)) {
+            wcerr << L"❌ 删除" << what << L" " << spec.name << L" 失败" << endl;
+            return false;
+        }
+        if (verbose) wcout << L"✓ 已删除" << what << L" " << spec.name << endl;
+        path.clear();
+        return true;
+    };
+
+    if (deleteObject(pooled.virtualDiskPath, L"MSFT_VirtualDisk", L"虚拟磁盘")
+        && deleteObject(pooled.poolPath, L"MSFT_StoragePool", L"存储池")) {
+        pooled.diskNumber = -1;
+        return true;
+    }
+
+    PrintPooledDiskLeftovers(spec, pooled);
+    return false;
+}
+
+void PrintPooledDiskLeftovers(const PoolSpec& spec, const PooledDisk& pooled) {
+    if (pooled.poolPath.empty()) return;
+
+    wcerr << L"⚠️  残留: ";
+    if (!pooled.virtualDiskPath.empty()) wcerr << L"虚拟磁盘 " << spec.name << L", ";
+    wcerr << L"存储池 " << spec.name << L"; 手动清理:" << endl;
+    if (!pooled.virtualDiskPath.empty()) {
+        wcerr << L"   Remove-VirtualDisk -FriendlyName '" << spec.name << L"' -Confirm:$false" << endl;
+    }
+    wcerr << L"   Remove-StoragePool -FriendlyName '" << spec.name << L"' -Confirm:$false" << endl;
+}
@@ -0,0 +1,76 @@
+﻿#pragma once
+
+/*
+ * 存储空间条带卷 (--pool)
+ *
+ * 把 --disk 选中的磁盘组成一个存储池, 在池中创建一个 Simple (条带) 或 Mirror 虚拟磁盘,
+ * 再把虚拟磁盘交给常规的分区/格式化流程:
+ *   1. 清除成员盘上已有的分区 (MSFT_Disk.Clear), 确认 MSFT_PhysicalDisk.CanPool;
+ *   2. MSFT_StorageSubSystem.CreateStoragePool;
+ *   3. MSFT_StoragePool.CreateVirtualDisk (固定配置, 指定列数/交错大小/副本数);
+ *   4. 经关联找到虚拟磁盘对应的 MSFT_Disk, 初始化为 GPT。
+ * 任一步失败 (含之后的分区/格式化) 时删除已建立的虚拟磁盘与池 (DeleteObject),
+ * 删除不成功则给出残留对象的名字与清理命令。
+ * 列数与交错大小默认自动选择, 使条带宽度 (列数 × 交错) 等于簇大小,
+ * 每个簇的写入恰好在每列上各落一次。
+ */
+
+#include "utils.h"
+#include "wmi_manager.h"
+
+#include <string>
+#include <vector>
+
+struct PoolSpec {
+    bool enabled = false;
+    std::wstring name = L"DiskPartPool";   // 池名, 虚拟磁盘同名
+    bool mirror = false;                   // resiliency=simple|mirror
+    int copies = 2;                        // 镜像的数据副本数 (2 或 3)
+    int columns = 0;                       // 0 为自动
+    ULONGLONG interleave = 0;              // 0 为自动
+    ULONGLONG size = 0;                    // 虚拟磁盘大小, 0 为池的全部可用空间
+};
+
+// 形式: name=Scratch,resiliency=simple|mirror,copies=2,columns=auto|<N>,interleave=auto|<大小>,size=max|<大小>
+bool ParsePoolSpec(const std::wstring& params, PoolSpec& spec);
+
+struct StripeLayout {
+    int columns = 1;
+    int copies = 1;
+    ULONGLONG interleave = 0;
+    ULONGLONG clusterBytes = 0;            // 格式化使用的簇大小, 0 为文件系统默认
+    bool aligned = false;                  // 条带宽度 == 簇大小
+
+    ULONGLONG StripeWidth() const { return interleave * (ULONGLONG)columns; }
+};
+
+// 选择列数、交错大小与簇大小:
+//   - 列数取不超过 (磁盘数 / 副本数) 的最大 2 的幂 (簇大小是 2 的幂, 条带宽度才能与之相等);
+//   - 给定簇大小 (unit=) 时交错 = 簇 / 列数, 不足最小交错 (16K) 时减少列数;
+//     簇本身小于 16K 时无法对齐, 保留全部列数并取 64K 交错;
+//   - 未给定时交错取 64K, 簇 = 列数 × 64K, 超过文件系统的最大簇时按上一条由最大簇反推。
+// columns= / interleave= 显式指定的值不做调整
+StripeLayout PlanStripe(const PoolSpec& spec, int diskCount, const std::wstring& fileSystem, ULONGLONG clusterBytes);
+
+// 本次建立的存储池与虚拟磁盘 (回滚时按对象路径删除, 不会误删已有的同名对象)
+struct PooledDisk {
+    std::wstring poolPath;
+    std::wstring virtualDiskPath;
+    int diskNumber = -1;                   // 虚拟磁盘对应的 MSFT_Disk
+};
+
+// 在 diskNumbers 上创建池与虚拟磁盘并初始化为 GPT; 失败时已建立的部分会被删除
+bool CreatePooledDisk(
+    WMIManager& wmi,
+    const PoolSpec& spec,
+    const std::vector<int>& diskNumbers,
+    const StripeLayout& stripe,
+    PooledDisk& pooled,
+    bool verbose
+);
+
+// 删除 pooled 中的虚拟磁盘与存储池 (路径为空的跳过); 删除失败时输出残留对象与清理命令
+bool RemovePooledDisk(WMIManager& wmi, const PoolSpec& spec, PooledDisk& pooled, bool verbose);
+
+// 输出 pooled 中尚未删除的虚拟磁盘/存储池及手动清理命令
+void PrintPooledDiskLeftovers(const PoolSpec& spec, const PooledDisk& pooled);
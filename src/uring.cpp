@@ -0,0 +1,170 @@
+﻿#include "uring.h"
+
+#ifdef HAVE_IO_URING
+
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+Uring::~Uring() {
+    // 在途请求仍引用调用方的缓冲区, 先等它们完成
+    if (inflight > 0) Drain();
+    Close();
+}
+
+void Uring::Close() {
+    if (sqes) munmap(sqes, sqesSize);
+    if (cqRing) munmap(cqRing, cqRingSize);
+    if (sqRing) munmap(sqRing, sqRingSize);
+    if (ringFd >= 0) close(ringFd);
+
+    sqes = nullptr;
+    cqRing = nullptr;
+    sqRing = nullptr;
+    ringFd = -1;
+    capacity = 0;
+    cqCapacity = 0;
+    pending = 0;
+    inflight = 0;
+}
+
+bool Uring::Setup(unsigned entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ringFd < 0) return false;
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+    sqRing = Map(sqRingSize, IORING_OFF_SQ_RING);
+    cqRing = Map(cqRingSize, IORING_OFF_CQ_RING);
+    sqes = (io_uring_sqe*)Map(sqesSize, IORING_OFF_SQES);
+    if (!sqRing || !cqRing || !sqes) return false;
+
+    char* sq = (char*)sqRing;
+    sqHead = (unsigned*)(sq + params.sq_off.head);
+    sqTail = (unsigned*)(sq + params.sq_off.tail);
+    sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+    sqArray = (unsigned*)(sq + params.sq_off.array);
+
+    char* cq = (char*)cqRing;
+    cqHead = (unsigned*)(cq + params.cq_off.head);
+    cqTail = (unsigned*)(cq + params.cq_off.tail);
+    cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+    cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    capacity = params.sq_entries;
+    cqCapacity = params.cq_entries;
+    return true;
+}
+
+// 提交队列尾部的槽位, 填写后由 Publish 发布给内核;
+// 环已关闭或完成队列放不下时返回 nullptr, 提交队列已满时先提交已排队的请求
+io_uring_sqe* Uring::NextSqe() {
+    if (ringFd < 0 || inflight >= cqCapacity) return nullptr;
+
+    while (*sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= capacity) {
+        long submitted = syscall(__NR_io_uring_enter, ringFd, pending, 0, 0, nullptr, 0);
+        enters++;
+        if (submitted < 0 && errno == EINTR) continue;
+        if (submitted <= 0) return nullptr;
+        pending -= (unsigned)submitted;
+    }
+
+    io_uring_sqe* sqe = &sqes[*sqTail & *sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+void Uring::Publish() {
+    unsigned tail = *sqTail;
+    unsigned index = tail & *sqMask;
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    pending++;
+    inflight++;
+}
+
+bool Uring::Queue(int fd, bool write, iovec* iov, ULONGLONG offset, uint64_t tag) {
+    io_uring_sqe* sqe = NextSqe();
+    if (!sqe) return false;
+    sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)iov;
+    sqe->len = 1;
+    sqe->off = offset;
+    sqe->user_data = tag;
+
+    Publish();
+    return true;
+}
+
+bool Uring::QueueFsync(int fd, uint64_t tag) {
+    io_uring_sqe* sqe = NextSqe();
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd;
+    sqe->user_data = tag;
+
+    Publish();
+    return true;
+}
+
+bool Uring::Wait(uint64_t& tag, int& res, unsigned minComplete) {
+    while (!Reap(tag, res)) {
+        long submitted = syscall(__NR_io_uring_enter, ringFd, pending, minComplete, IORING_ENTER_GETEVENTS, nullptr, 0);
+        enters++;
+        if (submitted < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        pending -= (unsigned)submitted;
+    }
+    return true;
+}
+
+bool Uring::Drain() {
+    uint64_t tag = 0;
+    int res = 0;
+    while (inflight > 0) {
+        if (Reap(tag, res)) continue;
+
+        long submitted = syscall(__NR_io_uring_enter, ringFd, pending, inflight, IORING_ENTER_GETEVENTS, nullptr, 0);
+        enters++;
+        if (submitted < 0) {
+            if (errno == EINTR) continue;
+            Close();
+            return false;
+        }
+        pending -= (unsigned)submitted;
+    }
+    return true;
+}
+
+void* Uring::Map(size_t size, off_t offset) {
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, offset);
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+bool Uring::Reap(uint64_t& tag, int& res) {
+    if (!cqRing) return false;
+
+    unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return false;
+
+    const io_uring_cqe& cqe = cqes[head & *cqMask];
+    tag = cqe.user_data;
+    res = cqe.res;
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+    inflight--;
+    return true;
+}
+
+#endif
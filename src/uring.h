@@ -0,0 +1,91 @@
+﻿#pragma once
+
+/*
+ * 最小的 io_uring 封装 (直接使用系统调用, 不依赖 liburing)
+ *
+ * I/O 验收 (--qualify) 与批量镜像 (--farm) 共用。只在 Linux 且有内核头文件时编译 (HAVE_IO_URING);
+ * 内核不支持或被 seccomp 禁止时 Setup 失败, 调用方回退到线程。
+ * Queue* 只填写提交队列, 由 Wait 在一次 io_uring_enter 中提交全部排队的请求并等待完成;
+ * 提交队列已满时 Queue* 先提交已排队的请求腾出槽位。在途请求数不超过完成队列长度, 否则 Queue* 返回 false。
+ * Wait 失败时调用方须先 Drain 再释放缓冲区: 内核仍可能在读写在途请求的 iovec 与数据。
+ */
+
+#include "utils.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+class Uring {
+public:
+    Uring() = default;
+    ~Uring();
+
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+
+    // 内核不支持或被 seccomp 禁止时返回 false
+    bool Setup(unsigned entries);
+
+    // 提交队列的长度 (内核可能向上取整到 2 的幂)
+    unsigned Capacity() const { return capacity; }
+
+    // 读写请求; iov 与数据须保持有效直到取出其完成项 (或 Drain 返回)
+    // 环已关闭、完成队列放不下或提交失败时返回 false
+    bool Queue(int fd, bool write, iovec* iov, ULONGLONG offset, uint64_t tag);
+
+    // 刷新文件 (fsync 语义, 含文件长度等元数据)
+    bool QueueFsync(int fd, uint64_t tag);
+
+    // 提交排队的请求并取出一个完成项; 需要进入内核时至少等到 minComplete 个完成
+    bool Wait(uint64_t& tag, int& res, unsigned minComplete = 1);
+
+    // 提交剩余请求并等待全部在途请求完成, 丢弃其结果; io_uring_enter 仍然失败时关闭环
+    // (内核取消并回收剩余请求), 返回 false, 之后 Ready() 为 false
+    bool Drain();
+
+    bool Ready() const { return ringFd >= 0; }
+
+    // 已排队或已提交、尚未取出完成项的请求数
+    unsigned Inflight() const { return inflight; }
+
+    // io_uring_enter 的调用次数
+    ULONGLONG Enters() const { return enters; }
+
+private:
+    io_uring_sqe* NextSqe();
+    void Publish();
+    void* Map(size_t size, off_t offset);
+    bool Reap(uint64_t& tag, int& res);
+    void Close();
+
+    int ringFd = -1;
+    unsigned capacity = 0;
+    unsigned cqCapacity = 0;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    size_t sqesSize = 0;
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned pending = 0;               // 已排队、尚未提交给内核
+    unsigned inflight = 0;              // 已排队或已提交、尚未取出完成项
+    ULONGLONG enters = 0;
+};
+
+#endif
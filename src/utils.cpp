@@ -0,0 +1,210 @@
+﻿#include "utils.h"
+
+#include <cwctype>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+// ================================
+// 常量定义
+// ================================
+
+const wstring GUID_BASIC_DATA_PARTITION = L"{EBD0A0A2-B9E5-4433-87C0-68B6B72699C7}";
+const wstring GUID_EFI_SYSTEM_PARTITION = L"{C12A7328-F81F-11D2-BA4B-00A0C93EC93B}";
+const wstring GUID_MICROSOFT_RESERVED = L"{E3C9E316-0B5C-4DB8-817D-F92DF00215AE}";
+
+const map<wstring, int> FILE_SYSTEMS = {
+    {L"ntfs", 7},    // NTFS
+    {L"fat32", 5},   // FAT32
+    {L"exfat", 8},   // exFAT
+    {L"refs", 9}     // ReFS
+};
+
+// ================================
+// 工具函数
+// ================================
+
+ULONGLONG ParseSizeString(const wstring& sizeStr) {
+    wstring str = sizeStr;
+    ULONGLONG multiplier = 1;
+
+    if (!str.empty()) {
+        wchar_t unit = towupper(str.back());
+        if (unit == L'K' || unit == L'M' || unit == L'G' || unit == L'T') {
+            str.pop_back();
+            switch (unit) {
+            case L'K': multiplier = 1024ULL; break;
+            case L'M': multiplier = 1024ULL * 1024; break;
+            case L'G': multiplier = 1024ULL * 1024 * 1024; break;
+            case L'T': multiplier = 1024ULL * 1024 * 1024 * 1024; break;
+            }
+        }
+    }
+
+    return stoull(str) * multiplier;
+}
+
+map<wstring, wstring> ParseParams(const wstring& paramStr) {
+    map<wstring, wstring> params;
+    wstringstream ss(paramStr);
+    wstring token;
+
+    while (getline(ss, token, L',')) {
+        size_t pos = token.find(L'=');
+        if (pos != wstring::npos) {
+            wstring key = token.substr(0, pos);
+            wstring value = token.substr(pos + 1);
+            params[key] = value;
+        }
+    }
+
+    return params;
+}
+
+wstring PartitionTypeToGuid(const wstring& type) {
+    if (type == L"basic" || type == L"data") {
+        return GUID_BASIC_DATA_PARTITION;
+    }
+    else if (type == L"efi") {
+        return GUID_EFI_SYSTEM_PARTITION;
+    }
+    else if (type == L"msr") {
+        return GUID_MICROSOFT_RESERVED;
+    }
+    return type; // 假设是完整 GUID
+}
+
+vector<int> ParseNumberList(const wstring& listStr) {
+    vector<int> numbers;
+
+    for (const auto& token : SplitString(listStr, L',')) {
+        if (token.empty()) continue;
+
+        size_t dash = token.find(L'-', 1);
+        if (dash == wstring::npos) {
+            numbers.push_back(stoi(token));
+            continue;
+        }
+
+        // 区间形式: 5-8
+        int first = stoi(token.substr(0, dash));
+        int last = stoi(token.substr(dash + 1));
+        for (int n = first; n <= last; n++) {
+            numbers.push_back(n);
+        }
+    }
+
+    return numbers;
+}
+
+chrono::nanoseconds ParseDuration(const wstring& durationStr) {
+    size_t pos = 0;
+    double value = stod(durationStr, &pos);
+    wstring unit = durationStr.substr(pos);
+
+    double nanos = value * 1e6; // 默认毫秒
+    if (unit == L"ns") nanos = value;
+    else if (unit == L"us") nanos = value * 1e3;
+    else if (unit == L"s") nanos = value * 1e9;
+    else if (unit == L"min") nanos = value * 60e9;
+
+    return chrono::nanoseconds((long long)nanos);
+}
+
+vector<wstring> SplitString(const wstring& str, wchar_t delimiter) {
+    vector<wstring> parts;
+    wstringstream ss(str);
+    wstring token;
+
+    while (getline(ss, token, delimiter)) {
+        parts.push_back(token);
+    }
+
+    return parts;
+}
+
+string ToUtf8(const wstring& str) {
+    string out;
+    out.reserve(str.size());
+
+    for (size_t i = 0; i < str.size(); i++) {
+        unsigned long cp = (unsigned long)str[i];
+
+        // Windows 下 wchar_t 为 UTF-16, 需要合并代理对
+        if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < str.size()) {
+            unsigned long low = (unsigned long)str[i + 1];
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            }
+        }
+
+        if (cp < 0x80) {
+            out += (char)cp;
+        }
+        else if (cp < 0x800) {
+            out += (char)(0xC0 | (cp >> 6));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+        else if (cp < 0x10000) {
+            out += (char)(0xE0 | (cp >> 12));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+        else {
+            out += (char)(0xF0 | (cp >> 18));
+            out += (char)(0x80 | ((cp >> 12) & 0x3F));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+    }
+
+    return out;
+}
+
+wstring FromUtf8(const string& str) {
+    wstring out;
+    out.reserve(str.size());
+
+    for (size_t i = 0; i < str.size();) {
+        unsigned char c = (unsigned char)str[i];
+        unsigned long cp = c;
+        int extra = 0;
+
+        if (c >= 0xF0) { cp = c & 0x07; extra = 3; }
+        else if (c >= 0xE0) { cp = c & 0x0F; extra = 2; }
+        else if (c >= 0xC0) { cp = c & 0x1F; extra = 1; }
+
+        i++;
+        for (int k = 0; k < extra && i < str.size(); k++, i++) {
+            cp = (cp << 6) | ((unsigned char)str[i] & 0x3F);
+        }
+
+        if (sizeof(wchar_t) == 2 && cp >= 0x10000) {
+            cp -= 0x10000;
+            out += (wchar_t)(0xD800 + (cp >> 10));
+            out += (wchar_t)(0xDC00 + (cp & 0x3FF));
+        }
+        else {
+            out += (wchar_t)cp;
+        }
+    }
+
+    return out;
+}
+
+wstring FormatBytes(ULONGLONG bytes) {
+    static const wchar_t* units[] = { L"B", L"KB", L"MB", L"GB", L"TB" };
+    double value = (double)bytes;
+    int unit = 0;
+
+    while (value >= 1024.0 && unit < 4) {
+        value /= 1024.0;
+        unit++;
+    }
+
+    wstringstream ss;
+    ss << fixed << setprecision(unit == 0 ? 0 : 2) << value << L" " << units[unit];
+    return ss.str();
+}
@@ -0,0 +1,62 @@
+﻿#pragma once
+
+/*
+ * 通用工具函数与常量
+ *
+ * 本文件中的内容与平台无关, Windows 与 Linux (模拟/镜像模式) 共用。
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cstdint>
+typedef unsigned long long ULONGLONG;
+typedef long long LONGLONG;
+typedef long HRESULT;
+#endif
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+// ================================
+// 常量定义
+// ================================
+
+// GPT 分区类型 GUID
+extern const std::wstring GUID_BASIC_DATA_PARTITION;
+extern const std::wstring GUID_EFI_SYSTEM_PARTITION;
+extern const std::wstring GUID_MICROSOFT_RESERVED;
+
+// 文件系统类型 (MSFT_Partition.Format 的 FileSystem 枚举值)
+extern const std::map<std::wstring, int> FILE_SYSTEMS;
+
+// ================================
+// 工具函数
+// ================================
+
+// 转换字节大小的字符串(如 "10G", "500M") 为字节数
+ULONGLONG ParseSizeString(const std::wstring& sizeStr);
+
+// 解析参数字符串 (如 "size=10G,label=MyPart,type=basic")
+std::map<std::wstring, std::wstring> ParseParams(const std::wstring& paramStr);
+
+// GUID 字符串转换
+std::wstring PartitionTypeToGuid(const std::wstring& type);
+
+// 解析磁盘编号列表 (如 "1,3,5-8")
+std::vector<int> ParseNumberList(const std::wstring& listStr);
+
+// 解析时长字符串 (如 "250ms", "3s", "80us", 无单位按毫秒)
+std::chrono::nanoseconds ParseDuration(const std::wstring& durationStr);
+
+// 按分隔符拆分字符串
+std::vector<std::wstring> SplitString(const std::wstring& str, wchar_t delimiter);
+
+// 宽字符串与 UTF-8 互转 (文件路径、JSON 输出等)
+std::string ToUtf8(const std::wstring& str);
+std::wstring FromUtf8(const std::string& str);
+
+// 字节数格式化为易读文本 (如 "1.50 GB")
+std::wstring FormatBytes(ULONGLONG bytes);
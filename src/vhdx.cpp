@@ -0,0 +1,539 @@
+﻿#include "vhdx.h"
+
+#include "byte_order.h"
+#include "checksum.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <vector>
+
+using namespace std;
+
+static const ULONGLONG KiB = 1024;
+static const ULONGLONG MiB = 1024 * 1024;
+
+static const ULONGLONG HEADER1_OFFSET = 64 * KiB;
+static const ULONGLONG HEADER2_OFFSET = 128 * KiB;
+static const ULONGLONG REGION1_OFFSET = 192 * KiB;
+static const ULONGLONG REGION2_OFFSET = 256 * KiB;
+static const ULONGLONG LOG_OFFSET = 1 * MiB;
+static const ULONGLONG LOG_LENGTH = 1 * MiB;
+static const ULONGLONG METADATA_OFFSET = 2 * MiB;
+static const ULONGLONG METADATA_LENGTH = 1 * MiB;
+static const ULONGLONG BAT_OFFSET = 3 * MiB;
+
+static const size_t HEADER_SIZE = 4 * KiB;
+static const size_t REGION_TABLE_SIZE = 64 * KiB;
+static const ULONGLONG METADATA_ITEMS_OFFSET = 64 * KiB;   // 相对元数据区域
+
+// BAT 项状态
+static const uint64_t PAYLOAD_BLOCK_ZERO = 2;
+static const uint64_t PAYLOAD_BLOCK_FULLY_PRESENT = 6;
+static const uint64_t PAYLOAD_BLOCK_STATE_MASK = 7;
+
+// File Parameters 标志
+static const uint32_t FILE_HAS_PARENT = 0x2;
+
+// 区域与元数据项 GUID
+static const wchar_t* const BAT_REGION_GUID = L"2DC27766-F623-4200-9D64-115E9BFD4A08";
+static const wchar_t* const METADATA_REGION_GUID = L"8B7CA206-4790-4B9A-B8FE-575F050F886E";
+static const wchar_t* const FILE_PARAMETERS_GUID = L"CAA16737-FA36-4D43-B3B6-33F0AA44E76B";
+static const wchar_t* const VIRTUAL_DISK_SIZE_GUID = L"2FA54224-CD1B-4876-B211-5DBED83BF4B8";
+static const wchar_t* const VIRTUAL_DISK_ID_GUID = L"BECA12AB-B2E6-4523-93EF-C309E000C746";
+static const wchar_t* const LOGICAL_SECTOR_SIZE_GUID = L"8141BF1D-A96F-4709-BA47-F233A8FAAB5F";
+static const wchar_t* const PHYSICAL_SECTOR_SIZE_GUID = L"CDA348C7-445D-4471-9CC9-E9885251C556";
+
+// 元数据项标志
+static const uint32_t META_IS_VIRTUAL_DISK = 0x2;
+static const uint32_t META_IS_REQUIRED = 0x4;
+
+static void PutGuid(uint8_t* p, const wchar_t* text) {
+    Guid guid;
+    ParseGuid(text, guid);
+    memcpy(p, guid.bytes, 16);
+}
+
+static bool GuidEquals(const uint8_t* p, const wchar_t* text) {
+    uint8_t expected[16];
+    PutGuid(expected, text);
+    return memcmp(p, expected, 16) == 0;
+}
+
+// 稀疏写入: 只保留缓冲区中到最后一个非零字节为止的部分 (按 4 KiB 取整)
+static void AddTrimmed(ExtentList& file, ULONGLONG offset, const vector<uint8_t>& buffer) {
+    size_t used = buffer.size();
+    while (used > 0 && buffer[used - 1] == 0) used--;
+    if (used == 0) return;
+
+    used = (size_t)min<ULONGLONG>(buffer.size(), (used + 4 * KiB - 1) / (4 * KiB) * (4 * KiB));
+    file.Write(offset, buffer.data(), used);
+}
+
+static vector<uint8_t> BuildHeader(uint64_t sequence, const Guid& fileWriteGuid, const Guid& dataWriteGuid) {
+    vector<uint8_t> header(HEADER_SIZE, 0);
+    uint8_t* h = header.data();
+
+    memcpy(h, "head", 4);
+    PutLE64(h + 8, sequence);
+    memcpy(h + 16, fileWriteGuid.bytes, 16);
+    memcpy(h + 32, dataWriteGuid.bytes, 16);
+    // LogGuid 为零: 没有需要重放的日志
+    PutLE16(h + 64, 0);                          // LogVersion
+    PutLE16(h + 66, 1);                          // Version
+    PutLE32(h + 68, (uint32_t)LOG_LENGTH);
+    PutLE64(h + 72, LOG_OFFSET);
+
+    PutLE32(h + 4, Crc32c(h, HEADER_SIZE));
+    return header;
+}
+
+static vector<uint8_t> BuildRegionTable(ULONGLONG batLength) {
+    vector<uint8_t> table(REGION_TABLE_SIZE, 0);
+    uint8_t* t = table.data();
+
+    memcpy(t, "regi", 4);
+    PutLE32(t + 8, 2);                           // EntryCount
+
+    uint8_t* e = t + 16;
+    PutGuid(e, BAT_REGION_GUID);
+    PutLE64(e + 16, BAT_OFFSET);
+    PutLE32(e + 24, (uint32_t)batLength);
+    PutLE32(e + 28, 1);                          // Required
+
+    e += 32;
+    PutGuid(e, METADATA_REGION_GUID);
+    PutLE64(e + 16, METADATA_OFFSET);
+    PutLE32(e + 24, (uint32_t)METADATA_LENGTH);
+    PutLE32(e + 28, 1);
+
+    PutLE32(t + 4, Crc32c(t, REGION_TABLE_SIZE));
+    return table;
+}
+
+static vector<uint8_t> BuildMetadata(const VhdxOptions& options, const Guid& virtualDiskId) {
+    vector<uint8_t> region((size_t)(METADATA_ITEMS_OFFSET + 4 * KiB), 0);
+    uint8_t* r = region.data();
+
+    memcpy(r, "metadata", 8);
+    PutLE16(r + 10, 5);                          // EntryCount
+
+    uint32_t itemOffset = (uint32_t)METADATA_ITEMS_OFFSET;
+    uint8_t* entry = r + 32;
+
+    auto addItem = [&](const wchar_t* id, uint32_t length, uint32_t flags) -> uint8_t* {
+        PutGuid(entry, id);
+        PutLE32(entry + 16, itemOffset);
+        PutLE32(entry + 20, length);
+        PutLE32(entry + 24, flags);
+        entry += 32;
+
+        uint8_t* item = r + itemOffset;
+        itemOffset += length;
+        return item;
+    };
+
+    // File Parameters: BlockSize, 不保留已分配块, 无父磁盘
+    uint8_t* fileParameters = addItem(FILE_PARAMETERS_GUID, 8, META_IS_REQUIRED);
+    PutLE32(fileParameters, (uint32_t)options.blockSize);
+
+    uint8_t* diskSize = addItem(VIRTUAL_DISK_SIZE_GUID, 8, META_IS_VIRTUAL_DISK | META_IS_REQUIRED);
+    PutLE64(diskSize, options.diskSize);
+
+    uint8_t* diskId = addItem(VIRTUAL_DISK_ID_GUID, 16, META_IS_VIRTUAL_DISK | META_IS_REQUIRED);
+    memcpy(diskId, virtualDiskId.bytes, 16);
+
+    uint8_t* logical = addItem(LOGICAL_SECTOR_SIZE_GUID, 4, META_IS_VIRTUAL_DISK | META_IS_REQUIRED);
+    PutLE32(logical, options.logicalSectorSize);
+
+    uint8_t* physical = addItem(PHYSICAL_SECTOR_SIZE_GUID, 4, META_IS_VIRTUAL_DISK | META_IS_REQUIRED);
+    PutLE32(physical, options.physicalSectorSize);
+
+    return region;
+}
+
+bool BuildVhdx(
+    const VhdxOptions& options,
+    const ExtentList& extents,
+    mt19937_64& rng,
+    ExtentList& file,
+    VhdxStats& stats
+) {
+    stats = VhdxStats();
+    file.Clear();
+
+    const ULONGLONG blockSize = options.blockSize;
+    if (blockSize < 1 * MiB || blockSize > 256 * MiB || (blockSize & (blockSize - 1)) != 0) {
+        wcerr << L"❌ VHDX 块大小必须是 1 MiB - 256 MiB 之间的 2 的幂" << endl;
+        return false;
+    }
+    if (options.logicalSectorSize != 512 && options.logicalSectorSize != 4096) {
+        wcerr << L"❌ VHDX 逻辑扇区大小只能是 512 或 4096" << endl;
+        return false;
+    }
+    if (options.diskSize == 0 || options.diskSize % options.logicalSectorSize != 0
+        || options.diskSize > 64ULL * 1024 * 1024 * MiB) {
+        wcerr << L"❌ VHDX 虚拟磁盘大小无效 (须为扇区整数倍, 不超过 64 TB)" << endl;
+        return false;
+    }
+
+    // ---------- BAT 尺寸 ----------
+    const ULONGLONG totalBlocks = (options.diskSize + blockSize - 1) / blockSize;
+    const ULONGLONG chunkRatio = (8ULL * 1024 * 1024 * options.logicalSectorSize) / blockSize;
+    const ULONGLONG batEntries = totalBlocks + (totalBlocks - 1) / chunkRatio;
+    const ULONGLONG batLength = (batEntries * 8 + MiB - 1) / MiB * MiB;
+    const ULONGLONG payloadStart = BAT_OFFSET + batLength;
+
+    // ---------- 块状态 ----------
+    map<ULONGLONG, uint64_t> blockState;      // 块号 -> 状态 (只记录非空块)
+    for (const auto& entry : extents.Extents()) {
+        const ImageExtent& ext = entry.second;
+        if (ext.End() > options.diskSize) {
+            wcerr << L"❌ 镜像区段超出虚拟磁盘范围" << endl;
+            return false;
+        }
+
+        ULONGLONG first = ext.offset / blockSize;
+        ULONGLONG last = (ext.End() - 1) / blockSize;
+        for (ULONGLONG block = first; block <= last; block++) {
+            uint64_t& state = blockState[block];
+            if (!ext.IsZero()) state = PAYLOAD_BLOCK_FULLY_PRESENT;
+            else if (state == 0) state = PAYLOAD_BLOCK_ZERO;
+        }
+    }
+
+    // 数据块在文件中的位置 (按块号顺序分配)
+    map<ULONGLONG, ULONGLONG> blockOffset;
+    ULONGLONG fileEnd = payloadStart;
+    for (const auto& entry : blockState) {
+        if (entry.second == PAYLOAD_BLOCK_FULLY_PRESENT) {
+            blockOffset[entry.first] = fileEnd;
+            fileEnd += blockSize;
+            stats.allocatedBlocks++;
+        }
+        else {
+            stats.zeroBlocks++;
+        }
+    }
+
+    stats.totalBlocks = totalBlocks;
+    stats.fileSize = fileEnd;
+
+    // ---------- 文件类型标识 ----------
+    {
+        vector<uint8_t> identifier(64 * KiB, 0);
+        memcpy(identifier.data(), "vhdxfile", 8);
+        const wchar_t* creator = L"disk_part_fmt";
+        for (size_t i = 0; creator[i]; i++) {
+            PutLE16(&identifier[8 + i * 2], (uint16_t)creator[i]);
+        }
+        AddTrimmed(file, 0, identifier);
+    }
+
+    // ---------- 头与区域表 ----------
+    Guid fileWriteGuid = RandomGuid(rng);
+    Guid dataWriteGuid = RandomGuid(rng);
+    Guid virtualDiskId = RandomGuid(rng);
+
+    file.Write(HEADER1_OFFSET, BuildHeader(0, fileWriteGuid, dataWriteGuid).data(), HEADER_SIZE);
+    file.Write(HEADER2_OFFSET, BuildHeader(1, fileWriteGuid, dataWriteGuid).data(), HEADER_SIZE);
+
+    auto regionTable = BuildRegionTable(batLength);
+    AddTrimmed(file, REGION1_OFFSET, regionTable);
+    AddTrimmed(file, REGION2_OFFSET, regionTable);
+
+    AddTrimmed(file, METADATA_OFFSET, BuildMetadata(options, virtualDiskId));
+
+    // ---------- BAT: 只写出含非零项的 4 KiB 页 ----------
+    {
+        const ULONGLONG entriesPerPage = 4 * KiB / 8;
+        map<ULONGLONG, vector<uint8_t>> pages;
+
+        for (const auto& entry : blockState) {
+            ULONGLONG block = entry.first;
+            ULONGLONG index = block + block / chunkRatio;   // 每 chunkRatio 项后有一个扇区位图项
+            uint64_t value = entry.second;
+            auto allocated = blockOffset.find(block);
+            if (allocated != blockOffset.end()) {
+                value |= (allocated->second / MiB) << 20;
+            }
+
+            auto& page = pages[index / entriesPerPage];
+            if (page.empty()) page.assign(4 * KiB, 0);
+            PutLE64(&page[(size_t)(index % entriesPerPage) * 8], value);
+        }
+
+        for (const auto& page : pages) {
+            file.Write(BAT_OFFSET + page.first * 4 * KiB, page.second.data(), page.second.size());
+        }
+    }
+
+    // ---------- 数据块 ----------
+    for (const auto& entry : extents.Extents()) {
+        const ImageExtent& ext = entry.second;
+        if (ext.IsZero()) continue;   // 新分配块与未分配块均读出为零
+
+        ULONGLONG pos = ext.offset;
+        while (pos < ext.End()) {
+            ULONGLONG block = pos / blockSize;
+            ULONGLONG blockEnd = (block + 1) * blockSize;
+            ULONGLONG chunk = min(ext.End(), blockEnd) - pos;
+
+            // 块在文件中按 1 MiB 对齐, 填充相位不变, 填充区段在文件内容中仍保持为填充
+            ULONGLONG target = blockOffset[block] + (pos - block * blockSize);
+            if (ext.IsFill()) file.Fill(target, chunk, ext.fill);
+            else file.Write(target, ext.data.data() + (pos - ext.offset), (size_t)chunk);
+            pos += chunk;
+        }
+    }
+
+    return true;
+}
+
+// ================================
+// 已有 VHDX 的随机读写
+// ================================
+
+bool VhdxFile::Open(const wstring& path, mt19937_64& random) {
+    rng = &random;
+    batCache.clear();
+    updating = false;
+    allocatedBlocks = 0;
+
+    ULONGLONG fileSize = 0;
+    if (!file.Open(path) || !file.QuerySize(fileSize)) return false;
+
+    char identifier[8] = {};
+    if (fileSize < BAT_OFFSET || !file.ReadAt(0, identifier, sizeof(identifier))
+        || memcmp(identifier, "vhdxfile", 8) != 0) {
+        wcerr << L"❌ 不是 VHDX 文件: " << path << endl;
+        return false;
+    }
+
+    // ---------- 头: 取 CRC 有效且序号最大的一份 ----------
+    uint64_t bestSequence = 0;
+    for (ULONGLONG offset : { HEADER1_OFFSET, HEADER2_OFFSET }) {
+        vector<uint8_t> h(HEADER_SIZE);
+        if (!file.ReadAt(offset, h.data(), h.size())) return false;
+        if (memcmp(h.data(), "head", 4) != 0) continue;
+
+        uint32_t crc = GetLE32(&h[4]);
+        PutLE32(&h[4], 0);
+        if (Crc32c(h.data(), h.size()) != crc) continue;
+        PutLE32(&h[4], crc);
+
+        uint64_t sequence = GetLE64(&h[8]);
+        if (header.empty() || sequence > bestSequence) {
+            header = h;
+            headerOffset = offset;
+            bestSequence = sequence;
+        }
+    }
+    if (header.empty()) {
+        wcerr << L"❌ VHDX 头已损坏: " << path << endl;
+        return false;
+    }
+
+    bool logEmpty = all_of(&header[48], &header[64], [](uint8_t b) { return b == 0; });
+    if (!logEmpty) {
+        wcerr << L"❌ VHDX 日志中有未重放的记录, 请先在 Windows 中挂载一次: " << path << endl;
+        return false;
+    }
+
+    // ---------- 区域表 ----------
+    vector<uint8_t> regions(REGION_TABLE_SIZE);
+    if (!file.ReadAt(REGION1_OFFSET, regions.data(), regions.size())) return false;
+    uint32_t regionCrc = GetLE32(&regions[4]);
+    PutLE32(&regions[4], 0);
+    if (memcmp(regions.data(), "regi", 4) != 0 || Crc32c(regions.data(), regions.size()) != regionCrc) {
+        wcerr << L"❌ VHDX 区域表已损坏: " << path << endl;
+        return false;
+    }
+
+    ULONGLONG metadataOffset = 0;
+    uint32_t regionCount = min<uint32_t>(GetLE32(&regions[8]), (REGION_TABLE_SIZE - 16) / 32);
+    for (uint32_t i = 0; i < regionCount; i++) {
+        const uint8_t* e = &regions[16 + i * 32];
+        if (GuidEquals(e, BAT_REGION_GUID)) {
+            batOffset = GetLE64(e + 16);
+            batLength = GetLE32(e + 24);
+        }
+        else if (GuidEquals(e, METADATA_REGION_GUID)) {
+            metadataOffset = GetLE64(e + 16);
+        }
+    }
+
+    // ---------- 元数据 ----------
+    vector<uint8_t> metadata(METADATA_ITEMS_OFFSET);
+    if (batOffset == 0 || metadataOffset == 0
+        || !file.ReadAt(metadataOffset, metadata.data(), metadata.size())
+        || memcmp(metadata.data(), "metadata", 8) != 0) {
+        wcerr << L"❌ VHDX 缺少 BAT 或元数据区域: " << path << endl;
+        return false;
+    }
+
+    uint32_t fileFlags = 0;
+    uint16_t entryCount = min<uint16_t>(GetLE16(&metadata[10]), 2047);
+    for (uint16_t i = 0; i < entryCount; i++) {
+        const uint8_t* e = &metadata[32 + i * 32];
+        uint8_t item[8] = {};
+        uint32_t length = min<uint32_t>(GetLE32(e + 20), sizeof(item));
+        if (length > 0 && !file.ReadAt(metadataOffset + GetLE32(e + 16), item, length)) return false;
+
+        if (GuidEquals(e, FILE_PARAMETERS_GUID)) {
+            blockSize = GetLE32(item);
+            fileFlags = GetLE32(item + 4);
+        }
+        else if (GuidEquals(e, VIRTUAL_DISK_SIZE_GUID)) {
+            diskSize = GetLE64(item);
+        }
+        else if (GuidEquals(e, LOGICAL_SECTOR_SIZE_GUID)) {
+            logicalSectorSize = GetLE32(item);
+        }
+        else if (GuidEquals(e, PHYSICAL_SECTOR_SIZE_GUID)) {
+            physicalSectorSize = GetLE32(item);
+        }
+    }
+
+    if (fileFlags & FILE_HAS_PARENT) {
+        wcerr << L"❌ 不支持差分 VHDX: " << path << endl;
+        return false;
+    }
+    if (blockSize < 1 * MiB || blockSize > 256 * MiB || (blockSize & (blockSize - 1)) != 0
+        || (logicalSectorSize != 512 && logicalSectorSize != 4096) || diskSize == 0) {
+        wcerr << L"❌ VHDX 元数据无效: " << path << endl;
+        return false;
+    }
+
+    chunkRatio = (8ULL * 1024 * 1024 * logicalSectorSize) / blockSize;
+    return true;
+}
+
+bool VhdxFile::ReadBatEntry(ULONGLONG block, uint64_t& entry) {
+    auto cached = batCache.find(block);
+    if (cached != batCache.end()) {
+        entry = cached->second;
+        return true;
+    }
+
+    ULONGLONG index = block + block / chunkRatio;   // 每 chunkRatio 项后有一个扇区位图项
+    if ((index + 1) * 8 > batLength) {
+        wcerr << L"❌ VHDX BAT 项越界 (块 " << block << L")" << endl;
+        return false;
+    }
+
+    uint8_t raw[8];
+    if (!file.ReadAt(batOffset + index * 8, raw, sizeof(raw))) return false;
+    entry = GetLE64(raw);
+    batCache[block] = entry;
+    return true;
+}
+
+// 在文件末尾 (1 MiB 对齐) 追加一个块并更新 BAT; 新块为空洞, 读出为零
+bool VhdxFile::AllocateBlock(ULONGLONG block, ULONGLONG& fileOffset) {
+    ULONGLONG fileSize = 0;
+    if (!file.QuerySize(fileSize)) return false;
+
+    fileOffset = (fileSize + MiB - 1) / MiB * MiB;
+    if (!file.SetSize(fileOffset + blockSize)) return false;
+
+    uint64_t entry = PAYLOAD_BLOCK_FULLY_PRESENT | ((fileOffset / MiB) << 20);
+    uint8_t raw[8];
+    PutLE64(raw, entry);
+
+    ULONGLONG index = block + block / chunkRatio;
+    if (!file.WriteAt(batOffset + index * 8, raw, sizeof(raw))) return false;
+
+    batCache[block] = entry;
+    allocatedBlocks++;
+    return true;
+}
+
+// 首次修改前写入序号加一、带新写入 GUID 的头 (写到另一份头的位置, 原头保留到成功为止)
+bool VhdxFile::BeginUpdate() {
+    if (updating) return true;
+
+    vector<uint8_t> h = header;
+    Guid fileWriteGuid = RandomGuid(*rng);
+    Guid dataWriteGuid = RandomGuid(*rng);
+
+    PutLE64(&h[8], GetLE64(&h[8]) + 1);
+    memcpy(&h[16], fileWriteGuid.bytes, 16);
+    memcpy(&h[32], dataWriteGuid.bytes, 16);
+    PutLE32(&h[4], 0);
+    PutLE32(&h[4], Crc32c(h.data(), h.size()));
+
+    ULONGLONG target = headerOffset == HEADER1_OFFSET ? HEADER2_OFFSET : HEADER1_OFFSET;
+    if (!file.WriteAt(target, h.data(), h.size())) return false;
+
+    header = h;
+    headerOffset = target;
+    updating = true;
+    return true;
+}
+
+bool VhdxFile::Read(ULONGLONG offset, void* data, size_t length) {
+    uint8_t* p = (uint8_t*)data;
+    if (offset + length > diskSize) {
+        wcerr << L"❌ 读取超出 VHDX 虚拟磁盘范围" << endl;
+        return false;
+    }
+
+    while (length > 0) {
+        ULONGLONG block = offset / blockSize;
+        size_t chunk = (size_t)min<ULONGLONG>(length, (block + 1) * blockSize - offset);
+
+        uint64_t entry = 0;
+        if (!ReadBatEntry(block, entry)) return false;
+
+        if ((entry & PAYLOAD_BLOCK_STATE_MASK) == PAYLOAD_BLOCK_FULLY_PRESENT) {
+            ULONGLONG fileOffset = (entry >> 20) * MiB + (offset - block * blockSize);
+            if (!file.ReadAt(fileOffset, p, chunk)) return false;
+        }
+        else {
+            memset(p, 0, chunk);
+        }
+
+        p += chunk;
+        offset += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool VhdxFile::Write(ULONGLONG offset, const void* data, size_t length) {
+    const uint8_t* p = (const uint8_t*)data;
+    if (offset + length > diskSize) {
+        wcerr << L"❌ 写入超出 VHDX 虚拟磁盘范围" << endl;
+        return false;
+    }
+    if (!BeginUpdate()) return false;
+
+    while (length > 0) {
+        ULONGLONG block = offset / blockSize;
+        size_t chunk = (size_t)min<ULONGLONG>(length, (block + 1) * blockSize - offset);
+
+        uint64_t entry = 0;
+        if (!ReadBatEntry(block, entry)) return false;
+
+        ULONGLONG blockOffset = 0;
+        if ((entry & PAYLOAD_BLOCK_STATE_MASK) == PAYLOAD_BLOCK_FULLY_PRESENT) {
+            blockOffset = (entry >> 20) * MiB;
+        }
+        else if (!AllocateBlock(block, blockOffset)) {
+            return false;
+        }
+
+        if (!file.WriteAt(blockOffset + (offset - block * blockSize), p, chunk)) return false;
+
+        p += chunk;
+        offset += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool VhdxFile::Close() {
+    return file.Close();
+}
@@ -0,0 +1,90 @@
+﻿#pragma once
+
+/*
+ * 动态 VHDX 容器写入 (MS-VHDX 1.0)
+ *
+ * 文件布局:
+ *   0       文件类型标识 "vhdxfile"
+ *   64 KiB  头 1 / 128 KiB 头 2 (CRC32C)
+ *   192 KiB 区域表 1 / 256 KiB 区域表 2 (CRC32C)
+ *   1 MiB   日志 (空)
+ *   2 MiB   元数据区域
+ *   3 MiB   BAT, 之后为按需分配的数据块
+ *
+ * 只有区段列表中含数据的块才分配 (PAYLOAD_BLOCK_FULLY_PRESENT); 只含零区段的块
+ * 标记为 PAYLOAD_BLOCK_ZERO, 其余保持未分配。文件本身为稀疏文件, 块内未写入的
+ * 部分不占用空间, 因此 2 TB 的镜像只写入几 MiB。
+ *
+ * VhdxFile 为已有 VHDX 的随机读写 (原地修改镜像用): 按 BAT 把虚拟磁盘偏移映射到
+ * 文件偏移, 写入未分配的块时在文件末尾追加新块。
+ */
+
+#include "extent.h"
+#include "file_io.h"
+#include "guid.h"
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+struct VhdxOptions {
+    ULONGLONG diskSize = 0;
+    unsigned logicalSectorSize = 512;
+    unsigned physicalSectorSize = 4096;
+    ULONGLONG blockSize = 32ULL * 1024 * 1024;   // 1 MiB - 256 MiB, 2 的幂
+};
+
+struct VhdxStats {
+    ULONGLONG totalBlocks = 0;
+    ULONGLONG allocatedBlocks = 0;
+    ULONGLONG zeroBlocks = 0;
+    ULONGLONG fileSize = 0;
+};
+
+// 生成整个 VHDX 文件 (按文件偏移的区段列表), 文件长度见 stats.fileSize
+bool BuildVhdx(
+    const VhdxOptions& options,
+    const ExtentList& extents,
+    std::mt19937_64& rng,
+    ExtentList& file,
+    VhdxStats& stats
+);
+
+// 已有 VHDX 的随机读写; 只支持日志为空、没有父磁盘的 VHDX
+class VhdxFile {
+public:
+    // rng 用于首次写入时生成新的 FileWriteGuid / DataWriteGuid
+    bool Open(const std::wstring& path, std::mt19937_64& rng);
+
+    // 虚拟磁盘偏移; 未分配与零块读出为零
+    bool Read(ULONGLONG offset, void* data, size_t length);
+    bool Write(ULONGLONG offset, const void* data, size_t length);
+
+    bool Close();
+
+    ULONGLONG DiskSize() const { return diskSize; }
+    unsigned LogicalSectorSize() const { return logicalSectorSize; }
+    unsigned PhysicalSectorSize() const { return physicalSectorSize; }
+    ULONGLONG AllocatedBlocks() const { return allocatedBlocks; }   // 本次新分配的块
+
+private:
+    bool ReadBatEntry(ULONGLONG block, uint64_t& entry);
+    bool AllocateBlock(ULONGLONG block, ULONGLONG& fileOffset);
+    bool BeginUpdate();
+
+    OutputFile file;
+    std::mt19937_64* rng = nullptr;
+    ULONGLONG diskSize = 0;
+    unsigned logicalSectorSize = 512;
+    unsigned physicalSectorSize = 4096;
+    ULONGLONG blockSize = 0;
+    ULONGLONG chunkRatio = 0;
+    ULONGLONG batOffset = 0;
+    ULONGLONG batLength = 0;
+    ULONGLONG headerOffset = 0;         // 当前有效的头
+    std::vector<uint8_t> header;
+    bool updating = false;              // 已写入新的头
+    ULONGLONG allocatedBlocks = 0;
+    std::map<ULONGLONG, uint64_t> batCache;
+};
@@ -0,0 +1,461 @@
+﻿/*
+ * WMI 后端 (ATL 版本): ROOT\Microsoft\Windows\Storage
+ *
+ * 仅在 Windows 下编译, 将 StorageBackend 接口映射到 IWbemServices。
+ */
+
+#include "storage_backend.h"
+
+#include <atlbase.h>      // ATL 基础类
+#include <atlcomcli.h>
+#include <comdef.h>
+#include <Wbemidl.h>
+#include <climits>
+#include <iostream>
+
+#pragma comment(lib, "wbemuuid.lib")
+#pragma comment(lib, "ole32.lib")
+#pragma comment(lib, "oleaut32.lib")
+
+using namespace std;
+using namespace ATL;
+
+// ================================
+// VARIANT <-> PropValue 转换
+// ================================
+
+class ComObject;
+
+static PropValue VariantToProp(const VARIANT& var);
+static void PropToVariant(const PropValue& value, CComVariant& var);
+
+// IWbemClassObject 包装
+class ComObject : public StorageObject {
+public:
+    explicit ComObject(IWbemClassObject* obj) : pObj(obj) {}
+
+    bool Get(const wstring& name, PropValue& value) const override {
+        CComVariant var;
+        HRESULT hres = pObj->Get(CComBSTR(name.c_str()), 0, &var, 0, 0);
+        if (FAILED(hres)) {
+            value = PropValue();
+            return false;
+        }
+        value = VariantToProp(var);
+        return true;
+    }
+
+    bool Put(const wstring& name, const PropValue& value) override {
+        CComVariant var;
+        PropToVariant(value, var);
+        return SUCCEEDED(pObj->Put(CComBSTR(name.c_str()), 0, &var, 0));
+    }
+
+    vector<wstring> GetNames() const override {
+        vector<wstring> names;
+        SAFEARRAY* psaNames = NULL;
+        if (FAILED(pObj->GetNames(NULL, WBEM_FLAG_ALWAYS, NULL, &psaNames)) || !psaNames) {
+            return names;
+        }
+
+        LONG lower = 0, upper = -1;
+        SafeArrayGetLBound(psaNames, 1, &lower);
+        SafeArrayGetUBound(psaNames, 1, &upper);
+        for (LONG i = lower; i <= upper; i++) {
+            CComBSTR name;
+            SafeArrayGetElement(psaNames, &i, &name);
+            if (name) names.push_back(wstring(name));
+        }
+        SafeArrayDestroy(psaNames);
+        return names;
+    }
+
+    IWbemClassObject* Raw() const { return pObj; }
+
+private:
+    CComPtr<IWbemClassObject> pObj;   // ATL 智能指针，自动管理引用计数
+};
+
+static IWbemClassObject* RawObject(const StorageObjectPtr& obj) {
+    auto comObj = dynamic_cast<ComObject*>(obj.get());
+    return comObj ? comObj->Raw() : nullptr;
+}
+
+static PropValue VariantToProp(const VARIANT& var) {
+    switch (var.vt) {
+    case VT_BOOL:
+        return PropValue(var.boolVal != VARIANT_FALSE);
+    case VT_I1: return PropValue((int)var.cVal);
+    case VT_UI1: return PropValue((int)var.bVal);
+    case VT_I2: return PropValue((int)var.iVal);
+    case VT_UI2: return PropValue((int)var.uiVal);
+    case VT_I4: return PropValue((long)var.lVal);
+    case VT_UI4: return PropValue((long long)var.ulVal);
+    case VT_INT: return PropValue((int)var.intVal);
+    case VT_UINT: return PropValue((long long)var.uintVal);
+    case VT_I8: return PropValue((long long)var.llVal);
+    case VT_UI8: return PropValue((ULONGLONG)var.ullVal);
+    case VT_BSTR:
+        return PropValue(wstring(var.bstrVal ? var.bstrVal : L""));
+    case VT_UNKNOWN:
+    {
+        CComPtr<IWbemClassObject> pObj;
+        if (var.punkVal) {
+            var.punkVal->QueryInterface(IID_IWbemClassObject, (void**)&pObj);
+        }
+        if (!pObj) return PropValue();
+        return PropValue(StorageObjectPtr(make_shared<ComObject>(pObj)));
+    }
+    case VT_ARRAY | VT_BSTR:
+    {
+        vector<wstring> items;
+        LONG lower = 0, upper = -1;
+        SafeArrayGetLBound(var.parray, 1, &lower);
+        SafeArrayGetUBound(var.parray, 1, &upper);
+        for (LONG i = lower; i <= upper; i++) {
+            CComBSTR item;
+            SafeArrayGetElement(var.parray, &i, &item);
+            items.push_back(item ? wstring(item) : wstring());
+        }
+        return PropValue(items);
+    }
+    case VT_ARRAY | VT_I4:
+    {
+        // uint16[] 等整数数组 (如 MSFT_PhysicalDisk.OperationalStatus) 按十进制字符串数组返回
+        vector<wstring> items;
+        LONG lower = 0, upper = -1;
+        SafeArrayGetLBound(var.parray, 1, &lower);
+        SafeArrayGetUBound(var.parray, 1, &upper);
+        for (LONG i = lower; i <= upper; i++) {
+            LONG item = 0;
+            SafeArrayGetElement(var.parray, &i, &item);
+            items.push_back(to_wstring(item));
+        }
+        return PropValue(items);
+    }
+    case VT_ARRAY | VT_UNKNOWN:
+    {
+        vector<StorageObjectPtr> items;
+        LONG lower = 0, upper = -1;
+        SafeArrayGetLBound(var.parray, 1, &lower);
+        SafeArrayGetUBound(var.parray, 1, &upper);
+        for (LONG i = lower; i <= upper; i++) {
+            CComPtr<IUnknown> pUnk;
+            SafeArrayGetElement(var.parray, &i, &pUnk);
+            CComPtr<IWbemClassObject> pObj;
+            if (pUnk) pUnk->QueryInterface(IID_IWbemClassObject, (void**)&pObj);
+            if (pObj) items.push_back(make_shared<ComObject>(pObj));
+        }
+        return PropValue(items);
+    }
+    default:
+    {
+        // 其他类型统一转换为字符串
+        CComVariant converted;
+        if (SUCCEEDED(VariantChangeType(&converted, &var, 0, VT_BSTR))) {
+            return PropValue(wstring(converted.bstrVal));
+        }
+        return PropValue();
+    }
+    }
+}
+
+static void PropToVariant(const PropValue& value, CComVariant& var) {
+    switch (value.GetKind()) {
+    case PropValue::Kind::Bool:
+        var = value.AsBool();
+        break;
+    case PropValue::Kind::Int:
+    {
+        long long v = value.AsInt();
+        if (v >= LONG_MIN && v <= LONG_MAX) {
+            var = (long)v;
+        }
+        else {
+            var = (LONGLONG)v;
+        }
+        break;
+    }
+    case PropValue::Kind::UInt64:
+        // 确保类型为 UINT64
+        var.Clear();
+        var.vt = VT_UI8;
+        var.ullVal = value.AsUInt64();
+        break;
+    case PropValue::Kind::String:
+        var = CComBSTR(value.AsString().c_str());
+        break;
+    case PropValue::Kind::Object:
+    {
+        IWbemClassObject* pObj = RawObject(value.AsObject());
+        var.Clear();
+        if (pObj) {
+            var.vt = VT_UNKNOWN;
+            var.punkVal = pObj;
+            pObj->AddRef();
+        }
+        break;
+    }
+    case PropValue::Kind::StringArray:
+    {
+        const auto& items = value.AsStringArray();
+        SAFEARRAY* psa = SafeArrayCreateVector(VT_BSTR, 0, (ULONG)items.size());
+        for (LONG i = 0; i < (LONG)items.size(); i++) {
+            CComBSTR item(items[i].c_str());
+            SafeArrayPutElement(psa, &i, item);
+        }
+        var.Clear();
+        var.vt = VT_ARRAY | VT_BSTR;
+        var.parray = psa;
+        break;
+    }
+    case PropValue::Kind::ObjectArray:
+    {
+        const auto& items = value.AsObjectArray();
+        SAFEARRAY* psa = SafeArrayCreateVector(VT_UNKNOWN, 0, (ULONG)items.size());
+        for (LONG i = 0; i < (LONG)items.size(); i++) {
+            SafeArrayPutElement(psa, &i, RawObject(items[i]));
+        }
+        var.Clear();
+        var.vt = VT_ARRAY | VT_UNKNOWN;
+        var.parray = psa;
+        break;
+    }
+    default:
+        var.Clear();
+        break;
+    }
+}
+
+// ================================
+// 枚举器
+// ================================
+
+class ComEnumerator : public ObjectEnumerator {
+public:
+    explicit ComEnumerator(IEnumWbemClassObject* pEnum) : pEnumerator(pEnum) {}
+
+    bool Next(StorageObjectPtr& obj) override {
+        CComPtr<IWbemClassObject> pclsObj;
+        ULONG uReturn = 0;
+        pEnumerator->Next(WBEM_INFINITE, 1, &pclsObj, &uReturn);
+        if (uReturn == 0) return false;
+
+        obj = make_shared<ComObject>(pclsObj);
+        return true;
+    }
+
+private:
+    CComPtr<IEnumWbemClassObject> pEnumerator;
+};
+
+// ================================
+// WMI 后端
+// ================================
+
+class WmiBackend : public StorageBackend {
+private:
+    CComPtr<IWbemLocator> pLoc;      // ATL 智能指针，自动管理引用计数
+    CComPtr<IWbemServices> pSvc;     // ATL 智能指针
+    bool initialized;
+
+public:
+    WmiBackend() : initialized(false) {}
+
+    ~WmiBackend() override {
+        Cleanup();
+    }
+
+    wstring Name() const override { return L"wmi"; }
+
+    bool Initialize() {
+        HRESULT hres;
+
+        // 初始化 COM
+        hres = CoInitializeEx(0, COINIT_MULTITHREADED);
+        if (FAILED(hres) && hres != RPC_E_CHANGED_MODE) {
+            wcerr << L"❌ COM 初始化失败. 错误代码: 0x" << hex << hres << endl;
+            return false;
+        }
+
+        // 设置 COM 安全级别
+        hres = CoInitializeSecurity(
+            NULL,
+            -1,
+            NULL,
+            NULL,
+            RPC_C_AUTHN_LEVEL_DEFAULT,
+            RPC_C_IMP_LEVEL_IMPERSONATE,
+            NULL,
+            EOAC_NONE,
+            NULL
+        );
+
+        if (FAILED(hres) && hres != RPC_E_TOO_LATE) {
+            wcerr << L"❌ COM 安全初始化失败. 错误代码: 0x" << hex << hres << endl;
+            CoUninitialize();
+            return false;
+        }
+
+        // 获取 WMI 定位器 - 使用 ATL 智能指针
+        hres = pLoc.CoCreateInstance(CLSID_WbemLocator);
+        if (FAILED(hres)) {
+            wcerr << L"❌ 创建 WbemLocator 失败. 错误代码: 0x" << hex << hres << endl;
+            CoUninitialize();
+            return false;
+        }
+
+        // 连接到 ROOT\Microsoft\Windows\Storage 命名空间
+        CComBSTR bstrNamespace(L"ROOT\\Microsoft\\Windows\\Storage");
+        hres = pLoc->ConnectServer(
+            bstrNamespace,
+            NULL,
+            NULL,
+            0,
+            NULL,
+            0,
+            0,
+            &pSvc
+        );
+
+        if (FAILED(hres)) {
+            wcerr << L"❌ 连接到 WMI Storage 命名空间失败. 错误代码: 0x" << hex << hres << endl;
+            pLoc.Release();  // ATL 智能指针会自动 Release，但可以显式调用
+            CoUninitialize();
+            return false;
+        }
+
+        // 设置代理安全级别
+        hres = CoSetProxyBlanket(
+            pSvc,
+            RPC_C_AUTHN_WINNT,
+            RPC_C_AUTHZ_NONE,
+            NULL,
+            RPC_C_AUTHN_LEVEL_CALL,
+            RPC_C_IMP_LEVEL_IMPERSONATE,
+            NULL,
+            EOAC_NONE
+        );
+
+        if (FAILED(hres)) {
+            wcerr << L"❌ 设置代理安全失败. 错误代码: 0x" << hex << hres << endl;
+            pSvc.Release();
+            pLoc.Release();
+            CoUninitialize();
+            return false;
+        }
+
+        initialized = true;
+        return true;
+    }
+
+    void Cleanup() {
+        // ATL 智能指针会自动释放，但确保 COM 清理
+        pSvc.Release();
+        pLoc.Release();
+        if (initialized) {
+            CoUninitialize();
+            initialized = false;
+        }
+    }
+
+    bool ExecQuery(const wstring& query, unique_ptr<ObjectEnumerator>& result) override {
+        CComPtr<IEnumWbemClassObject> pEnumerator;
+
+        HRESULT hres = pSvc->ExecQuery(
+            CComBSTR(L"WQL"),
+            CComBSTR(query.c_str()),
+            WBEM_FLAG_FORWARD_ONLY | WBEM_FLAG_RETURN_IMMEDIATELY,
+            NULL,
+            &pEnumerator
+        );
+
+        lastError = hres;
+        if (FAILED(hres)) return false;
+
+        result.reset(new ComEnumerator(pEnumerator));
+        return true;
+    }
+
+    bool GetObjectByPath(const wstring& path, StorageObjectPtr& result) override {
+        CComPtr<IWbemClassObject> pObj;
+        HRESULT hres = pSvc->GetObject(CComBSTR(path.c_str()), 0, NULL, &pObj, NULL);
+
+        lastError = hres;
+        if (FAILED(hres)) return false;
+
+        result = make_shared<ComObject>(pObj);
+        return true;
+    }
+
+    bool GetMethod(const StorageObjectPtr& classObj, const wstring& methodName,
+        StorageObjectPtr& inParamsDefinition) override {
+        IWbemClassObject* pClass = RawObject(classObj);
+        if (!pClass) {
+            lastError = WBEM_E_INVALID_PARAMETER;
+            return false;
+        }
+
+        CComPtr<IWbemClassObject> pInParamsDef;
+        HRESULT hres = pClass->GetMethod(CComBSTR(methodName.c_str()), 0, &pInParamsDef, NULL);
+
+        lastError = hres;
+        if (FAILED(hres)) return false;
+
+        // 无输入参数的方法返回空定义
+        inParamsDefinition = pInParamsDef ? make_shared<ComObject>(pInParamsDef) : nullptr;
+        return true;
+    }
+
+    bool SpawnInstance(const StorageObjectPtr& definition, StorageObjectPtr& instance) override {
+        IWbemClassObject* pDef = RawObject(definition);
+        if (!pDef) {
+            lastError = WBEM_E_INVALID_PARAMETER;
+            return false;
+        }
+
+        CComPtr<IWbemClassObject> pInst;
+        HRESULT hres = pDef->SpawnInstance(0, &pInst);
+
+        lastError = hres;
+        if (FAILED(hres)) return false;
+
+        instance = make_shared<ComObject>(pInst);
+        return true;
+    }
+
+    bool ExecMethod(const wstring& objectPath, const wstring& methodName,
+        const StorageObjectPtr& inParams, StorageObjectPtr& outParams) override {
+        CComPtr<IWbemClassObject> pOutParams;
+
+        HRESULT hres = pSvc->ExecMethod(
+            CComBSTR(objectPath.c_str()),
+            CComBSTR(methodName.c_str()),
+            0,
+            NULL,
+            RawObject(inParams),
+            &pOutParams,
+            NULL
+        );
+
+        lastError = hres;
+        if (FAILED(hres)) return false;
+
+        outParams = pOutParams ? make_shared<ComObject>(pOutParams) : nullptr;
+        return true;
+    }
+
+    bool PutInstance(const StorageObjectPtr& obj) override {
+        HRESULT hres = pSvc->PutInstance(RawObject(obj), WBEM_FLAG_UPDATE_ONLY, NULL, NULL);
+        lastError = hres;
+        return SUCCEEDED(hres);
+    }
+};
+
+unique_ptr<StorageBackend> CreateWmiBackend() {
+    unique_ptr<WmiBackend> backend(new WmiBackend());
+    if (!backend->Initialize()) {
+        return nullptr;
+    }
+    return backend;
+}
@@ -0,0 +1,131 @@
+﻿#include "wmi_manager.h"
+
+#include <iostream>
+
+using namespace std;
+
+bool WMIManager::Initialize() {
+#ifdef _WIN32
+    auto wmiBackend = CreateWmiBackend();
+    if (!wmiBackend) {
+        return false;
+    }
+    wcout << L"✓ WMI 连接成功" << endl;
+    return Initialize(move(wmiBackend));
+#else
+    wcerr << L"❌ 当前平台不支持 WMI, 请使用 --sim 模拟提供程序" << endl;
+    return false;
+#endif
+}
+
+bool WMIManager::Initialize(unique_ptr<StorageBackend> storageBackend) {
+    if (!storageBackend) {
+        return false;
+    }
+
+    backend = move(storageBackend);
+    initialized = true;
+    return true;
+}
+
+void WMIManager::Cleanup() {
+    backend.reset();
+    initialized = false;
+}
+
+bool WMIManager::ExecMethod(
+    const wstring& objectPath,
+    const wstring& methodName,
+    const StorageObjectPtr& inParams,
+    StorageObjectPtr& outParams
+) {
+    if (!Timed(CallKind::ExecMethod, [&]() { return backend->ExecMethod(objectPath, methodName, inParams, outParams); })) {
+        wcerr << L"❌ 执行方法 " << methodName << L" 失败. 错误代码: 0x" << hex << backend->LastError() << dec << endl;
+        return false;
+    }
+
+    // 检查返回值
+    if (outParams) {
+        PropValue varReturnValue;
+        if (outParams->Get(L"ReturnValue", varReturnValue) && !varReturnValue.IsEmpty()) {
+            long long retVal = varReturnValue.AsInt();
+
+            if (retVal != 0) {
+                wcerr << L"❌ 方法 " << methodName << L" 返回错误码: " << retVal << endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+unique_ptr<ObjectEnumerator> WMIManager::Query(const wstring& query) {
+    unique_ptr<ObjectEnumerator> pEnumerator;
+
+    if (!Timed(CallKind::ExecQuery, [&]() { return backend->ExecQuery(query, pEnumerator); })) {
+        wcerr << L"❌ WMI 查询失败: " << query << endl;
+        return nullptr;
+    }
+
+    return pEnumerator;
+}
+
+bool WMIManager::Next(ObjectEnumerator& enumerator, StorageObjectPtr& obj) {
+    obj.reset();
+
+    // 枚举结束也是一次往返, 不计为失败
+    bool more = false;
+    Timed(CallKind::Next, [&]() { more = backend->Next(enumerator, obj); return true; });
+    return more;
+}
+
+StorageObjectPtr WMIManager::GetObjectByPath(const wstring& path) {
+    StorageObjectPtr obj;
+    if (!Timed(CallKind::GetObject, [&]() { return backend->GetObjectByPath(path, obj); })) {
+        return nullptr;
+    }
+    return obj;
+}
+
+StorageObjectPtr WMIManager::GetMethod(const StorageObjectPtr& classObj, const wstring& methodName) {
+    StorageObjectPtr inParamsDefinition;
+    if (!classObj || !Timed(CallKind::GetMethod, [&]() { return backend->GetMethod(classObj, methodName, inParamsDefinition); })) {
+        return nullptr;
+    }
+    return inParamsDefinition;
+}
+
+StorageObjectPtr WMIManager::SpawnInstance(const StorageObjectPtr& definition) {
+    StorageObjectPtr instance;
+    if (!definition || !Timed(CallKind::SpawnInstance, [&]() { return backend->SpawnInstance(definition, instance); })) {
+        return nullptr;
+    }
+    return instance;
+}
+
+bool WMIManager::PutInstance(const StorageObjectPtr& obj) {
+    return Timed(CallKind::PutInstance, [&]() { return backend->PutInstance(obj); });
+}
+
+StorageObjectPtr WMIManager::PrepareMethod(const wstring& className, const wstring& methodName) {
+    auto pClass = GetObjectByPath(className);
+    if (!pClass) {
+        wcerr << L"❌ 获取 " << className << L" 类失败" << endl;
+        return nullptr;
+    }
+
+    auto pInParamsDefinition = GetMethod(pClass, methodName);
+    if (!pInParamsDefinition) {
+        wcerr << L"❌ 获取 " << methodName << L" 方法失败" << endl;
+        return nullptr;
+    }
+
+    auto pInParams = SpawnInstance(pInParamsDefinition);
+    if (!pInParams) {
+        wcerr << L"❌ 创建 " << methodName << L" 参数实例失败" << endl;
+        return nullptr;
+    }
+
+    return pInParams;
+}
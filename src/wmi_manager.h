@@ -0,0 +1,85 @@
+﻿#pragma once
+
+/*
+ * WMI 管理类
+ *
+ * 面向 DiskManager 的统一调用入口: 负责后端生命周期、错误输出与
+ * ExecMethod 返回值检查。后端可以是真实 WMI, 也可以是模拟提供程序。
+ * 每次跨进程调用都按类型计数计时 (见 call_stats.h)。
+ */
+
+#include "call_stats.h"
+#include "storage_backend.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+class WMIManager {
+private:
+    std::unique_ptr<StorageBackend> backend;
+    bool initialized;
+    CallStats stats;
+
+    // 计时并记录一次往返调用
+    template <typename Call>
+    bool Timed(CallKind kind, Call&& call) {
+        auto start = backend->Now();
+        bool ok = call();
+        stats.Record(kind, backend->Now() - start, ok);
+        return ok;
+    }
+
+public:
+    WMIManager() : initialized(false) {}
+
+    ~WMIManager() {
+        Cleanup();
+    }
+
+    // 连接本机 ROOT\Microsoft\Windows\Storage (仅 Windows)
+    bool Initialize();
+
+    // 使用指定后端 (模拟提供程序等)
+    bool Initialize(std::unique_ptr<StorageBackend> storageBackend);
+
+    void Cleanup();
+
+    StorageBackend* GetBackend() { return backend.get(); }
+
+    // 执行 WMI 方法, 并检查 ReturnValue
+    bool ExecMethod(
+        const std::wstring& objectPath,
+        const std::wstring& methodName,
+        const StorageObjectPtr& inParams,
+        StorageObjectPtr& outParams
+    );
+
+    // 查询对象, 失败时返回 nullptr
+    std::unique_ptr<ObjectEnumerator> Query(const std::wstring& query);
+
+    // 取枚举结果的下一个对象
+    bool Next(ObjectEnumerator& enumerator, StorageObjectPtr& obj);
+
+    // 获取类或实例对象, 失败时返回 nullptr
+    StorageObjectPtr GetObjectByPath(const std::wstring& path);
+
+    // 获取方法输入参数定义
+    StorageObjectPtr GetMethod(const StorageObjectPtr& classObj, const std::wstring& methodName);
+
+    // 创建方法参数实例
+    StorageObjectPtr SpawnInstance(const StorageObjectPtr& definition);
+
+    // 提交实例修改
+    bool PutInstance(const StorageObjectPtr& obj);
+
+    // 准备方法参数: GetObject(类) -> GetMethod -> SpawnInstance
+    StorageObjectPtr PrepareMethod(const std::wstring& className, const std::wstring& methodName);
+
+    // 往返调用统计
+    const CallStats& Stats() const { return stats; }
+    void ResetStats() { stats = CallStats(); }
+
+    std::chrono::nanoseconds Now() const { return backend->Now(); }
+    void Sleep(std::chrono::nanoseconds duration) { backend->Sleep(duration); }
+};
@@ -0,0 +1,747 @@
+﻿/*
+ * ntfs_test: 对 FormatNtfs / GrowNtfs 生成的卷做结构检查 (不依赖 ntfs.cpp 的解析代码)
+ *
+ * 检查项:
+ *   boot     引导扇区字段, 位于分区最后一个扇区的备份与之相同
+ *   fixups   每个 MFT 记录与索引块的更新序列、记录号与属性链
+ *   mirror   $MFTMirr 与 $MFT 开头的记录逐字节一致
+ *   bitmap   $Bitmap 与全部非常驻属性的区段一致 (无越界、无重叠、无遗漏, 卷末填充位为 1),
+ *            $BadClus:$Bad 是覆盖整个卷的稀疏流
+ *   index    $I30 按 $UpCase 排序, 索引项与记录的 $FILE_NAME 一致, 每个名称恰好被父目录索引一次
+ *   secure   $SDS 各项的哈希、偏移与 256 KiB 处的镜像, $SDH/$SII 的顺序与数据
+ *
+ * 用例在内存中格式化 (ExtentList), 覆盖不同的扇区与簇大小, 并在原地扩展 (包括需要为 $Bitmap 分配新簇的情况) 后再次检查。
+ * 命令行给出 raw 镜像路径时改为检查其中的每个 NTFS 分区 (例如 --resize-part 之后的镜像)。
+ * 任一检查失败时退出码为 1。
+ */
+
+#include "byte_order.h"
+#include "extent.h"
+#include "layout.h"
+#include "ntfs.h"
+
+#include <algorithm>
+#include <clocale>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <stdio.h>
+#else
+#include <langinfo.h>
+#endif
+
+using namespace std;
+
+static int failures = 0;
+
+static void Check(bool condition, const wstring& what) {
+    if (!condition) {
+        wcerr << L"  ❌ " << what << endl;
+        failures++;
+    }
+}
+
+// ================================
+// 磁盘结构
+// ================================
+
+static const uint32_t AT_FILE_NAME = 0x30;
+static const uint32_t AT_DATA = 0x80;
+static const uint32_t AT_INDEX_ROOT = 0x90;
+static const uint32_t AT_INDEX_ALLOCATION = 0xA0;
+static const uint32_t AT_BITMAP = 0xB0;
+static const uint32_t AT_END = 0xFFFFFFFF;
+
+static const uint16_t RECORD_IN_USE = 0x0001;
+static const uint16_t INDEX_ENTRY_NODE = 0x01;
+static const uint16_t INDEX_ENTRY_END = 0x02;
+
+static const uint32_t RECORD_MFT = 0;
+static const uint32_t RECORD_MFTMIRR = 1;
+static const uint32_t RECORD_BITMAP = 6;
+static const uint32_t RECORD_BADCLUS = 8;
+static const uint32_t RECORD_SECURE = 9;
+static const uint32_t RECORD_UPCASE = 10;
+
+static const ULONGLONG SDS_MIRROR_OFFSET = 0x40000;
+
+struct DataRun {
+    ULONGLONG lcn = 0;
+    ULONGLONG clusters = 0;
+    bool sparse = false;
+};
+
+struct Attribute {
+    uint32_t type = 0;
+    u16string name;
+    bool nonResident = false;
+    size_t offset = 0;                 // 在记录中的偏移
+    size_t length = 0;
+};
+
+struct Record {
+    uint32_t number = 0;
+    uint16_t sequence = 0;
+    uint16_t flags = 0;
+    vector<uint8_t> data;              // 已还原更新序列
+    vector<Attribute> attributes;
+
+    bool InUse() const { return (flags & RECORD_IN_USE) != 0; }
+
+    const Attribute* Find(uint32_t type, const u16string& name) const {
+        for (const auto& a : attributes) {
+            if (a.type == type && a.name == name) return &a;
+        }
+        return nullptr;
+    }
+
+    // 常驻属性的值
+    vector<uint8_t> Value(const Attribute& a) const {
+        const uint8_t* p = &data[a.offset];
+        size_t length = GetLE32(p + 0x10);
+        size_t offset = GetLE16(p + 0x14);
+        if (offset + length > a.length) return {};
+        return vector<uint8_t>(p + offset, p + offset + length);
+    }
+};
+
+// 还原更新序列; 任一 512 字节块的末尾与更新序列号不符时返回 false
+static bool RemoveFixups(vector<uint8_t>& block) {
+    const size_t usaOffset = GetLE16(&block[0x04]);
+    const size_t usaCount = GetLE16(&block[0x06]);
+    if (usaCount != block.size() / 512 + 1 || usaOffset + 2 * usaCount > block.size()) return false;
+
+    const uint16_t usn = GetLE16(&block[usaOffset]);
+    for (size_t i = 1; i < usaCount; i++) {
+        uint8_t* tail = &block[i * 512 - 2];
+        if (GetLE16(tail) != usn) return false;
+        memcpy(tail, &block[usaOffset + 2 * i], 2);
+    }
+    return true;
+}
+
+static bool DecodeRuns(const uint8_t* p, size_t length, vector<DataRun>& runs) {
+    long long lcn = 0;
+    size_t pos = 0;
+    for (;;) {
+        if (pos >= length) return false;
+        const unsigned header = p[pos];
+        if (header == 0) return true;
+
+        const unsigned lengthBytes = header & 0x0F;
+        const unsigned lcnBytes = header >> 4;
+        if (lengthBytes == 0 || pos + 1 + lengthBytes + lcnBytes > length) return false;
+
+        DataRun run;
+        for (unsigned i = 0; i < lengthBytes; i++) run.clusters |= (ULONGLONG)p[pos + 1 + i] << (8 * i);
+        if (lcnBytes == 0) {
+            run.sparse = true;
+        }
+        else {
+            long long delta = (int8_t)p[pos + lengthBytes + lcnBytes];          // 最高字节带符号
+            for (unsigned i = lcnBytes - 1; i-- > 0;) delta = delta * 256 + p[pos + 1 + lengthBytes + i];
+            lcn += delta;
+            run.lcn = (ULONGLONG)lcn;
+        }
+        runs.push_back(run);
+        pos += 1 + lengthBytes + lcnBytes;
+    }
+}
+
+// ================================
+// 卷检查
+// ================================
+
+class VolumeChecker {
+public:
+    VolumeChecker(const NtfsReader& read, ULONGLONG base, ULONGLONG partitionSize, unsigned sectorSize, const wstring& name)
+        : read(read), base(base), partitionSize(partitionSize), sectorSize(sectorSize), name(name) {}
+
+    void Run() {
+        if (!CheckBoot() || !LoadMft()) return;
+        CheckMirror();
+        CheckClusters();
+        LoadUpcase();
+        for (const auto& record : records) {
+            if (record.InUse() && record.Find(AT_INDEX_ROOT, u"$I30")) CheckDirectory(record);
+        }
+        CheckNamesIndexed();
+        CheckSecure();
+    }
+
+private:
+    bool Fail(const wstring& what) {
+        Check(false, name + L": " + what);
+        return false;
+    }
+
+    bool Read(ULONGLONG offset, void* data, size_t length) {
+        return read(base + offset, (uint8_t*)data, length) || Fail(L"读取失败 @" + to_wstring(offset));
+    }
+
+    // ---------- boot ----------
+    bool CheckBoot() {
+        boot.resize(sectorSize);
+        if (!Read(0, boot.data(), boot.size())) return false;
+        if (memcmp(&boot[3], "NTFS    ", 8) != 0 || boot[0x1FE] != 0x55 || boot[0x1FF] != 0xAA) {
+            return Fail(L"引导扇区签名无效");
+        }
+        if (GetLE16(&boot[0x0B]) != sectorSize) return Fail(L"每扇区字节数与磁盘不符");
+
+        const unsigned spcField = boot[0x0D];
+        const unsigned spc = spcField <= 0x80 ? spcField : 1u << (256 - spcField);
+        clusterBytes = sectorSize * spc;
+        recordBytes = (int8_t)boot[0x40] > 0 ? boot[0x40] * clusterBytes : 1u << (256 - boot[0x40]);
+        indexBlockBytes = (int8_t)boot[0x44] > 0 ? boot[0x44] * clusterBytes : 1u << (256 - boot[0x44]);
+
+        const ULONGLONG totalSectors = GetLE64(&boot[0x28]);
+        Check(totalSectors == partitionSize / sectorSize - 1, name + L": 总扇区数 " + to_wstring(totalSectors)
+            + L" 不是分区扇区数减 1");
+        clusterCount = totalSectors / spc;
+
+        vector<uint8_t> backup(sectorSize);
+        if (!Read(totalSectors * sectorSize, backup.data(), backup.size())) return false;
+        Check(backup == boot, name + L": 备份引导扇区与主引导扇区不同");
+        return true;
+    }
+
+    // ---------- fixups: 读出全部 MFT 记录 ----------
+    bool ParseRecord(uint32_t number, vector<uint8_t> raw, Record& record) {
+        wstring where = L"MFT 记录 " + to_wstring(number);
+        record.number = number;
+        if (memcmp(raw.data(), "FILE", 4) != 0) return Fail(where + L" 签名无效");
+        if (!RemoveFixups(raw)) return Fail(where + L" 的更新序列与扇区末尾不符");
+
+        record.data = move(raw);
+        const vector<uint8_t>& d = record.data;
+        record.sequence = GetLE16(&d[0x10]);
+        record.flags = GetLE16(&d[0x16]);
+        if (GetLE32(&d[0x1C]) != d.size()) return Fail(where + L" 的分配大小与引导扇区不符");
+        if (GetLE32(&d[0x2C]) != number) return Fail(where + L" 的记录号字段为 " + to_wstring(GetLE32(&d[0x2C])));
+
+        const size_t used = GetLE32(&d[0x18]);
+        if (used > d.size()) return Fail(where + L" 的已用大小超出记录");
+
+        size_t pos = GetLE16(&d[0x14]);
+        for (;;) {
+            if (pos + 8 > used) return Fail(where + L" 的属性链没有结束标记");
+            Attribute a;
+            a.type = GetLE32(&d[pos]);
+            if (a.type == AT_END) {
+                if (pos + 8 != used) return Fail(where + L" 的已用大小与结束标记不符");
+                return true;
+            }
+            a.length = GetLE32(&d[pos + 4]);
+            if (a.length < 0x18 || a.length % 8 != 0 || pos + a.length > used) return Fail(where + L" 的属性长度无效");
+            a.offset = pos;
+            a.nonResident = d[pos + 8] != 0;
+            for (unsigned i = 0; i < d[pos + 9]; i++) a.name.push_back((char16_t)GetLE16(&d[pos + GetLE16(&d[pos + 0x0A]) + 2 * i]));
+            record.attributes.push_back(a);
+            pos += a.length;
+        }
+    }
+
+    bool Runs(const Record& record, const Attribute& a, vector<DataRun>& runs) {
+        wstring where = L"MFT 记录 " + to_wstring(record.number) + L" 的属性 0x" + to_wstring(a.type);
+        if (!a.nonResident) return Fail(where + L" 不是非常驻属性");
+
+        const uint8_t* p = &record.data[a.offset];
+        const size_t pairsOffset = GetLE16(p + 0x20);
+        runs.clear();
+        if (pairsOffset >= a.length || !DecodeRuns(p + pairsOffset, a.length - pairsOffset, runs)) {
+            return Fail(where + L" 的 mapping pairs 无效");
+        }
+
+        ULONGLONG clusters = 0;
+        for (const auto& run : runs) clusters += run.clusters;
+        Check(GetLE64(p + 0x10) == 0 && clusters == GetLE64(p + 0x18) + 1, name + L": " + where + L" 的区段与 VCN 范围不符");
+        Check(GetLE64(p + 0x28) == clusters * clusterBytes, name + L": " + where + L" 的分配大小与区段不符");
+        Check(GetLE64(p + 0x30) <= GetLE64(p + 0x28) && GetLE64(p + 0x38) <= GetLE64(p + 0x30),
+            name + L": " + where + L" 的数据大小超出分配大小");
+        return true;
+    }
+
+    bool ReadStream(const vector<DataRun>& runs, ULONGLONG length, vector<uint8_t>& out) {
+        out.assign((size_t)length, 0);
+        ULONGLONG pos = 0;
+        for (const auto& run : runs) {
+            if (pos >= length) break;
+            ULONGLONG n = min(run.clusters * clusterBytes, length - pos);
+            if (!run.sparse && !Read(run.lcn * clusterBytes, &out[(size_t)pos], (size_t)n)) return false;
+            pos += n;
+        }
+        return true;
+    }
+
+    bool ReadDataStream(const Record& record, const u16string& stream, vector<uint8_t>& out) {
+        const Attribute* a = record.Find(AT_DATA, stream);
+        vector<DataRun> runs;
+        if (!a || !Runs(record, *a, runs)) return Fail(L"MFT 记录 " + to_wstring(record.number) + L" 缺少数据流");
+        return ReadStream(runs, GetLE64(&record.data[a->offset + 0x30]), out);
+    }
+
+    bool LoadMft() {
+        vector<uint8_t> first(recordBytes);
+        const ULONGLONG mftOffset = GetLE64(&boot[0x30]) * clusterBytes;
+        if (!Read(mftOffset, first.data(), first.size())) return false;
+
+        Record mft;
+        if (!ParseRecord(RECORD_MFT, first, mft) || !ReadDataStream(mft, u"", mftRaw)) return false;
+
+        const size_t count = mftRaw.size() / recordBytes;
+        if (count <= RECORD_UPCASE) return Fail(L"$MFT 只有 " + to_wstring(count) + L" 个记录");
+        for (size_t i = 0; i < count; i++) {
+            Record record;
+            vector<uint8_t> raw(mftRaw.begin() + i * recordBytes, mftRaw.begin() + (i + 1) * recordBytes);
+            if (!ParseRecord((uint32_t)i, raw, record)) return false;
+            records.push_back(move(record));
+        }
+        return true;
+    }
+
+    // ---------- mirror ----------
+    void CheckMirror() {
+        vector<uint8_t> mirror;
+        if (!ReadDataStream(records[RECORD_MFTMIRR], u"", mirror)) return;
+        Check(mirror.size() >= 4 * (size_t)recordBytes && mirror.size() <= mftRaw.size()
+            && equal(mirror.begin(), mirror.end(), mftRaw.begin()), name + L": $MFTMirr 与 $MFT 开头的记录不同");
+    }
+
+    // ---------- bitmap ----------
+    void CheckClusters() {
+        vector<bool> claimed((size_t)clusterCount, false);
+        size_t overlaps = 0;
+        for (const auto& record : records) {
+            if (!record.InUse()) continue;
+            for (const auto& a : record.attributes) {
+                vector<DataRun> runs;
+                if (!a.nonResident || !Runs(record, a, runs)) continue;
+                for (const auto& run : runs) {
+                    if (run.sparse) continue;
+                    if (run.lcn + run.clusters > clusterCount) {
+                        Fail(L"MFT 记录 " + to_wstring(record.number) + L" 的区段超出卷");
+                        continue;
+                    }
+                    for (ULONGLONG c = run.lcn; c < run.lcn + run.clusters; c++) {
+                        if (claimed[(size_t)c]) overlaps++;
+                        claimed[(size_t)c] = true;
+                    }
+                }
+            }
+        }
+        Check(overlaps == 0, name + L": " + to_wstring(overlaps) + L" 个簇被多个区段占用");
+
+        vector<uint8_t> bitmap;
+        if (!ReadDataStream(records[RECORD_BITMAP], u"", bitmap)) return;
+        if (bitmap.size() * 8 < clusterCount) {
+            Fail(L"$Bitmap 只有 " + to_wstring(bitmap.size()) + L" 字节");
+            return;
+        }
+
+        size_t mismatches = 0;
+        ULONGLONG firstMismatch = 0;
+        for (ULONGLONG c = 0; c < bitmap.size() * 8; c++) {
+            bool bit = (bitmap[(size_t)(c / 8)] >> (c % 8)) & 1;
+            bool expected = c < clusterCount ? (bool)claimed[(size_t)c] : true;
+            if (bit != expected && mismatches++ == 0) firstMismatch = c;
+        }
+        Check(mismatches == 0, name + L": $Bitmap 有 " + to_wstring(mismatches) + L" 位与区段不符 (第一个为簇 "
+            + to_wstring(firstMismatch) + L")");
+
+        const Record& bad = records[RECORD_BADCLUS];
+        const Attribute* a = bad.Find(AT_DATA, u"$Bad");
+        vector<DataRun> runs;
+        if (!a || !Runs(bad, *a, runs)) {
+            Fail(L"缺少 $BadClus:$Bad");
+            return;
+        }
+        ULONGLONG sparseClusters = 0;
+        for (const auto& run : runs) sparseClusters += run.sparse ? run.clusters : 0;
+        Check(sparseClusters == clusterCount && GetLE64(&bad.data[a->offset + 0x30]) == clusterCount * clusterBytes,
+            name + L": $BadClus:$Bad 没有覆盖整个卷");
+    }
+
+    // ---------- index ----------
+    void LoadUpcase() {
+        vector<uint8_t> data;
+        if (!ReadDataStream(records[RECORD_UPCASE], u"", data) || data.size() != 65536 * 2) {
+            Fail(L"$UpCase 不是 65536 个字符");
+            return;
+        }
+        upcase.resize(65536);
+        for (size_t i = 0; i < upcase.size(); i++) upcase[i] = GetLE16(&data[2 * i]);
+    }
+
+    // 一个索引节点 (索引根或索引块中的索引头) 的项; 有子节点时递归, 按排序顺序输出
+    bool WalkNode(const uint8_t* header, size_t available, const vector<uint8_t>& allocation,
+        const vector<uint8_t>& inUse, int depth, vector<vector<uint8_t>>& out) {
+        if (depth > 8) return Fail(L"索引层数过多");
+
+        size_t pos = GetLE32(header);
+        const size_t used = GetLE32(header + 4);
+        if (used > available) return Fail(L"索引头的已用大小超出范围");
+        for (;;) {
+            if (pos + 0x10 > used) return Fail(L"索引项越界或缺少结束项");
+            const uint8_t* e = header + pos;
+            const size_t length = GetLE16(e + 0x08);
+            const uint16_t flags = GetLE16(e + 0x0C);
+            if (length < 0x10 || pos + length > used) return Fail(L"索引项长度无效");
+
+            if (flags & INDEX_ENTRY_NODE) {
+                ULONGLONG vcn = GetLE64(e + length - 8);
+                size_t blockOffset = (size_t)(vcn * (indexBlockBytes < clusterBytes ? 512 : clusterBytes));
+                size_t blockIndex = blockOffset / indexBlockBytes;
+                if (blockOffset + indexBlockBytes > allocation.size() || blockIndex / 8 >= inUse.size()
+                    || !((inUse[blockIndex / 8] >> (blockIndex % 8)) & 1)) {
+                    return Fail(L"索引项指向无效或未使用的索引块");
+                }
+
+                vector<uint8_t> block(allocation.begin() + blockOffset, allocation.begin() + blockOffset + indexBlockBytes);
+                if (memcmp(block.data(), "INDX", 4) != 0 || !RemoveFixups(block)) return Fail(L"索引块的签名或更新序列无效");
+                if (GetLE64(&block[0x10]) != vcn) return Fail(L"索引块的 VCN 字段与位置不符");
+                if (!WalkNode(&block[0x18], block.size() - 0x18, allocation, inUse, depth + 1, out)) return false;
+            }
+            if (flags & INDEX_ENTRY_END) return true;
+
+            out.push_back(vector<uint8_t>(e, e + length));
+            pos += length;
+        }
+    }
+
+    // 索引根与索引分配中的全部项, 按树的中序
+    bool ReadIndex(const Record& record, const u16string& index, vector<vector<uint8_t>>& entries) {
+        const Attribute* root = record.Find(AT_INDEX_ROOT, index);
+        if (!root) return Fail(L"MFT 记录 " + to_wstring(record.number) + L" 缺少索引根");
+        vector<uint8_t> rootValue = record.Value(*root);
+        if (rootValue.size() < 0x20) return Fail(L"索引根过短");
+
+        vector<uint8_t> allocation;
+        vector<uint8_t> inUse;
+        if (const Attribute* a = record.Find(AT_INDEX_ALLOCATION, index)) {
+            vector<DataRun> runs;
+            if (!Runs(record, *a, runs) || !ReadStream(runs, GetLE64(&record.data[a->offset + 0x30]), allocation)) return false;
+            const Attribute* bitmap = record.Find(AT_BITMAP, index);
+            if (!bitmap) return Fail(L"索引分配缺少 $BITMAP");
+            inUse = record.Value(*bitmap);
+        }
+        return WalkNode(&rootValue[0x10], rootValue.size() - 0x10, allocation, inUse, 0, entries);
+    }
+
+    // $I30 的排序: 先按 $UpCase 转换后比较, 相同时按原字符比较
+    int CompareNames(const u16string& a, const u16string& b) const {
+        for (int pass = 0; pass < 2; pass++) {
+            for (size_t i = 0; i < min(a.size(), b.size()); i++) {
+                uint16_t x = pass == 0 ? upcase[a[i]] : a[i];
+                uint16_t y = pass == 0 ? upcase[b[i]] : b[i];
+                if (x != y) return x < y ? -1 : 1;
+            }
+            if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+        }
+        return 0;
+    }
+
+    static u16string KeyName(const vector<uint8_t>& fileName) {
+        u16string n;
+        if (fileName.size() < 0x42) return n;
+        for (unsigned i = 0; i < fileName[0x40] && 0x42 + 2 * i + 2 <= fileName.size(); i++) {
+            n.push_back((char16_t)GetLE16(&fileName[0x42 + 2 * i]));
+        }
+        return n;
+    }
+
+    void CheckDirectory(const Record& dir) {
+        if (upcase.empty()) return;
+
+        vector<vector<uint8_t>> entries;
+        if (!ReadIndex(dir, u"$I30", entries)) return;
+
+        wstring where = name + L": 目录 " + to_wstring(dir.number) + L" 的 $I30";
+        u16string previous;
+        for (size_t i = 0; i < entries.size(); i++) {
+            const vector<uint8_t>& e = entries[i];
+            const size_t keyLength = GetLE16(&e[0x0A]);
+            if (0x10 + keyLength > e.size()) {
+                Fail(L"目录 " + to_wstring(dir.number) + L" 的索引项键长度无效");
+                continue;
+            }
+            vector<uint8_t> key(e.begin() + 0x10, e.begin() + 0x10 + keyLength);
+            u16string current = KeyName(key);
+            Check(i == 0 || CompareNames(previous, current) < 0, where + L" 的项未按 $UpCase 排序");
+            previous = current;
+
+            const ULONGLONG reference = GetLE64(&e[0]);
+            const size_t target = (size_t)(reference & 0xFFFFFFFFFFFFULL);
+            if (target >= records.size() || !records[target].InUse()) {
+                Fail(L"目录 " + to_wstring(dir.number) + L" 的索引项指向未使用的记录 " + to_wstring(target));
+                continue;
+            }
+            const Record& file = records[target];
+            Check((reference >> 48) == file.sequence, where + L" 中记录 " + to_wstring(target) + L" 的序列号不符");
+            Check(key.size() >= 8 && (GetLE64(&key[0]) & 0xFFFFFFFFFFFFULL) == dir.number,
+                where + L" 中记录 " + to_wstring(target) + L" 的父目录不符");
+
+            bool matched = false;
+            for (const auto& a : file.attributes) {
+                if (a.type == AT_FILE_NAME && !a.nonResident && file.Value(a) == key) matched = true;
+            }
+            Check(matched, where + L" 中记录 " + to_wstring(target) + L" 的键与其 $FILE_NAME 不同");
+            indexed[target]++;
+        }
+    }
+
+    void CheckNamesIndexed() {
+        for (const auto& record : records) {
+            if (!record.InUse() || !record.Find(AT_FILE_NAME, u"")) continue;
+            Check(indexed[record.number] == 1, name + L": 记录 " + to_wstring(record.number) + L" 被父目录索引了 "
+                + to_wstring(indexed[record.number]) + L" 次");
+        }
+    }
+
+    // ---------- secure ----------
+    void CheckSecure() {
+        const Record& secure = records[RECORD_SECURE];
+        vector<uint8_t> sds;
+        if (!ReadDataStream(secure, u"$SDS", sds)) return;
+        if (sds.size() <= SDS_MIRROR_OFFSET) {
+            Fail(L"$SDS 没有镜像部分");
+            return;
+        }
+
+        // 第一段的各项: 偏移字段、哈希与镜像
+        map<uint32_t, vector<uint8_t>> headers;
+        size_t pos = 0;
+        while (pos + 20 <= SDS_MIRROR_OFFSET) {
+            const uint32_t length = GetLE32(&sds[pos + 16]);
+            if (length == 0) break;
+            if (length < 20 || pos + length > SDS_MIRROR_OFFSET) {
+                Fail(L"$SDS 项长度无效 @" + to_wstring(pos));
+                return;
+            }
+
+            uint32_t hash = 0;
+            for (size_t i = pos + 20; i + 4 <= pos + length; i += 4) hash = GetLE32(&sds[i]) + ((hash << 3) | (hash >> 29));
+            const uint32_t id = GetLE32(&sds[pos + 4]);
+            Check(GetLE32(&sds[pos]) == hash, name + L": $SDS 项 " + to_wstring(id) + L" 的哈希不符");
+            Check(GetLE64(&sds[pos + 8]) == pos, name + L": $SDS 项 " + to_wstring(id) + L" 的偏移字段不符");
+            Check(pos + SDS_MIRROR_OFFSET + length <= sds.size()
+                && equal(sds.begin() + pos, sds.begin() + pos + length, sds.begin() + pos + SDS_MIRROR_OFFSET),
+                name + L": $SDS 项 " + to_wstring(id) + L" 与镜像不同");
+            Check(headers.emplace(id, vector<uint8_t>(sds.begin() + pos, sds.begin() + pos + 20)).second,
+                name + L": $SDS 中安全 ID " + to_wstring(id) + L" 重复");
+            pos = (pos + length + 15) & ~(size_t)15;
+        }
+        Check(!headers.empty(), name + L": $SDS 为空");
+
+        // 视图索引: 键之后的数据为 $SDS 项头
+        auto checkView = [&](const u16string& index, size_t keyLength) {
+            vector<vector<uint8_t>> entries;
+            if (!ReadIndex(secure, index, entries)) return;
+            wstring where = name + L": $Secure:" + (index == u"$SDH" ? L"$SDH" : L"$SII");
+            Check(entries.size() == headers.size(), where + L" 的项数与 $SDS 不同");
+
+            vector<uint8_t> previousKey;
+            for (const auto& e : entries) {
+                const size_t dataOffset = GetLE16(&e[0]);
+                const size_t dataLength = GetLE16(&e[2]);
+                if (GetLE16(&e[0x0A]) != keyLength || dataLength != 20 || dataOffset + dataLength > e.size()) {
+                    Fail(L"$Secure 视图索引项的键或数据长度无效");
+                    continue;
+                }
+
+                // $SDH 按 (哈希, ID), $SII 按 ID, 均为小端 32 位整数逐个比较
+                vector<uint8_t> key(e.begin() + 0x10, e.begin() + 0x10 + keyLength);
+                if (!previousKey.empty()) {
+                    bool less = false;
+                    for (size_t i = 0; i < keyLength; i += 4) {
+                        uint32_t a = GetLE32(&previousKey[i]);
+                        uint32_t b = GetLE32(&key[i]);
+                        if (a != b) {
+                            less = a < b;
+                            break;
+                        }
+                    }
+                    Check(less, where + L" 的项未按键排序");
+                }
+                previousKey = key;
+
+                vector<uint8_t> data(e.begin() + dataOffset, e.begin() + dataOffset + dataLength);
+                const uint32_t id = GetLE32(&key[keyLength - 4]);
+                Check(headers.count(id) && headers[id] == data, where + L" 中安全 ID " + to_wstring(id) + L" 的数据与 $SDS 不同");
+                if (keyLength == 8) Check(GetLE32(&key[0]) == GetLE32(&data[0]), where + L" 的键哈希与 $SDS 不同");
+            }
+        };
+        checkView(u"$SDH", 8);
+        checkView(u"$SII", 4);
+    }
+
+    NtfsReader read;
+    ULONGLONG base;
+    ULONGLONG partitionSize;
+    unsigned sectorSize;
+    wstring name;
+
+    vector<uint8_t> boot;
+    unsigned clusterBytes = 0;
+    unsigned recordBytes = 0;
+    unsigned indexBlockBytes = 0;
+    ULONGLONG clusterCount = 0;
+    vector<uint8_t> mftRaw;            // $MFT 的原始数据 (含更新序列), 与 $MFTMirr 比较
+    vector<Record> records;
+    vector<uint16_t> upcase;
+    map<uint32_t, int> indexed;
+};
+
+// ================================
+// 用例
+// ================================
+
+static const ULONGLONG MiB = 1024ULL * 1024;
+static const ULONGLONG PARTITION_OFFSET = 1 * MiB;
+
+struct Case {
+    const wchar_t* name;
+    unsigned sectorSize;
+    ULONGLONG clusterBytes;            // 0 为默认
+    ULONGLONG size;
+    vector<ULONGLONG> grows;           // 依次扩展到的分区大小
+};
+
+static void CheckImage(const ExtentList& image, ULONGLONG size, unsigned sectorSize, const wstring& name) {
+    NtfsReader read = [&](ULONGLONG offset, uint8_t* data, size_t length) {
+        image.Read(offset, data, length);
+        return true;
+    };
+    VolumeChecker(read, PARTITION_OFFSET, size, sectorSize, name).Run();
+}
+
+static void RunCase(const Case& c) {
+    wcout << L"▶ " << c.name << endl;
+
+    DiskLayout layout;
+    layout.sectorSize = c.sectorSize;
+    layout.formatTime = 132000000000000000ULL;
+
+    PlannedPartition partition;
+    partition.number = 1;
+    partition.offset = PARTITION_OFFSET;
+    partition.size = c.size;
+    partition.format = true;
+    partition.formatSpec.volumeLabel = L"Test";
+    partition.formatSpec.allocationUnitSize = c.clusterBytes;
+
+    ExtentList image;
+    if (!FormatNtfs(layout, partition, 0x1122334455667788ULL, image)) {
+        Check(false, wstring(c.name) + L": FormatNtfs 失败");
+        return;
+    }
+    CheckImage(image, c.size, c.sectorSize, c.name);
+
+    for (ULONGLONG size : c.grows) {
+        wstring name = wstring(c.name) + L" → " + to_wstring(size / MiB) + L"M";
+
+        vector<uint8_t> boot(c.sectorSize);
+        image.Read(PARTITION_OFFSET, boot.data(), boot.size());
+
+        ExtentList writes;
+        NtfsReader read = [&](ULONGLONG offset, uint8_t* data, size_t length) {
+            image.Read(offset, data, length);
+            return true;
+        };
+        if (!GrowNtfs(read, PARTITION_OFFSET, boot, size, writes)) {
+            Check(false, name + L": GrowNtfs 失败");
+            return;
+        }
+        for (const auto& entry : writes.Extents()) image.Write(entry.second.offset, entry.second.data);
+        CheckImage(image, size, c.sectorSize, name);
+    }
+}
+
+// ================================
+// raw 镜像
+// ================================
+
+// 按 GPT 检查镜像中的每个 NTFS 分区 (逻辑扇区 512 或 4096)
+static void CheckImageFile(const char* path) {
+    wstring name(path, path + strlen(path));
+    wcout << L"▶ " << name << endl;
+
+    ifstream file(path, ios::binary);
+    NtfsReader read = [&](ULONGLONG offset, uint8_t* data, size_t length) {
+        file.clear();
+        file.seekg((streamoff)offset);
+        file.read((char*)data, (streamsize)length);
+        return (size_t)file.gcount() == length;
+    };
+
+    for (unsigned sector : { 512u, 4096u }) {
+        vector<uint8_t> header(sector);
+        if (!read(sector, header.data(), header.size()) || memcmp(header.data(), "EFI PART", 8) != 0) continue;
+
+        const ULONGLONG entriesLba = GetLE64(&header[0x48]);
+        const uint32_t count = GetLE32(&header[0x50]);
+        const uint32_t entrySize = GetLE32(&header[0x54]);
+        vector<uint8_t> entries((size_t)count * entrySize);
+        if (entrySize < 128 || !read(entriesLba * sector, entries.data(), entries.size())) break;
+
+        int checked = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            const uint8_t* e = &entries[(size_t)i * entrySize];
+            const ULONGLONG first = GetLE64(e + 32);
+            const ULONGLONG last = GetLE64(e + 40);
+            if (first == 0 || last < first) continue;
+
+            vector<uint8_t> boot(sector);
+            if (!read(first * sector, boot.data(), boot.size()) || memcmp(&boot[3], "NTFS    ", 8) != 0) continue;
+
+            wstring partName = name + L" 分区 " + to_wstring(i + 1);
+            NtfsReader partRead = [&](ULONGLONG offset, uint8_t* data, size_t length) { return read(offset, data, length); };
+            VolumeChecker(partRead, first * sector, (last - first + 1) * sector, sector, partName).Run();
+            checked++;
+        }
+        Check(checked > 0, name + L": 没有 NTFS 分区");
+        return;
+    }
+    Check(false, name + L": 不是 GPT 镜像");
+}
+
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_U16TEXT);
+    _setmode(_fileno(stderr), _O_U16TEXT);
+#else
+    // 宽字符输出需要 UTF-8 locale
+    setlocale(LC_ALL, "");
+    if (strcmp(nl_langinfo(CODESET), "UTF-8") != 0) {
+        setlocale(LC_ALL, "C.UTF-8");
+    }
+#endif
+
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) CheckImageFile(argv[i]);
+    }
+    else {
+        const vector<Case> cases = {
+            { L"512/默认簇 256M", 512, 0, 256 * MiB, { 4096 * MiB } },
+            { L"512/64K 2G", 512, 64 * 1024, 2048 * MiB, { 3000 * MiB } },
+            { L"4Kn/默认簇 1G", 4096, 0, 1024 * MiB, { 1024 * MiB + 4096, 2048 * MiB } },
+            // 512 字节簇: 扩展时 $Bitmap 需要新簇, 第二次扩展再追加一个区段
+            { L"512/512 64M", 512, 512, 64 * MiB, { 1024 * MiB, 2048 * MiB } },
+        };
+        for (const auto& c : cases) RunCase(c);
+    }
+
+    if (failures > 0) {
+        wcerr << L"❌ " << failures << L" 项检查失败" << endl;
+        return 1;
+    }
+
+    wcout << L"✓ 全部通过" << endl;
+    return 0;
+}
@@ -0,0 +1,417 @@
+﻿/*
+ * provision_test: 针对模拟提供程序运行 ProvisionDisks 的回归测试
+ *
+ * 用例:
+ *   success      多盘并发分区+格式化全部成功, Snapshot() 中的分区与卷与布局一致
+ *   remaining-space  省略 size 的分区占用剩余空间
+ *   format-fail  --sim-fail=Format:1, 每盘都失败, 分区已创建但没有卷
+ *   partial-fail --sim-fail=CreatePartition:0.5, 成功的盘布局完整, 失败的盘没有卷
+ *   preflight    --sim-health 给出的高温/Warning 磁盘在预检中不合格, 只有其余磁盘被配置
+ *   pool-stripe  --pool 按 unit= 给出的簇大小选择列数与交错, 虚拟磁盘与卷的实际参数一致
+ *   audit        --sim-partitions 预置的 32256 字节偏移 (旧式 63 扇区) 被标为未对齐, 修复到 1 MiB
+ *   retrim       thin=1 的磁盘完全格式化后整个分区被分配, --retrim 把空闲簇归还给阵列
+ *   pool-rollback  --pool 的虚拟磁盘格式化失败, 虚拟磁盘与存储池被删除, 成员盘不再属于任何池
+ *
+ * 任一检查失败时退出码为 1。
+ */
+
+#include "audit.h"
+#include "cli.h"
+#include "preflight.h"
+#include "provision.h"
+#include "retrim.h"
+#include "sim_backend.h"
+#include "utils.h"
+
+#include <clocale>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <stdio.h>
+#else
+#include <cstring>
+#include <langinfo.h>
+#endif
+
+using namespace std;
+
+static int failures = 0;
+
+static void Check(bool condition, const wstring& what) {
+    if (!condition) {
+        wcerr << L"  ❌ " << what << endl;
+        failures++;
+    }
+}
+
+static CommandLineArgs MakeArgs(vector<wstring> argStrings) {
+    argStrings.insert(argStrings.begin(), L"disk_part_fmt");
+
+    vector<wchar_t*> argv;
+    for (auto& arg : argStrings) argv.push_back(&arg[0]);
+
+    CommandLineArgs args = ParseCommandLine((int)argv.size(), argv.data());
+    args.quiet = true;
+    return args;
+}
+
+static const vector<wstring> LAYOUT = {
+    L"--create-part=size=1G,label=Data",
+    L"--format=fs=ntfs,vol=Data,unit=64K",
+    L"--create-part=size=2G,label=Logs",
+    L"--format=fs=fat32,vol=LOGS",
+};
+
+static vector<wstring> WithLayout(vector<wstring> argStrings) {
+    argStrings.insert(argStrings.end(), LAYOUT.begin(), LAYOUT.end());
+    return argStrings;
+}
+
+// 按布局检查一块磁盘: 两个分区, 名称/大小/卷与格式化参数一致
+static void CheckProvisionedDisk(const SimDisk& disk) {
+    wstring prefix = L"磁盘 " + to_wstring(disk.number) + L": ";
+
+    Check(disk.partitionStyle == 2, prefix + L"未初始化为 GPT");
+    Check(disk.partitions.size() == 2, prefix + L"分区数 " + to_wstring(disk.partitions.size()) + L" != 2");
+    if (disk.partitions.size() != 2) return;
+
+    const SimPartition& data = disk.partitions[0];
+    const SimPartition& logs = disk.partitions[1];
+
+    Check(data.size == 1ULL << 30 && logs.size == 2ULL << 30, prefix + L"分区大小与布局不一致");
+    Check(data.offset + data.size <= logs.offset, prefix + L"分区重叠");
+    Check(data.offset % (1024 * 1024) == 0 && logs.offset % (1024 * 1024) == 0, prefix + L"分区未按 1 MiB 对齐");
+    Check(data.name == L"Data" && logs.name == L"Logs", prefix + L"GPT 分区名称与布局不一致");
+    Check(data.gptType == GUID_BASIC_DATA_PARTITION && logs.gptType == GUID_BASIC_DATA_PARTITION, prefix + L"分区类型不是基本数据分区");
+
+    Check(data.hasVolume && logs.hasVolume, prefix + L"缺少卷");
+    if (!data.hasVolume || !logs.hasVolume) return;
+
+    Check(data.volume.fileSystem == L"NTFS" && data.volume.label == L"Data", prefix + L"第 1 个卷的文件系统或卷标不符");
+    Check(data.volume.allocationUnitSize == 64 * 1024, prefix + L"第 1 个卷的簇大小不是 64K");
+    Check(logs.volume.fileSystem == L"FAT32" && logs.volume.label == L"LOGS", prefix + L"第 2 个卷的文件系统或卷标不符");
+    Check(data.driveLetter != 0 && logs.driveLetter != 0 && data.driveLetter != logs.driveLetter,
+        prefix + L"盘符未分配或重复");
+}
+
+static void TestSuccess() {
+    wcout << L"▶ success" << endl;
+
+    CommandLineArgs args = MakeArgs(WithLayout({ L"--sim=disks=4,size=64G", L"--disk=1-4", L"--concurrency=4" }));
+    Check(!args.invalid, L"参数解析失败");
+
+    SimulatedStorage storage(args.simConfig);
+    vector<ProvisionResult> results = ProvisionDisks(storage.Factory(), args);
+
+    Check(results.size() == 4, L"结果数 " + to_wstring(results.size()) + L" != 4");
+    for (const auto& result : results) {
+        Check(result.success, L"磁盘 " + to_wstring(result.diskNumber) + L" 失败");
+        Check(result.finished > result.started, L"磁盘 " + to_wstring(result.diskNumber) + L" 的虚拟耗时为 0");
+    }
+
+    vector<SimDisk> disks = storage.Snapshot();
+    Check(disks.size() == 4, L"快照中的磁盘数 " + to_wstring(disks.size()) + L" != 4");
+    for (const auto& disk : disks) CheckProvisionedDisk(disk);
+}
+
+static void TestRemainingSpace() {
+    wcout << L"▶ remaining-space" << endl;
+
+    // 省略 size: CreatePartition 以 UseMaximumSize 占用剩余空间
+    CommandLineArgs args = MakeArgs({ L"--sim=disks=1,size=64G", L"--disk=1",
+        L"--create-part=size=1G,label=Boot", L"--format=fs=fat32,vol=BOOT",
+        L"--create-part=label=Rest", L"--format=fs=ntfs,vol=Rest" });
+    Check(!args.invalid, L"参数解析失败");
+
+    SimulatedStorage storage(args.simConfig);
+    vector<ProvisionResult> results = ProvisionDisks(storage.Factory(), args);
+    Check(results.size() == 1 && results[0].success, L"省略 size 的分区创建失败");
+
+    vector<SimDisk> disks = storage.Snapshot();
+    if (disks.size() != 1 || disks[0].partitions.size() != 2) {
+        Check(false, L"省略 size 时分区数不是 2");
+        return;
+    }
+    const SimPartition& rest = disks[0].partitions[1];
+    Check(rest.name == L"Rest" && rest.hasVolume, L"剩余空间分区的名称或卷不符");
+    Check(rest.offset + rest.size + 2 * 1024 * 1024 > disks[0].size, L"剩余空间分区没有延伸到磁盘末尾");
+}
+
+static void TestFormatFailure() {
+    wcout << L"▶ format-fail" << endl;
+
+    CommandLineArgs args = MakeArgs(WithLayout({ L"--sim=disks=2,size=64G", L"--disk=1-2", L"--concurrency=2", L"--sim-fail=Format:1" }));
+    Check(!args.invalid, L"参数解析失败");
+
+    SimulatedStorage storage(args.simConfig);
+    vector<ProvisionResult> results = ProvisionDisks(storage.Factory(), args);
+
+    Check(results.size() == 2, L"结果数 " + to_wstring(results.size()) + L" != 2");
+    for (const auto& result : results) {
+        Check(!result.success, L"磁盘 " + to_wstring(result.diskNumber) + L" 注入格式化失败后仍报告成功");
+    }
+
+    // 第一次格式化失败即停止: 只有第一个分区, 且没有卷
+    for (const auto& disk : storage.Snapshot()) {
+        wstring prefix = L"磁盘 " + to_wstring(disk.number) + L": ";
+        Check(disk.partitions.size() == 1, prefix + L"格式化失败后仍继续创建分区");
+        for (const auto& part : disk.partitions) {
+            Check(!part.hasVolume, prefix + L"格式化失败的分区上出现了卷");
+        }
+    }
+}
+
+static void TestPartialFailure() {
+    wcout << L"▶ partial-fail" << endl;
+
+    // 注入的随机数按会话创建顺序取种子, 单线程时哪些盘失败是确定的
+    CommandLineArgs args = MakeArgs(WithLayout({
+        L"--sim=disks=8,size=64G,seed=7", L"--disk=1-8", L"--sim-fail=CreatePartition:0.5" }));
+    Check(!args.invalid, L"参数解析失败");
+
+    SimulatedStorage storage(args.simConfig);
+    vector<ProvisionResult> results = ProvisionDisks(storage.Factory(), args);
+
+    map<int, bool> success;
+    for (const auto& result : results) success[result.diskNumber] = result.success;
+
+    size_t succeeded = 0;
+    for (const auto& entry : success) {
+        if (entry.second) succeeded++;
+    }
+    Check(succeeded > 0 && succeeded < success.size(),
+        L"失败率 0.5 下 8 块盘的成功数为 " + to_wstring(succeeded) + L", 注入未生效");
+
+    for (const auto& disk : storage.Snapshot()) {
+        if (success[disk.number]) {
+            CheckProvisionedDisk(disk);
+            continue;
+        }
+
+        // 失败的盘: 布局未完成
+        size_t volumes = 0;
+        for (const auto& part : disk.partitions) {
+            if (part.hasVolume) volumes++;
+        }
+        Check(volumes < 2, L"磁盘 " + to_wstring(disk.number) + L": 报告失败但布局完整");
+    }
+}
+
+static void TestPreflight() {
+    wcout << L"▶ preflight" << endl;
+
+    CommandLineArgs args = MakeArgs(WithLayout({ L"--sim=disks=4,size=64G", L"--disk=1-4", L"--preflight",
+        L"--sim-health=2:temp=71", L"--sim-health=3:health=warning" }));
+    Check(!args.invalid, L"参数解析失败");
+
+    SimulatedStorage storage(args.simConfig);
+    PreflightProbe probe;
+    probe.read = [&storage](int diskNumber, ULONGLONG, int samples, vector<double>& latenciesMs) {
+        return storage.ProbeRead(diskNumber, samples, latenciesMs);
+    };
+    probe.simulated = true;
+
+    vector<PreflightResult> preflight = RunPreflight(storage.Factory(), args.diskNumbers, args.preflight, probe, 4);
+    Check(preflight.size() == 4, L"预检结果数 " + to_wstring(preflight.size()) + L" != 4");
+
+    // 与主程序的 action=exclude 相同: 只配置通过预检的磁盘
+    vector<int> passed;
+    for (const auto& result : preflight) {
+        bool expected = result.diskNumber != 2 && result.diskNumber != 3;
+        Check(result.Passed() == expected, L"磁盘 " + to_wstring(result.diskNumber) + (expected ? L": 健康磁盘未通过预检" : L": 未被预检排除"));
+        if (result.diskNumber == 2) Check(result.temperature == 71, L"磁盘 2: 预检未读到 71°C 的温度");
+        if (result.diskNumber == 3) Check(result.healthStatus == 1, L"磁盘 3: 预检未读到 Warning 健康状态");
+        if (result.Passed()) passed.push_back(result.diskNumber);
+    }
+    args.diskNumbers = passed;
+
+    vector<ProvisionResult> results = ProvisionDisks(storage.Factory(), args);
+    Check(results.size() == 2, L"配置的磁盘数 " + to_wstring(results.size()) + L" != 2");
+
+    for (const auto& disk : storage.Snapshot()) {
+        if (disk.number == 2 || disk.number == 3) {
+            Check(disk.partitions.empty(), L"磁盘 " + to_wstring(disk.number) + L": 已排除的磁盘被修改");
+        }
+        else {
+            CheckProvisionedDisk(disk);
+        }
+    }
+}
+
+static void TestPoolStripe() {
+    wcout << L"▶ pool-stripe" << endl;
+
+    const ULONGLONG KB = 1024;
+    struct Case {
+        const wchar_t* unit;
+        ULONGLONG clusterBytes;
+        int columns;
+        ULONGLONG interleave;
+    };
+    const Case cases[] = {
+        { L"256K", 256 * KB, 8, 32 * KB },      // 8 块盘: 256K / 8 列 = 32K 交错
+        { L"64K",  64 * KB,  4, 16 * KB },      // 8 列时交错 8K 低于 16K, 减为 4 列
+    };
+
+    for (const auto& c : cases) {
+        wstring prefix = wstring(L"unit=") + c.unit + L": ";
+
+        CommandLineArgs args = MakeArgs({ L"--sim=disks=8,size=64G", L"--disk=1-8", L"--pool=name=Stripe",
+            L"--create-part=label=Data", wstring(L"--format=fs=ntfs,vol=Data,unit=") + c.unit });
+        Check(!args.invalid, prefix + L"参数解析失败");
+
+        SimulatedStorage storage(args.simConfig);
+        PooledDisk pooled;
+        if (!ProvisionPool(storage.Factory(), args, pooled)) {
+            Check(false, prefix + L"存储池创建失败");
+            continue;
+        }
+
+        vector<ProvisionResult> results = ProvisionDisks(storage.Factory(), args);
+        Check(results.size() == 1 && results[0].success, prefix + L"虚拟磁盘的分区/格式化失败");
+
+        vector<SimPool> pools = storage.PoolSnapshot();
+        if (pools.size() != 1 || pools[0].virtualDisks.size() != 1) {
+            Check(false, prefix + L"存储池或虚拟磁盘数不是 1");
+            continue;
+        }
+        const SimVirtualDisk& vd = pools[0].virtualDisks[0];
+        Check(vd.columns == c.columns, prefix + L"列数 " + to_wstring(vd.columns) + L" != " + to_wstring(c.columns));
+        Check(vd.interleave == c.interleave, prefix + L"交错 " + FormatBytes(vd.interleave) + L" != " + FormatBytes(c.interleave));
+        Check(vd.interleave * (ULONGLONG)vd.columns == c.clusterBytes, prefix + L"条带宽度不等于簇大小");
+
+        for (const auto& disk : storage.Snapshot()) {
+            if (disk.number != vd.diskNumber) continue;
+            bool formatted = disk.partitions.size() == 1 && disk.partitions[0].hasVolume;
+            Check(formatted, prefix + L"虚拟磁盘上没有格式化的卷");
+            if (formatted) {
+                Check(disk.partitions[0].volume.allocationUnitSize == c.clusterBytes, prefix + L"卷的簇大小与 unit= 不一致");
+            }
+        }
+    }
+}
+
+static void TestAudit() {
+    wcout << L"▶ audit" << endl;
+
+    const ULONGLONG MB = 1024 * 1024;
+    CommandLineArgs args = MakeArgs({ L"--sim=disks=2,size=64G,sector=512/4096", L"--disk=1-2", L"--audit",
+        L"--sim-partitions=1:32256+10G", L"--sim-partitions=2:1M+10G" });
+    Check(!args.invalid, L"参数解析失败");
+
+    SimulatedStorage storage(args.simConfig);
+    vector<AuditDisk> disks = RunAudit(storage.Factory(), args.diskNumbers, args.audit, 2);
+    if (disks.size() != 2 || disks[0].partitions.size() != 1 || disks[1].partitions.size() != 1) {
+        Check(false, L"审计结果应为 2 块磁盘各 1 个分区");
+        return;
+    }
+
+    const AuditPartition& legacy = disks[0].partitions[0];
+    Check(disks[0].error.empty() && disks[0].Misaligned() == 1, L"磁盘 1: 32256 偏移未被标为未对齐");
+    Check(legacy.offset == 32256 && !legacy.Aligned(), L"磁盘 1: 分区偏移或对齐结论不符");
+    Check(legacy.penalty > 1.0, L"磁盘 1: 错位分区没有读-改-写惩罚");
+    bool physicalMisaligned = false;
+    for (const auto& check : legacy.checks) {
+        if (check.unit == L"physical") physicalMisaligned = check.remainder == 32256 % 4096;
+    }
+    Check(physicalMisaligned, L"磁盘 1: 物理扇区检查的余数不是 3584");
+    Check(legacy.targetOffset == MB && legacy.targetSize == legacy.size - (MB - 32256),
+        L"磁盘 1: 修复方案不是起点后移到 1 MiB 并相应缩小");
+
+    Check(disks[1].error.empty() && disks[1].Misaligned() == 0 && disks[1].partitions[0].Aligned(),
+        L"磁盘 2: 1 MiB 偏移被误报为未对齐");
+}
+
+static void TestRetrim() {
+    wcout << L"▶ retrim" << endl;
+
+    const ULONGLONG MB = 1024 * 1024;
+    CommandLineArgs args = MakeArgs({ L"--sim=disks=2,size=16G,thin=1", L"--disk=1-2", L"--retrim",
+        L"--create-part=size=4G,label=Data", L"--format=fs=ntfs,vol=Data,quick=0" });
+    Check(!args.invalid, L"参数解析失败");
+
+    SimulatedStorage storage(args.simConfig);
+    vector<ProvisionResult> provisioned = ProvisionDisks(storage.Factory(), args);
+    for (const auto& result : provisioned) {
+        Check(result.success, L"磁盘 " + to_wstring(result.diskNumber) + L" 完全格式化失败");
+    }
+
+    vector<RetrimResult> results = RunRetrim(storage.Factory(), args.diskNumbers, 2);
+    Check(results.size() == 2, L"回收结果数 " + to_wstring(results.size()) + L" != 2");
+
+    for (const auto& result : results) {
+        wstring prefix = L"磁盘 " + to_wstring(result.diskNumber) + L": ";
+        Check(result.Succeeded() && result.IsThin(), prefix + L"回收失败或未报告为精简置备");
+        Check(result.volumes.size() == 1 && result.TrimmedBytes() > 0, prefix + L"没有对卷执行 ReTrim");
+
+        // 完全格式化写满整个分区; 回收后只剩元数据所在的分配单元
+        Check(result.allocatedBefore >= 4096 * MB, prefix + L"完全格式化后已分配 " + FormatBytes(result.allocatedBefore) + L" < 4 GB");
+        Check(result.allocatedAfter < 64 * MB, prefix + L"回收后仍分配 " + FormatBytes(result.allocatedAfter));
+        Check(result.ReturnedBytes() + 64 * MB > result.TrimmedBytes(), prefix + L"归还量 " + FormatBytes(result.ReturnedBytes())
+            + L" 明显少于回收范围 " + FormatBytes(result.TrimmedBytes()));
+    }
+}
+
+static void TestPoolRollback() {
+    wcout << L"▶ pool-rollback" << endl;
+
+    CommandLineArgs args = MakeArgs({ L"--sim=disks=4,size=64G", L"--disk=1-4", L"--pool=name=Scratch",
+        L"--create-part=label=Data", L"--format=fs=ntfs,vol=Data", L"--sim-fail=Format:1" });
+    Check(!args.invalid, L"参数解析失败");
+
+    SimulatedStorage storage(args.simConfig);
+    PooledDisk pooled;
+    if (!ProvisionPool(storage.Factory(), args, pooled)) {
+        Check(false, L"存储池创建失败");
+        return;
+    }
+    Check(storage.PoolSnapshot().size() == 1, L"存储池未建立");
+
+    vector<ProvisionResult> results = ProvisionDisks(storage.Factory(), args);
+    Check(results.size() == 1 && !results[0].success, L"注入格式化失败后虚拟磁盘仍报告成功");
+
+    Check(RollbackPool(storage.Factory(), args, pooled), L"回滚报告失败");
+    Check(storage.PoolSnapshot().empty(), L"回滚后仍残留存储池");
+
+    vector<SimDisk> disks = storage.Snapshot();
+    Check(disks.size() == 4, L"回滚后的磁盘数 " + to_wstring(disks.size()) + L" != 4 (虚拟磁盘未删除)");
+    for (const auto& disk : disks) {
+        Check(!disk.isVirtual && disk.poolId == 0, L"磁盘 " + to_wstring(disk.number) + L": 回滚后仍属于存储池");
+    }
+}
+
+int main() {
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_U16TEXT);
+    _setmode(_fileno(stderr), _O_U16TEXT);
+#else
+    // 宽字符输出需要 UTF-8 locale
+    setlocale(LC_ALL, "");
+    if (strcmp(nl_langinfo(CODESET), "UTF-8") != 0) {
+        setlocale(LC_ALL, "C.UTF-8");
+    }
+#endif
+
+    TestSuccess();
+    TestRemainingSpace();
+    TestFormatFailure();
+    TestPartialFailure();
+    TestPreflight();
+    TestPoolStripe();
+    TestAudit();
+    TestRetrim();
+    TestPoolRollback();
+
+    if (failures > 0) {
+        wcerr << L"❌ " << failures << L" 项检查失败" << endl;
+        return 1;
+    }
+
+    wcout << L"✓ 全部通过" << endl;
+    return 0;
+}